@@ -9,6 +9,12 @@
 /// for cases when a pool of the requested size class is empty. A size class
 /// is a power of 2.  This allocator is not suitable for shared memory
 /// interprocess allocations.
+///
+/// Each thread keeps a magazine (a small local stack of free chunks) per
+/// size class, so that most allocations and deallocations don't touch
+/// shared memory.  Magazines are exchanged with the global per-class depots
+/// in bulk: a thread whose magazine is empty takes a full one from the
+/// depot, and a thread that freed too many chunks returns a full one.
 //----------------------------------------------------------------------------
 // Created: 2009-11-21
 //----------------------------------------------------------------------------
@@ -45,6 +51,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/atomic.hpp>
 #include <utxx/container/concurrent_stack.hpp>
 #include <utxx/compiler_hints.hpp>
+#include <utxx/thread_local.hpp>
+#include <atomic>
 #ifdef DEBUG
 #include <iomanip>
 #endif
@@ -54,6 +62,8 @@ namespace memory {
 
 using namespace container;
 
+namespace detail { struct cached_allocator_tag {}; }
+
 //-----------------------------------------------------------------------------
 // CACHED_ALLOCATOR
 //-----------------------------------------------------------------------------
@@ -67,25 +77,96 @@ using namespace container;
 /// @tparam   SizeClasses - Max number of size class managed by the allocator.
 ///                         Objects of size >= 2^SizeClasses are allocated/freed
 ///                         directly using the AllocT bypassing caching.
+/// @tparam   MagazineSize - Max number of chunks in a thread's magazine
+///                         (0 disables magazines).  Magazines of large size
+///                         classes are smaller, so that a magazine holds no
+///                         more than s_magazine_bytes, and chunks larger than
+///                         s_magazine_bytes/2 bypass magazines.
 template <
     class T, 
     class AllocT        = std::allocator<T>,
     int   MinSize       = 3 * sizeof(long), 
-    int   SizeClasses   = 21>
+    int   SizeClasses   = 21,
+    int   MagazineSize  = 32>
 class cached_allocator {
     typedef typename AllocT::template rebind<T>::other UserAllocT;
     typedef versioned_stack::node_t node_t;
 
+    /// Header of a full magazine stored in the data area of its first node,
+    /// which is pushed to the depot (the rest are linked through "next")
+    struct magazine {
+        node_t* rest;
+        size_t  count;
+    };
+
+    /// Thread's magazine of a size class
+    struct class_cache {
+        node_t*               head;
+        size_t                count;
+        // Written by the owning thread only, read by stats()
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+
+        class_cache() : head(NULL), count(0), hits(0), misses(0) {}
+    };
+
+    struct thread_cache {
+        cached_allocator* m_parent;
+        class_cache       m_classes[SizeClasses];
+
+        explicit thread_cache(cached_allocator* a_parent) : m_parent(a_parent) {}
+
+        // Return the chunks to the depots on thread exit
+        ~thread_cache() { if (m_parent) m_parent->flush(*this); }
+    };
+
+    /// Shared counters of a size class
+    struct class_counters {
+        std::atomic<uint64_t> hits;     // Of exited threads
+        std::atomic<uint64_t> misses;   // Of exited threads
+        std::atomic<uint64_t> refills;
+        std::atomic<uint64_t> flushes;
+
+        class_counters() : hits(0), misses(0), refills(0), flushes(0) {}
+    };
+
+    static const size_t s_min_class =
+        log<upper_power<MinSize, 2>::value, 2>::value;
+
+    BOOST_STATIC_ASSERT((1u << s_min_class) >= sizeof(node_t) + sizeof(magazine));
+
     versioned_stack  m_freelist[SizeClasses];
+    versioned_stack  m_depot[SizeClasses];      ///< Full magazines
+    class_counters   m_counters[SizeClasses];
     UserAllocT&      m_alloc;
     volatile long    m_large_objects;
+    thr_local_ptr<thread_cache, detail::cached_allocator_tag>
+                     m_cache;   // Must be last for dtor ordering
 
     static UserAllocT& default_allocator() {
         static std::allocator<T> allocator;
         return allocator;
     }
 
+    static size_t size_class_of(size_t a_alloc_sz) {
+        return a_alloc_sz <= (1u << s_min_class)
+             ? s_min_class : math::upper_log2(a_alloc_sz);
+    }
+
     void* alloc_size_class(size_t size_class);
+
+    thread_cache* local_cache() {
+        thread_cache* c = m_cache.get();
+        if (unlikely(c == NULL)) {
+            c = new thread_cache(this);
+            m_cache.reset(c);
+        }
+        return c;
+    }
+
+    bool refill(class_cache& a_cache, size_t a_size_class);
+    void flush_magazine(class_cache& a_cache, size_t a_size_class, size_t a_count);
+    void flush(thread_cache& a_cache);
 public:
     typedef ::std::size_t    size_type;
     typedef ::std::ptrdiff_t difference_type;
@@ -104,15 +185,36 @@ public:
     static const unsigned int max_size_class = SizeClasses-1;
     static const unsigned int min_size       = MinSize;
 
+    /// Max number of bytes in a magazine
+    static const size_t       s_magazine_bytes = 64 * 1024;
+
     template <typename U>
     struct rebind {
         typedef typename AllocT::template rebind<U>::other ArenaAlloc;
-        typedef cached_allocator<U, ArenaAlloc, MinSize, SizeClasses> other;
+        typedef cached_allocator<U, ArenaAlloc, MinSize, SizeClasses, MagazineSize> other;
+    };
+
+    /// Allocation statistics of a size class
+    struct class_stats {
+        uint64_t hits;      ///< Allocations served from a thread's magazine
+        uint64_t misses;    ///< Allocations finding a thread's magazine empty
+        uint64_t refills;   ///< Full magazines taken from the depot
+        uint64_t flushes;   ///< Full magazines returned to the depot
     };
 
     cached_allocator() : m_alloc(default_allocator()), m_large_objects(0) {}
     cached_allocator(AllocT& alloc) : m_alloc(alloc),  m_large_objects(0) {}
 
+    /// The copy shares the user allocator but not the cached chunks
+    /// (chunks can be freed by any instance).
+    cached_allocator(const cached_allocator& a)
+        : m_alloc(a.m_alloc), m_large_objects(0) {}
+
+    ~cached_allocator() {
+        for (auto& cache : m_cache.access_all_threads())
+            cache.m_parent = NULL;
+    }
+
     /// Allocate a count number of objects T. This operation is thread-safe.
     T* allocate(size_t count);
 
@@ -149,6 +251,16 @@ public:
         return node_t::to_node(p)->size_class();
     }
 
+    /// Number of chunks in a full magazine of the size class
+    static size_t magazine_size(size_t a_size_class) {
+        size_t n = std::min<size_t>(MagazineSize, s_magazine_bytes >> a_size_class);
+        return n < 2 ? 0 : n;
+    }
+
+    /// Allocation statistics of the size class summed over all threads.
+    /// It's a best-effort snapshot, since other threads keep updating them.
+    class_stats stats(size_t a_size_class) const;
+
     #ifdef DEBUG
     void dump() const;
     #endif
@@ -158,21 +270,18 @@ public:
 // IMPLEMENTATION
 //-----------------------------------------------------------------------------
 
-template <class T, class AllocT, int MinSize, int SizeClasses>
-inline T* cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+inline T* cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::allocate(size_t count) 
 {
     using namespace container;
 
     size_t alloc_sz = sizeof(T)*count + versioned_stack::header_size();
-    char size_class = (alloc_sz < min_size)
-              ? upper_power<min_size, 2>::value 
-              : math::upper_log2(alloc_sz);
-    return static_cast<T*>(alloc_size_class(size_class));
+    return static_cast<T*>(alloc_size_class(size_class_of(alloc_sz)));
 }
 
-template <class T, class AllocT, int MinSize, int SizeClasses>
-inline void cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+inline void cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::free(void* p)
 {
     using namespace container;
@@ -183,8 +292,8 @@ inline void cached_allocator<T, AllocT, MinSize, SizeClasses>
     free_node(nd);
 }
 
-template <class T, class AllocT, int MinSize, int SizeClasses>
-void* cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void* cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::reallocate(void* p, size_t sz) 
 {
     using namespace container;
@@ -196,11 +305,8 @@ void* cached_allocator<T, AllocT, MinSize, SizeClasses>
 
     BOOST_ASSERT(nd->valid());
 
-    char old_size_class = nd->size_class();
-    size_t alloc_sz     = sz + versioned_stack::header_size();
-    char new_size_class = (alloc_sz < min_size)
-                        ? log<min_size, 2>::value
-                        : math::upper_log2(alloc_sz);
+    size_t old_size_class = nd->size_class();
+    size_t new_size_class = size_class_of(sz + versioned_stack::header_size());
     if (new_size_class <= old_size_class)
         return p;
 
@@ -211,22 +317,42 @@ void* cached_allocator<T, AllocT, MinSize, SizeClasses>
     // Copy old data
     node_t* nnd = node_t::to_node(pnew);
     void* data = nnd->data();
-    memcpy(data, nd->data(), old_size_class - versioned_stack::header_size());
+    memcpy(data, nd->data(), (1u << old_size_class) - versioned_stack::header_size());
     // Free old node
     free(p);
     return data;
 }
 
-template <class T, class AllocT, int MinSize, int SizeClasses>
-void* cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void* cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::alloc_size_class(size_t size_class) 
 {
     using namespace container;
 
-    size_t size = 1 << size_class;
+    size_t  size = 1ul << size_class;
+    node_t* nd   = NULL;
+
+    if (likely(size_class <= max_size_class)) {
+        if (magazine_size(size_class)) {
+            class_cache& c = local_cache()->m_classes[size_class];
+            // Only the owning thread updates the counters
+            if (likely(c.head != NULL))
+                c.hits.store(c.hits.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+            else
+                refill(c, size_class);
+
+            if (likely(c.head != NULL)) {
+                nd       = c.head;
+                c.head   = nd->next;
+                nd->next = NULL;
+                --c.count;
+                return nd->data();
+            }
+        }
+        nd = m_freelist[size_class].pop();
+    }
 
-    node_t* nd = unlikely(size_class > max_size_class)
-                                ? NULL : m_freelist[size_class].pop();
     if (nd == NULL) {
         nd = reinterpret_cast<node_t*>(m_alloc.allocate(size));
         BOOST_ASSERT((reinterpret_cast<unsigned long>(nd) &
@@ -238,8 +364,8 @@ void* cached_allocator<T, AllocT, MinSize, SizeClasses>
     return nd->data();
 }
 
-template <class T, class AllocT, int MinSize, int SizeClasses>
-void cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::free_node(node_t* nd)
 {
     using namespace container;
@@ -249,17 +375,103 @@ void cached_allocator<T, AllocT, MinSize, SizeClasses>
     char size_class = nd->size_class();
 
     if (unlikely((uint8_t)size_class > max_size_class)) {
-        m_alloc.deallocate(reinterpret_cast<T*>(nd), 1 << size_class);
+        m_alloc.deallocate(reinterpret_cast<T*>(nd), 1ul << size_class);
         atomic::add(&m_large_objects, -1);
         return;
     }
 
+    if (size_t n = magazine_size(size_class)) {
+        class_cache& c = local_cache()->m_classes[(uint8_t)size_class];
+        nd->next = c.head;
+        c.head   = nd;
+        // Keep a magazine worth of chunks for subsequent allocations
+        if (unlikely(++c.count >= 2*n))
+            flush_magazine(c, size_class, n);
+        return;
+    }
+
     m_freelist[(uint8_t)size_class].push(nd);
 }
 
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+bool cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
+::refill(class_cache& a_cache, size_t a_size_class)
+{
+    a_cache.misses.store(a_cache.misses.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+
+    node_t* nd = m_depot[a_size_class].pop();
+    if (!nd)
+        return false;
+
+    magazine* mg  = static_cast<magazine*>(nd->data());
+    nd->next      = mg->rest;
+    a_cache.head  = nd;
+    a_cache.count = mg->count;
+    m_counters[a_size_class].refills.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
+::flush_magazine(class_cache& a_cache, size_t a_size_class, size_t a_count)
+{
+    BOOST_ASSERT(a_count && a_count <= a_cache.count);
+
+    // Detach a_count chunks from the top of the thread's stack
+    node_t* head = a_cache.head;
+    node_t* tail = head;
+    for (size_t i = 1; i < a_count; ++i)
+        tail = tail->next;
+
+    a_cache.head   = tail->next;
+    a_cache.count -= a_count;
+    tail->next     = NULL;
+
+    magazine* mg = static_cast<magazine*>(head->data());
+    mg->rest     = head->next;
+    mg->count    = a_count;
+    m_depot[a_size_class].push(head);
+    m_counters[a_size_class].flushes.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
+::flush(thread_cache& a_cache)
+{
+    for (size_t i = 0; i < SizeClasses; ++i) {
+        class_cache&    c   = a_cache.m_classes[i];
+        class_counters& cnt = m_counters[i];
+        if (c.count)
+            flush_magazine(c, i, c.count);
+        cnt.hits  .fetch_add(c.hits.load(std::memory_order_relaxed),   std::memory_order_relaxed);
+        cnt.misses.fetch_add(c.misses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+typename cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>::class_stats
+cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
+::stats(size_t a_size_class) const
+{
+    BOOST_ASSERT(a_size_class < SizeClasses);
+    const class_counters& cnt = m_counters[a_size_class];
+    class_stats res = {
+        cnt.hits   .load(std::memory_order_relaxed),
+        cnt.misses .load(std::memory_order_relaxed),
+        cnt.refills.load(std::memory_order_relaxed),
+        cnt.flushes.load(std::memory_order_relaxed)
+    };
+    for (auto& cache : m_cache.access_all_threads()) {
+        res.hits   += cache.m_classes[a_size_class].hits  .load(std::memory_order_relaxed);
+        res.misses += cache.m_classes[a_size_class].misses.load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
 #ifdef DEBUG
-template <class T, class AllocT, int MinSize, int SizeClasses>
-void cached_allocator<T, AllocT, MinSize, SizeClasses>
+template <class T, class AllocT, int MinSize, int SizeClasses, int MagazineSize>
+void cached_allocator<T, AllocT, MinSize, SizeClasses, MagazineSize>
 ::dump() const
 {
     std::cout
@@ -267,7 +479,11 @@ void cached_allocator<T, AllocT, MinSize, SizeClasses>
         << "Free lists...: ";
     for (size_t i = 0; i < SizeClasses; ++i) {
         if (i > 0) std::cout << "               ";
-        std::cout << '[' << std::setw(2) << i << "]: " << cache_size(i) << std::endl;
+        class_stats st = stats(i);
+        std::cout << '[' << std::setw(2) << i << "]: " << cache_size(i)
+                  << " (hits=" << st.hits << ", misses=" << st.misses
+                  << ", refills=" << st.refills << ", flushes=" << st.flushes
+                  << ')' << std::endl;
     }
 }
 #endif
@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <boost/noncopyable.hpp>
 #include <boost/cstdint.hpp>
 #include <utxx/atomic.hpp>
+#include <utxx/page_backing.hpp>
 #include <stdlib.h>
 #ifdef _ALLOCATOR_MEM_DEBUG
 #include <stdio.h>
@@ -54,6 +55,10 @@ namespace memory {
  * deallocation method is very weak for cases when some of the
  * objects in the page have short lifetime and some have long
  * lifetime.
+ *
+ * By default the pages are allocated on the heap.  Alternatively
+ * they can come from a page_backing, which can back them by huge
+ * pages, bind them to a NUMA node, lock and prefault them.
  */
 template <
       typename T
@@ -65,7 +70,8 @@ class aligned_page_allocator : public boost::noncopyable {
         const uint32_t magic;       ///< Magic version that must match s_magic.
         T*             avail_chunk; ///< Next available chunk on this page
         long           alloc_count; ///< Number of allocated chunks on this page
-        header() : magic(s_magic) {}
+        page_backing*  backing;     ///< Owner of the page (NULL - the heap)
+        header(page_backing* a_backing) : magic(s_magic), backing(a_backing) {}
     };
 
     typedef std::allocator<T> base;
@@ -79,25 +85,30 @@ class aligned_page_allocator : public boost::noncopyable {
     BOOST_STATIC_ASSERT(s_begin_offset < PageSize);
     BOOST_STATIC_ASSERT(s_max_chunks > 0);
 
-    header* m_page;
+    page_backing* m_backing;
+    header*       m_page;
 
-    static header* page_alloc() {
+    header* page_alloc() {
         union {
             unsigned long n;
             void*   pp;
             char*   pc;
             header* p;
         } u;
-        #if defined(_WIN32) || defined (_WIN64)
-        u.pp = _aligned_malloc(PageSize, PageSize);
-        if (!u.pp)
-            throw std::bad_alloc();
-        #else
-        if (posix_memalign(&u.pp, PageSize, PageSize) < 0)
-            throw std::bad_alloc();
-        #endif
+        if (m_backing)
+            u.pp = m_backing->allocate();
+        else {
+            #if defined(_WIN32) || defined (_WIN64)
+            u.pp = _aligned_malloc(PageSize, PageSize);
+            if (!u.pp)
+                throw std::bad_alloc();
+            #else
+            if (posix_memalign(&u.pp, PageSize, PageSize) < 0)
+                throw std::bad_alloc();
+            #endif
+        }
         BOOST_ASSERT((u.n & s_page_mask) == 0);
-        new (u.p) header();
+        new (u.p) header(m_backing);
         u.p->avail_chunk = reinterpret_cast<T*>(u.pc + s_begin_offset);
         u.p->alloc_count = 0;
         #ifdef _ALLOCATOR_MEM_DEBUG
@@ -111,6 +122,11 @@ class aligned_page_allocator : public boost::noncopyable {
         printf("Freeing page %p\n", p);
         #endif
 
+        if (p->backing) {
+            p->backing->deallocate(p);
+            return;
+        }
+
         #if defined(_WIN32) || defined (_WIN64)
         _aligned_free(p);
         #else
@@ -131,11 +147,20 @@ public:
         typedef aligned_page_allocator<U, PageSize> other;
     };
 
-    aligned_page_allocator() : m_page(page_alloc()) {
+    /// @param a_backing store of pages (NULL - allocate pages on the heap).
+    ///                  Its page size must be PageSize.
+    explicit aligned_page_allocator(page_backing* a_backing = NULL)
+        : m_backing(a_backing)
+        , m_page((!a_backing || a_backing->page_size() == PageSize)
+                 ? page_alloc() : NULL)
+    {
         #ifdef _ALLOCATOR_MEM_DEBUG
         printf("Page size: %d\n", PageSize);
         #endif
 
+        if (a_backing && a_backing->page_size() != PageSize)
+            UTXX_THROW_BADARG_ERROR("Page size of the backing ",
+                a_backing->page_size(), " doesn't match ", PageSize);
         if (!m_page)
             throw std::bad_alloc();
     }
@@ -148,7 +173,7 @@ public:
     }
 
     pointer allocate(size_type n, const void *hint = 0) {
-        if (m_page->avail_chunk >= reinterpret_cast<pointer>(
+        if (m_page->avail_chunk + 1 > reinterpret_cast<pointer>(
                 reinterpret_cast<char*>(m_page) + PageSize))
             m_page = page_alloc();
 
@@ -167,7 +192,8 @@ public:
         printf("  Deallocating %p, page=%p\n", p, h);
         #endif
         BOOST_ASSERT(h->magic == header::s_magic);
-        if (atomic::add(&h->alloc_count, -1) == 0 && h != m_page)
+        // atomic::add() returns the previous value
+        if (atomic::add(&h->alloc_count, -1) == 1 && h != m_page)
             page_free(h);
     }
 
@@ -180,6 +206,7 @@ public:
      }
 
      const header* address() const { return m_page; }
+     page_backing* backing() const { return m_backing; }
 };
 
 } // namespace memory
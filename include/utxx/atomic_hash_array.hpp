@@ -286,8 +286,9 @@ private:
         simple_ret_t() {}
     };
 
+    // a_force ignores max_load_factor (used for moving entries by rehash)
     template <class T>
-    simple_ret_t internal_insert(const KeyT& key, T&& value);
+    simple_ret_t internal_insert(const KeyT& key, T&& value, bool a_force = false);
     simple_ret_t internal_find  (const KeyT& key) const;
 
     static std::atomic<KeyT>* cell_pkey(const value_type& r) {
@@ -317,6 +318,7 @@ private:
     thread_cached_int<int64_t> m_pend_entries; ///< Used by internal_insert
     std::atomic<int64_t>       m_is_full;      ///< Used by internal_insert
     std::atomic<int64_t>       m_num_erases;   ///< Successful key erases
+    std::atomic<bool>          m_frozen;       ///< No new keys (being rehashed)
 
     //-------------------------------------------------------------------------
     // This must be the last field of this class
@@ -335,8 +337,11 @@ private:
 
     inline bool try_lock_cell(value_type* const cell) {
         KeyT expect = m_empty_key;
+        // Sequentially consistent, so that either the locking thread sees
+        // m_frozen set by a concurrent rehash, or the rehashing thread sees
+        // the locked cell
         return cell_pkey(*cell)->compare_exchange_strong
-                (expect, m_locked_key, std::memory_order_acq_rel);
+                (expect, m_locked_key, std::memory_order_seq_cst);
     }
 
     inline size_t key_to_anchor_idx(const KeyT& k) const {
@@ -53,6 +53,7 @@ atomic_hash_array(size_t capacity, const config& c) noexcept
     , m_pend_entries(0, c.m_entry_cnt_thr_cache_sz)
     , m_is_full     (0)
     , m_num_erases  (0)
+    , m_frozen      (false)
 {}
 
 /*
@@ -102,7 +103,7 @@ template <class KeyT, class ValueT, class HashFcn, class EqualFcn>
 template <class T>
 typename atomic_hash_array<KeyT, ValueT, HashFcn, EqualFcn>::simple_ret_t
 atomic_hash_array<KeyT, ValueT, HashFcn, EqualFcn>::
-internal_insert(const KeyT& key_in, T&& value) {
+internal_insert(const KeyT& key_in, T&& value, bool a_force) {
     const short NO_NEW_INSERTS = 1;
     const short NO_PENDING_INSERTS = 2;
     assert(!is_empty_eq(key_in));
@@ -119,7 +120,7 @@ internal_insert(const KeyT& key_in, T&& value) {
         // possible to insert more than m_max_entries entries. However, it's not
         // possible to insert past m_capacity.
         ++m_pend_entries;
-        if (m_is_full.load(std::memory_order_acquire)) {
+        if (!a_force && m_is_full.load(std::memory_order_acquire)) {
             --m_pend_entries;
 
             // Before deciding whether this insert succeeded, this thread needs to
@@ -149,6 +150,13 @@ internal_insert(const KeyT& key_in, T&& value) {
             // If we fail, fall through to comparison below; maybe the insert that
             // just beat us was for this very key....
             if (try_lock_cell(cell)) {
+                // The array is being rehashed by atomic_hash_map, and the
+                // new key would be missed by the migration
+                if (unlikely(m_frozen.load(std::memory_order_seq_cst))) {
+                    unlock_cell(cell, m_empty_key);
+                    --m_pend_entries;
+                    return simple_ret_t(m_capacity, false);
+                }
                 // Write the value - done before unlocking
                 try {
                     assert(is_locked_eq(load_key_relaxed(*cell)));
@@ -342,6 +350,7 @@ clear() {
     m_pend_entries.set(0);
     m_is_full.store(0, std::memory_order_relaxed);
     m_num_erases.store(0, std::memory_order_relaxed);
+    m_frozen.store(false, std::memory_order_relaxed);
 }
 
 
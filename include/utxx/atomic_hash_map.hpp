@@ -8,9 +8,11 @@
 /// done by Serge Aleynikov to support hosting hash map/array in shared memory.
 ///
 /// Supports insert, find(key), find_at(index), erase(key), size, and more.
-/// Memory cannot be freed or reclaimed by erase.
+/// Memory cannot be freed or reclaimed by erase, other than by rehashing
+/// the map (see atomic_hash_map::rehash()).
 /// Can grow to a maximum of about 18 times the
-/// initial capacity, but performance degrades linearly with growth. Can also be
+/// initial capacity, but performance degrades linearly with growth unless
+/// the map is rehashed into a larger table. Can also be
 /// used as an object store with unique 32-bit references directly into the
 /// internal storage (retrieved with iterator::index()).
 ///
@@ -53,6 +55,14 @@
 ///   Insert returns false if there is a key collision and throws if the max size
 ///   of the map is exceeded.
 ///
+///   AHMap can be rehashed online: live entries of all sub-maps are moved
+///   into a new primary sub-map incrementally (by the inserting threads or
+///   by calling migrate()), while readers keep finding every entry in either
+///   the old or the new table.  With auto_rehash() enabled the map rehashes
+///   itself instead of growing past a given number of sub-maps, which keeps
+///   lookups fast and reclaims erased cells in long-running processes (the
+///   old sub-maps are freed by calling reclaim() when no thread uses the map).
+///
 ///   Benchmark performance with 8 simultaneous threads processing 1 million
 ///   unique <int64, int64> entries on a 4-core, 2.5 GHz machine:
 ///
@@ -97,6 +107,9 @@
 #include <stdexcept>
 #include <functional>
 #include <atomic>
+#include <limits>
+#include <type_traits>
+#include <sched.h>
 
 #include <utxx/atomic_hash_array.hpp>
 
@@ -123,9 +136,10 @@ namespace utxx {
  *   EqualityComparable.  (Most of these are probably not something
  *   you actually want to do with this anyway.)
  *
- * - We don't support the various bucket functions, rehash(),
- *   reserve(), or equal_range().  Also no constructors taking
- *   iterators, although this could change.
+ * - We don't support the various bucket functions, reserve(), or
+ *   equal_range().  Also no constructors taking iterators, although
+ *   this could change.  rehash() differs from the standard one in that
+ *   it can run concurrently with other operations (see begin_rehash()).
  *
  * - Several insertion functions, notably operator[], are not
  *   implemented.  It is a little too easy to misuse these functions
@@ -210,6 +224,10 @@ public:
             assert(map);
             SubMap::destroy(&*map, m_allocator);
         }
+        PSubMap next = m_next.load(std::memory_order_relaxed);
+        if (next)
+            SubMap::destroy(&*next, m_allocator);
+        free_retired();
     }
 
     const key_equal& key_eq()        const { return m_config.m_eq_fun;   }
@@ -270,6 +288,76 @@ public:
     /// Check if there's a value associated with the key
     bool exists(const key_type& k) const { return find(k) != end(); }
 
+    /// Start rehashing the map into a new primary submap
+    ///
+    /// The new submap has room for max(\a a_size, 2*size()) entries, and
+    /// no less than the current primary submap.  From this point on new
+    /// keys are inserted into the new submap, and live entries of the old
+    /// submaps are moved to it by migrate(), which is also called by every
+    /// insert() until the rehash is complete.  Readers are never blocked
+    /// and find every entry in either the old or the new submap.  Erased
+    /// cells are not moved, so rehashing reclaims them.
+    ///
+    /// Values are copied to the new submap, so they must not be modified
+    /// in place while the map is being rehashed.  Iterators and indices of
+    /// the old submaps become invalid when their entries are moved.
+    /// Indices of entries in the new submap stay valid when the rehash is
+    /// complete and until the next rehash moves them (as long as the new
+    /// submap has no more than 2^26 cells), and iterators into the new
+    /// submap stay valid until the next rehash is started.
+    /// The old submaps are freed by reclaim() or when
+    /// the next rehash is started by this function, so the caller must
+    /// ensure that no thread holds on to references to their entries
+    /// (e.g. is inside find()) at that point.
+    ///
+    /// @return false if another rehash is in progress
+    bool begin_rehash(size_t a_size = 0);
+
+    /// Move up to \a a_max_cells cells of the old submaps to the new one
+    ///
+    /// Does nothing if another thread is moving cells at the same time.
+    /// @return true if there's no rehash in progress
+    bool migrate(size_t a_max_cells = s_migrate_batch) {
+        return do_migrate(a_max_cells, can_rehash());
+    }
+
+    /// Rehash the map and move all entries in the calling thread
+    void rehash(size_t a_size = 0) {
+        begin_rehash(a_size);
+        while (!migrate(std::numeric_limits<size_t>::max()))
+            sched_yield();
+    }
+
+    /// True while the map is being rehashed
+    bool rehashing() const { return m_next.load(std::memory_order_acquire) != nullptr; }
+
+    /// Number of completed rehashes
+    size_t rehash_count() const {
+        return m_generation.load(std::memory_order_relaxed) / 2;
+    }
+
+    /// Start a rehash when an insert would otherwise allocate more than
+    /// \a a_max_submaps submaps, or the map would be full (0 - disabled,
+    /// which is the default, so that indices and iterators stay valid).
+    ///
+    /// Concurrent readers may still be accessing the submaps retired by an
+    /// automatic rehash, so they are only freed by reclaim(), which the
+    /// application must call periodically at a point where no thread is
+    /// accessing the map.  When there's no room left to retire submaps,
+    /// the map grows instead of being rehashed until reclaim() is called.
+    void auto_rehash(uint32_t a_max_submaps) {
+        static_assert(can_rehash::value,
+                      "Rehashing requires copy-constructible values");
+        m_auto_rehash = std::min<uint32_t>(a_max_submaps, uint32_t(s_num_submaps));
+    }
+
+    /// Max number of submaps before the map is rehashed (0 - disabled)
+    uint32_t auto_rehash() const { return m_auto_rehash; }
+
+    /// Free the submaps retired by completed rehashes.  Call it when no
+    /// thread may hold references to the entries of the retired submaps.
+    void reclaim();
+
     /// Returns an iterator into the map associated with given index
     ///
     /// Note: \a idx should only be an unmodified value returned by calling
@@ -277,9 +365,8 @@ public:
     /// invalid you have a bug and the process aborts.
     iterator find_at(uint32_t idx) {
         simple_ret_t ret = internal_find_at(idx);
-        assert(int(ret.i) < num_submaps());
-        return iterator(this, ret.i,
-        m_submaps[ret.i].load(std::memory_order_relaxed)->make_iter(ret.j));
+        assert(ret.i == s_next_map || int(ret.i) < num_submaps());
+        return iterator(this, ret.i, ret.map->make_iter(ret.j));
     }
     const_iterator find_at(uint32_t idx) const {
         return const_cast<atomic_hash_map*>(this)->find_at(idx);
@@ -295,8 +382,10 @@ public:
         const int numMaps = m_alloc_num_maps.load(std::memory_order_acquire);
         for (int i = 0; i < numMaps; ++i) {
         PSubMap map = m_submaps[i].load(std::memory_order_relaxed);
-        map->entry_count_thr_cache_size(newSize);
+        if (map) map->entry_count_thr_cache_size(newSize);
         }
+        PSubMap next = m_next.load(std::memory_order_acquire);
+        if (next) next->entry_count_thr_cache_size(newSize);
     }
 
     /// Number of sub maps allocated so far to implement this map
@@ -308,14 +397,14 @@ public:
 
     iterator begin() {
         return iterator(this, 0,
-        m_submaps[0].load(std::memory_order_relaxed)->begin());
+        m_submaps[0].load(std::memory_order_acquire)->begin());
     }
 
     iterator end() { return iterator(); }
 
     const_iterator begin() const {
         return const_iterator(this, 0,
-        m_submaps[0].load(std::memory_order_relaxed)->begin());
+        m_submaps[0].load(std::memory_order_acquire)->begin());
     }
 
     const_iterator end()   const { return const_iterator(); }
@@ -352,9 +441,12 @@ public:
 
     inline const value_type& idx_to_rec(uint32_t idx) const {
         simple_ret_t ret = internal_find_at(idx);
-        return m_submaps[ret.i].load(std::memory_order_relaxed)->idx_to_rec(ret.j);
+        return ret.map->m_cells[ret.j];
     }
 
+    /// Number of cells moved by migrate() per insert during a rehash
+    static const size_t s_migrate_batch = 64;
+
 private:
     // This limits primary submap size to 2^31 ~= 2 billion, secondary submap
     // size to 2^(32 - s_num_submap_bits - 1) = 2^27 ~= 130 million, and num subMaps
@@ -363,34 +455,99 @@ private:
     static const uint32_t  s_secondary_map_bit = 1u << 31; // Highest bit
     static const uint32_t  s_submap_idx_shift  = 32 - s_num_submap_bits - 1;
     static const uint32_t  s_submap_idx_mask   = (1 << s_submap_idx_shift) - 1;
+    // Indices of the target of a rehash are marked with the parity of the
+    // rehash number in the highest bit of the offset
+    static const uint32_t  s_rehash_parity_bit = 1u << (s_submap_idx_shift - 1);
+    static const uint32_t  s_next_idx_mask     = s_rehash_parity_bit - 1;
     static const uint32_t  s_num_submaps       = 1  << s_num_submap_bits;
     static const PSubMap   s_locked_ptr;
+    // Pseudo submap index of the target of the rehash in progress
+    static const uint32_t  s_next_map          = s_num_submaps;
+    // Max number of submaps retired by rehashes and not yet reclaimed
+    static const uint32_t  s_max_retired       = 4 * s_num_submaps;
+    // m_cursor is encoded as (submap << s_cursor_shift | cell)
+    static const uint32_t  s_cursor_shift      = 48;
+
+    using can_rehash = std::is_copy_constructible<ValueT>;
 
     struct simple_ret_t {
         uint32_t i;
         size_t   j;
         bool     success;
-        simple_ret_t(uint32_t ii, size_t jj, bool s) : i(ii), j(jj), success(s) {}
+        PSubMap  map;       // Submap holding the entry
+        simple_ret_t(uint32_t ii, size_t jj, bool s, PSubMap m = nullptr)
+            : i(ii), j(jj), success(s), map(m) {}
         simple_ret_t() {}
     };
 
     template <class T>
     simple_ret_t internal_insert (const KeyT& k, T&& value);
     simple_ret_t internal_find   (const KeyT& k) const;
+    simple_ret_t find_in_submaps (const KeyT& k) const;
     simple_ret_t internal_find_at(uint32_t  idx) const;
 
+    bool do_migrate(size_t a_max_cells, std::true_type);
+    bool do_migrate(size_t, std::false_type) { return true; }
+    void move_cell(SubMap& a_map, value_type& a_cell, PSubMap a_next);
+    void finish_rehash(PSubMap a_next, uint32_t a_num_maps);
+    void free_retired();
+
+    /// Start a rehash and free the retired submaps if \a a_free_retired is
+    /// set, or fail if there's no room to retire the current submaps
+    bool do_begin_rehash(size_t a_size, bool a_free_retired);
+
+    /// Start an automatic rehash.  Returns false if it's not possible
+    /// because the retired submaps haven't been reclaimed yet
+    bool start_auto_rehash(std::true_type) {
+        if (m_num_retired.load(std::memory_order_relaxed) +
+            m_alloc_num_maps.load(std::memory_order_relaxed) > s_max_retired)
+            return false;
+        if (!do_begin_rehash(0, false))
+            sched_yield();  // Another thread is resizing the map
+        return true;
+    }
+    bool start_auto_rehash(std::false_type) { return false; }
+
+    // Submap by index, where s_next_map refers to the target of the rehash
+    // in progress (which becomes the primary submap when it's complete)
+    PSubMap submap(uint32_t i) const {
+        if (i != s_next_map)
+            return m_submaps[i].load(std::memory_order_acquire);
+        PSubMap next = m_next.load(std::memory_order_acquire);
+        return next ? next : m_submaps[0].load(std::memory_order_acquire);
+    }
+
+    bool try_lock_resize() {
+        return !m_resizing.exchange(true, std::memory_order_acquire);
+    }
+    void unlock_resize() { m_resizing.store(false, std::memory_order_release); }
+
     char_alloc              m_allocator;
     std::atomic<PSubMap>    m_submaps[s_num_submaps];
     std::atomic<uint32_t>   m_alloc_num_maps;
     const config            m_config;
 
+    // Rehashing state
+    std::atomic<PSubMap>    m_next;         // Target of the rehash in progress
+    std::atomic<uint32_t>   m_generation;   // Odd while a rehash is in progress
+    std::atomic<bool>       m_resizing;     // Held while adding submaps or moving cells
+    std::atomic<uint64_t>   m_cursor;       // Next old cell to move
+    std::atomic<KeyT>       m_moving_key;   // Key being moved by migrate()
+    std::atomic<int64_t>    m_next_room;    // New keys that still fit in m_next
+    uint32_t                m_auto_rehash;  // Max submaps before auto rehash
+    std::atomic<uint32_t>   m_num_retired;  // Submaps waiting for reclaim()
+    PSubMap                 m_retired[s_max_retired];
+
     inline bool try_lock_map(int idx) {
         PSubMap val = nullptr;
         return m_submaps[idx].compare_exchange_strong
                 (val, s_locked_ptr, std::memory_order_acquire);
     }
 
-    static inline uint32_t encode_idx(uint32_t a_submap, uint32_t a_submap_idx);
+    inline uint32_t encode_idx(uint32_t a_submap, uint32_t a_submap_idx) const;
+
+    /// Parity of the number of the rehash in progress (or last completed)
+    static uint32_t rehash_parity(uint32_t a_gen) { return ((a_gen - 1) >> 1) & 1; }
 
 }; // atomic_hash_map
 
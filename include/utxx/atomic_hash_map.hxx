@@ -53,6 +53,14 @@ atomic_hash_map(size_t size, const config& config, const char_alloc& alloc)
                     1.0 - config.m_max_load_factor : config.m_growth_factor)
     , m_allocator(alloc)
     , m_config(config)
+    , m_next(nullptr)
+    , m_generation(0)
+    , m_resizing(false)
+    , m_cursor(0)
+    , m_moving_key(config.m_empty_key)
+    , m_next_room(0)
+    , m_auto_rehash(0)
+    , m_num_retired(0)
 {
     assert(config.m_max_load_factor > 0.0 && config.m_max_load_factor < 1.0);
     m_submaps[0].store(SubMap::create(size, m_allocator, m_config).release(),
@@ -72,8 +80,7 @@ std::pair<typename atomic_hash_map<KeyT, ValueT, HashFcn,
 atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 insert(const key_type& k, const mapped_type& v) {
     simple_ret_t ret = internal_insert(k,v);
-    PSubMap      map = m_submaps[ret.i].load(std::memory_order_relaxed);
-    return std::make_pair(iterator(this, ret.i, map->make_iter(ret.j)),
+    return std::make_pair(iterator(this, ret.i, ret.map->make_iter(ret.j)),
                           ret.success);
 }
 
@@ -84,8 +91,7 @@ std::pair<typename atomic_hash_map<KeyT, ValueT, HashFcn,
 atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 insert(const key_type& k, mapped_type&& v) {
     auto ret = internal_insert(k, std::move(v));
-    auto map = m_submaps[ret.i].load(std::memory_order_relaxed);
-    return std::make_pair(iterator(this, ret.i, map->make_iter(ret.j)),
+    return std::make_pair(iterator(this, ret.i, ret.map->make_iter(ret.j)),
                           ret.success);
 }
 
@@ -98,30 +104,82 @@ simple_ret_t
 atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 internal_insert(const key_type& key, T&& value) {
   beginInsertInternal:
+    uint32_t gen  = m_generation.load(std::memory_order_acquire);
+    PSubMap  next = m_next.load(std::memory_order_acquire);
+
+    if (unlikely(next != nullptr)) {
+        // The map is being rehashed.  Help moving the old entries, and
+        // insert new keys into the new submap.  Keys are never missing in
+        // both the old and the new submaps while being moved, so checking
+        // the old ones first guarantees that we don't insert a duplicate.
+        migrate();
+
+        simple_ret_t ret = find_in_submaps(key);
+        if (ret.success)
+            return simple_ret_t(ret.i, ret.j, false, ret.map);
+
+        if (m_next_room.fetch_sub(1, std::memory_order_relaxed) > 0) {
+            auto res = next->internal_insert(key, std::forward<T>(value));
+            if (!res.success)
+                m_next_room.fetch_add(1, std::memory_order_relaxed);
+            if (res.idx != next->m_capacity)
+                return simple_ret_t(s_next_map, res.idx, res.success, next);
+        } else
+            m_next_room.fetch_add(1, std::memory_order_relaxed);
+
+        // The new submap is full: complete the rehash, so that the map
+        // can grow as usual
+        while (!migrate(std::numeric_limits<size_t>::max()))
+            sched_yield();
+        goto beginInsertInternal;
+    }
+
     // this maintains our state
     int next_map_idx = m_alloc_num_maps.load(std::memory_order_acquire);
     typename SubMap::simple_ret_t ret;
     for (int i=0; i < next_map_idx; ++i) {
         // insert in each map successively.  If one succeeds, we're done!
-        auto map = m_submaps[i].load(std::memory_order_relaxed);
+        auto map = m_submaps[i].load(std::memory_order_acquire);
+        if (unlikely(!map))
+            goto beginInsertInternal; // a rehash has just completed
         ret = map->internal_insert(key, std::forward<T>(value));
         if (ret.idx == map->m_capacity)
             continue;  //map is full, so try the next one
 
         // Either collision or success - insert in either case
-        return simple_ret_t(i, ret.idx, ret.success);
+        return simple_ret_t(i, ret.idx, ret.success, map);
     }
 
-    // If we made it this far, all maps are full and we need to try to allocate
+    // If we made it this far, all maps are full (or frozen by a rehash
+    // that started after we read m_next) and we need to try to allocate
     // the next one.
+    if (m_generation.load(std::memory_order_acquire) != gen)
+        goto beginInsertInternal;
 
-    auto prim_submap = m_submaps[0].load(std::memory_order_relaxed);
-    if (next_map_idx >= int(s_num_submaps)
-        || prim_submap->m_capacity * m_growth_frac < 1.0)
+    auto prim_submap = m_submaps[0].load(std::memory_order_acquire);
+    bool can_grow    = next_map_idx < int(s_num_submaps)
+                    && prim_submap->m_capacity * m_growth_frac >= 1.0;
+
+    // Rehash live entries into a larger primary submap instead
+    if (m_auto_rehash && (!can_grow || next_map_idx >= int(m_auto_rehash)) &&
+        start_auto_rehash(can_rehash()))
+        goto beginInsertInternal;
+
+    if (!can_grow)
         // Can't allocate any more sub maps.
         throw atomic_hash_map_full_error();
 
-    if (try_lock_map(next_map_idx)) {
+    if (try_lock_resize()) {
+        // Only one thread adds submaps or rehashes the map at a time.
+        // Make sure that nothing has changed since we scanned the submaps.
+        if (gen != m_generation.load(std::memory_order_acquire) ||
+            next_map_idx != int(m_alloc_num_maps.load(std::memory_order_acquire)) ||
+            !try_lock_map(next_map_idx))
+        {
+            unlock_resize();
+            goto beginInsertInternal;
+        }
+
         // Alloc a new map and shove it in.  We can change whatever
         // we want because other threads are waiting on us...
         size_t alloc_num_cells = (size_t)
@@ -142,27 +200,20 @@ internal_insert(const key_type& key, T&& value) {
         // Publish the map to other threads.
         m_alloc_num_maps.fetch_add(1, std::memory_order_release);
         assert(next_map_idx+1 == int(m_alloc_num_maps.load(std::memory_order_relaxed)));
+        unlock_resize();
     } else {
         // If we lost the race, we'll have to wait for the next map to get
         // allocated before doing any insertion here.
         for (int n=0
             ; next_map_idx >= int(m_alloc_num_maps.load(std::memory_order_acquire))
+              && m_resizing.load(std::memory_order_acquire)
               && n < 50000
             ; n++)
             sched_yield();
     }
 
-    // Relaxed is ok here because either we just created this map, or we
-    // just did a spin wait with an acquire load on m_alloc_num_maps.
-    PSubMap map = m_submaps[next_map_idx].load(std::memory_order_relaxed);
-    assert(map);
-    assert(map != s_locked_ptr);
-    ret = map->internal_insert(key, std::forward<T>(value));
-    if (ret.idx != map->m_capacity)
-        return simple_ret_t(next_map_idx, ret.idx, ret.success);
-
-    // We took way too long and the new map is already full...try again from
-    // the top (this should pretty much never happen).
+    // Either we just created the next map, or some other thread changed
+    // the map while we waited, so start over
     goto beginInsertInternal;
 }
 
@@ -175,8 +226,7 @@ find(const KeyT& k) {
     simple_ret_t ret = internal_find(k);
     if (!ret.success)
         return end();
-    auto subMap = m_submaps[ret.i].load(std::memory_order_relaxed);
-    return iterator(this, ret.i, subMap->make_iter(ret.j));
+    return iterator(this, ret.i, ret.map->make_iter(ret.j));
 }
 
 template <class KeyT, class ValueT,
@@ -195,18 +245,50 @@ typename atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap
 simple_ret_t
 atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 internal_find(const KeyT& k) const {
-    PSubMap const primaryMap = m_submaps[0].load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t     gen = m_generation.load(std::memory_order_acquire);
+        simple_ret_t ret = find_in_submaps(k);
+        if (likely(ret.success))
+            return ret;
+
+        // While the map is being rehashed the key may have been moved to
+        // the new submap.  It is inserted there before being erased from
+        // the old one, so checking the new submap after the old ones
+        // doesn't miss it.
+        PSubMap const next = m_next.load(std::memory_order_acquire);
+        if (next) {
+            auto res = next->internal_find(k);
+            if (res.idx != next->m_capacity)
+                return simple_ret_t(s_next_map, res.idx, res.success, next);
+        }
+
+        // A rehash started or completed while we were searching
+        if (likely(gen == m_generation.load(std::memory_order_acquire)))
+            return ret;
+    }
+}
+
+// find_in_submaps -- Searches the submaps excluding the target of a rehash
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+typename atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+simple_ret_t
+atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+find_in_submaps(const KeyT& k) const {
+    PSubMap const primaryMap = m_submaps[0].load(std::memory_order_acquire);
     typename SubMap::simple_ret_t ret = primaryMap->internal_find(k);
     if (likely(ret.idx != primaryMap->m_capacity))
-        return simple_ret_t(0, ret.idx, ret.success);
+        return simple_ret_t(0, ret.idx, ret.success, primaryMap);
 
     int const maps_count = m_alloc_num_maps.load(std::memory_order_acquire);
     for (int i=1; i < maps_count; ++i) {
         // Check each map successively.  If one succeeds, we're done!
-        PSubMap const map = m_submaps[i].load(std::memory_order_relaxed);
+        PSubMap const map = m_submaps[i].load(std::memory_order_acquire);
+        if (unlikely(!map))
+            break;  // a rehash has just completed
         ret = map->internal_find(k);
         if (likely(ret.idx != map->m_capacity))
-            return simple_ret_t(i, ret.idx, ret.success);
+            return simple_ret_t(i, ret.idx, ret.success, map);
     }
     // Didn't find our key...
     return simple_ret_t(maps_count, 0, false);
@@ -223,14 +305,24 @@ internal_find_at(uint32_t idx) const {
         // idx falls in a secondary map
         idx &= ~s_secondary_map_bit;  // unset secondary bit
         submap_idx    = idx >> s_submap_idx_shift;
-        assert(submap_idx < m_alloc_num_maps.load(std::memory_order_relaxed));
         submap_offset = idx & s_submap_idx_mask;
+        // The target of a rehash, which is the primary map once it's done
+        // (or when a later rehash is in progress)
+        if (submap_idx == 0) {
+            uint32_t gen   = m_generation.load(std::memory_order_acquire);
+            uint32_t par   = (idx & s_rehash_parity_bit) ? 1 : 0;
+            submap_offset &= s_next_idx_mask;
+            if ((gen & 1) && par == rehash_parity(gen))
+                submap_idx = s_next_map;
+        }
+        assert(submap_idx == s_next_map ||
+               submap_idx < m_alloc_num_maps.load(std::memory_order_relaxed));
     } else {
         // idx falls in primary map
         submap_idx    = 0;
         submap_offset = idx;
     }
-    return simple_ret_t(submap_idx, submap_offset, true);
+    return simple_ret_t(submap_idx, submap_offset, true, submap(submap_idx));
 }
 
 // erase --
@@ -239,13 +331,36 @@ template <class KeyT, class ValueT,
 typename atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::size_type
 atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 erase(const KeyT& k) {
-    int const num_maps = m_alloc_num_maps.load(std::memory_order_acquire);
-    for (int i=0; i < num_maps; ++i)
-        // Check each map successively.  If one succeeds, we're done!
-        if (m_submaps[i].load(std::memory_order_relaxed)->erase(k))
-            return 1;
-    // Didn't find our key...
-    return 0;
+    while (true) {
+        uint32_t  gen      = m_generation.load(std::memory_order_acquire);
+        int const num_maps = m_alloc_num_maps.load(std::memory_order_acquire);
+        size_type res      = 0;
+        for (int i=0; i < num_maps; ++i) {
+            // Check each map successively.  If one succeeds, we're done!
+            auto map = m_submaps[i].load(std::memory_order_acquire);
+            if (unlikely(!map))
+                break;
+            if (map->erase(k)) {
+                res = 1;
+                break;
+            }
+        }
+
+        // The erasing CAS above and the load below are sequentially
+        // consistent, so either migrate() sees the erased key, or we see
+        // the rehash in progress and wait until the key is moved, so that
+        // we can erase the copy.
+        PSubMap next = m_next.load(std::memory_order_seq_cst);
+        if (next) {
+            if (res)
+                while (m_config.m_eq_fun(m_moving_key.load(std::memory_order_seq_cst), k))
+                    sched_yield();
+            res |= next->erase(k);
+        }
+
+        if (res || gen == m_generation.load(std::memory_order_acquire))
+            return res;
+    }
 }
 
 // capacity -- summation of capacities of all submaps
@@ -255,8 +370,12 @@ size_t atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>:
 capacity() const {
     size_t    tot_cap  = 0;
     int const num_maps = m_alloc_num_maps.load(std::memory_order_acquire);
-    for (int i=0; i < num_maps; ++i)
-        tot_cap += m_submaps[i].load(std::memory_order_relaxed)->m_capacity;
+    for (int i=0; i < num_maps; ++i) {
+        auto map = m_submaps[i].load(std::memory_order_acquire);
+        if (map) tot_cap += map->m_capacity;
+    }
+    auto next = m_next.load(std::memory_order_acquire);
+    if (next) tot_cap += next->m_capacity;
     return tot_cap;
 }
 
@@ -266,12 +385,17 @@ template <class KeyT, class ValueT,
           class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
 size_t atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 remaining_space() const {
+    auto next = m_next.load(std::memory_order_acquire);
+    if (next)
+        return std::max<int64_t>(0, m_next_room.load(std::memory_order_relaxed));
+
     size_t    rem_space = 0;
     int const num_maps  = m_alloc_num_maps.load(std::memory_order_acquire);
     for (int i=0; i < num_maps; ++i) {
-        auto  map   = m_submaps[i].load(std::memory_order_relaxed);
-        rem_space  += std::max
-            (0,  map->m_max_entries - &map->m_num_entries.read_full());
+        auto  map   = m_submaps[i].load(std::memory_order_acquire);
+        if (!map) break;
+        rem_space  += std::max<int64_t>
+            (0, int64_t(map->m_max_entries) - map->m_num_entries.read_full());
     }
     return rem_space;
 }
@@ -282,6 +406,12 @@ template <class KeyT, class ValueT,
           class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
 void atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
 clear() {
+    PSubMap next = m_next.exchange(nullptr, std::memory_order_relaxed);
+    if (next) {
+        SubMap::destroy(&*next, m_allocator);
+        m_generation.fetch_add(1, std::memory_order_relaxed);
+    }
+    free_retired();
     m_submaps[0].load(std::memory_order_relaxed)->clear();
     int const num_maps = m_alloc_num_maps.load(std::memory_order_relaxed);
     for (int i=1; i < num_maps; ++i) {
@@ -300,8 +430,12 @@ size_t atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>:
 size() const {
     size_t    tot_size = 0;
     int const num_maps = m_alloc_num_maps.load(std::memory_order_acquire);
-    for (int i=0; i < num_maps; ++i)
-        tot_size += m_submaps[i].load(std::memory_order_relaxed)->size();
+    for (int i=0; i < num_maps; ++i) {
+        auto map = m_submaps[i].load(std::memory_order_acquire);
+        if (map) tot_size += map->size();
+    }
+    auto next = m_next.load(std::memory_order_acquire);
+    if (next) tot_size += next->size();
     return tot_size;
 }
 
@@ -323,12 +457,33 @@ size() const {
 //         31              1
 //      27-30   which subMap
 //       0-26  subMap offset (index_ret input)
+//
+//   if subMap == s_next_map (target of a rehash in progress) =>
+//     bit(s)          value
+//         31              1
+//      27-30              0
+//         26  parity of the rehash number
+//       0-25  subMap offset (index_ret input)
+//
+// The target of a rehash becomes the primary map when the rehash is
+// complete, so its entries are found at the same offset of the primary
+// map after that, including while the next rehash (of a different
+// parity) is moving them (see internal_find_at()).  Once the rehash is
+// complete, entries of its target are encoded as those of the primary map.
 template <class KeyT, class ValueT,
           class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
 inline uint32_t atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
-encode_idx(uint32_t a_submap, uint32_t a_offset) {
+encode_idx(uint32_t a_submap, uint32_t a_offset) const {
     assert((a_offset & s_secondary_map_bit) == 0);  // offset can't be too big
     if (a_submap == 0) return a_offset;
+    if (a_submap == s_next_map) {
+        uint32_t gen = m_generation.load(std::memory_order_acquire);
+        if (!(gen & 1))
+            return a_offset;
+        assert((a_offset & ~s_next_idx_mask) == 0);
+        return a_offset | s_secondary_map_bit
+             | (rehash_parity(gen) ? s_rehash_parity_bit : 0);
+    }
     // Make sure subMap isn't too big
     assert((a_submap >> s_num_submap_bits) == 0);
     // Make sure subMap bits of offset are clear
@@ -339,6 +494,187 @@ encode_idx(uint32_t a_submap, uint32_t a_offset) {
 }
 
 
+// begin_rehash -- Publishes the new submap and freezes the old ones
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+bool atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+begin_rehash(size_t a_size) {
+    static_assert(can_rehash::value, "Rehashing requires copy-constructible values");
+    // The caller guarantees that the retired submaps are no longer referenced
+    return do_begin_rehash(a_size, true);
+}
+
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+bool atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+do_begin_rehash(size_t a_size, bool a_free_retired) {
+    if (!try_lock_resize())
+        return false;
+    if (m_next.load(std::memory_order_relaxed)) {
+        unlock_resize();
+        return false;
+    }
+
+    if (a_free_retired)
+        free_retired();
+    else if (m_num_retired.load(std::memory_order_relaxed) +
+             m_alloc_num_maps.load(std::memory_order_relaxed) > s_max_retired) {
+        unlock_resize();
+        return false;
+    }
+
+    size_t live = size();
+    size_t sz   = std::max(std::max(a_size, 2*live),
+                           m_submaps[0].load(std::memory_order_relaxed)->m_max_entries);
+    PSubMap next;
+    try {
+        next = SubMap::create(sz, m_allocator, m_config).release();
+    } catch (...) {
+        unlock_resize();
+        throw;
+    }
+    next->entry_count_thr_cache_size
+        (m_submaps[0].load(std::memory_order_relaxed)->entry_count_thr_cache_size());
+
+    // Leave room for moving the live entries
+    m_next_room.store(int64_t(next->m_max_entries) - int64_t(live),
+                      std::memory_order_relaxed);
+    m_cursor.store(0, std::memory_order_relaxed);
+    m_next.store(next, std::memory_order_seq_cst);
+    m_generation.fetch_add(1, std::memory_order_seq_cst);
+
+    // From now on inserts of new keys into the old submaps fail, and
+    // inserting threads retry with the new one
+    uint32_t num = m_alloc_num_maps.load(std::memory_order_relaxed);
+    for (uint32_t i=0; i < num; ++i)
+        m_submaps[i].load(std::memory_order_relaxed)
+                   ->m_frozen.store(true, std::memory_order_seq_cst);
+
+    unlock_resize();
+    return true;
+}
+
+// do_migrate -- Moves up to a_max_cells cells to the new submap
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+bool atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+do_migrate(size_t a_max_cells, std::true_type) {
+    if (!m_next.load(std::memory_order_acquire))
+        return true;
+    if (!try_lock_resize())
+        return false;
+
+    PSubMap next = m_next.load(std::memory_order_acquire);
+    if (!next) {
+        unlock_resize();
+        return true;
+    }
+
+    uint32_t num = m_alloc_num_maps.load(std::memory_order_relaxed);
+    uint64_t cur = m_cursor.load(std::memory_order_relaxed);
+    uint32_t i   = cur >> s_cursor_shift;
+    size_t   j   = cur &  ((1ul << s_cursor_shift) - 1);
+
+    for (size_t n=0; i < num && n < a_max_cells; ++n) {
+        PSubMap map = m_submaps[i].load(std::memory_order_relaxed);
+        if (j == map->m_capacity) {
+            ++i;
+            j = 0;
+            continue;
+        }
+        move_cell(*map, map->m_cells[j++], next);
+    }
+
+    m_cursor.store(uint64_t(i) << s_cursor_shift | j, std::memory_order_relaxed);
+
+    bool done = i >= num;
+    if (done)
+        finish_rehash(next, num);
+
+    unlock_resize();
+    return done;
+}
+
+// move_cell -- Copies a live entry to the new submap, and erases it in the
+// old one.  Called with the resize lock held.
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+void atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+move_cell(SubMap& a_map, value_type& a_cell, PSubMap a_next) {
+    auto pkey = SubMap::cell_pkey(a_cell);
+    KeyT key  = pkey->load(std::memory_order_seq_cst);
+
+    // An insert that locked the cell before the submap was frozen
+    while (a_map.is_locked_eq(key)) {
+        sched_yield();
+        key = pkey->load(std::memory_order_seq_cst);
+    }
+
+    if (a_map.is_empty_eq(key) || a_map.is_erased_eq(key))
+        return;
+
+    // Announce the key to erase(), and make sure it wasn't erased before
+    m_moving_key.store(key, std::memory_order_seq_cst);
+
+    if (a_map.is_key_eq(pkey->load(std::memory_order_seq_cst), key)) {
+        auto res = a_next->internal_insert(key, ValueT(a_cell.second), true);
+        assert(res.idx != a_next->m_capacity);
+
+        KeyT expect = key;
+        if (pkey->compare_exchange_strong(expect, a_map.m_erased_key,
+                                          std::memory_order_seq_cst))
+            a_map.m_num_erases.fetch_add(1, std::memory_order_relaxed);
+        else if (res.success)
+            // The key was erased while being copied
+            a_next->erase(key);
+    }
+
+    m_moving_key.store(m_config.m_empty_key, std::memory_order_release);
+}
+
+// finish_rehash -- Makes the new submap primary. Called with the resize
+// lock held.
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+void atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+finish_rehash(PSubMap a_next, uint32_t a_num_maps) {
+    // Old submaps can still be accessed by concurrent readers, so they
+    // are freed by reclaim() or by the next call to begin_rehash()
+    uint32_t n = m_num_retired.load(std::memory_order_relaxed);
+    assert(n + a_num_maps <= s_max_retired);
+    for (uint32_t i=0; i < a_num_maps; ++i)
+        m_retired[n++] = m_submaps[i].load(std::memory_order_relaxed);
+    m_num_retired.store(n, std::memory_order_relaxed);
+
+    m_submaps[0].store(a_next, std::memory_order_release);
+    m_alloc_num_maps.store(1, std::memory_order_release);
+    m_next.store(nullptr, std::memory_order_release);
+    m_generation.fetch_add(1, std::memory_order_seq_cst);
+
+    for (uint32_t i=1; i < a_num_maps; ++i)
+        m_submaps[i].store(nullptr, std::memory_order_release);
+}
+
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+void atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+free_retired() {
+    uint32_t n = m_num_retired.load(std::memory_order_relaxed);
+    for (uint32_t i=0; i < n; ++i)
+        SubMap::destroy(&*m_retired[i], m_allocator);
+    m_num_retired.store(0, std::memory_order_relaxed);
+}
+
+template <class KeyT, class ValueT,
+          class HashFcn, class EqualFcn, class Alloc, class SubMap, class PSubMap>
+void atomic_hash_map<KeyT, ValueT, HashFcn, EqualFcn, Alloc, SubMap, PSubMap>::
+reclaim() {
+    while (!try_lock_resize())
+        sched_yield();
+    free_retired();
+    unlock_resize();
+}
+
 // iterator implementation
 
 template <class KeyT, class ValueT,
@@ -408,16 +744,21 @@ private:
         if (is_end())
             return;
 
-        auto map = m_ahm->m_submaps[m_submap].load(std::memory_order_relaxed);
-        if (m_subit == map->end()) {
-            // This sub iterator is done, advance to next one
-            if (m_submap+1 >= m_ahm->m_alloc_num_maps.load(std::memory_order_acquire))
-                m_ahm = nullptr;
-            else {
+        auto map = m_ahm->submap(m_submap);
+        while (m_subit == map->end()) {
+            // This sub iterator is done, advance to next one (visiting the
+            // target of a rehash in progress last)
+            if (m_submap+1 < m_ahm->m_alloc_num_maps.load(std::memory_order_acquire))
                 ++m_submap;
-                map = m_ahm->m_submaps[m_submap].load(std::memory_order_relaxed);
-                m_subit = map->begin();
+            else if (m_submap != s_next_map &&
+                     m_ahm->m_next.load(std::memory_order_acquire))
+                m_submap = s_next_map;
+            else {
+                m_ahm = nullptr;
+                return;
             }
+            map     = m_ahm->submap(m_submap);
+            m_subit = map->begin();
         }
     }
 
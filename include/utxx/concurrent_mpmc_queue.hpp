@@ -0,0 +1,380 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file   concurrent_mpmc_queue.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Bounded lock-free multi-producer/multi-consumer queue.
+///
+/// The queue is a ring of cells, each tagged with a sequence number that
+/// tells producers and consumers whether the cell is ready to be written or
+/// read in the current lap around the ring (see D.Vyukov's "Bounded MPMC
+/// queue": http://www.1024cores.net/home/lock-free-algorithms/queues).
+/// A push or a pop costs a single CAS on the shared enqueue or dequeue
+/// position, and no memory is allocated after construction.
+///
+/// Besides the non-blocking try_push()/try_pop(), the queue offers blocking
+/// push()/pop() that spin for a while and then park the calling thread on a
+/// futex until the opposite side makes progress.  The futex words live in
+/// the queue's header, so that blocking calls also work between processes
+/// sharing the queue's memory.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+#include <utxx/math.hpp>
+#include <utxx/error.hpp>
+#include <utxx/futex.hpp>
+#include <utxx/compiler_hints.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <time.h>
+
+namespace utxx {
+
+//===========================================================================//
+// concurrent_mpmc_queue is a bounded queue with any number of producers and //
+// consumers.                                                                //
+//===========================================================================//
+template <class T>
+class concurrent_mpmc_queue : private boost::noncopyable
+{
+    static constexpr uint64_t s_magic = 0x43504d4d58545455;   // "UTTXMMPC"
+
+    //-----------------------------------------------------------------------//
+    // Header (can also be located in ShMem along with the cells):           //
+    //-----------------------------------------------------------------------//
+    struct header
+    {
+        uint64_t                m_magic;
+        uint32_t                m_capacity;
+        uint32_t                m_cell_size;
+        alignas(UTXX_CL_SIZE)
+        std::atomic<uint64_t>   m_enqueue;          // Next position to push
+        alignas(UTXX_CL_SIZE)
+        std::atomic<uint64_t>   m_dequeue;          // Next position to pop
+        // Events signaled when a blocked consumer (producer) may proceed:
+        alignas(UTXX_CL_SIZE)
+        futex_event             m_not_empty;
+        alignas(UTXX_CL_SIZE)
+        futex_event             m_not_full;
+    };
+
+    struct cell
+    {
+        std::atomic<uint64_t>   m_seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type m_data;
+
+        T*       data()       { return reinterpret_cast<T*>(&m_data);       }
+        T const* data() const { return reinterpret_cast<T const*>(&m_data); }
+    };
+
+    // Header size rounded up to a cache line, so that the first cell doesn't
+    // share a line with the consumers' futex word:
+    static constexpr size_t s_header_size =
+        (sizeof(header) + UTXX_CL_SIZE - 1) / UTXX_CL_SIZE * UTXX_CL_SIZE;
+
+public:
+    typedef T value_type;
+
+    /// Number of try_push()/try_pop() attempts made by blocking calls before
+    /// parking the calling thread on a futex
+    static constexpr int s_spin_count = 128;
+
+    /// @return memory size needed for a queue of \a a_capacity items
+    /// (capacity is rounded up to a power of 2)
+    static size_t memory_size(uint32_t a_capacity)
+      { return s_header_size + adjust_capacity(a_capacity) * sizeof(cell); }
+
+    //-----------------------------------------------------------------------//
+    // Ctors, Dtor:                                                          //
+    //-----------------------------------------------------------------------//
+    /// Ctor with automatic memory allocation on the heap.
+    /// The capacity is rounded up to the nearest power of 2.
+    explicit concurrent_mpmc_queue(uint32_t a_capacity)
+        : m_shared_data(false)
+    {
+        auto   capacity = adjust_capacity(a_capacity);
+        auto   size     = memory_size(capacity);
+        void*  p;
+        if (::posix_memalign(&p, UTXX_CL_SIZE, size) != 0)
+            throw std::bad_alloc();
+        attach(p);
+        init(capacity);
+    }
+
+    /// Ctor for using external memory (eg shared memory).
+    /// @param a_storage memory aligned at least to cache line size
+    /// @param a_size    size of \a a_storage obtained by memory_size()
+    /// @param a_init    when true the queue is initialized empty, otherwise
+    ///                  \a a_storage is expected to contain a queue previously
+    ///                  initialized by another instance (possibly in another
+    ///                  process).  Only one process must initialize the queue,
+    ///                  before any other process attaches to it.
+    concurrent_mpmc_queue(void* a_storage, size_t a_size, bool a_init)
+        : m_shared_data(true)
+    {
+        if (a_size <= s_header_size)
+            UTXX_THROW_BADARG_ERROR("Invalid storage size: ", a_size);
+        if (reinterpret_cast<uintptr_t>(a_storage) % alignof(cell) != 0)
+            UTXX_THROW_BADARG_ERROR("Misaligned storage: ", a_storage);
+
+        attach(a_storage);
+
+        if (a_init) {
+            // Round the number of cells fitting in storage down to power of 2
+            auto n   = uint32_t((a_size - s_header_size) / sizeof(cell));
+            auto cap = adjust_capacity(n);
+            if (cap > n) cap /= 2;
+            if (cap < 2)
+                UTXX_THROW_BADARG_ERROR("Invalid storage size: ", a_size);
+            init(cap);
+        } else if (m_header->m_magic != s_magic ||
+                   m_header->m_cell_size != sizeof(cell))
+            UTXX_THROW_RUNTIME_ERROR("Storage doesn't contain a compatible queue");
+        else if (memory_size(m_header->m_capacity) > a_size)
+            UTXX_THROW_BADARG_ERROR("Storage size ", a_size,
+                                    " is smaller than queue's size ",
+                                    memory_size(m_header->m_capacity));
+        m_mask = m_header->m_capacity - 1;
+    }
+
+    /// Dtor destructs the items left in a queue allocated on the heap.
+    /// Queues in external storage are left intact (their lifetime is managed
+    /// by the caller).
+    ~concurrent_mpmc_queue()
+    {
+        if (m_shared_data)
+            return;
+        if (!std::is_trivially_destructible<T>::value) {
+            auto& hdr = *m_header;
+            for (auto pos = hdr.m_dequeue.load(std::memory_order_relaxed),
+                      end = hdr.m_enqueue.load(std::memory_order_relaxed);
+                 pos != end; ++pos)
+                m_cells[pos & m_mask].data()->~T();
+        }
+        ::free(m_header);
+    }
+
+    //-----------------------------------------------------------------------//
+    // Properties:                                                           //
+    //-----------------------------------------------------------------------//
+    uint32_t capacity() const { return m_header->m_capacity; }
+
+    /// Approximate number of items in the queue (exact only if there are no
+    /// concurrent pushes or pops)
+    uint32_t size() const {
+        auto pop  = m_header->m_dequeue.load(std::memory_order_relaxed);
+        auto push = m_header->m_enqueue.load(std::memory_order_relaxed);
+        auto n    = int64_t(push - pop);
+        return n < 0 ? 0 : n > capacity() ? capacity() : uint32_t(n);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    //-----------------------------------------------------------------------//
+    // Non-blocking operations:                                              //
+    //-----------------------------------------------------------------------//
+    /// Construct an item at the tail of the queue
+    ///
+    /// If T's constructor may throw, the item is constructed in a temporary
+    /// before a cell is claimed, and moved into the cell (so T must then be
+    /// nothrow move-constructible).
+    /// @return false if the queue is full
+    template <class... Args>
+    bool try_emplace(Args&&... a_args)
+    {
+        return do_emplace(std::is_nothrow_constructible<T, Args&&...>(),
+                          std::forward<Args>(a_args)...);
+    }
+
+    bool try_push(T const& a_val) { return try_emplace(a_val);            }
+    bool try_push(T&&      a_val) { return try_emplace(std::move(a_val)); }
+
+    /// Remove an item from the head of the queue
+    /// @return false if the queue is empty
+    bool try_pop(T& a_val)
+    {
+        auto& hdr = *m_header;
+        auto  pos = hdr.m_dequeue.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &m_cells[pos & m_mask];
+            auto seq  = c->m_seq.load(std::memory_order_acquire);
+            auto diff = int64_t(seq - (pos+1));
+            if (diff == 0) {
+                if (hdr.m_dequeue.compare_exchange_weak
+                        (pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0)
+                return false;   // The cell hasn't been written in this lap
+            else
+                pos = hdr.m_dequeue.load(std::memory_order_relaxed);
+        }
+        a_val = std::move(*c->data());
+        c->data()->~T();
+        c->m_seq.store(pos + m_mask + 1, std::memory_order_release);
+        hdr.m_not_full.notify();
+        return true;
+    }
+
+    //-----------------------------------------------------------------------//
+    // Blocking operations:                                                  //
+    //-----------------------------------------------------------------------//
+    /// Push an item, waiting while the queue is full
+    /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+    /// @return false on timeout
+    bool push(T const& a_val, const timespec* a_timeout = nullptr)
+    {
+        return m_header->m_not_full.wait
+            ([&]() { return try_emplace(a_val); }, a_timeout, s_spin_count);
+    }
+
+    bool push(T&& a_val, const timespec* a_timeout = nullptr)
+    {
+        return m_header->m_not_full.wait
+            ([&]() { return try_emplace(std::move(a_val)); }, a_timeout, s_spin_count);
+    }
+
+    /// Pop an item, waiting while the queue is empty
+    /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+    /// @return false on timeout
+    bool pop(T& a_val, const timespec* a_timeout = nullptr)
+    {
+        return m_header->m_not_empty.wait
+            ([&]() { return try_pop(a_val); }, a_timeout, s_spin_count);
+    }
+
+    template <class Rep, class Period>
+    bool push(T const& a_val, std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ts = to_timespec(a_timeout);
+        return push(a_val, &ts);
+    }
+
+    template <class Rep, class Period>
+    bool push(T&& a_val, std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ts = to_timespec(a_timeout);
+        return push(std::move(a_val), &ts);
+    }
+
+    template <class Rep, class Period>
+    bool pop(T& a_val, std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ts = to_timespec(a_timeout);
+        return pop(a_val, &ts);
+    }
+
+private:
+    header* m_header;
+    cell*   m_cells;
+    size_t  m_mask;
+    bool    m_shared_data;
+
+    static uint32_t adjust_capacity(uint32_t a_capacity)
+    {
+        return a_capacity < 2 ? 2 : math::upper_power(a_capacity, 2);
+    }
+
+    template <class Rep, class Period>
+    static timespec to_timespec(std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (a_timeout).count();
+        if (ns < 0) ns = 0;
+        return timespec{time_t(ns / 1000000000), long(ns % 1000000000)};
+    }
+
+    /// T's ctor can't throw: construct in place in the claimed cell
+    template <class... Args>
+    bool do_emplace(std::true_type, Args&&... a_args)
+    {
+        auto& hdr = *m_header;
+        auto  pos = hdr.m_enqueue.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &m_cells[pos & m_mask];
+            auto seq  = c->m_seq.load(std::memory_order_acquire);
+            auto diff = int64_t(seq - pos);
+            if (diff == 0) {
+                if (hdr.m_enqueue.compare_exchange_weak
+                        (pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0)
+                return false;   // The cell still holds an item of prior lap
+            else
+                pos = hdr.m_enqueue.load(std::memory_order_relaxed);
+        }
+        new (c->data()) T(std::forward<Args>(a_args)...);
+        c->m_seq.store(pos+1, std::memory_order_release);
+        hdr.m_not_empty.notify();
+        return true;
+    }
+
+    /// T's ctor may throw: construct before claiming a cell, since a claimed
+    /// cell left unpublished would block consumers forever
+    template <class... Args>
+    bool do_emplace(std::false_type, Args&&... a_args)
+    {
+        static_assert(std::is_nothrow_move_constructible<T>::value,
+                      "T must have a nothrow ctor or a nothrow move ctor");
+        T tmp(std::forward<Args>(a_args)...);
+        return do_emplace(std::true_type(), std::move(tmp));
+    }
+
+    void attach(void* a_storage)
+    {
+        m_header = static_cast<header*>(a_storage);
+        m_cells  = reinterpret_cast<cell*>
+                   (static_cast<char*>(a_storage) + s_header_size);
+    }
+
+    void init(uint32_t a_capacity)
+    {
+        auto& hdr = *new (m_header) header;
+        hdr.m_magic     = s_magic;
+        hdr.m_capacity  = a_capacity;
+        hdr.m_cell_size = sizeof(cell);
+        hdr.m_enqueue.store(0, std::memory_order_relaxed);
+        hdr.m_dequeue.store(0, std::memory_order_relaxed);
+        hdr.m_not_empty.reset();
+        hdr.m_not_full.reset();
+        for (uint32_t i = 0; i < a_capacity; ++i)
+            new (&m_cells[i].m_seq) std::atomic<uint64_t>(i);
+        m_mask = a_capacity - 1;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+};
+
+} // namespace utxx
@@ -38,6 +38,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <cstdlib>
 #include <stdexcept>
 #include <type_traits>
@@ -45,11 +46,168 @@
 #include <boost/noncopyable.hpp>
 #include <boost/type_traits.hpp>
 #include <utxx/math.hpp>
+#include <utxx/compiler_hints.hpp>
+#include <utxx/concurrent_mpmc_queue.hpp>
 
 namespace utxx {
 
 #if __cplusplus >= 201103L
 
+namespace detail {
+
+/**
+ * Lock-free pool of memory blocks of BlockSize bytes used for nodes of
+ * concurrent_mpsc_queue.
+ *
+ * Every thread keeps a cache of free blocks.  A block freed by the consumer
+ * goes to the consumer's cache, and when the cache grows over 2*Batch blocks,
+ * Batch blocks are moved as one chain to a shared depot.  A producer whose
+ * cache is empty takes a whole chain from the depot, and only calls the
+ * allocator when the depot is empty, so in a steady state nodes circulate
+ * between producers and the consumer without touching the system allocator.
+ *
+ * The depot is a bounded MPMC queue of chains holding up to DepotBytes worth
+ * of blocks.  When it's full, surplus chains are returned to the allocator.
+ * The pool is shared by all queues with the same block size and allocator
+ * type (so the allocator must be stateless).
+ */
+template <size_t BlockSize, class Alloc, unsigned Batch = 64,
+          size_t DepotBytes = 4*1024*1024>
+class mpsc_block_pool {
+    struct block { block* next; };
+
+    static_assert(BlockSize >= sizeof(block), "Block is too small");
+    static_assert(std::is_empty<Alloc>::value, "Allocator must be stateless");
+
+    using depot = concurrent_mpmc_queue<block*>;
+
+    static constexpr size_t s_depot_chains =
+        DepotBytes / (Batch * BlockSize) < 16 ? 16
+                                              : DepotBytes / (Batch * BlockSize);
+
+    struct cache {
+        block*   head  = nullptr;
+        unsigned count = 0;
+
+        ~cache() {
+            while (count >= Batch)
+                spill();
+            release(head);
+        }
+
+        /// Move Batch blocks to the depot
+        void spill() {
+            block* first = head, *last = head;
+            for (unsigned i = 1; i < Batch; ++i)
+                last = last->next;
+            head  = last->next;
+            count -= Batch;
+            last->next = nullptr;
+            if (!global().try_push(first))
+                release(first);     // The depot is full
+        }
+
+        /// Take a chain of Batch blocks from the depot
+        bool refill() {
+            if (!global().try_pop(head))
+                return false;
+            count = Batch;
+            return true;
+        }
+    };
+
+    // The depot is never destroyed, since threads may exit (and return their
+    // cached blocks) after static destructors were called
+    static depot& global() { static depot* s_depot = new depot(s_depot_chains); return *s_depot; }
+    static cache& local()  { static thread_local cache s_cache; return s_cache; }
+
+    static void release(block* a_list) {
+        Alloc alloc;
+        for (block* p; a_list; a_list = p) {
+            p = a_list->next;
+            alloc.deallocate(reinterpret_cast<char*>(a_list), BlockSize);
+        }
+    }
+public:
+    static constexpr size_t block_size() { return BlockSize; }
+
+    static void* allocate() {
+        auto& c = local();
+        if (unlikely(!c.head) && !c.refill())
+            return Alloc().allocate(BlockSize);
+        block* p = c.head;
+        c.head   = p->next;
+        --c.count;
+        return p;
+    }
+
+    static void deallocate(void* a_block) {
+        auto& c   = local();
+        auto  p   = static_cast<block*>(a_block);
+        p->next   = c.head;
+        c.head    = p;
+        if (unlikely(++c.count >= 2*Batch))
+            c.spill();
+    }
+
+    /// Number of free blocks in the calling thread's cache
+    static unsigned cached() { return local().count; }
+};
+
+/**
+ * Pools of blocks of sizes from 32 to 4096 bytes (in powers of 2).  Larger
+ * sizes are served by the allocator directly.
+ */
+template <class Alloc>
+struct mpsc_sized_pool {
+    static constexpr unsigned s_classes = 8;
+    static constexpr size_t   s_max     = 32u << (s_classes-1);
+
+    template <unsigned K>
+    using pool = mpsc_block_pool<(32u << K), Alloc>;
+
+    /// Size class of a block of \a a_size bytes
+    static unsigned size_class(size_t a_size) {
+        return a_size <= 32 ? 0 : 64 - __builtin_clzl(a_size-1) - 5;
+    }
+
+    static void* allocate(size_t a_size) {
+        switch (size_class(a_size)) {
+            case 0:  return pool<0>::allocate();
+            case 1:  return pool<1>::allocate();
+            case 2:  return pool<2>::allocate();
+            case 3:  return pool<3>::allocate();
+            case 4:  return pool<4>::allocate();
+            case 5:  return pool<5>::allocate();
+            case 6:  return pool<6>::allocate();
+            case 7:  return pool<7>::allocate();
+            default: return Alloc().allocate(a_size);
+        }
+    }
+
+    static void deallocate(void* a_block, size_t a_size) {
+        switch (size_class(a_size)) {
+            case 0:  pool<0>::deallocate(a_block); break;
+            case 1:  pool<1>::deallocate(a_block); break;
+            case 2:  pool<2>::deallocate(a_block); break;
+            case 3:  pool<3>::deallocate(a_block); break;
+            case 4:  pool<4>::deallocate(a_block); break;
+            case 5:  pool<5>::deallocate(a_block); break;
+            case 6:  pool<6>::deallocate(a_block); break;
+            case 7:  pool<7>::deallocate(a_block); break;
+            default: Alloc().deallocate(static_cast<char*>(a_block), a_size);
+        }
+    }
+};
+
+/// Placeholder of a pool for queues with stateful allocators
+struct mpsc_no_pool {
+    static void* allocate(size_t = 0)        { throw std::bad_alloc(); }
+    static void  deallocate(void*, size_t = 0) {}
+};
+
+} // namespace detail
+
 /**
  * A lock-free implementation of the multi-producer-single-consumer queue.
  * All elements are equally sized of type T.
@@ -75,11 +233,31 @@ struct concurrent_mpsc_queue {
 
     typedef typename Allocator::template rebind<node>::other Alloc;
 
-    explicit concurrent_mpsc_queue(const Alloc& a_alloc = Alloc())
+    /// True if nodes can be recycled through a pool (the allocator is
+    /// stateless and the node doesn't need extended alignment)
+    static constexpr bool s_poolable =
+        std::is_empty<Allocator>::value &&
+        alignof(node) <= alignof(std::max_align_t);
+
+    typedef typename std::conditional<s_poolable,
+        detail::mpsc_block_pool<sizeof(node),
+                                typename Allocator::template rebind<char>::other>,
+        detail::mpsc_no_pool>::type node_pool;
+
+    /// @param a_alloc  allocator of nodes
+    /// @param a_pooled when true (and the allocator is stateless), freed
+    ///                 nodes are recycled through a lock-free pool of nodes
+    ///                 cached by every thread, instead of being deallocated
+    explicit concurrent_mpsc_queue(const Alloc& a_alloc = Alloc(),
+                                   bool a_pooled = true)
         : m_head     (nullptr)
         , m_allocator(a_alloc)
+        , m_pooled   (a_pooled && s_poolable)
     {}
 
+    /// True if the nodes are recycled through the node pool
+    bool pooled() const { return m_pooled; }
+
     bool empty() const {
         return m_head.load(std::memory_order_relaxed) == nullptr;
     }
@@ -87,7 +265,7 @@ struct concurrent_mpsc_queue {
     template <typename... Args>
     node* allocate(Args&&... args) {
         try {
-            node*  n = m_allocator.allocate(1);
+            node*  n = allocate_node();
             new   (n)  node(std::forward<Args>(args)...);
             return n;
         } catch (std::bad_alloc const&) {
@@ -98,7 +276,7 @@ struct concurrent_mpsc_queue {
     /// Insert an element's copy into the queue. 
     bool push(const T& data) {
         try {
-            node* n = m_allocator.allocate(1);
+            node* n = allocate_node();
             new  (n)  node(data);
             push (n);
             return true;
@@ -150,7 +328,10 @@ struct concurrent_mpsc_queue {
     /// Deallocate a node created by a call to pop_all() or pop_all_reverse()
     void free(node* a_node) {
         a_node->~node();
-        m_allocator.deallocate(a_node, a_node->size());
+        if (m_pooled)
+            node_pool::deallocate(a_node);
+        else
+            m_allocator.deallocate(a_node, 1);
     }
 
     /// Clear the queue
@@ -163,6 +344,12 @@ struct concurrent_mpsc_queue {
 private:
     std::atomic<node*> m_head;
     Alloc              m_allocator;
+    const bool         m_pooled;
+
+    node* allocate_node() {
+        return m_pooled ? static_cast<node*>(node_pool::allocate())
+                        : m_allocator.allocate(1);
+    }
 };
 
 template <class Allocator>
@@ -193,18 +380,36 @@ struct concurrent_mpsc_queue<char, Allocator> {
         { assert(sizeof(T) == m_size); return *reinterpret_cast<const T*>(m_data); }
     };
 
-    explicit concurrent_mpsc_queue(const Allocator& a_alloc = Allocator())
+    /// True if nodes can be recycled through a pool (the allocator is
+    /// stateless)
+    static constexpr bool s_poolable = std::is_empty<Allocator>::value;
+
+    typedef typename std::conditional<s_poolable,
+        detail::mpsc_sized_pool<Allocator>,
+        detail::mpsc_no_pool>::type node_pool;
+
+    /// @param a_alloc  allocator of nodes
+    /// @param a_pooled when true (and the allocator is stateless), freed
+    ///                 nodes of up to 4K bytes are recycled through lock-free
+    ///                 pools of nodes cached by every thread (one pool per
+    ///                 power-of-2 size class)
+    explicit concurrent_mpsc_queue(const Allocator& a_alloc = Allocator(),
+                                   bool a_pooled = true)
         : m_head     (nullptr)
         , m_allocator(a_alloc)
+        , m_pooled   (a_pooled && s_poolable)
     {}
 
+    /// True if the nodes are recycled through the node pool
+    bool pooled() const { return m_pooled; }
+
     bool empty() const {
         return m_head.load(std::memory_order_relaxed) == nullptr;
     }
 
     node* allocate(size_t a_size) {
         try {
-            node*  n = m_allocator.allocate(sizeof(node) + a_size);
+            node*  n = allocate_node(a_size);
             new   (n)  node(a_size);
             return n;
         } catch(std::bad_alloc const&) {
@@ -217,7 +422,7 @@ struct concurrent_mpsc_queue<char, Allocator> {
     template <typename T, typename... Args>
     bool emplace(Args&&... args) {
         try {
-            node* n    = reinterpret_cast<node*>(m_allocator.allocate(sizeof(node) + sizeof(T)));
+            node* n    = allocate_node(sizeof(T));
             new  (n)     node(sizeof(T));
             T*    data = reinterpret_cast<T*>(n->data());
             new  (data)  T(std::forward<Args>(args)...);
@@ -231,7 +436,7 @@ struct concurrent_mpsc_queue<char, Allocator> {
     template <typename InitLambda>
     bool push(size_t a_size, InitLambda a_fun) {
         try {
-            node* n    = reinterpret_cast<node*>(m_allocator.allocate(sizeof(node) + a_size));
+            node* n    = allocate_node(a_size);
             new  (n)     node(a_size);
             a_fun(n->data(), a_size);
             push (n);
@@ -244,7 +449,7 @@ struct concurrent_mpsc_queue<char, Allocator> {
     template <int N>
     bool push(const char (&a_value)[N]) {
         try {
-            node*  n  = reinterpret_cast<node*>(m_allocator.allocate(sizeof(node) + N));
+            node*  n  = allocate_node(N);
             new   (n)   node(N);
             memcpy(n->data(), a_value, N);
             push  (n);
@@ -258,7 +463,7 @@ struct concurrent_mpsc_queue<char, Allocator> {
     bool push(const std::basic_string<Ch>& a_value) {
         try {
             size_t sz  = a_value.size()+1;
-            node*  n   = reinterpret_cast<node*>(m_allocator.allocate(sizeof(node) + sz));
+            node*  n   = allocate_node(sz);
             new   (n)    node(sz);
             memcpy(n->data(), a_value.c_str(), sz);
             push  (n);
@@ -298,8 +503,12 @@ struct concurrent_mpsc_queue<char, Allocator> {
 
     /// Deallocate a node created by a call to pop_all() or pop_all_reverse()
     void free(node* a_node) {
+        size_t sz = sizeof(node) + a_node->size();
         a_node->~node();
-        m_allocator.deallocate(reinterpret_cast<char*>(a_node), sizeof(node) + a_node->size());
+        if (m_pooled)
+            node_pool::deallocate(a_node, sz);
+        else
+            m_allocator.deallocate(reinterpret_cast<char*>(a_node), sz);
     }
 
     /// Clear the queue
@@ -312,6 +521,14 @@ struct concurrent_mpsc_queue<char, Allocator> {
 public:
     std::atomic<node*> m_head;
     Allocator          m_allocator;
+private:
+    const bool         m_pooled;
+
+    node* allocate_node(size_t a_size) {
+        size_t sz = sizeof(node) + a_size;
+        return reinterpret_cast<node*>
+            (m_pooled ? node_pool::allocate(sz) : m_allocator.allocate(sz));
+    }
 };
 
 #endif // __cplusplus > 201103L
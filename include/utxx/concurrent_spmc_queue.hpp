@@ -0,0 +1,590 @@
+// vim:ts=4:et:sw=4
+//----------------------------------------------------------------------------
+/// \file   concurrent_spmc_queue.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Single-producer multi-consumer broadcast queue.
+///
+/// Every item pushed by the producer is delivered to every subscribed
+/// consumer.  The items are written once to a ring, and each consumer
+/// advances its own cursor over the ring.  The ring and the cursors can be
+/// located in a memory-mapped file (or other shared memory), so that fan-out
+/// to consumers in several processes costs a single write.
+///
+/// When the ring is full, the overflow policy chosen at creation decides
+/// whether the producer waits for the slowest consumer (spmc_overflow::block),
+/// or overwrites the oldest items, in which case a lagging consumer skips
+/// to the oldest available item and accounts for the lost ones
+/// (spmc_overflow::overwrite).
+///
+/// In the overwrite mode consumers copy items while they may be overwritten,
+/// and discard the copy if it was, so T must be trivially copyable.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+#include <utxx/math.hpp>
+#include <utxx/error.hpp>
+#include <utxx/futex.hpp>
+#include <utxx/scope_exit.hpp>
+#include <utxx/compiler_hints.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utxx {
+
+/// Action taken by the producer of concurrent_spmc_queue when the ring is
+/// full
+enum class spmc_overflow : uint32_t {
+    block,      ///< Wait until the slowest consumer frees space
+    overwrite   ///< Overwrite the oldest items (lagging consumers lose them)
+};
+
+//===========================================================================//
+// concurrent_spmc_queue is a bounded broadcast queue with one producer and  //
+// a fixed maximum number of consumers.                                      //
+//===========================================================================//
+template <class T>
+class concurrent_spmc_queue : private boost::noncopyable
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Items must be trivially copyable");
+
+    static constexpr uint64_t s_magic   = 0x43504d5358545455;   // "UTTXSMPC"
+    static constexpr uint64_t s_writing = ~0ul;                 // Slot is busy
+
+    //-----------------------------------------------------------------------//
+    // Shared state:                                                         //
+    //-----------------------------------------------------------------------//
+    struct header
+    {
+        uint64_t                m_magic;
+        uint32_t                m_capacity;
+        uint32_t                m_max_consumers;
+        uint32_t                m_slot_size;
+        spmc_overflow           m_overflow;
+        alignas(UTXX_CL_SIZE)
+        std::atomic<uint64_t>   m_tail;         // Next position to push
+        alignas(UTXX_CL_SIZE)
+        futex_event             m_not_empty;    // Signaled on push
+        alignas(UTXX_CL_SIZE)
+        futex_event             m_not_full;     // Signaled on consumer's pop
+    };
+
+    struct alignas(UTXX_CL_SIZE) cursor
+    {
+        std::atomic<uint64_t>   m_pos;          // Next position to pop
+        std::atomic<uint64_t>   m_lost;         // Items overwritten unread
+        std::atomic<uint32_t>   m_active;       // 0 - free, 1 - subscribed
+    };
+
+    static constexpr uint32_t s_claimed = 2;    // Consumer is subscribing
+
+    struct slot
+    {
+        std::atomic<uint64_t>   m_seq;          // Position of the item plus 1
+        T                       m_data;
+    };
+
+    template <class U>
+    static constexpr size_t align(U n)
+      { return (n + UTXX_CL_SIZE - 1) / UTXX_CL_SIZE * UTXX_CL_SIZE; }
+
+    static constexpr size_t s_header_size = align(sizeof(header));
+
+public:
+    typedef T value_type;
+
+    class consumer;
+
+    /// Number of attempts made by blocking calls before parking the thread
+    static constexpr int s_spin_count = 128;
+
+    /// @return memory size needed for a queue of \a a_capacity items
+    /// (rounded up to a power of 2) and \a a_max_consumers
+    static size_t memory_size(uint32_t a_capacity, uint32_t a_max_consumers)
+    {
+        return s_header_size + a_max_consumers * sizeof(cursor)
+             + adjust_capacity(a_capacity) * sizeof(slot);
+    }
+
+    /// Default permission mask used for creating a file
+    static int default_file_mode() { return S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP; }
+
+    //-----------------------------------------------------------------------//
+    // Ctors, Dtor:                                                          //
+    //-----------------------------------------------------------------------//
+    /// Use one of the init() methods to attach the queue to its storage
+    concurrent_spmc_queue()
+        : m_header(nullptr), m_cursors(nullptr), m_slots(nullptr)
+        , m_mask(0), m_min_pos(0), m_map_size(0)
+    {}
+
+    /// Ctor for using external memory (see init())
+    concurrent_spmc_queue(void* a_storage, size_t a_size, bool a_init,
+                          uint32_t      a_max_consumers = 16,
+                          spmc_overflow a_overflow      = spmc_overflow::block)
+        : concurrent_spmc_queue()
+    {
+        init(a_storage, a_size, a_init, a_max_consumers, a_overflow);
+    }
+
+    ~concurrent_spmc_queue() { close(); }
+
+    /// Attach the queue to external memory (e.g. shared memory).
+    /// @param a_storage memory aligned at least to cache line size
+    /// @param a_size    size of \a a_storage obtained by memory_size()
+    /// @param a_init    when true the queue is initialized empty, with the
+    ///                  capacity of as many items as fit in \a a_size.
+    ///                  Otherwise \a a_storage must contain a queue
+    ///                  initialized by another instance (possibly in another
+    ///                  process), and the remaining arguments are ignored.
+    void init(void* a_storage, size_t a_size, bool a_init,
+              uint32_t      a_max_consumers = 16,
+              spmc_overflow a_overflow      = spmc_overflow::block)
+    {
+        close();
+        if (reinterpret_cast<uintptr_t>(a_storage) % UTXX_CL_SIZE != 0)
+            UTXX_THROW_BADARG_ERROR("Misaligned storage: ", a_storage);
+
+        auto hdr = static_cast<header*>(a_storage);
+        if (a_init) {
+            size_t fixed = s_header_size + a_max_consumers * sizeof(cursor);
+            if (a_max_consumers == 0 || a_size <= fixed)
+                UTXX_THROW_BADARG_ERROR("Invalid storage size: ", a_size);
+            auto n   = uint32_t((a_size - fixed) / sizeof(slot));
+            auto cap = adjust_capacity(n);
+            if (cap > n) cap /= 2;
+            if (cap < 2)
+                UTXX_THROW_BADARG_ERROR("Invalid storage size: ", a_size);
+            format(hdr, cap, a_max_consumers, a_overflow);
+        } else {
+            validate(hdr, a_size, "memory");
+        }
+        attach(hdr);
+    }
+
+    /// Create or open a queue in a memory-mapped file.
+    /// @param a_filename      name of the file
+    /// @param a_capacity      max number of items (rounded up to power of 2)
+    /// @param a_max_consumers max number of subscribed consumers
+    /// @param a_overflow      overflow policy
+    /// @param a_mode          permissions of the file when it's created
+    /// @return true if the file didn't exist and was created.  If it exists,
+    ///         it's used with its own capacity and policy.
+    bool init(const char* a_filename, uint32_t a_capacity,
+              uint32_t      a_max_consumers = 16,
+              spmc_overflow a_overflow      = spmc_overflow::block,
+              int           a_mode          = default_file_mode())
+    {
+        close();
+
+        int fd = ::open(a_filename, O_RDWR | O_CREAT, a_mode);
+        if (fd < 0)
+            UTXX_THROW_IO_ERROR(errno, "Cannot open file ", a_filename);
+        UTXX_SCOPE_EXIT([=] { ::close(fd); });
+
+        // Serialize creation with other processes opening the same file.
+        // The lock must be released explicitly, since the mapping keeps
+        // the open file description alive after the descriptor is closed
+        if (::flock(fd, LOCK_EX) < 0)
+            UTXX_THROW_IO_ERROR(errno, "Cannot lock file ", a_filename);
+        UTXX_SCOPE_EXIT([=] { ::flock(fd, LOCK_UN); });
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0)
+            UTXX_THROW_IO_ERROR(errno, "Cannot stat file ", a_filename);
+
+        bool   create = st.st_size == 0;
+        size_t size   = create ? memory_size(a_capacity, a_max_consumers)
+                               : size_t(st.st_size);
+        if (create && ::ftruncate(fd, size) < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error setting file ", a_filename,
+                                " to size ", size);
+
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            UTXX_THROW_IO_ERROR(errno, "Cannot map file ", a_filename);
+        m_map_size = size;
+
+        auto hdr = static_cast<header*>(p);
+        try {
+            if (create)
+                format(hdr, adjust_capacity(a_capacity), a_max_consumers,
+                       a_overflow);
+            else
+                validate(hdr, size, a_filename);
+        } catch (...) {
+            ::munmap(p, size);
+            m_map_size = 0;
+            throw;
+        }
+        attach(hdr);
+        return create;
+    }
+
+    /// Detach from storage (unmap the file if it was mapped by init())
+    void close()
+    {
+        if (m_map_size)
+            ::munmap(m_header, m_map_size);
+        m_header   = nullptr;
+        m_map_size = 0;
+    }
+
+    //-----------------------------------------------------------------------//
+    // Properties:                                                           //
+    //-----------------------------------------------------------------------//
+    bool          is_open()       const { return m_header != nullptr;       }
+    uint32_t      capacity()      const { return m_header->m_capacity;      }
+    uint32_t      max_consumers() const { return m_header->m_max_consumers; }
+    spmc_overflow overflow()      const { return m_header->m_overflow;      }
+
+    /// Total number of items pushed
+    uint64_t      pushed() const
+      { return m_header->m_tail.load(std::memory_order_relaxed); }
+
+    /// Number of subscribed consumers
+    uint32_t      consumers() const
+    {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < max_consumers(); ++i)
+            n += m_cursors[i].m_active.load(std::memory_order_relaxed) == 1;
+        return n;
+    }
+
+    //-----------------------------------------------------------------------//
+    // Producer:                                                             //
+    //-----------------------------------------------------------------------//
+    /// Push an item to all consumers (must be called by a single thread).
+    /// @return false if the overflow policy is "block" and the slowest
+    ///         consumer hasn't consumed the item pushed capacity() items ago
+    bool try_push(T const& a_val)
+    {
+        auto& hdr = *m_header;
+        auto  pos = hdr.m_tail.load(std::memory_order_relaxed);
+        auto& s   = m_slots[pos & m_mask];
+
+        if (hdr.m_overflow == spmc_overflow::block) {
+            if (unlikely(pos - m_min_pos > m_mask) &&
+                (m_min_pos = min_position(pos)) + m_mask < pos)
+                return false;
+            s.m_data = a_val;
+        } else {
+            // Make concurrent readers of the slot discard their copy
+            s.m_seq.store(s_writing, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.m_data = a_val;
+        }
+        s.m_seq.store(pos+1, std::memory_order_release);
+        hdr.m_tail.store(pos+1, std::memory_order_release);
+        hdr.m_not_empty.notify_all();
+        return true;
+    }
+
+    /// Push an item to all consumers, waiting while the queue is full
+    /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+    /// @return false on timeout
+    bool push(T const& a_val, const timespec* a_timeout = nullptr)
+    {
+        return m_header->m_not_full.wait
+            ([&]() { return try_push(a_val); }, a_timeout, s_spin_count);
+    }
+
+    template <class Rep, class Period>
+    bool push(T const& a_val, std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ts = to_timespec(a_timeout);
+        return push(a_val, &ts);
+    }
+
+    /// Forcefully unsubscribe a consumer (e.g. of a process that died, which
+    /// would otherwise hold back the producer in the "block" mode)
+    void evict(uint32_t a_id)
+    {
+        if (a_id >= max_consumers())
+            UTXX_THROW_BADARG_ERROR("Invalid consumer id: ", a_id);
+        m_cursors[a_id].m_active.store(0, std::memory_order_release);
+        m_header->m_not_full.notify();
+    }
+
+    //-----------------------------------------------------------------------//
+    // Consumers:                                                            //
+    //-----------------------------------------------------------------------//
+    /// Subscribe a consumer that will receive items pushed from now on.
+    /// The consumer is unsubscribed when the returned object is destroyed.
+    /// @throw runtime_error if max_consumers() are already subscribed
+    consumer subscribe()
+    {
+        auto& hdr = *m_header;
+        for (uint32_t i = 0; i < max_consumers(); ++i) {
+            auto&    c    = m_cursors[i];
+            uint32_t free = 0;
+            if (c.m_active.load(std::memory_order_relaxed) ||
+               !c.m_active.compare_exchange_strong(free, s_claimed))
+                continue;
+            c.m_pos.store(hdr.m_tail.load(std::memory_order_acquire),
+                          std::memory_order_relaxed);
+            c.m_lost.store(0, std::memory_order_relaxed);
+            c.m_active.store(1);
+            // The producer may have advanced past the position stored above
+            // before it could see the cursor, so re-read it afterwards
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            c.m_pos.store(hdr.m_tail.load(std::memory_order_acquire),
+                          std::memory_order_release);
+            return consumer(this, i);
+        }
+        UTXX_THROW_RUNTIME_ERROR("No free consumer slots (max=",
+                                 max_consumers(), ')');
+    }
+
+    /// Consumer's handle of a queue (can only be used by one thread at a
+    /// time, and is movable between threads)
+    class consumer
+    {
+        friend class concurrent_spmc_queue;
+
+        concurrent_spmc_queue* m_queue;
+        uint32_t               m_id;
+
+        consumer(concurrent_spmc_queue* a_q, uint32_t a_id)
+            : m_queue(a_q), m_id(a_id)
+        {}
+
+        cursor& cur() const { return m_queue->m_cursors[m_id]; }
+    public:
+        consumer() : m_queue(nullptr), m_id(0) {}
+        consumer(consumer&& a_rhs) : m_queue(a_rhs.m_queue), m_id(a_rhs.m_id)
+          { a_rhs.m_queue = nullptr; }
+        consumer(const consumer&) = delete;
+
+        consumer& operator=(consumer&& a_rhs)
+        {
+            if (this != &a_rhs) {
+                unsubscribe();
+                m_queue = a_rhs.m_queue;
+                m_id    = a_rhs.m_id;
+                a_rhs.m_queue = nullptr;
+            }
+            return *this;
+        }
+
+        ~consumer() { unsubscribe(); }
+
+        /// Release the consumer's slot in the queue
+        void unsubscribe()
+        {
+            if (m_queue)
+                m_queue->evict(m_id);
+            m_queue = nullptr;
+        }
+
+        bool     valid() const { return m_queue != nullptr; }
+        uint32_t id()    const { return m_id; }
+
+        /// Number of items overwritten before this consumer read them
+        uint64_t lost()  const { return cur().m_lost.load(std::memory_order_relaxed); }
+
+        /// Number of items pending for this consumer
+        uint64_t size()  const
+        {
+            auto n = m_queue->pushed() - cur().m_pos.load(std::memory_order_relaxed);
+            return std::min<uint64_t>(n, m_queue->capacity());
+        }
+
+        bool     empty() const { return size() == 0; }
+
+        /// Get the next item
+        /// @return false if there are no pending items
+        bool try_pop(T& a_val) { return m_queue->read(cur(), a_val); }
+
+        /// Get the next item, waiting while there are no pending items
+        /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+        /// @return false on timeout
+        bool pop(T& a_val, const timespec* a_timeout = nullptr)
+        {
+            return m_queue->m_header->m_not_empty.wait
+                ([&]() { return try_pop(a_val); }, a_timeout, s_spin_count);
+        }
+
+        template <class Rep, class Period>
+        bool pop(T& a_val, std::chrono::duration<Rep, Period> a_timeout)
+        {
+            auto ts = to_timespec(a_timeout);
+            return pop(a_val, &ts);
+        }
+    };
+
+private:
+    header*     m_header;
+    cursor*     m_cursors;
+    slot*       m_slots;
+    uint64_t    m_mask;
+    uint64_t    m_min_pos;      // Producer's cached position of slowest consumer
+    size_t      m_map_size;     // Non-zero if the storage was mapped by init()
+
+    static uint32_t adjust_capacity(uint32_t a_capacity)
+    {
+        return a_capacity < 2 ? 2 : math::upper_power(a_capacity, 2);
+    }
+
+    template <class Rep, class Period>
+    static timespec to_timespec(std::chrono::duration<Rep, Period> a_timeout)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (a_timeout).count();
+        if (ns < 0) ns = 0;
+        return timespec{time_t(ns / 1000000000), long(ns % 1000000000)};
+    }
+
+    static void format(header* a_hdr, uint32_t a_capacity,
+                       uint32_t a_max_consumers, spmc_overflow a_overflow)
+    {
+        auto& hdr = *new (a_hdr) header;
+        hdr.m_capacity      = a_capacity;
+        hdr.m_max_consumers = a_max_consumers;
+        hdr.m_slot_size     = sizeof(slot);
+        hdr.m_overflow      = a_overflow;
+        hdr.m_tail.store(0, std::memory_order_relaxed);
+
+        auto cursors = cursors_of(a_hdr);
+        for (uint32_t i = 0; i < a_max_consumers; ++i) {
+            auto& c = *new (&cursors[i]) cursor;
+            c.m_pos.store(0,    std::memory_order_relaxed);
+            c.m_lost.store(0,   std::memory_order_relaxed);
+            c.m_active.store(0, std::memory_order_relaxed);
+        }
+        auto slots = slots_of(a_hdr);
+        for (uint32_t i = 0; i < a_capacity; ++i)
+            new (&slots[i].m_seq) std::atomic<uint64_t>(0);
+
+        std::atomic_thread_fence(std::memory_order_release);
+        hdr.m_magic = s_magic;
+    }
+
+    static void validate(header* a_hdr, size_t a_size, const char* a_name)
+    {
+        if (a_size < s_header_size || a_hdr->m_magic != s_magic)
+            UTXX_THROW_RUNTIME_ERROR("Invalid spmc queue format in ", a_name);
+        if (a_hdr->m_slot_size != sizeof(slot))
+            UTXX_THROW_RUNTIME_ERROR("Invalid item size in ", a_name,
+                                     " (expected ", sizeof(slot),
+                                     " got ", a_hdr->m_slot_size, ')');
+        auto sz = memory_size(a_hdr->m_capacity, a_hdr->m_max_consumers);
+        if (a_size < sz)
+            UTXX_THROW_BADARG_ERROR("Storage size ", a_size, " of ", a_name,
+                                    " is smaller than queue's size ", sz);
+    }
+
+    static cursor* cursors_of(header* a_hdr)
+    {
+        return reinterpret_cast<cursor*>
+               (reinterpret_cast<char*>(a_hdr) + s_header_size);
+    }
+
+    static slot* slots_of(header* a_hdr)
+    {
+        return reinterpret_cast<slot*>
+               (cursors_of(a_hdr) + a_hdr->m_max_consumers);
+    }
+
+    void attach(header* a_hdr)
+    {
+        m_header  = a_hdr;
+        m_cursors = cursors_of(a_hdr);
+        m_slots   = slots_of(a_hdr);
+        m_mask    = a_hdr->m_capacity - 1;
+        m_min_pos = min_position(a_hdr->m_tail.load(std::memory_order_acquire));
+    }
+
+    /// Position of the slowest active consumer (or \a a_tail if there are
+    /// no consumers)
+    uint64_t min_position(uint64_t a_tail) const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t res = a_tail;
+        for (uint32_t i = 0, n = m_header->m_max_consumers; i < n; ++i) {
+            auto& c = m_cursors[i];
+            if (c.m_active.load(std::memory_order_acquire) != 1)
+                continue;
+            auto pos = c.m_pos.load(std::memory_order_acquire);
+            if (pos < res)
+                res = pos;
+        }
+        return res;
+    }
+
+    bool read(cursor& a_cur, T& a_val)
+    {
+        auto& hdr = *m_header;
+        auto  pos = a_cur.m_pos.load(std::memory_order_relaxed);
+        while (true) {
+            auto tail = hdr.m_tail.load(std::memory_order_acquire);
+            if (pos == tail)
+                return false;
+
+            if (hdr.m_overflow == spmc_overflow::block) {
+                a_val = m_slots[pos & m_mask].m_data;
+                break;
+            }
+
+            // The items older than capacity() have been overwritten
+            if (unlikely(tail - pos > m_mask + 1)) {
+                auto next = tail - m_mask - 1;
+                a_cur.m_lost.fetch_add(next - pos, std::memory_order_relaxed);
+                pos = next;
+            }
+            auto& s   = m_slots[pos & m_mask];
+            auto  seq = s.m_seq.load(std::memory_order_acquire);
+            if (seq == pos+1) {
+                std::memcpy(static_cast<void*>(&a_val), &s.m_data, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.m_seq.load(std::memory_order_relaxed) == seq)
+                    break;
+            }
+            // The slot was overwritten while we were reading it, so the
+            // producer is now more than capacity() items ahead: skip forward
+        }
+        a_cur.m_pos.store(pos+1, std::memory_order_release);
+        if (hdr.m_overflow == spmc_overflow::block)
+            hdr.m_not_full.notify();
+        return true;
+    }
+};
+
+} // namespace utxx
@@ -38,10 +38,12 @@
 */
 #pragma once
 
+#include <utxx/config.h>
 #include <utxx/math.hpp>
 #include <utxx/error.hpp>
 #include <utxx/compiler_hints.hpp>
 #include <boost/noncopyable.hpp>
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
@@ -55,14 +57,35 @@
 
 namespace utxx {
 
+//===========================================================================//
+// Memory layout of the queue's head and tail indices:                       //
+//===========================================================================//
+enum class spsc_layout
+{
+    // Head and tail are adjacent, and every push/pop reads the opposite side's
+    // index (the line holding them is transferred between the producer's and
+    // consumer's cores on every operation):
+    compact,
+    // Head and tail are on separate cache lines, and the producer and consumer
+    // keep local cached copies of the opposite side's index, which are only
+    // refreshed when the queue appears full (or empty, respectively):
+    padded
+};
+
 //===========================================================================//
 // concurrent_spsc_queue is a one producer and one consumer queue            //
 // without locks.                                                            //
 //===========================================================================//
-template<class T, uint32_t StaticCapacity=0>
+template<class T, uint32_t StaticCapacity=0,
+         spsc_layout Layout = spsc_layout::compact>
 class concurrent_spsc_queue : private boost::noncopyable
 {
 private:
+    static constexpr bool   s_padded = Layout == spsc_layout::padded;
+    // Size of padding following an index in the "padded" layout:
+    static constexpr size_t s_pad    = s_padded
+                                     ? UTXX_CL_SIZE - sizeof(uint32_t) : 0;
+
     //=======================================================================//
     // Implementation:                                                       //
     //=======================================================================//
@@ -72,7 +95,9 @@ private:
     struct header
     {
         std::atomic<uint32_t>  m_head;
+        char                   m_head_pad[s_pad];
         std::atomic<uint32_t>  m_tail;
+        char                   m_tail_pad[s_pad];
         uint32_t    const      m_capacity;
         T                      __padding[0];
 
@@ -163,6 +188,9 @@ public:
            (a_size  - sizeof(header)) % sizeof(T) != 0)
             UTXX_THROW_BADARG_ERROR("Invalid storage size: ", a_size);
 
+        // The storage may hold a queue that is already in use:
+        refresh_cache();
+
         if (unlikely(StaticCapacity != 0))
             UTXX_THROW_RUNTIME_ERROR("Cannot specify both static and dynamic "
                                      "capacity!");
@@ -252,7 +280,7 @@ public:
         uint32_t t    = tail().load(std::memory_order_relaxed);
         uint32_t next = increment(t);
 
-        if (next != head().load(std::memory_order_acquire))
+        if (next != producer_head(next))
         {
             T* at = m_rec_ptr + t;
             new (at) T(std::forward<Args>(a_item_args)...);
@@ -270,7 +298,7 @@ public:
         assert(m_side != side_t::producer);
 
         uint32_t h = head().load(std::memory_order_relaxed);
-        if (h == tail().load(std::memory_order_acquire))
+        if (h == consumer_tail(h))
             // queue is empty:
             return false;
 
@@ -290,7 +318,7 @@ public:
         assert(m_side != side_t::producer);
 
         uint32_t h = head().load(std::memory_order_relaxed);
-        assert(h  != tail().load(std::memory_order_acquire));
+        assert(h  != consumer_tail(h));
 
         uint32_t next = increment(h);
         if (!std::is_trivially_destructible<T>::value)
@@ -308,7 +336,7 @@ public:
 
         uint32_t h = head().load(std::memory_order_relaxed);
         return
-            (h == tail().load(std::memory_order_acquire))
+            (h == consumer_tail(h))
             ? nullptr    // queue is empty
             : (m_rec_ptr + h);
     }
@@ -321,6 +349,57 @@ public:
               (const_cast<concurrent_spsc_queue const*>(this)->peek());
     }
 
+    /// Copy (or move, given move iterators) up to \a a_n items starting at
+    /// \a a_items to the queue, making them visible to the consumer at once.
+    /// @return the number of items written (less than \a a_n if the queue
+    /// doesn't have enough space)
+    template<class InputIt>
+    uint32_t push_n(InputIt a_items, uint32_t a_n)
+    {
+        // Must NOT be on the Consumer side:
+        assert(m_side != side_t::consumer);
+
+        uint32_t t    = tail().load(std::memory_order_relaxed);
+        uint32_t room = (cached_head() - t - 1) & m_mask;
+        if (room < a_n && s_padded)
+            room = (load_head() - t - 1) & m_mask;
+
+        uint32_t n = std::min(a_n, room);
+        for (uint32_t i = 0; i < n; ++i, ++a_items, t = increment(t))
+            new (m_rec_ptr + t) T(*a_items);
+
+        if (n)
+            tail().store(t, std::memory_order_release);
+        return n;
+    }
+
+    /// Move up to \a a_n items from the front of the queue to \a a_items,
+    /// releasing their slots to the producer at once.
+    /// @return the number of items read
+    template<class OutputIt>
+    uint32_t pop_n(OutputIt a_items, uint32_t a_n)
+    {
+        // Must NOT be on the Producer side:
+        assert(m_side != side_t::producer);
+
+        uint32_t h     = head().load(std::memory_order_relaxed);
+        uint32_t avail = (cached_tail() - h) & m_mask;
+        if (avail < a_n && s_padded)
+            avail = (load_tail() - h) & m_mask;
+
+        uint32_t n = std::min(a_n, avail);
+        for (uint32_t i = 0; i < n; ++i, ++a_items, h = increment(h))
+        {
+            *a_items = std::move(m_rec_ptr[h]);
+            if (!std::is_trivially_destructible<T>::value)
+                m_rec_ptr[h].~T();
+        }
+
+        if (n)
+            head().store(h, std::memory_order_release);
+        return n;
+    }
+
     /// Clear: Remove all entries from the queue. Only safe if invoked on the
     /// Consumer side:
     void clear(bool force = false)
@@ -346,8 +425,8 @@ public:
     bool empty() const
     {
         assert(m_side != side_t::producer);
-        return head().load(std::memory_order_relaxed)
-            == tail().load(std::memory_order_acquire);
+        uint32_t h = head().load(std::memory_order_relaxed);
+        return   h == consumer_tail(h);
     }
 
     /// Test for the queue begin full, safe if invoked from the producer side.
@@ -359,7 +438,7 @@ public:
     {
         assert(m_side != side_t::consumer);
         uint32_t next =  increment(tail().load(std::memory_order_relaxed));
-        return   next == head().load(std::memory_order_acquire);
+        return   next == producer_head(next);
     }
 
     /// Return current count of T objects stored in the queue.
@@ -727,17 +806,74 @@ private:
             UTXX_THROW_BADARG_ERROR("Side must be valid, and "
                                     "only allowed with shared data");
         m_side = side;
+        refresh_cache();
     }
 
 private:
+    // Index cached by one side (on its own cache line in the "padded" layout,
+    // so that the producer's and consumer's caches don't share a line):
+    struct cached_index
+    {
+        char                   m_pad[s_pad];
+        uint32_t mutable       m_value = 0;
+    };
+
     header          m_header;
     header*  const  m_header_ptr;   // Ptr to the actual hdr  (mb to m_header)
     T*       const  m_rec_ptr;      // Ptr to the actual data (mb to m_records)
     bool     const  m_shared_data;
     side_t          m_side;
     uint32_t const  m_mask;
+    cached_index    m_head_cache;   // Producer's copy of head ("padded" only)
+    cached_index    m_tail_cache;   // Consumer's copy of tail ("padded" only)
+    char            m_cache_pad[s_pad];
     T               m_records[StaticCapacity];
 
+    //-----------------------------------------------------------------------//
+    // Opposite side's index seen by the producer (head) and the consumer    //
+    // (tail). In the "padded" layout the cached copy is used, unless it     //
+    // equals \a a_idx, i.e. the queue appears full (empty, respectively):   //
+    //-----------------------------------------------------------------------//
+    uint32_t load_head() const
+    {
+        uint32_t h = head().load(std::memory_order_acquire);
+        if (s_padded)
+            m_head_cache.m_value = h;
+        return h;
+    }
+
+    uint32_t load_tail() const
+    {
+        uint32_t t = tail().load(std::memory_order_acquire);
+        if (s_padded)
+            m_tail_cache.m_value = t;
+        return t;
+    }
+
+    uint32_t cached_head() const
+      { return s_padded ? m_head_cache.m_value : load_head(); }
+
+    uint32_t cached_tail() const
+      { return s_padded ? m_tail_cache.m_value : load_tail(); }
+
+    uint32_t producer_head(uint32_t a_idx) const
+    {
+        uint32_t h = cached_head();
+        return (s_padded && h == a_idx) ? load_head() : h;
+    }
+
+    uint32_t consumer_tail(uint32_t a_idx) const
+    {
+        uint32_t t = cached_tail();
+        return (s_padded && t == a_idx) ? load_tail() : t;
+    }
+
+    void refresh_cache()
+    {
+        m_head_cache.m_value = head().load(std::memory_order_acquire);
+        m_tail_cache.m_value = tail().load(std::memory_order_acquire);
+    }
+
     //-----------------------------------------------------------------------//
     // Accessors (for internal use only):                                    //
     //-----------------------------------------------------------------------//
@@ -72,30 +72,33 @@ public:
 /// @class blocking_unbound_fifo
 //-----------------------------------------------------------------------------
 
-template <typename T, int Size, typename EventT = futex>
+template <typename T, int Size, typename EventT = futex,
+          typename WaitT = wait_strategy>
 class blocking_bound_fifo
     : public detail::blocking_lock_free_queue<
-        T, detail::bound_allocator<T,Size>, true, EventT> {
+        T, detail::bound_allocator<T,Size>, true, EventT, WaitT> {
     typedef detail::blocking_lock_free_queue<
-        T, detail::bound_allocator<T,Size>, true, EventT> base_t;
+        T, detail::bound_allocator<T,Size>, true, EventT, WaitT> base_t;
     detail::bound_allocator<T,Size> m_allocator;
 public:
-    blocking_bound_fifo() : base_t(m_allocator) {}
+    explicit blocking_bound_fifo(const WaitT& a_wait = WaitT())
+        : base_t(m_allocator, a_wait) {}
 };
 
 //-----------------------------------------------------------------------------
 /// @class blocking_unbound_fifo
 //-----------------------------------------------------------------------------
 
-template <typename T, typename EventT = futex>
+template <typename T, typename EventT = futex, typename WaitT = wait_strategy>
 class blocking_unbound_fifo
     : public detail::blocking_lock_free_queue<
-        T, detail::unbound_cached_allocator<T>, false, EventT> {
+        T, detail::unbound_cached_allocator<T>, false, EventT, WaitT> {
     typedef detail::blocking_lock_free_queue<
-        T, detail::unbound_cached_allocator<T>, false, EventT> base_t;
+        T, detail::unbound_cached_allocator<T>, false, EventT, WaitT> base_t;
     detail::unbound_cached_allocator<T> m_allocator;
 public:
-    blocking_unbound_fifo() : base_t(m_allocator) {}
+    explicit blocking_unbound_fifo(const WaitT& a_wait = WaitT())
+        : base_t(m_allocator, a_wait) {}
 };
 
 } // namespace container
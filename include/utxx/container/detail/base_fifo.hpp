@@ -47,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/atomic.hpp>
 #include <utxx/container/concurrent_stack.hpp>
 #include <utxx/container/detail/base_allocator.hpp>
+#include <utxx/wait_strategy.hpp>
 #include <ostream>
 
 namespace utxx {
@@ -173,19 +174,24 @@ public:
 /// A queue class that supports blocking put/get operations in cases when the
 /// queue is full/empty.
 /// Implementation can be bound or unbound depending on the chosen allocator.
+/// The way a blocked caller waits for the queue to become non-empty/non-full
+/// is determined by the \a WaitT policy (see utxx::wait_strategy).
 //-----------------------------------------------------------------------------
-template <typename T, typename AllocT, bool IsBound, typename EventT = futex>
+template <typename T, typename AllocT, bool IsBound, typename EventT = futex,
+          typename WaitT = wait_strategy>
 class blocking_lock_free_queue {
     AllocT&                     m_allocator;
     lock_free_queue<T, AllocT>  m_queue;
     EventT                      m_not_empty_condition;
     EventT                      m_not_full_condition;
+    WaitT                       m_wait;
     bool                        m_terminated;
 public:
-    blocking_lock_free_queue(AllocT& alloc)
+    blocking_lock_free_queue(AllocT& alloc, const WaitT& a_wait = WaitT())
         : m_allocator(alloc)
         , m_queue(alloc), m_not_empty_condition(true)
         , m_not_full_condition(true)
+        , m_wait(a_wait)
         , m_terminated(false)
     {}
 
@@ -195,6 +201,10 @@ public:
         m_terminated = false;
     }
 
+    /// Policy of waiting in blocking enqueue()/dequeue() calls
+    const WaitT& wait_policy() const        { return m_wait; }
+    void wait_policy(const WaitT& a_wait)   { m_wait = a_wait; }
+
     bool try_enqueue(const T& item) { return m_queue.enqueue(item); }
     bool try_dequeue(T& item)       { return m_queue.dequeue(item); }
 
@@ -207,44 +217,22 @@ public:
                 m_not_empty_condition.signal();
             return ok ? 0 : -1;
         }
-        int sync_val = m_not_full_condition.value();
-        if (try_enqueue(item)) {
-            m_not_empty_condition.signal();
-            return 0;
-        }
-        wakeup_result res = m_not_full_condition.wait(timeout, &sync_val);
-        if ((res != wakeup_result::SIGNALED && res != wakeup_result::CHANGED) || m_terminated) {
-            m_not_empty_condition.signal();
-            return -1;
-        }
-        if (try_enqueue(item)) {
-            m_not_empty_condition.signal();
-            return 0;
-        }
-        return -1;
+        bool done = false;
+        m_wait.wait([&]() { return m_terminated || (done = try_enqueue(item)); },
+                    m_not_full_condition, timeout);
+        m_not_empty_condition.signal();
+        return done ? 0 : -1;
     }
 
     int  dequeue(T& item, const struct timespec* timeout = NULL) {
         if (m_terminated)
             return -2;
-        int sync_val = m_not_empty_condition.value();
-        if (try_dequeue(item)) {
-            if (IsBound)
-                m_not_full_condition.signal();
-            return 0;
-        }
-        wakeup_result res = m_not_empty_condition.wait(timeout, &sync_val);
-        if ((res != wakeup_result::SIGNALED && res != wakeup_result::CHANGED) || m_terminated) {
-            if (IsBound)
-                m_not_full_condition.signal();
-            return -1;
-        }
-        if (try_dequeue(item)) {
-            if (IsBound)
-                m_not_full_condition.signal();
-            return 0;
-        }
-        return -1;
+        bool done = false;
+        m_wait.wait([&]() { return m_terminated || (done = try_dequeue(item)); },
+                    m_not_empty_condition, timeout);
+        if (IsBound)
+            m_not_full_condition.signal();
+        return done ? 0 : -1;
     }
 
     /// Returns true if the queue is empty.
@@ -0,0 +1,763 @@
+//----------------------------------------------------------------------------
+/// \file   flat_hash_map.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Open-addressing hash map with SIMD probing of control bytes.
+///
+/// The map stores its elements in a flat array of slots, accompanied by an
+/// array of one-byte control words (the "Swiss table" layout).  A control
+/// byte is either EMPTY, DELETED or holds 7 bits of the hash of the key in
+/// the slot, so that a lookup compares a group of 16 (SSE2) or 32 (AVX2)
+/// control bytes with a single instruction, and only touches the slots
+/// whose hash bits match.  Unlike node-based maps, a lookup normally costs
+/// one cache miss in the control array and one in the slot array.
+///
+/// The map is not thread-safe.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/compiler_hints.hpp>
+#include <utxx/error.hpp>
+#include <utxx/hashmap.hpp>
+#include <utxx/name.hpp>
+#include <utxx/string.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace utxx {
+
+//------------------------------------------------------------------------------
+// Hash and equality functors
+//------------------------------------------------------------------------------
+
+/// Hash functor used by flat_hash_map by default.
+/// The specializations for string-like keys are transparent, i.e. allow
+/// looking up a key by a value of another type without constructing the key.
+template <class K>
+struct flat_hash : std::hash<K> {};
+
+/// Equality functor used by flat_hash_map by default
+template <class K>
+struct flat_equal_to : std::equal_to<K> {};
+
+namespace detail {
+    inline size_t flat_hash_bytes(const char* a_str, size_t a_len) {
+        return murmur_hash64(a_str, a_len, 0);
+    }
+
+    template <class H, class = void>
+    struct flat_is_transparent : std::false_type {};
+
+    template <class H>
+    struct flat_is_transparent<H, typename std::conditional
+        <true, void, typename H::is_transparent>::type> : std::true_type {};
+
+    /// Convert a string to name_t.
+    /// @return false if the string is not a valid name
+    inline bool flat_to_name(const char* a_str, size_t a_len, name_t& a_res) {
+        return a_len <= name_t::size() && a_res.set(a_str, a_len) == 0
+            && a_res.length() == a_len;
+    }
+}
+
+/// Hashing of basic_short_string, also accepting C and std::string keys
+template <class C, int N, class A>
+struct flat_hash<basic_short_string<C, N, A>> {
+    using is_transparent = void;
+
+    size_t operator()(const basic_short_string<C, N, A>& a) const {
+        return detail::flat_hash_bytes((const char*)a.c_str(),
+                                       std::max(0, a.size()) * sizeof(C));
+    }
+    size_t operator()(const std::basic_string<C>& a) const {
+        return detail::flat_hash_bytes((const char*)a.c_str(), a.size() * sizeof(C));
+    }
+    size_t operator()(const C* a) const {
+        return detail::flat_hash_bytes
+            ((const char*)a, std::char_traits<C>::length(a) * sizeof(C));
+    }
+};
+
+template <class C, int N, class A>
+struct flat_equal_to<basic_short_string<C, N, A>> {
+    using is_transparent = void;
+    using key_type       = basic_short_string<C, N, A>;
+
+    bool operator()(const key_type& a, const key_type& b) const { return a == b; }
+    bool operator()(const key_type& a, const std::basic_string<C>& b) const {
+        return size_t(a.size()) == b.size()
+            && !memcmp(a.c_str(), b.c_str(), b.size() * sizeof(C));
+    }
+    bool operator()(const key_type& a, const C* b) const {
+        return !a.is_null() && a == b;
+    }
+};
+
+/// Hashing of name_t, also accepting string keys, which are encoded as
+/// names before hashing
+template <>
+struct flat_hash<name_t> {
+    using is_transparent = void;
+
+    size_t operator()(name_t a) const { return a.to_int(); }
+    size_t operator()(const std::string& a) const {
+        return operator()(a.c_str(), a.size());
+    }
+    size_t operator()(const char* a) const { return operator()(a, strlen(a)); }
+    size_t operator()(const char* a, size_t n) const {
+        name_t nm;
+        // Invalid names don't match any key, so their hash doesn't matter
+        return detail::flat_to_name(a, n, nm) ? nm.to_int() : 0;
+    }
+};
+
+template <>
+struct flat_equal_to<name_t> {
+    using is_transparent = void;
+
+    bool operator()(name_t a, name_t b) const { return a == b; }
+    bool operator()(name_t a, const std::string& b) const {
+        name_t nm;
+        return detail::flat_to_name(b.c_str(), b.size(), nm) && a == nm;
+    }
+    bool operator()(name_t a, const char* b) const {
+        name_t nm;
+        return detail::flat_to_name(b, strlen(b), nm) && a == nm;
+    }
+};
+
+namespace detail {
+
+    //--------------------------------------------------------------------------
+    /// Group of control bytes of flat_hash_map probed at once
+    //--------------------------------------------------------------------------
+    struct flat_hash_group {
+        using ctrl_t = int8_t;
+
+        enum : ctrl_t {
+            s_empty   = -128, // 0b10000000
+            s_deleted = -2    // 0b11111110
+        };
+
+#if defined(__AVX2__)
+        static const size_t s_width = 32;
+
+        explicit flat_hash_group(const ctrl_t* a_pos)
+            : m_ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_pos)))
+        {}
+
+        /// Bitmask of the slots matching the 7 bits of hash \a a_h2
+        uint32_t match(ctrl_t a_h2) const {
+            return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(a_h2), m_ctrl));
+        }
+        uint32_t match_empty() const { return match(s_empty); }
+        uint32_t match_empty_or_deleted() const {
+            return _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-1), m_ctrl));
+        }
+    private:
+        __m256i m_ctrl;
+#elif defined(__SSE2__)
+        static const size_t s_width = 16;
+
+        explicit flat_hash_group(const ctrl_t* a_pos)
+            : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_pos)))
+        {}
+
+        /// Bitmask of the slots matching the 7 bits of hash \a a_h2
+        uint32_t match(ctrl_t a_h2) const {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(a_h2), m_ctrl));
+        }
+        uint32_t match_empty() const { return match(s_empty); }
+        uint32_t match_empty_or_deleted() const {
+            return _mm_movemask_epi8(_mm_cmplt_epi8(m_ctrl, _mm_set1_epi8(-1)));
+        }
+    private:
+        __m128i m_ctrl;
+#else
+        static const size_t s_width = 16;
+
+        explicit flat_hash_group(const ctrl_t* a_pos) { memcpy(m_ctrl, a_pos, s_width); }
+
+        /// Bitmask of the slots matching the 7 bits of hash \a a_h2
+        uint32_t match(ctrl_t a_h2) const {
+            uint32_t res = 0;
+            for (size_t i = 0; i < s_width; ++i)
+                res |= uint32_t(m_ctrl[i] == a_h2) << i;
+            return res;
+        }
+        uint32_t match_empty() const { return match(s_empty); }
+        uint32_t match_empty_or_deleted() const {
+            uint32_t res = 0;
+            for (size_t i = 0; i < s_width; ++i)
+                res |= uint32_t(m_ctrl[i] < -1) << i;
+            return res;
+        }
+    private:
+        ctrl_t m_ctrl[s_width];
+#endif
+    };
+
+} // namespace detail
+
+//------------------------------------------------------------------------------
+/// Single-threaded open-addressing hash map with SIMD probing.
+///
+/// The interface follows std::unordered_map with these differences:
+/// * iterators and references are invalidated by inserts that grow the map;
+/// * value_type is std::pair<K, V> not std::pair<const K, V> (as in
+///   assoc_vector), so that the elements can be moved when the map grows;
+/// * if both Hash and Eq define \c is_transparent, lookup functions accept
+///   any key type they can hash and compare (e.g. find("IBM") in a map keyed
+///   by name_t or basic_short_string);
+/// * the max load factor is fixed at 7/8.
+//------------------------------------------------------------------------------
+template <
+    class K,
+    class V,
+    class Hash  = flat_hash<K>,
+    class Eq    = flat_equal_to<K>,
+    class Alloc = std::allocator<std::pair<K, V>>
+>
+class flat_hash_map : private Hash, private Eq {
+    using group  = detail::flat_hash_group;
+    using ctrl_t = group::ctrl_t;
+
+    static const size_t s_width = group::s_width;
+
+public:
+    using key_type        = K;
+    using mapped_type     = V;
+    using value_type      = std::pair<K, V>;
+    using size_type       = size_t;
+    using hasher          = Hash;
+    using key_equal       = Eq;
+    using allocator_type  = typename std::allocator_traits<Alloc>::
+                            template rebind_alloc<value_type>;
+    using reference       = value_type&;
+    using const_reference = const value_type&;
+
+    template <class T>
+    class iter_base {
+        const ctrl_t* m_ctrl;
+        T*            m_slot;
+        const ctrl_t* m_end;
+
+        friend class flat_hash_map;
+
+        void skip_empty() {
+            while (m_ctrl != m_end && *m_ctrl < 0) { ++m_ctrl; ++m_slot; }
+        }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T*;
+        using reference         = T&;
+
+        iter_base() : m_ctrl(nullptr), m_slot(nullptr), m_end(nullptr) {}
+        iter_base(const ctrl_t* a_ctrl, T* a_slot, const ctrl_t* a_end)
+            : m_ctrl(a_ctrl), m_slot(a_slot), m_end(a_end)
+        {}
+
+        /// Conversion of iterator to const_iterator
+        template <class U, class = typename std::enable_if<
+            std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+        iter_base(const iter_base<U>& a)
+            : m_ctrl(a.m_ctrl), m_slot(a.m_slot), m_end(a.m_end)
+        {}
+
+        T& operator*()  const { return *m_slot; }
+        T* operator->() const { return  m_slot; }
+
+        iter_base& operator++()   { ++m_ctrl; ++m_slot; skip_empty(); return *this; }
+        iter_base  operator++(int){ auto it = *this; ++*this; return it; }
+
+        template <class U>
+        bool operator==(const iter_base<U>& a) const { return m_ctrl == a.m_ctrl; }
+        template <class U>
+        bool operator!=(const iter_base<U>& a) const { return m_ctrl != a.m_ctrl; }
+
+        template <class U> friend class iter_base;
+    };
+
+    using iterator       = iter_base<value_type>;
+    using const_iterator = iter_base<const value_type>;
+
+private:
+    /// Enable lookup by a type other than the key if Hash and Eq permit
+    template <class T, class R>
+    using if_transparent = typename std::enable_if<
+        !std::is_same<T, K>::value &&
+        !std::is_convertible<const T&, const_iterator>::value &&
+        detail::flat_is_transparent<Hash>::value &&
+        detail::flat_is_transparent<Eq>::value, R>::type;
+
+public:
+
+    explicit flat_hash_map(size_t a_size_hint = 0, const Hash& a_hash = Hash(),
+                           const Eq& a_eq = Eq(), const Alloc& a_alloc = Alloc())
+        : Hash(a_hash), Eq(a_eq), m_alloc(a_alloc)
+        , m_slots(nullptr), m_ctrl(empty_ctrl()), m_mask(0), m_size(0)
+        , m_growth_left(0)
+    {
+        if (a_size_hint)
+            reserve(a_size_hint);
+    }
+
+    flat_hash_map(std::initializer_list<value_type> a_list)
+        : flat_hash_map(a_list.size())
+    {
+        for (auto& v : a_list) insert(v);
+    }
+
+    flat_hash_map(const flat_hash_map& a)
+        : flat_hash_map(a.size(), a.hash_function(), a.key_eq(), a.m_alloc)
+    {
+        for (auto& v : a) insert_unique(hash(v.first), v);
+    }
+
+    flat_hash_map(flat_hash_map&& a) noexcept
+        : Hash(a.hash_function()), Eq(a.key_eq()), m_alloc(std::move(a.m_alloc))
+        , m_slots(a.m_slots), m_ctrl(a.m_ctrl), m_mask(a.m_mask), m_size(a.m_size)
+        , m_growth_left(a.m_growth_left)
+    {
+        a.reset_empty();
+    }
+
+    ~flat_hash_map() { destroy(); }
+
+    flat_hash_map& operator=(const flat_hash_map& a) {
+        if (this != &a) {
+            flat_hash_map tmp(a);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    flat_hash_map& operator=(flat_hash_map&& a) noexcept {
+        if (this != &a) {
+            flat_hash_map tmp(std::move(a));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    size_t size()            const { return m_size;          }
+    bool   empty()           const { return m_size == 0;     }
+    /// Number of slots
+    size_t capacity()        const { return m_mask ? m_mask+1 : 0; }
+    float  load_factor()     const { return capacity() ? float(m_size)/capacity() : 0; }
+    static constexpr float max_load_factor() { return 7.0f / 8; }
+
+    const hasher&   hash_function() const { return *this; }
+    const key_equal& key_eq()       const { return *this; }
+
+    iterator begin() {
+        iterator it(m_ctrl, m_slots, m_ctrl + capacity());
+        it.skip_empty();
+        return it;
+    }
+    const_iterator begin() const { return const_cast<flat_hash_map*>(this)->begin(); }
+    const_iterator cbegin()const { return begin(); }
+
+    iterator       end()         { return iterator(m_ctrl + capacity(), nullptr, nullptr); }
+    const_iterator end()   const { return const_cast<flat_hash_map*>(this)->end(); }
+    const_iterator cend()  const { return end(); }
+
+    //--------------------------------------------------------------------------
+    // Lookup
+    //--------------------------------------------------------------------------
+    iterator       find(const K& a_key)       { return find_impl(a_key); }
+    const_iterator find(const K& a_key) const {
+        return const_cast<flat_hash_map*>(this)->find_impl(a_key);
+    }
+
+    template <class T>
+    if_transparent<T, iterator> find(const T& a_key) { return find_impl(a_key); }
+
+    template <class T>
+    if_transparent<T, const_iterator> find(const T& a_key) const {
+        return const_cast<flat_hash_map*>(this)->find_impl(a_key);
+    }
+
+    size_t count(const K& a_key) const { return find(a_key) != end(); }
+
+    template <class T>
+    if_transparent<T, size_t> count(const T& a_key) const { return find(a_key) != end(); }
+
+    bool contains(const K& a_key) const { return count(a_key); }
+
+    template <class T>
+    if_transparent<T, bool> contains(const T& a_key) const { return count(a_key); }
+
+    V& at(const K& a_key) { return at_impl(a_key); }
+    const V& at(const K& a_key) const {
+        return const_cast<flat_hash_map*>(this)->at_impl(a_key);
+    }
+
+    template <class T>
+    if_transparent<T, V&> at(const T& a_key) { return at_impl(a_key); }
+
+    template <class T>
+    if_transparent<T, const V&> at(const T& a_key) const {
+        return const_cast<flat_hash_map*>(this)->at_impl(a_key);
+    }
+
+    //--------------------------------------------------------------------------
+    // Modifiers
+    //--------------------------------------------------------------------------
+    V& operator[](const K& a_key) { return try_emplace(a_key).first->second; }
+    V& operator[](K&& a_key)      { return try_emplace(std::move(a_key)).first->second; }
+
+    std::pair<iterator, bool> insert(const value_type& a_value) {
+        return try_emplace(a_value.first, a_value.second);
+    }
+    std::pair<iterator, bool> insert(value_type&& a_value) {
+        return try_emplace(std::move(a_value.first), std::move(a_value.second));
+    }
+
+    template <class InputIt>
+    void insert(InputIt a_begin, InputIt a_end) {
+        for (; a_begin != a_end; ++a_begin) insert(*a_begin);
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K& a_key, M&& a_value) {
+        auto res = try_emplace(a_key, std::forward<M>(a_value));
+        if (!res.second)
+            res.first->second = std::forward<M>(a_value);
+        return res;
+    }
+
+    /// Insert a value constructed from \a a_args unless \a a_key is present
+    template <class KK, class... Args>
+    std::pair<iterator, bool> try_emplace(KK&& a_key, Args&&... a_args) {
+        size_t h   = hash(a_key);
+        auto   res = find_or_prepare_insert(a_key, h);
+        if (res.second) {
+            auto slot = m_slots + res.first;
+            new (slot) value_type(std::piecewise_construct,
+                                  std::forward_as_tuple(std::forward<KK>(a_key)),
+                                  std::forward_as_tuple(std::forward<Args>(a_args)...));
+            set_ctrl(res.first, h2(h));
+            ++m_size;
+        }
+        return std::make_pair(iterator_at(res.first), res.second);
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args&&... a_args) {
+        value_type v(std::forward<Args>(a_args)...);
+        return try_emplace(std::move(v.first), std::move(v.second));
+    }
+
+    size_t erase(const K& a_key) { return erase_key(a_key); }
+
+    template <class T>
+    if_transparent<T, size_t> erase(const T& a_key) { return erase_key(a_key); }
+
+    /// Erase the element at \a a_it.
+    /// @return iterator following the erased element
+    iterator erase(const_iterator a_it) {
+        size_t i = a_it.m_ctrl - m_ctrl;
+        erase_at(i);
+        iterator it(m_ctrl + i, m_slots + i, m_ctrl + capacity());
+        it.skip_empty();
+        return it;
+    }
+
+    void clear() {
+        if (!m_mask) return;
+        destroy_slots();
+        memset(m_ctrl, group::s_empty, capacity() + s_width);
+        m_size        = 0;
+        m_growth_left = max_entries(capacity());
+    }
+
+    /// Make room for at least \a a_size elements without growing
+    void reserve(size_t a_size) {
+        if (a_size > m_size + m_growth_left)
+            resize(capacity_for(a_size));
+    }
+
+    /// Rebuild the table with at least \a a_buckets slots (also drops the
+    /// markers of erased elements)
+    void rehash(size_t a_buckets) {
+        resize(std::max(capacity_for(m_size), normalize(a_buckets)));
+    }
+
+    void swap(flat_hash_map& a) {
+        std::swap(static_cast<Hash&>(*this), static_cast<Hash&>(a));
+        std::swap(static_cast<Eq&>(*this),   static_cast<Eq&>(a));
+        std::swap(m_alloc,       a.m_alloc);
+        std::swap(m_slots,       a.m_slots);
+        std::swap(m_ctrl,        a.m_ctrl);
+        std::swap(m_mask,        a.m_mask);
+        std::swap(m_size,        a.m_size);
+        std::swap(m_growth_left, a.m_growth_left);
+    }
+
+private:
+    allocator_type m_alloc;
+    value_type*    m_slots;
+    ctrl_t*        m_ctrl;          ///< capacity()+s_width control bytes
+    size_t         m_mask;          ///< capacity()-1 (0 if not allocated)
+    size_t         m_size;
+    size_t         m_growth_left;   ///< Inserts into EMPTY slots before growth
+
+    /// Control bytes of a map without slots (never matches any hash)
+    static ctrl_t* empty_ctrl() {
+        static struct empty_group {
+            ctrl_t ctrl[s_width];
+            empty_group() { memset(ctrl, group::s_empty, s_width); }
+        } s_group;
+        return s_group.ctrl;
+    }
+
+    void reset_empty() {
+        m_slots = nullptr; m_ctrl = empty_ctrl();
+        m_mask  = m_size   = m_growth_left = 0;
+    }
+
+    /// Mix the bits of the user hash, since std::hash of integers is identity
+    template <class T>
+    size_t hash(const T& a_key) const {
+        uint64_t h = static_cast<const Hash&>(*this)(a_key);
+        __uint128_t m = __uint128_t(h) * 0x9E3779B97F4A7C15ull;
+        return uint64_t(m) ^ uint64_t(m >> 64);
+    }
+    static size_t h1(size_t a_hash) { return a_hash >> 7;            }
+    static ctrl_t h2(size_t a_hash) { return ctrl_t(a_hash & 0x7F);  }
+
+    template <class T>
+    bool equal(const K& a_key, const T& a_other) const {
+        return static_cast<const Eq&>(*this)(a_key, a_other);
+    }
+
+    static size_t max_entries(size_t a_capacity) { return a_capacity - a_capacity/8; }
+
+    static size_t normalize(size_t a_n) {
+        size_t n = s_width;
+        while (n < a_n) n <<= 1;
+        return n;
+    }
+    static size_t capacity_for(size_t a_size) {
+        return normalize(a_size + (a_size+6)/7);
+    }
+
+    /// Number of value_type elements allocated for the slots and control bytes
+    static size_t alloc_count(size_t a_capacity) {
+        return a_capacity + (a_capacity + s_width + sizeof(value_type)-1) / sizeof(value_type);
+    }
+
+    iterator iterator_at(size_t i) {
+        return iterator(m_ctrl + i, m_slots + i, m_ctrl + capacity());
+    }
+
+    /// Set a control byte and its mirror past the end of the table, which
+    /// lets groups that wrap around the end be loaded with a single load
+    void set_ctrl(size_t i, ctrl_t a_val) {
+        m_ctrl[i] = a_val;
+        m_ctrl[((i - s_width) & m_mask) + s_width] = a_val;
+    }
+
+    /// Probe sequence over groups of slots: pos += s_width * k(k+1)/2.
+    /// Visits every group of a power-of-two table.
+    struct probe_seq {
+        size_t m_pos, m_step, m_mask;
+        probe_seq(size_t a_hash, size_t a_mask)
+            : m_pos(h1(a_hash) & a_mask), m_step(0), m_mask(a_mask) {}
+        size_t offset(size_t i) const { return (m_pos + i) & m_mask; }
+        void   next() { m_step += s_width; m_pos = (m_pos + m_step) & m_mask; }
+    };
+
+    template <class T>
+    iterator find_impl(const T& a_key) {
+        size_t    h = hash(a_key);
+        probe_seq seq(h, m_mask);
+        while (true) {
+            group g(m_ctrl + seq.m_pos);
+            for (uint32_t m = g.match(h2(h)); m; m &= m-1) {
+                size_t i = seq.offset(__builtin_ctz(m));
+                if (likely(equal(m_slots[i].first, a_key)))
+                    return iterator_at(i);
+            }
+            if (likely(g.match_empty()))
+                return end();
+            seq.next();
+        }
+    }
+
+    template <class T>
+    V& at_impl(const T& a_key) {
+        auto it = find_impl(a_key);
+        if (it == end())
+            UTXX_THROW_RUNTIME_ERROR("flat_hash_map: key not found");
+        return it->second;
+    }
+
+    /// First EMPTY or DELETED slot on the probe sequence of \a a_hash
+    size_t find_first_non_full(size_t a_hash) const {
+        probe_seq seq(a_hash, m_mask);
+        while (true) {
+            group g(m_ctrl + seq.m_pos);
+            if (uint32_t m = g.match_empty_or_deleted())
+                return seq.offset(__builtin_ctz(m));
+            seq.next();
+        }
+    }
+
+    /// @return slot index of \a a_key and false if the key is present,
+    ///         or the slot to construct the key in and true otherwise
+    template <class T>
+    std::pair<size_t, bool> find_or_prepare_insert(const T& a_key, size_t a_hash) {
+        if (m_mask) {
+            probe_seq seq(a_hash, m_mask);
+            while (true) {
+                group g(m_ctrl + seq.m_pos);
+                for (uint32_t m = g.match(h2(a_hash)); m; m &= m-1) {
+                    size_t i = seq.offset(__builtin_ctz(m));
+                    if (likely(equal(m_slots[i].first, a_key)))
+                        return std::make_pair(i, false);
+                }
+                if (likely(g.match_empty()))
+                    break;
+                seq.next();
+            }
+        }
+        return std::make_pair(prepare_insert(a_hash), true);
+    }
+
+    size_t prepare_insert(size_t a_hash) {
+        size_t i = find_first_non_full(a_hash);
+        if (unlikely(m_growth_left == 0 && m_ctrl[i] != group::s_deleted)) {
+            grow();
+            i = find_first_non_full(a_hash);
+        }
+        m_growth_left -= m_ctrl[i] == group::s_empty;
+        return i;
+    }
+
+    /// Insert a key known to be absent (used when copying)
+    void insert_unique(size_t a_hash, const value_type& a_value) {
+        size_t i = prepare_insert(a_hash);
+        new (m_slots + i) value_type(a_value);
+        set_ctrl(i, h2(a_hash));
+        ++m_size;
+    }
+
+    void grow() {
+        // If at least half of the used slots are DELETED markers, rebuild
+        // the table in place instead of doubling it
+        size_t cap = capacity();
+        resize(!cap ? s_width : m_size <= max_entries(cap)/2 ? cap : cap*2);
+    }
+
+    void resize(size_t a_capacity) {
+        value_type* old_slots = m_slots;
+        ctrl_t*     old_ctrl  = m_ctrl;
+        size_t      old_cap   = capacity();
+
+        m_slots = std::allocator_traits<allocator_type>::allocate(m_alloc, alloc_count(a_capacity));
+        m_ctrl  = reinterpret_cast<ctrl_t*>(m_slots + a_capacity);
+        m_mask  = a_capacity - 1;
+        memset(m_ctrl, group::s_empty, a_capacity + s_width);
+        m_growth_left = max_entries(a_capacity) - m_size;
+
+        for (size_t i = 0; i < old_cap; ++i) {
+            if (old_ctrl[i] < 0)
+                continue;
+            value_type& v = old_slots[i];
+            size_t      h = hash(v.first);
+            size_t      j = find_first_non_full(h);
+            new (m_slots + j) value_type(std::move(v));
+            v.~value_type();
+            set_ctrl(j, h2(h));
+        }
+
+        if (old_cap)
+            std::allocator_traits<allocator_type>::deallocate
+                (m_alloc, old_slots, alloc_count(old_cap));
+    }
+
+    template <class T>
+    size_t erase_key(const T& a_key) {
+        auto it = find_impl(a_key);
+        if (it == end())
+            return 0;
+        erase_at(it.m_ctrl - m_ctrl);
+        return 1;
+    }
+
+    void erase_at(size_t i) {
+        m_slots[i].~value_type();
+        --m_size;
+
+        // If there's no full group around the slot, no probe sequence has
+        // ever passed it, so it can be marked EMPTY rather than DELETED
+        size_t   before   = (i - s_width) & m_mask;
+        uint32_t empty_b  = group(m_ctrl + before).match_empty();
+        uint32_t empty_a  = group(m_ctrl + i).match_empty();
+        bool     was_free = empty_b && empty_a
+                         && size_t(__builtin_ctz(empty_a) +
+                                   __builtin_clz(empty_b) - (32 - s_width)) < s_width;
+        set_ctrl(i, was_free ? group::s_empty : group::s_deleted);
+        m_growth_left += was_free;
+    }
+
+    void destroy_slots() {
+        if (!std::is_trivially_destructible<value_type>::value)
+            for (size_t i = 0, n = capacity(); i < n; ++i)
+                if (m_ctrl[i] >= 0)
+                    m_slots[i].~value_type();
+    }
+
+    void destroy() {
+        if (!m_mask) return;
+        destroy_slots();
+        std::allocator_traits<allocator_type>::deallocate
+            (m_alloc, m_slots, alloc_count(capacity()));
+        reset_empty();
+    }
+};
+
+template <class K, class V, class H, class E, class A>
+inline void swap(flat_hash_map<K,V,H,E,A>& a, flat_hash_map<K,V,H,E,A>& b) { a.swap(b); }
+
+} // namespace utxx
@@ -32,9 +32,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 #pragma once
 
+#include <algorithm>
 #include <limits>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <boost/type_traits/make_signed.hpp>
 #include <boost/type_traits/make_unsigned.hpp>
 #include <boost/assert.hpp>
@@ -45,17 +47,193 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/bits.hpp>
 #include <utxx/types.hpp>
 #include <utxx/compiler_hints.hpp>
+#include <utxx/fast_itoa.hpp>
+#include <utxx/detail/dtoa_tables.hpp>
+#include <utxx/detail/atof_tables.hpp>
 #include <stdint.h>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
 
 namespace utxx {
 
 namespace detail {
-    static inline const char int_to_char(int n) {
-        static const char  s_characters[] = { "9876543210123456789" };
-        static const char* s_middle = s_characters + 9;
-        return s_middle[n];
+    //-----------------------------------------------------------------------
+    // SWAR (SIMD within a register) conversion of digits.  A 64-bit word
+    // holds 8 chars with the first char in the lowest byte, so these are
+    // only used on little-endian targets (see swar_enabled()).
+    //-----------------------------------------------------------------------
+    /// Combine 8 bytes of \a a with values 0..15 as decimal digits (the
+    /// first byte is the most significant one) using three multiplications
+    inline uint32_t swar_8digits(uint64_t a) {
+        a = (a * 10) + (a >> 8);    // Two-digit numbers in every other byte
+        a = (((a & 0x000000FF000000FFull) * 0x000F424000000064ull) +       // 100, 1000000
+             (((a >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) // 1, 10000
+            >> 32;
+        return uint32_t(a);
+    }
+
+    /// Convert 8 decimal digits packed in \a a to an integer
+    inline uint32_t parse_8digits(uint64_t a) {
+        return swar_8digits(a - 0x3030303030303030ull);
+    }
+
+    /// Number of leading decimal digits in 8 chars packed in \a a
+    inline int count_8digits(uint64_t a) {
+        // Bytes outside of '0'..'9' get their high bit set.  Carries and
+        // borrows only propagate to the higher bytes past the first non-digit.
+        uint64_t nd = ((a + 0x4646464646464646ull) | (a - 0x3030303030303030ull))
+                    & 0x8080808080808080ull;
+        return nd ? __builtin_ctzll(nd) >> 3 : 8;
+    }
+
+    /// Mask with the high bit set in every non-zero byte of \a a
+    inline uint64_t nonzero_bytes(uint64_t a) {
+        return (((a & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | a)
+             & 0x8080808080808080ull;
+    }
+
+    /// Mask with the high bit set in every byte of \a a that is not a digit.
+    /// Unlike count_8digits() it's exact for all bytes.
+    inline uint64_t nondigit_bytes(uint64_t a) {
+        a ^= 0x3030303030303030ull;   // Digits become 0..9
+        return (((a & 0x7F7F7F7F7F7F7F7Full) + 0x7676767676767676ull) | a)
+             & 0x8080808080808080ull;
+    }
+
+    /// Load N <= 8 chars at \a p into the highest bytes of a word, so that
+    /// the lower bytes are zero.  Two overlapping 4-byte loads are used
+    /// rather than memcpy() to a zeroed word, which would stall on the
+    /// store forwarding.
+    template <int N>
+    inline uint64_t load_chars(const char* p) {
+        static_assert(N > 0 && N <= 8, "Invalid N");
+        if (N >= 4) {
+            uint32_t lo, hi;
+            memcpy(&lo, p, 4);
+            memcpy(&hi, p + N - 4, 4);
+            return (uint64_t(hi) << 32) | (uint64_t(lo) << (8 * (8 - N)));
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < N; ++i)
+            v |= uint64_t(uint8_t(p[i])) << (8 * (8 - N + i));
+        return v;
+    }
+
+    /// Number of leading spaces in N chars at \a p
+    template <int N>
+    inline int leading_spaces(const char* p) {
+        int n = 0;
+        for (; n + 8 <= N; n += 8) {
+            uint64_t v;
+            memcpy(&v, p + n, 8);
+            uint64_t m = nonzero_bytes(v ^ 0x2020202020202020ull);
+            if (m)
+                return n + (__builtin_ctzll(m) >> 3);
+        }
+        if (N % 8) {
+            // The zero bytes past the N chars aren't spaces
+            uint64_t v = load_chars<(N % 8 ? N % 8 : 1)>(p + n) >> (8 * (8 - N % 8));
+            n += __builtin_ctzll(nonzero_bytes(v ^ 0x2020202020202020ull)) >> 3;
+        }
+        return n;
+    }
+
+#if defined(__SSSE3__)
+    /// Combine 16 bytes of \a a_val with values 0..15 as decimal digits (the
+    /// first byte is the most significant one) using pmaddubsw/pmaddwd
+    inline uint64_t simd_16digits(__m128i a) {
+        a = _mm_maddubs_epi16(a, _mm_setr_epi8(10,1,10,1,10,1,10,1,10,1,10,1,10,1,10,1));
+        a = _mm_madd_epi16   (a, _mm_setr_epi16(100,1,100,1,100,1,100,1));
+        a = _mm_packs_epi32  (a, a);    // The 4-digit numbers fit in 16 bits
+        a = _mm_madd_epi16   (a, _mm_setr_epi16(10000,1,10000,1,10000,1,10000,1));
+        return uint64_t(uint32_t(_mm_cvtsi128_si32(a))) * 100000000u
+             + uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(a, 4)));
+    }
+#endif
+
+    /// Check that chars [a_from, N) at \a p are digits
+    template <int N>
+    inline bool digits_from(const char* p, int a_from) {
+        if (!swar_enabled()) {
+            for (int i = a_from; i < N; ++i)
+                if (p[i] < '0' || p[i] > '9')
+                    return false;
+            return true;
+        }
+        // Mask of the bytes of the word at offset a_off preceding a_from
+        auto skip = [a_from](int a_off) {
+            return a_from <= a_off     ? 0ull
+                 : a_from >= a_off + 8 ? ~0ull
+                 : (1ull << (8 * (a_from - a_off))) - 1;
+        };
+        uint64_t bad = 0;
+        int      i   = 0;
+        for (; i + 8 <= N; i += 8) {
+            uint64_t v;
+            memcpy(&v, p + i, 8);
+            bad |= nondigit_bytes(v) & ~skip(i);
+        }
+        if (N % 8) {
+            // Pad with '0's
+            uint64_t v = (load_chars<(N % 8 ? N % 8 : 1)>(p + i) >> (8 * (8 - N % 8)))
+                       | (0x3030303030303030ull << (8 * (N % 8)));
+            bad |= nondigit_bytes(v) & ~skip(i);
+        }
+        return !bad;
     }
 
+    //-----------------------------------------------------------------------
+    // Conversion of a fixed-width field of N chars to an integer, treating
+    // every char as (c & 0x0F), so that ' ' is the same as '0'.  The method
+    // is selected at compile time by N:
+    //   N < 4         - unrolled scalar loop;
+    //   4 <= N <= 8   - one SWAR word;
+    //   N == 16       - SSSE3 (if enabled) or two SWAR words;
+    //   other N       - composed of the above.
+    //-----------------------------------------------------------------------
+    template <int N, int Method = (N < 4 || !swar_enabled()) ? 0
+                                : N <= 8 ? 1 : N == 16 ? 2 : 3>
+    struct fixed_digits {
+        static uint64_t convert(const char* p) {
+            uint64_t n = 0;
+            for (int i = 0; i < N; ++i)
+                n = n*10 + (p[i] & 0x0F);
+            return n;
+        }
+    };
+
+    template <int N>
+    struct fixed_digits<N, 1> {
+        static uint64_t convert(const char* p) {
+            return swar_8digits(load_chars<N>(p) & 0x0F0F0F0F0F0F0F0Full);
+        }
+    };
+
+    template <>
+    struct fixed_digits<16, 2> {
+        static uint64_t convert(const char* p) {
+#if defined(__SSSE3__)
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            return simd_16digits(_mm_and_si128(v, _mm_set1_epi8(0x0F)));
+#else
+            return fixed_digits<8>::convert(p) * 100000000u
+                 + fixed_digits<8>::convert(p + 8);
+#endif
+        }
+    };
+
+    template <int N>
+    struct fixed_digits<N, 3> {
+        // Convert the trailing 8 or 16 chars with the fast method
+        static const int s_tail = N > 16 ? 16 : 8;
+
+        static uint64_t convert(const char* p) {
+            return fixed_digits<N - s_tail>::convert(p) * utxx::pow<10, s_tail>::value
+                 + fixed_digits<s_tail>::convert(p + N - s_tail);
+        }
+    };
+
     template<typename Char, typename I, bool Sign, alignment Align, Char Skip>
     struct convert;
 
@@ -76,22 +254,6 @@ namespace detail {
             return load_atoi(bytes, 0);
         }
 
-        static void pad_left(Char* bytes, Char ch) {
-            *bytes = ch;
-            next::pad_left(--bytes, ch);
-        }
-
-        inline static void save_itoa(Char*& bytes, long n, Char a_pad) {
-            long m = n / 10;
-            *bytes-- = int_to_char(n - m*10);
-            if (m == 0) {
-                if (a_pad)
-                    next::pad_left(bytes, a_pad);
-                return;
-            }
-            next::save_itoa(bytes, m, a_pad);
-        }
-
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) {
             typename boost::make_unsigned<Char>::type i=*bytes-'0';
             return i > 9u ? 0 : i + 10 * next::load_atoi(--bytes, acc);
@@ -109,30 +271,6 @@ namespace detail {
             return load_atoi(bytes, 0);
         }
 
-        static void reverse(Char* p, Char* q) {
-            if (p >= q) return;
-            Char c = *p; *p = *q; *q = c;
-            next::reverse(++p, --q);
-        }
-
-        static void pad_right(Char* bytes, Char ch) {
-            *bytes = ch;
-            next::pad_right(++bytes, ch);
-        }
-
-        static void save_itoa(Char*& bytes, long n, Char a_pad) {
-            long m = n / 10;
-            *bytes++ = int_to_char(n - m*10);
-            if (m == 0) {
-                if (a_pad)
-                    next::pad_right(bytes, a_pad);
-                else
-                    *bytes = '\0';
-                return;
-            }
-            next::save_itoa(bytes, m, a_pad);
-        }
-
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) {
             typename boost::make_unsigned<Char>::type i=*bytes-'0';
             return (i > 9u) ? acc : next::load_atoi(++bytes, i + 10*acc);
@@ -147,13 +285,6 @@ namespace detail {
             return load_atoi(bytes, 0);
         }
 
-        static void pad_left(Char* bytes, Char ch) { *bytes = ch; }
-
-        inline static void save_itoa(Char*& bytes, long n, Char a_pad) {
-            BOOST_ASSERT(n / 10 == 0);
-            *bytes-- = int_to_char(n % 11);
-        }
-
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) {
             typename boost::make_unsigned<Char>::type i=*bytes-'0';
             if (i > 9u) return 0;
@@ -170,14 +301,6 @@ namespace detail {
             return load_atoi(bytes, 0);
         }
 
-        static void pad_right(Char* bytes, Char ch) { *bytes = ch; }
-        static void reverse(Char* p, Char* q) {}
-
-        static void save_itoa(Char*& bytes, long n, Char a_pad) {
-            BOOST_ASSERT(n / 10 == 0);
-            *bytes++ = int_to_char(n % 10);
-        }
-
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) {
             typename boost::make_unsigned<Char>::type i=*bytes-'0';
             if (i > 9u) return acc;
@@ -190,17 +313,12 @@ namespace detail {
     template <typename Char>
     struct unrolled_byte_loops<Char, 0, RIGHT> {
         static uint64_t atoi_skip_right(const Char*& bytes, Char skip) { return 0; }
-        static void     pad_left(Char* bytes, Char ch) {}
-        static void     save_itoa(Char*& bytes, long n, Char a_pad) {}
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) { return 0; }
     };
     //-------N=0, left justified---------------------------------------------
     template <typename Char>
     struct unrolled_byte_loops<Char, 0, LEFT> {
         static uint64_t atoi_skip_left(const Char*& bytes, Char skip) { return 0; }
-        static void     pad_right(Char* bytes, Char ch) {}
-        static void     reverse(Char* p, Char* q) {}
-        static void     save_itoa(Char*& bytes, long n, Char a_pad) {}
         static uint64_t load_atoi(const Char*& bytes, uint64_t acc) { return 0; }
     };
 
@@ -222,13 +340,13 @@ namespace detail {
             char* p;
             if (i < 0) {
                 p = signness_helper<T, N, false, RIGHT, Char>::
-                    fast_itoa(bytes, -i, pad);
+                    write(bytes, 0 - uint64_t(i), pad);
                 if (p >= bytes)
                     *p--= '-';
                 return pad ? bytes-1 : p;
             }
             p = signness_helper<T, N, false, RIGHT, Char>::
-                fast_itoa(bytes, i, pad);
+                write(bytes, uint64_t(i), pad);
             return pad ? bytes-1 : p;
         }
 
@@ -257,10 +375,10 @@ namespace detail {
             if (i < 0) {
                 *p++ = '-';
                 return signness_helper<T, N-1, false, LEFT, Char>::
-                    fast_itoa(p, i, pad);
+                    write(p, 0 - uint64_t(i), pad);
             }
             return signness_helper<T, N, false, LEFT, Char>::
-                fast_itoa(p, i, pad);
+                write(p, uint64_t(i), pad);
         }
 
         inline static T fast_atoi(const Char*& bytes, Char skip = '\0') {
@@ -297,11 +415,11 @@ namespace detail {
         template <int M>
         inline static T fast_atoi2(const Char*& bytes) {
             if (*bytes == '-') {
-                long n = unrolled_byte_loops<Char, N-1, LEFT>::
+                long n = unrolled_byte_loops<Char, M-1, LEFT>::
                     load_atoi(++bytes, 0);
                 return static_cast<T>(-n);
             }
-            return unrolled_byte_loops<Char, N, LEFT>::load_atoi(bytes, 0);
+            return unrolled_byte_loops<Char, M, LEFT>::load_atoi(bytes, 0);
         }
     };
 
@@ -309,9 +427,16 @@ namespace detail {
     template <typename T, int N, typename Char>
     struct signness_helper<T, N, false, RIGHT, Char> {
         static char* fast_itoa(Char* bytes, T i, Char pad = '\0') {
-            char* p = bytes + N - 1;
-            unrolled_byte_loops<Char, N, RIGHT>::save_itoa(p, i, pad);
-            return p;
+            return write(bytes, uint64_t(i), pad);
+        }
+        /// Write the last N digits of \a a_val (see detail::write_digits())
+        /// @return pointer below the leftmost digit
+        static char* write(Char* bytes, uint64_t a_val, Char pad) {
+            int n = std::min(decimal_length(a_val), N);
+            write_digits(bytes + N, a_val, n);
+            if (pad)
+                memset(bytes, pad, N - n);
+            return bytes + N - n - 1;
         }
         static T fast_atoi(const Char*& bytes, Char skip = '\0') {
             const Char* p = bytes;
@@ -329,10 +454,17 @@ namespace detail {
     template <typename T, int N, typename Char>
     struct signness_helper<T, N, false, LEFT, Char> {
         static char* fast_itoa(Char* bytes, T i, Char pad = '\0') {
-            char* p = bytes;
-            unrolled_byte_loops<Char, N, LEFT>::save_itoa(p, i, pad);
-            unrolled_byte_loops<Char, N, LEFT>::reverse(bytes, p-1);
-            if (pad) return bytes+N;
+            return write(bytes, uint64_t(i), pad);
+        }
+        /// Write the last N digits of \a a_val (see detail::write_digits())
+        static char* write(Char* bytes, uint64_t a_val, Char pad) {
+            int   n = std::min(decimal_length(a_val), N);
+            char* p = bytes + n;
+            write_digits(p, a_val, n);
+            if (pad) {
+                memset(p, pad, N - n);
+                return bytes+N;
+            }
             if (p < bytes+N) *p = '\0'; // Since we have space we take advantage of it.
             return p;
         }
@@ -354,51 +486,40 @@ namespace detail {
     //-------------------------------------------------------------------------
     // Similar but simplier approach with no error checking
     // The number is assumed to be right-justified.
+    // The digits are converted by fixed_digits<N> (SWAR/SSSE3 for N >= 4),
+    // and the results are the same as converting one char at a time with
+    // n = n*10 + (c & 0x0F), i.e. ' ' is treated the same as '0'.
     template <int N>
     struct unrolled_loop_atoul {
         inline static void convert(const char*& p, uint64_t& n) {
-            //BOOST_ASSERT(*p >= '0' && *p <= '9' || *p == ' ');
-            n = n*10 + (*(p++) & 0x0f);  // ' ' is treated the same as '0'
-            unrolled_loop_atoul<N-1>::convert(p, n);
+            n  = n * utxx::pow<10, N>::value + fixed_digits<N>::convert(p);
+            p += N;
         }
         inline static uint64_t convert(const char*& p) {
-            //BOOST_ASSERT(*p >= '0' && *p <= '9' || *p == ' ');
-            uint64_t n = *p++ & 0x0f;
-            unrolled_loop_atoul<N-1>::convert(p, n);
+            uint64_t n = fixed_digits<N>::convert(p);
+            p += N;
             return n;
         }
         inline static uint64_t convert_unsigned(const char*& p) {
-            if (*p == ' ')
-                return unrolled_loop_atoul<N-1>::convert_unsigned(++p);
-            if (*p < '0' || *p > '9')
+            // Leading spaces are zeros, the last char is never checked
+            int k = leading_spaces<N>(p);
+            if (k < N-1 && (p[k] < '0' || p[k] > '9')) {
+                p += k;
                 return 0u;
-            return unrolled_loop_atoul<N>::convert(p);
-        }
-        inline static int64_t convert_signed(const char*& p) {
-            if (*p == ' ')
-                return unrolled_loop_atoul<N-1>::convert_signed(++p);
-            if (*p == '-')
-                return -static_cast<int64_t>(unrolled_loop_atoul<N-1>::convert(++p));
-            if (*p < '0' || *p > '9')
-                return 0;
-            return unrolled_loop_atoul<N>::convert(p);
-        }
-    };
-
-    template <>
-    struct unrolled_loop_atoul<1> {
-        inline static void convert(const char*& p, uint64_t& n) {
-            //BOOST_ASSERT(*p >= '0' && *p <= '9' || *p == ' ');
-            n = n*10 + (*p++ & 0x0f);
-        }
-        inline static uint64_t convert(const char*& p) {
-            //BOOST_ASSERT(*p >= '0' && *p <= '9' || *p == ' ');
-            return *p++ & 0x0f;
-        }
-        inline static uint64_t convert_unsigned(const char*& p) {
+            }
             return convert(p);
         }
         inline static int64_t convert_signed(const char*& p) {
+            int k = leading_spaces<N>(p);
+            if (k < N-1) {
+                // Exclude ('-' & 0x0F) from the value
+                if (p[k] == '-')
+                    return -static_cast<int64_t>(convert(p) - 13 * pow10u(N-1-k));
+                if (p[k] < '0' || p[k] > '9') {
+                    p += k;
+                    return 0;
+                }
+            }
             return convert(p);
         }
     };
@@ -450,9 +571,11 @@ namespace detail {
     };
 
     enum FTOA : size_t {
-          FRAC_SIZE    = 52
-        , MAX_DECIMALS = (sizeof(s_pow10v) / sizeof(s_pow10v[0]))
-        , MAX_FLOAT    = ((size_t)1 << (FRAC_SIZE+1))
+          FRAC_SIZE     = 52
+        , MAX_DECIMALS  = (sizeof(s_pow10v) / sizeof(s_pow10v[0]))
+        , MAX_FLOAT     = ((size_t)1 << (FRAC_SIZE+1))
+        , SHORTEST_SIZE = 25    // Max length of ftoa_shortest() output with '\0'
+        , FIXED_SIZE    = 330   // Max length of a fixed notation w/o decimals
     };
 /*
     //constexpr double cs_rnd = 0.55555555555555555;
@@ -522,10 +645,25 @@ inline const char* unsafe_fixed_atol(const char* p, int64_t& value) {
     return q;
 }
 
+/// This function converts a fixed-length string to integer, validating it.
+/// The integer must be left padded with spaces (e.g. "  1234"), and all
+/// other chars must be digits.  The chars are checked and converted 8 at a
+/// time (see detail::fixed_digits).
+/// @return false if the field is blank or contains non-digit chars
+template <int N>
+inline bool fixed_atoul(const char* p, uint64_t& value) {
+    int k = detail::leading_spaces<N>(p);
+    if (k == N || !detail::digits_from<N>(p, k))
+        return false;
+    value = detail::fixed_digits<N>::convert(p);
+    return true;
+}
+
 /**
  * A replacement to itoa() library function that does the job 4 times faster.
  * The value written is aligned on the left and padded on the right with \a pad
- * character, unless it is '\0'.
+ * character, unless it is '\0'.  The digits are written by the fast_itoa.hpp
+ * engine (detail::write_digits()).
  * @return Pointer above the rightmost character (value or pad) written.
  * @code
  *   E.g.
@@ -581,7 +719,8 @@ inline const char* atoi_left(const Char (&bytes)[N], T& value, Char skip = '\0')
 /**
  * A replacement to itoa() library function that does the job 4 times faster.
  * The value written is aligned on the right and padded on the left with \a pad
- * character, unless it is '\0'.
+ * character, unless it is '\0'.  The digits are written by the fast_itoa.hpp
+ * engine (detail::write_digits()).
  * @return Pointer below the leftmost character (value or pad) written.
  * @code
  *   E.g.
@@ -631,22 +770,18 @@ inline const char* atoi_right(const Char (&bytes)[N], T& value, Char skip = '\0'
 }
 
 //--------------------------------------------------------------------------------
-/// Fallback implementation of itoa. Prints \a a_value into \a a_data buffer
-/// right-adjusted, left padded with \a a_pad character.
+/// Fallback implementation of itoa. Prints non-negative \a a_value into
+/// \a a_data buffer right-adjusted, left padded with \a a_pad character.
 /// @return pointer to the beginning of the buffer.
 // 2010-10-15 Serge Aleynikov
 //--------------------------------------------------------------------------------
 template <typename T, typename Char>
 inline Char* itoa_right(Char* a_data, size_t a_size, T a_value, Char a_pad = '\0') {
     BOOST_ASSERT(a_size > 0);
-    Char* p = a_data + a_size - 1;
-    while (p >= a_data) {
-        T n = a_value / 10;
-        *p-- = '0' + a_value - n * 10;
-        a_value = n;
-        if (a_value == 0)
-            break;
-    }
+    uint64_t v = uint64_t(a_value);
+    int      n = std::min<int>(detail::decimal_length(v), a_size);
+    detail::write_digits(a_data + a_size, v, n);
+    Char* p = a_data + a_size - n - 1;
 
     if (a_pad == '\0')
         return p;
@@ -697,6 +832,15 @@ template <typename T>
 char* itoa(T value, char*& result, int base = 10) {
     BOOST_ASSERT(base >= 2 || base <= 36);
 
+    if (base == 10) {
+        char* begin = result;
+        result  = std::numeric_limits<T>::is_signed
+                ? detail::write_int (result, int64_t(value))
+                : detail::write_uint(result, uint64_t(value));
+        *result = '\0';
+        return begin;
+    }
+
     char* p = result, *q = p;
     T     tmp;
 
@@ -776,11 +920,357 @@ bool fast_atoi(const std::string& a_value, T& a_res)
 // Floating point formatting
 //--------------------------------------------------------------------------------
 
+namespace detail {
+    //-------------------------------------------------------------------------
+    // Shortest round-trip conversion of binary floating point numbers to
+    // decimal (the Ryu algorithm by Ulf Adams, PLDI 2018).  It finds the
+    // decimal with the fewest digits in the rounding interval of a number
+    // using 128-bit multiplication by tabulated powers of 5, with no libc
+    // calls or big integer arithmetic.
+    //-------------------------------------------------------------------------
+
+    /// Decimal floating point number equal to digits * 10^exponent
+    struct decimal_fp {
+        uint64_t digits;
+        int      exponent;
+    };
+
+    // Approximations of ceil(log2(5^e)) (for e > 0), floor(log10(2^e)) and
+    // floor(log10(5^e)) exact in the used ranges of e
+    inline int pow5_bits (int e) { return int((uint32_t(e) * 1217359) >> 19) + 1; }
+    inline int log10_pow2(int e) { return int((uint32_t(e) * 78913)   >> 18); }
+    inline int log10_pow5(int e) { return int((uint32_t(e) * 732923)  >> 20); }
+
+    inline bool multiple_of_pow5(uint64_t a_val, int a_p) {
+        int n = 0;
+        for (; n < a_p && a_val % 5 == 0; ++n, a_val /= 5);
+        return n >= a_p;
+    }
+
+    inline bool multiple_of_pow2(uint64_t a_val, int a_p) {
+        return (a_val & ((1ull << a_p) - 1)) == 0;
+    }
+
+    inline uint64_t mul_shift64(uint64_t a_m, const uint64_t* a_mul, int a_shift) {
+        __uint128_t b0 = __uint128_t(a_m) * a_mul[0];
+        __uint128_t b2 = __uint128_t(a_m) * a_mul[1];
+        return uint64_t(((b0 >> 64) + b2) >> (a_shift - 64));
+    }
+
+    /// Find the shortest decimal that rounds to the non-zero finite binary
+    /// floating point number given by its IEEE-754 mantissa and exponent
+    template <int MantBits, int Bias>
+    decimal_fp to_shortest_decimal(uint64_t a_mant, uint32_t a_exp)
+    {
+        typedef dtoa_tables<> tables;
+
+        // The number is m2 * 2^e2, with e2 lowered by 2 so that the halfway
+        // points to the neighbors are integers
+        int      e2;
+        uint64_t m2;
+        if (a_exp == 0) {
+            e2 = 1 - Bias - MantBits - 2;
+            m2 = a_mant;
+        } else {
+            e2 = int(a_exp) - Bias - MantBits - 2;
+            m2 = (1ull << MantBits) | a_mant;
+        }
+        // Round-to-even accepts the bounds of the interval for even mantissas
+        bool     accept_bounds = (m2 & 1) == 0;
+        uint64_t mv            = 4 * m2;
+        // The lower neighbor is closer at a power of 2
+        uint32_t mm_shift      = a_mant != 0 || a_exp <= 1;
+
+        // Decimal scaled number (vr) and its interval bounds (vm, vp)
+        uint64_t vr, vp, vm;
+        int      e10;
+        bool     vm_trailing_zeros = false;
+        bool     vr_trailing_zeros = false;
+
+        if (e2 >= 0) {
+            int q = log10_pow2(e2) - (e2 > 3);
+            int k = tables::s_pow5_inv_bits + pow5_bits(q) - 1;
+            int i = -e2 + q + k;
+            e10   = q;
+            vr    = mul_shift64(mv,                tables::s_pow5_inv_split[q], i);
+            vp    = mul_shift64(mv + 2,            tables::s_pow5_inv_split[q], i);
+            vm    = mul_shift64(mv - 1 - mm_shift, tables::s_pow5_inv_split[q], i);
+            if (q <= 21) {
+                // Only one of mv, mp and mm can be a multiple of 5, if any
+                if (mv % 5 == 0)
+                    vr_trailing_zeros = multiple_of_pow5(mv, q);
+                else if (accept_bounds)
+                    vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+                else
+                    vp -= multiple_of_pow5(mv + 2, q);
+            }
+        } else {
+            int q = log10_pow5(-e2) - (-e2 > 1);
+            int i = -e2 - q;
+            int k = pow5_bits(i) - tables::s_pow5_bits;
+            int j = q - k;
+            e10   = q + e2;
+            vr    = mul_shift64(mv,                tables::s_pow5_split[i], j);
+            vp    = mul_shift64(mv + 2,            tables::s_pow5_split[i], j);
+            vm    = mul_shift64(mv - 1 - mm_shift, tables::s_pow5_split[i], j);
+            if (q <= 1) {
+                // mv has at least 2 trailing zero bits, and mm has one iff
+                // mm_shift is 1
+                vr_trailing_zeros = true;
+                if (accept_bounds)
+                    vm_trailing_zeros = mm_shift == 1;
+                else
+                    --vp;
+            } else if (q < 63)
+                vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+
+        // Remove the digits while the interval has a shorter decimal
+        int      removed = 0;
+        uint8_t  last    = 0;
+        uint64_t out;
+
+        if (unlikely(vm_trailing_zeros || vr_trailing_zeros)) {
+            for (; vp / 10 > vm / 10; ++removed) {
+                vm_trailing_zeros &= vm % 10 == 0;
+                vr_trailing_zeros &= last == 0;
+                last = uint8_t(vr % 10);
+                vr /= 10; vp /= 10; vm /= 10;
+            }
+            if (vm_trailing_zeros)
+                for (; vm % 10 == 0; ++removed) {
+                    vr_trailing_zeros &= last == 0;
+                    last = uint8_t(vr % 10);
+                    vr /= 10; vp /= 10; vm /= 10;
+                }
+            // Round an exact halfway case to even
+            if (vr_trailing_zeros && last == 5 && vr % 2 == 0)
+                last = 4;
+            out = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) ||
+                        last >= 5);
+        } else {
+            bool round_up = false;
+            if (vp / 100 > vm / 100) {
+                round_up = vr % 100 >= 50;
+                vr /= 100; vp /= 100; vm /= 100;
+                removed += 2;
+            }
+            for (; vp / 10 > vm / 10; ++removed) {
+                round_up = vr % 10 >= 5;
+                vr /= 10; vp /= 10; vm /= 10;
+            }
+            out = vr + (vr == vm || round_up);
+        }
+        return decimal_fp{out, e10 + removed};
+    }
+
+    /// Find the shortest decimal of a number with a few decimals (such as
+    /// a price or a quantity) faster than the general algorithm by trying
+    /// the candidates x * 10^k rounded to integers for increasing k.
+    /// Below 2^50 there is at most one k-decimal candidate in the rounding
+    /// interval of x, and the correctly rounded division tells if it
+    /// converts back to x.
+    /// @return false if no candidate with up to 9 decimals was found
+    inline bool to_short_fixed_decimal(double a_val, decimal_fp& a_res)
+    {
+        static const double s_limit = double(1ull << 50);
+        if (!(a_val < s_limit / 1e9 && a_val >= 1e-9))
+            return false;
+        for (int k = 0; k < 10; ++k) {
+            double   y = a_val * s_pow10v[k];
+            uint64_t n = uint64_t(y + 0.5);
+            if (double(n) / s_pow10v[k] == a_val) {
+                int e = -k;
+                if (k == 0)
+                    for (; n % 10 == 0; n /= 10, ++e);
+                a_res = decimal_fp{n, e};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Split a floating point number into the sign and the shortest decimal.
+    /// @return false if the number is NaN or infinite
+    inline bool to_shortest_decimal(double a_val, bool& a_neg, decimal_fp& a_res)
+    {
+        union { double f; uint64_t i; } u = { a_val };
+        uint64_t mant = u.i & ((1ull << 52) - 1);
+        uint32_t exp  = uint32_t(u.i >> 52) & 0x7ff;
+        a_neg         = (u.i >> 63) != 0;
+        if (unlikely(exp == 0x7ff))
+            return false;
+        if (!(mant | exp))
+            a_res = decimal_fp{0, 0};
+        else if (!to_short_fixed_decimal(a_neg ? -a_val : a_val, a_res))
+            a_res = to_shortest_decimal<52, 1023>(mant, exp);
+        return true;
+    }
+
+    inline bool to_shortest_decimal(float a_val, bool& a_neg, decimal_fp& a_res)
+    {
+        union { float f; uint32_t i; } u = { a_val };
+        uint32_t mant = u.i & ((1u << 23) - 1);
+        uint32_t exp  = (u.i >> 23) & 0xff;
+        a_neg         = (u.i >> 31) != 0;
+        if (unlikely(exp == 0xff))
+            return false;
+        a_res = (mant | exp) ? to_shortest_decimal<23, 127>(mant, exp) : decimal_fp{0, 0};
+        return true;
+    }
+
+    inline char* fill_zeros(char* a_p, int a_n) {
+        for (char* e = a_p + a_n; a_p < e; *a_p++ = '0');
+        return a_p;
+    }
+
+    /// Write "nan", "inf" or "-inf" (the same as printf)
+    inline int write_nan_inf(char* a_buf, bool a_neg, bool a_nan) {
+        char* p = a_buf;
+        if (a_neg) *p++ = '-';
+        memcpy(p, a_nan ? "nan" : "inf", 3);
+        return p + 3 - a_buf;
+    }
+
+    /// Format a decimal in fixed notation with \a a_precision digits past the
+    /// decimal point, rounding extra digits half up.  When \a a_precision is
+    /// negative, all digits of the decimal are written and integers get ".0".
+    /// @param a_compact when true, trailing zeros past the decimal point are
+    ///                  removed (leaving one)
+    /// @return number of chars written or -1 if \a a_size is insufficient
+    inline int format_fixed(char* a_buf, int a_size, bool a_neg, decimal_fp a_dec,
+                            int a_precision, bool a_compact)
+    {
+        int frac = -a_dec.exponent;
+
+        if (a_precision >= 0 && frac > a_precision) {
+            // Round to a_precision decimals
+            int drop = frac - a_precision;
+            if (drop > 19)
+                a_dec.digits = 0;
+            else {
+                uint64_t p10 = pow10u(drop);
+                uint64_t q   = a_dec.digits / p10;
+                a_dec.digits = q + (a_dec.digits - q*p10 >= p10 / 2);
+            }
+            frac = a_precision;
+        }
+
+        int n     = a_dec.digits ? decimal_length(a_dec.digits) : 0;
+        int point = n - frac;   // Number of integer digits
+        int ndec  = a_precision >= 0 ? a_precision : std::max(frac, 1);
+        int len   = a_neg + std::max(point, 1) + (ndec ? ndec + 1 : 0);
+
+        if (unlikely(len > a_size))
+            return -1;
+
+        char* p = a_buf;
+        if (a_neg)
+            *p++ = '-';
+
+        if (frac <= 0) {
+            // Integer: digits followed by zeros
+            write_digits(p += n, a_dec.digits, n);
+            p = fill_zeros(p, point - n);
+            if (!n) *p++ = '0';
+            if (ndec) {
+                *p++ = '.';
+                p = fill_zeros(p, ndec);
+            }
+        } else if (point > 0) {
+            // Write the digits shifted by one, and move the integer ones left
+            // to insert the decimal point
+            write_digits(p + 1 + n, a_dec.digits, n);
+            for (char* e = p + point; p < e; ++p)
+                p[0] = p[1];
+            *p = '.';
+            p  = fill_zeros(p + 1 + frac, ndec - frac);
+        } else {
+            *p++ = '0';
+            *p++ = '.';
+            p = fill_zeros(p, -point);
+            write_digits(p += n, a_dec.digits, n);
+            p = fill_zeros(p, ndec - frac);
+        }
+
+        if (a_compact && a_precision > 0)
+            p = find_first_trailing_zero(p);
+        return p - a_buf;
+    }
+
+    /// Format a floating point number in fixed notation (see format_fixed())
+    template <class T>
+    int ftoa_fixed(T a_val, char* a_buf, int a_size, int a_precision, bool a_compact)
+    {
+        bool       neg;
+        decimal_fp dec;
+        if (unlikely(!to_shortest_decimal(a_val, neg, dec))) {
+            if (a_size < 4)
+                return -1;
+            return write_nan_inf(a_buf, neg, std::isnan(a_val));
+        }
+        return format_fixed(a_buf, a_size, neg, dec, a_precision, a_compact);
+    }
+
+} // namespace detail
+
+/// Convert a floating point number to the shortest string that converts back
+/// to the same number.  Numbers with decimal exponents in [-4, 15] are written
+/// in fixed notation ("0.0001", "123.45", "100.0"), others in scientific
+/// notation ("1e-05", "1.2345e+16"), as does Python's repr().
+/// @param a_val    the number to convert
+/// @param a_buf    output buffer of at least detail::FTOA::SHORTEST_SIZE bytes
+/// @return number of chars written (excluding the terminator)
+template <bool WithTerminator = true, char Terminator = '\0', class T>
+inline typename std::enable_if<std::is_floating_point<T>::value, int>::
+type ftoa_shortest(T a_val, char* a_buf)
+{
+    bool               neg;
+    detail::decimal_fp dec;
+    int                n;
+
+    if (unlikely(!detail::to_shortest_decimal(a_val, neg, dec)))
+        n = detail::write_nan_inf(a_buf, neg, std::isnan(a_val));
+    else {
+        int nd  = detail::decimal_length(dec.digits);
+        int e10 = dec.digits ? nd + dec.exponent - 1 : 0; // Scientific exponent
+
+        if (e10 >= -4 && e10 < 16)
+            n = detail::format_fixed(a_buf, detail::FTOA::SHORTEST_SIZE, neg,
+                                     dec, -1, false);
+        else {
+            char* p = a_buf;
+            if (neg)
+                *p++ = '-';
+            // Write the digits shifted by one, and move the first one before
+            // the decimal point
+            detail::write_digits(p + 1 + nd, dec.digits, nd);
+            p[0] = p[1];
+            p[1] = '.';
+            p   += nd > 1 ? nd + 1 : 1;
+            *p++ = 'e';
+            *p++ = e10 < 0 ? '-' : '+';
+            unsigned e = std::abs(e10);
+            if (e >= 100) {
+                *p++ = char('0' + e / 100);
+                e   %= 100;
+            }
+            memcpy(p, detail::digits2(e), 2);
+            n = p + 2 - a_buf;
+        }
+    }
+    if (WithTerminator)
+        a_buf[n] = Terminator;
+    return n;
+}
+
 /// Convert a floating point number to a left-justified zero-terminated string
 /// @param f is the number to convert
 /// @param buffer is the output buffer
 /// @param buffer_size is the size of the output buffer
-/// @param precision is the number of digits past the decimal point
+/// @param precision is the number of digits past the decimal point (if
+///        negative, the shortest number of digits that converts back to
+///        \a f is used, see ftoa_shortest())
 /// @param compact when true extra trailing 0's will be truncated
 /// @return number of digits written or -1 on error
 template <bool WithTerminator = true, char Terminator = '\0'>
@@ -788,9 +1278,6 @@ inline int ftoa_left(double f, char* buffer, int buffer_size, int precision, boo
 {
     using detail::FTOA;
 
-    if (precision < 0)
-        return -1;
-
     union {double f; size_t i;} a;
     bool   neg;
     auto   p = buffer;
@@ -806,15 +1293,25 @@ inline int ftoa_left(double f, char* buffer, int buffer_size, int precision, boo
     // Don't bother with optimizing too large numbers or too large precision
     // Note that a.i>>52 test below is a faster check for NAN and INF than
     // calling std::isnan() and std::isinf()
-    if (a.f > FTOA::MAX_FLOAT || precision >= long(FTOA::MAX_DECIMALS) ||
-       ((a.i >> 52) >= 0x7ff))
+    if (((a.i >> 52) >= 0x7ff) || precision < 0)
+    {
+        // Leave room for the terminator
+        int len = detail::ftoa_fixed(f, buffer, buffer_size-1, precision, compact);
+        if (len < 0)
+            return -1;
+        if (WithTerminator)
+            buffer[len] = Terminator;
+        return len;
+    }
+    if (a.f > FTOA::MAX_FLOAT || precision >= long(FTOA::MAX_DECIMALS))
     {
+        // With an explicit precision print the exact value as "%.*f" does
         int len = snprintf(buffer, buffer_size, "%.*f", precision, f);
-        p += len;
-        if (len >= buffer_size)
+        if (len < 0 || len >= buffer_size)
             return -1;
+        p += len;
         // Delete trailing zeroes
-        if (compact)
+        if (compact && precision > 0)
             p = detail::find_first_trailing_zero(p);
         if (WithTerminator)
             *p = Terminator;
@@ -883,15 +1380,15 @@ inline int ftoa_left(double f, char* buffer, int buffer_size, int precision, boo
 /// @param buffer is the output buffer
 /// @param width is the width of the width of formatted output (buffer space
 ///              must be sufficient!)
-/// @param precision is the number of digits past the decimal point
+/// @param precision is the number of digits past the decimal point (if
+///        negative, the shortest number of digits that converts back to
+///        \a f is used, see ftoa_shortest())
 /// @param lpad      is the left-padding character
 inline void ftoa_right(double f, char* buffer, int width, int precision, char lpad = ' ')
 {
     using detail::FTOA;
 
-    int int_width = width - (precision ? precision+1 : 0);
-    if (unlikely(precision < 0))
-        throw std::invalid_argument("ftoa_right: incorrect precision");
+    int int_width = width - (precision > 0 ? precision+1 : 0);
     if (unlikely(int_width < 0))
         throw std::invalid_argument("ftoa_right: incorrect width");
 
@@ -907,15 +1404,24 @@ inline void ftoa_right(double f, char* buffer, int width, int precision, char lp
     }
 
     // Don't bother with optimizing too large numbers or too large precision
-    if (a.f > FTOA::MAX_FLOAT || precision >= long(FTOA::MAX_DECIMALS) ||
-        ((a.i >> 52) >= 0x7ff)) {
-        int len = snprintf(buffer, width+1, "%*.*f", width, precision, f);
-        if (len >= width)
+    if (((a.i >> 52) >= 0x7ff) || precision < 0) {
+        int len = detail::ftoa_fixed(f, buffer, width, precision, false);
+        if (len < 0)
             throw std::invalid_argument("ftoa_right: incorrect width or precision");
-        // Add padding
-        if (lpad != ' ')
-            for (auto p = buffer; *p == ' '; p++)
-              *p = lpad;
+        // Right-justify and add padding
+        memmove(buffer + width - len, buffer, len);
+        memset(buffer, lpad, width - len);
+        return;
+    }
+    if (a.f > FTOA::MAX_FLOAT || precision >= long(FTOA::MAX_DECIMALS)) {
+        // With an explicit precision print the exact value as "%.*f" does
+        // (the output buffer has no room for the terminator)
+        char tmp[512];
+        int  len = snprintf(tmp, sizeof(tmp), "%.*f", precision, f);
+        if (len < 0 || len > width || len >= int(sizeof(tmp)))
+            throw std::invalid_argument("ftoa_right: incorrect width or precision");
+        memset(buffer, lpad, width - len);
+        memcpy(buffer + width - len, tmp, len);
         return;
     }
 
@@ -970,80 +1476,352 @@ inline void ftoa_right(double f, char* buffer, int width, int precision, char lp
     for (char* q = buffer; q != p; *q++ = lpad);
 }
 
-//--------------------------------------------------------------------------------
-/// Parses floating point numbers with fixed number of decimal digits from string.
-/// @return pointer past the last successfully parsed character or \a p if
-/// nothing was parsed.
-//
-// atof:
-//      09-May-2009 Tom Van Baak (tvb) www.LeapSecond.com
-//      http://www.leapsecond.com/tools/fast_atof.c
-//      Contributor: 2010-10-15 Serge Aleynikov
-//--------------------------------------------------------------------------------
-template <typename T>
-inline typename std::enable_if<std::is_same<T,double>::value ||
-                               std::is_same<T,float >::value, const char*>::
-type atof(const char* p, const char* end, T& result)
-{
-    BOOST_ASSERT(p != nullptr && end != nullptr);
+namespace detail {
+    /// Decimal number parsed from a string: (-1)^negative * mantissa * 10^exponent
+    struct parsed_decimal {
+        uint64_t mantissa;
+        int      exponent;
+        bool     negative;
+        bool     truncated; ///< Non-zero digits past the first 19 were dropped
+    };
 
-    // Skip leading white space, if any.
-    while (p < end && (*p == ' ' || *p == '0'))
-        ++p;
+#if defined(__SSSE3__)
+    /// Count leading decimal digits in 16 chars at \a p, and convert them to
+    /// an integer if all 16 chars are digits
+    inline int parse_16digits(const char* p, uint64_t& a_val) {
+        __m128i d    = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)),
+                                    _mm_set1_epi8('0'));
+        __m128i nine = _mm_set1_epi8(9);
+        unsigned nd  = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine))
+                     & 0xFFFF;
+        if (nd)
+            return __builtin_ctz(nd);
+        a_val = simd_16digits(d);
+        return 16;
+    }
+#endif
 
-    // Get sign, if any.
+    /// Accumulate decimal digits at \a p into \a a_mant (which overflows
+    /// past 19 digits).
+    /// @return pointer past the last digit
+    inline __attribute__((always_inline))
+    const char* scan_digits(const char* p, const char* end, uint64_t& a_mant)
+    {
+#if defined(__SSSE3__)
+        uint64_t v;
+        if (end - p >= 16 && parse_16digits(p, v) == 16) {
+            a_mant = a_mant * 10000000000000000ull + v;
+            p     += 16;
+        }
+#endif
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        while (end - p >= 8) {
+            uint64_t c;
+            memcpy(&c, p, 8);
+            int n = count_8digits(c);
+            if (n < 8) {
+                if (n) {
+                    // Pad the digits with leading '0's
+                    c = (c << (8 * (8 - n))) | (0x3030303030303030ull >> (8 * n));
+                    a_mant = a_mant * pow10u(n) + parse_8digits(c);
+                }
+                return p + n;
+            }
+            a_mant = a_mant * 100000000u + parse_8digits(c);
+            p     += 8;
+        }
+#endif
+        for (unsigned c; p < end && (c = unsigned(*p - '0')) < 10; ++p)
+            a_mant = a_mant * 10 + c;
+        return p;
+    }
 
-    double sign = 1.0;
+    /// Accumulate at most 19 significant digits of a mantissa having the
+    /// integer digits \a a_int and fractional digits \a a_frac
+    inline void parse_long_mantissa(const char* a_int,  int a_nint,
+                                    const char* a_frac, int a_nfrac,
+                                    parsed_decimal& a_res)
+    {
+        uint64_t m    = 0;
+        int      nsig = 0, exp = 0;
+        bool     trunc = false;
+        auto add = [&](char a_digit, bool a_fraction) {
+            unsigned c = unsigned(a_digit - '0');
+            if (nsig < 19) {
+                m     = m * 10 + c;
+                nsig += m != 0;
+                exp  -= a_fraction;
+            } else {
+                trunc |= c != 0;
+                exp   += !a_fraction;
+            }
+        };
+        for (int i = 0; i < a_nint;  ++i) add(a_int[i],  false);
+        for (int i = 0; i < a_nfrac; ++i) add(a_frac[i], true);
+        a_res.mantissa  = m;
+        a_res.exponent  = exp;
+        a_res.truncated = trunc;
+    }
 
-    if (*p == '-') {
-        sign = -1.0;
-        ++p;
-    } else if (*p == '+') {
-        ++p;
+    /// Parse a decimal number "[+-]digits[.digits][(e|E)[+-]digits]"
+    /// without converting it to a floating point value.
+    /// @return pointer past the last parsed char or \a p if nothing was parsed
+    inline const char* parse_decimal(const char* p, const char* end,
+                                     parsed_decimal& a_res)
+    {
+        const char* begin = p;
+        uint64_t    mant  = 0;
+        bool        neg   = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            neg = *p++ == '-';
+
+        auto int_digits  = p;
+        p = scan_digits(p, end, mant);
+        int  nint        = p - int_digits;
+        int  nfrac       = 0;
+        auto frac_digits = p;
+
+        if (p < end && *p == '.') {
+            frac_digits = ++p;
+            p     = scan_digits(p, end, mant);
+            nfrac = p - frac_digits;
+        }
+        if (!(nint + nfrac))
+            return begin;
+
+        a_res.mantissa  = mant;
+        a_res.exponent  = -nfrac;
+        a_res.negative  = neg;
+        a_res.truncated = false;
+        if (unlikely(nint + nfrac > 19))
+            parse_long_mantissa(int_digits, nint, frac_digits, nfrac, a_res);
+
+        // The exponent is only consumed if it has digits
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            auto q    = p + 1;
+            bool eneg = q < end && *q == '-';
+            if (q < end && (*q == '-' || *q == '+'))
+                ++q;
+            if (q < end && unsigned(*q - '0') < 10) {
+                int n = 0;
+                for (; q < end && unsigned(*q - '0') < 10; ++q)
+                    if (n < 100000)
+                        n = n * 10 + (*q - '0');
+                a_res.exponent += eneg ? -n : n;
+                p = q;
+            }
+        }
+        return p;
     }
 
-    // Get digits before decimal point or exponent, if any.
+    template <typename T> struct float_traits;
+
+    template <> struct float_traits<double> {
+        typedef uint64_t bits_type;
+        static const int mant_bits          = 52;
+        static const int min_exponent       = -1023;
+        static const int inf_power          = 0x7FF;
+        static const int min_round_to_even  = -4;
+        static const int max_round_to_even  = 23;
+        static const int min_pow10          = -342;
+        static const int max_pow10          = 308;
+        static const int max_exact_pow10    = 22;
+        static const uint64_t max_exact_mant= 1ull << 53;
+
+        static double exact_pow10(int n) {
+            static const double s_pow10[] = {
+                1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            return s_pow10[n];
+        }
+        static double strtof(const char* a_str) { return ::strtod(a_str, nullptr); }
+    };
+
+    template <> struct float_traits<float> {
+        typedef uint32_t bits_type;
+        static const int mant_bits          = 23;
+        static const int min_exponent       = -127;
+        static const int inf_power          = 0xFF;
+        static const int min_round_to_even  = -17;
+        static const int max_round_to_even  = 10;
+        static const int min_pow10          = -65;
+        static const int max_pow10          = 38;
+        static const int max_exact_pow10    = 10;
+        static const uint64_t max_exact_mant= 1ull << 24;
+
+        static float exact_pow10(int n) {
+            static const float s_pow10[] = {
+                1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+            };
+            return s_pow10[n];
+        }
+        static float strtof(const char* a_str) { return ::strtof(a_str, nullptr); }
+    };
+
+    /// Compute the binary mantissa and biased exponent of a_w * 10^a_q
+    /// correctly rounded to nearest even, using the Eisel-Lemire algorithm.
+    /// @param a_w non-zero mantissa
+    /// @return false if the 128-bit approximation is insufficient to decide
+    template <typename T>
+    bool eisel_lemire(int a_q, uint64_t a_w, uint64_t& a_mant, int& a_pow2)
+    {
+        typedef float_traits<T>    traits;
+        typedef atof_tables<>      tables;
+        static const int s_mbits = traits::mant_bits;
+
+        if (a_q < traits::min_pow10) {
+            a_mant = 0; a_pow2 = 0;
+            return true;
+        }
+        if (a_q > traits::max_pow10) {
+            a_mant = 0; a_pow2 = traits::inf_power;
+            return true;
+        }
+
+        // Normalize the mantissa and multiply it by the 128-bit power of 5,
+        // computing the lower product only if the upper one is inexact
+        int lz  = __builtin_clzll(a_w);
+        a_w   <<= lz;
+        auto& pow5 = tables::s_pow5_128[a_q - tables::s_min_pow10];
+        __uint128_t prod = __uint128_t(a_w) * pow5[1];
+        uint64_t hi = uint64_t(prod >> 64), lo = uint64_t(prod);
+        const uint64_t mask = ~0ull >> (s_mbits + 3);
+        if ((hi & mask) == mask) {
+            uint64_t lo2 = uint64_t((__uint128_t(a_w) * pow5[0]) >> 64);
+            lo += lo2;
+            hi += lo < lo2;
+            if (lo == ~0ull && (a_q < -27 || a_q > 55))
+                return false;
+        }
+
+        int upper = int(hi >> 63);
+        int shift = upper + 64 - s_mbits - 3;
+        a_mant    = hi >> shift;
+        // floor(log2(10^q)) = floor(q * log2(10)) + q
+        a_pow2    = int(((152170 + 65536) * a_q) >> 16) + 63 + upper - lz
+                  - traits::min_exponent;
+
+        if (a_pow2 <= 0) {
+            // Subnormal
+            if (-a_pow2 + 1 >= 64) {
+                a_mant = 0; a_pow2 = 0;
+                return true;
+            }
+            a_mant >>= -a_pow2 + 1;
+            a_mant  += a_mant & 1;
+            a_mant >>= 1;
+            a_pow2   = a_mant < (uint64_t(1) << s_mbits) ? 0 : 1;
+            return true;
+        }
 
-    double value = 0.0;
-    uint8_t n = *p - '0';
-    while (p < end && n < 10u) {
-        value = value * 10.0 + n;
-        n = *(++p) - '0';
+        // Exactly halfway between two floats: round to even
+        if (lo <= 1 && a_q >= traits::min_round_to_even &&
+            a_q <= traits::max_round_to_even && (a_mant & 3) == 1 &&
+            (a_mant << shift) == hi)
+            a_mant &= ~uint64_t(1);
+
+        a_mant  += a_mant & 1;
+        a_mant >>= 1;
+        if (a_mant >= (uint64_t(2) << s_mbits)) {
+            a_mant = uint64_t(1) << s_mbits;
+            ++a_pow2;
+        }
+        a_mant &= ~(uint64_t(1) << s_mbits);
+        if (a_pow2 >= traits::inf_power) {
+            a_mant = 0; a_pow2 = traits::inf_power;
+        }
+        return true;
     }
 
-    // Get digits after decimal point, if any.
+    /// Convert a parsed decimal to the nearest floating point number.
+    /// The text [a_begin, a_end) of the number is used by the fallback to
+    /// strtod() in the rare cases when the result can't be decided quickly.
+    template <typename T>
+    T to_float(const parsed_decimal& a_dec, const char* a_begin, const char* a_end)
+    {
+        typedef float_traits<T> traits;
+        auto w = a_dec.mantissa;
+        auto q = a_dec.exponent;
+
+        if (w == 0)
+            return a_dec.negative ? -T(0) : T(0);
+
+        // Both the mantissa and the power of 10 are exact in T
+        if (!a_dec.truncated && w <= traits::max_exact_mant &&
+            q >= -traits::max_exact_pow10 && q <= traits::max_exact_pow10) {
+            T v = T(w);
+            v   = q <= 0 ? v / traits::exact_pow10(-q) : v * traits::exact_pow10(q);
+            return a_dec.negative ? -v : v;
+        }
+
+        uint64_t mant;
+        int      pow2;
+        bool     ok = eisel_lemire<T>(q, w, mant, pow2);
 
-    if (*p == '.') {
-        ++p;
+        // When digits were dropped, the result must be the same for the
+        // mantissa rounded up
+        if (ok && a_dec.truncated) {
+            uint64_t mant1;
+            int      pow21;
+            ok = eisel_lemire<T>(q, w + 1, mant1, pow21) && mant == mant1 && pow2 == pow21;
+        }
 
-        double pow10 = 1.0;
-        double acc   = 0.0;
-        n = *p - '0';
-        while (p < end && n < 10u) {
-            acc = acc * 10.0 + n;
-            n = *(++p) - '0';
-            pow10 *= 10.0;
+        if (unlikely(!ok)) {
+            std::string s(a_begin, a_end);
+            return traits::strtof(s.c_str());
         }
-        value += acc / pow10;
+
+        typename traits::bits_type bits = typename traits::bits_type(
+            mant | (uint64_t(pow2) << traits::mant_bits) |
+            (uint64_t(a_dec.negative) << (sizeof(T) * 8 - 1)));
+        T res;
+        memcpy(&res, &bits, sizeof(T));
+        return res;
     }
+} // namespace detail
 
-    result = sign * value;
-    return p;
+//--------------------------------------------------------------------------------
+/// Parses a floating point number "[+-]digits[.digits][(e|E)[+-]digits]"
+/// preceded by optional spaces from string.
+/// The result is correctly rounded (the same as strtod()).  Digits are
+/// converted 8 at a time (16 with SSSE3), and the binary value is computed
+/// by the Eisel-Lemire algorithm, which falls back to strtod() only for
+/// inputs that are extremely close to the midpoint between two numbers.
+/// @return pointer past the last successfully parsed character or \a p if
+/// nothing was parsed (in which case \a result is not modified).
+//--------------------------------------------------------------------------------
+template <typename T>
+inline typename std::enable_if<std::is_same<T,double>::value ||
+                               std::is_same<T,float >::value, const char*>::
+type atof(const char* p, const char* end, T& result)
+{
+    BOOST_ASSERT(p != nullptr && end != nullptr);
+
+    // Skip leading white space, if any.
+    auto begin = p;
+    while (p < end && *p == ' ')
+        ++p;
+
+    detail::parsed_decimal dec;
+    auto e = detail::parse_decimal(p, end, dec);
+    if (e == p)
+        return begin;
+
+    result = detail::to_float<T>(dec, p, e);
+    return e;
 }
 
 /// Convert an integer to string.
 template <typename T>
 inline typename std::enable_if<std::numeric_limits<T>::is_integer, std::string>::
 type int_to_string(T n) {
-    static const int s_size =
-        sizeof(T) == 1 ?  2 :
-        sizeof(T) == 2 ?  6 :
-        sizeof(T) == 4 ? 10 :
-        sizeof(T) == 8 ? 20 : -1;
-    static_assert(s_size != -1, "Invalid type T");
+    // Digits, sign, and the rounded off digit of digits10
+    static const int s_size = std::numeric_limits<T>::digits10 + 2;
     char buf[s_size];
-    itoa_left(buf, n);
-    return buf;
+    char* p = itoa_left(buf, n);
+    return std::string(buf, p - buf);
 }
 
 namespace detail {
@@ -195,6 +195,46 @@ public:
         m_mant = m;
     }
 
+    /// Parse a decimal from string (e.g. "-1234.50", "1.5e-3").
+    /// Digits past the 16 significant ones are rounded half up, so that the
+    /// mantissa fits in 55 bits and a sign.
+    /// @return pointer past the last parsed character or \a p if nothing was
+    ///         parsed or the exponent is out of range (in which case the
+    ///         decimal is not modified)
+    const char* from_string(const char* p, const char* end)
+    {
+        detail::parsed_decimal d;
+        auto e = detail::parse_decimal(p, end, d);
+        if (e == p)
+            return p;
+
+        auto m = d.mantissa;
+        int  x = d.exponent;
+        int  n = m ? detail::decimal_length(m) : 0;
+        if (n > 16) {
+            auto p10 = detail::pow10u(n - 16);
+            auto r   = m % p10;
+            m  = m / p10 + (r >= p10 - r);
+            x += n - 16;
+            if (m == 10000000000000000ul) { m /= 10; ++x; }
+        }
+        if (m == 0)
+            x = 0;
+        else
+            for (; m % 10 == 0; m /= 10, ++x);
+
+        if (x < -126 || x > 126)
+            return p;
+
+        m_exp  = x;
+        m_mant = d.negative ? -long(m) : long(m);
+        return e;
+    }
+
+    const char* from_string(const std::string& a_str) {
+        return from_string(a_str.c_str(), a_str.c_str() + a_str.size());
+    }
+
     /// \param a_const_exp can be either const or initial value of the exponent
     CONSTEXPR
     decimal& normalize(int a_const_exp = 0) {
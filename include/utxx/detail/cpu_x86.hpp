@@ -159,6 +159,39 @@ inline unsigned int apic_id () {
     return (b & INITIAL_APIC_ID_BITS) >> 24;
 }
 
+/// CPU instruction set extensions detected at run time
+struct cpu_features {
+    bool sse42;     ///< SSE4.2 (CRC32C instructions)
+    bool aes;       ///< AES-NI
+    bool avx2;
+
+    cpu_features() : sse42(false), aes(false), avx2(false) {
+        unsigned int a,b,c,d;
+        int max = get_max_input_value();
+        if ( max >= 1 ) {
+            // ECX[20] - SSE4.2, ECX[25] - AES-NI
+            cpuid( 1, a, b, c, d );
+            sse42 = c & (1u << 20);
+            aes   = c & (1u << 25);
+        }
+        if ( max >= 7 ) {
+            // EBX[5] - AVX2
+            cpuid( 7, 0, a, b, c, d );
+            avx2  = b & (1u << 5);
+        }
+    }
+};
+
+/// Returns the features of the CPU this code is running on (detected once)
+inline const cpu_features& cpu_info() {
+    static const cpu_features s_features;
+    return s_features;
+}
+
+inline bool has_sse42() { return cpu_info().sse42; }
+inline bool has_aes()   { return cpu_info().aes;   }
+inline bool has_avx2()  { return cpu_info().avx2;  }
+
 inline unsigned int cpu_count() {
     static unsigned int count = sysconf(_SC_NPROCESSORS_CONF);  // _SC_NPROCESSORS_ONLN
 	return count;
@@ -38,6 +38,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 #include <chrono>
 #include <atomic>
 #include <mutex>
@@ -269,6 +270,94 @@ private:
     std::atomic<int> m_count;
 };
 
+/** Event counter for parking threads until a condition that other threads
+ * make true without locking (e.g. "queue is not empty") may have changed.
+ * The object has no pointers, and can be placed in shared memory to block
+ * threads of different processes.
+ *
+ * The waiting side passes its lock-free condition check to wait(), and the
+ * signaling side calls notify() after making the condition true.  notify()
+ * doesn't make a system call unless a thread is parked in wait().
+ */
+class futex_event {
+    std::atomic<int> m_count;
+    std::atomic<int> m_waiters;
+
+    int* word() { return reinterpret_cast<int*>(&m_count); }
+
+    static int64_t now_nsec() {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+public:
+    futex_event() { reset(); }
+
+    void reset() {
+        m_count.store(0,   std::memory_order_relaxed);
+        m_waiters.store(0, std::memory_order_relaxed);
+    }
+
+    /// Number of threads parked in wait()
+    int waiters() const { return m_waiters.load(std::memory_order_relaxed); }
+
+    /// Wake up to \a a_count threads parked in wait().
+    /// The fence pairs with the one in wait(): either the waiter's condition
+    /// check sees the state published before the fence, or we see the waiter.
+    void notify(int a_count = 1) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) == 0)
+            return;
+        m_count.fetch_add(1, std::memory_order_release);
+        futex_wake_slow(word(), a_count);
+    }
+
+    void notify_all() { notify(INT_MAX); }
+
+    /// Call \a a_cond until it returns true, parking the thread after
+    /// \a a_spin failed attempts.
+    /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+    /// @return false on timeout
+    template <class Cond>
+    bool wait(const Cond& a_cond, const timespec* a_timeout = nullptr,
+              int a_spin = 128)
+    {
+        for (int i = 0; i < a_spin; ++i)
+            if (a_cond())
+                return true;
+
+        int64_t deadline = a_timeout
+                         ? now_nsec() + a_timeout->tv_sec * 1000000000
+                                      + a_timeout->tv_nsec
+                         : 0;
+        while (true) {
+            m_waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int  val = m_count.load(std::memory_order_acquire);
+            bool ok  = a_cond();
+
+            if (!ok) {
+                timespec  rel, *prel = nullptr;
+                if (a_timeout) {
+                    auto left = deadline - now_nsec();
+                    if (left <= 0) {
+                        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    rel.tv_sec  = left / 1000000000;
+                    rel.tv_nsec = left % 1000000000;
+                    prel        = &rel;
+                }
+                futex_wait_slow(word(), val, prel);
+            }
+
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (ok || a_cond())
+                return true;
+        }
+    }
+};
+
 } // namespace utxx
 
 #endif // __cplusplus
\ No newline at end of file
@@ -40,7 +40,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <limits.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <utxx/compiler_hints.hpp>
+#if defined(__x86_64__)
+#  include <utxx/cpu.hpp>
+#  include <immintrin.h>
+#endif
 
 namespace utxx {
     struct hash_pair {
@@ -355,5 +360,152 @@ namespace detail {
         return b;
     }
 
+    //-----------------------------------------------------------------------------
+    // Hardware-accelerated hashing.
+    //
+    // The functions suffixed with _hw require the CPU support of the respective
+    // instructions (see cpu.hpp), the other ones check it at run time.
+    //-----------------------------------------------------------------------------
+
+    /// CRC32C (Castagnoli) checksum computed without special CPU instructions
+    inline uint32_t crc32c_sw(const void* a_data, size_t a_len, uint32_t a_crc = 0)
+    {
+        struct table {
+            uint32_t data[256];
+            table() {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int j = 0; j < 8; ++j)
+                        c = (c >> 1) ^ (0x82F63B78 & (0u - (c & 1)));
+                    data[i] = c;
+                }
+            }
+        };
+        static const table s_table;
+
+        const uint8_t* p = (const uint8_t*)a_data;
+        uint32_t crc = ~a_crc;
+        for (const uint8_t* e = p + a_len; p != e; ++p)
+            crc = s_table.data[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+#if defined(__x86_64__)
+    /// CRC32C checksum computed with SSE4.2 instructions
+    __attribute__((target("sse4.2")))
+    inline uint32_t crc32c_hw(const void* a_data, size_t a_len, uint32_t a_crc = 0)
+    {
+        const char* p   = (const char*)a_data;
+        uint64_t    crc = ~a_crc;
+        for (; a_len >= 8; a_len -= 8, p += 8) {
+            uint64_t v; memcpy(&v, p, 8);
+            crc = _mm_crc32_u64(crc, v);
+        }
+        uint32_t c = crc;
+        if (a_len >= 4) {
+            uint32_t v; memcpy(&v, p, 4);
+            c = _mm_crc32_u32(c, v);
+            a_len -= 4; p += 4;
+        }
+        for (; a_len; --a_len)
+            c = _mm_crc32_u8(c, *p++);
+        return ~c;
+    }
+
+    /// Hash function based on CRC32C instructions (SSE4.2).
+    /// It's the fastest one for short keys, but its result only has 32 bits
+    /// of entropy, which is enough for hash tables, but not for fingerprints.
+    __attribute__((target("sse4.2")))
+    inline uint64_t crc32c_hash64_hw(const void* a_key, size_t a_len, uint64_t a_seed = 0)
+    {
+        uint64_t h = crc32c_hw(a_key, a_len, uint32_t(a_seed ^ (a_seed >> 32)));
+        h = (h | uint64_t(a_len) << 32) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+
+    /// Hash function based on AES-NI instructions.
+    /// Each 16-byte block of the key is mixed into the state by an AES round,
+    /// and the state is finalized by three more rounds for full avalanche.
+    __attribute__((target("aes")))
+    inline uint64_t aes_hash64_hw(const void* a_key, size_t a_len, uint64_t a_seed = 0)
+    {
+        // Round keys are digits of pi
+        const __m128i k0 = _mm_set_epi64x(0x243F6A8885A308D3ll, 0x13198A2E03707344ll);
+        const __m128i k1 = _mm_set_epi64x(0xA4093822299F31D0ll, 0x082EFA98EC4E6C89ll);
+
+        const char* p = (const char*)a_key;
+        __m128i     h = _mm_xor_si128(_mm_set_epi64x(a_len, a_seed), k0);
+        for (; a_len >= 16; a_len -= 16, p += 16)
+            h = _mm_aesenc_si128
+                (_mm_xor_si128(h, _mm_loadu_si128((const __m128i*)p)), k1);
+        if (a_len) {
+            // Load the tail with overlapping fixed-size reads, which cover
+            // all of its bytes (the length is already in the state)
+            uint64_t lo, hi = 0;
+            if (a_len >= 8) {
+                memcpy(&lo, p, 8);
+                memcpy(&hi, p + a_len - 8, 8);
+            } else if (a_len >= 4) {
+                uint32_t a, b;
+                memcpy(&a, p, 4);
+                memcpy(&b, p + a_len - 4, 4);
+                lo = uint64_t(b) << 32 | a;
+            } else
+                lo = uint64_t(uint8_t(p[0])) << 16
+                   | uint64_t(uint8_t(p[a_len >> 1])) << 8 | uint8_t(p[a_len - 1]);
+            h = _mm_aesenc_si128(_mm_xor_si128(h, _mm_set_epi64x(hi, lo)), k1);
+        }
+        h = _mm_aesenc_si128(h, k0);
+        h = _mm_aesenc_si128(h, k1);
+        h = _mm_aesenc_si128(h, k0);
+        return _mm_cvtsi128_si64(h) ^ _mm_cvtsi128_si64(_mm_unpackhi_epi64(h, h));
+    }
+#endif
+
+    /// CRC32C checksum using SSE4.2 instructions if the CPU supports them
+    inline uint32_t crc32c(const void* a_data, size_t a_len, uint32_t a_crc = 0)
+    {
+#if defined(__x86_64__)
+        static const bool s_hw = has_sse42();
+        if (likely(s_hw))
+            return crc32c_hw(a_data, a_len, a_crc);
+#endif
+        return crc32c_sw(a_data, a_len, a_crc);
+    }
+
+    /// The fastest good-quality 64-bit hash function available on this CPU:
+    /// aes_hash64_hw(), crc32c_hash64_hw() or murmur_hash64().
+    /// The resulting value depends on the CPU, so it must not be persisted
+    /// or sent to other hosts.
+    inline uint64_t fast_hash64(const void* a_key, size_t a_len, uint64_t a_seed = 0)
+    {
+        typedef uint64_t (*hash_fun_t)(const void*, size_t, uint64_t);
+        struct dispatch {
+            static uint64_t murmur(const void* a_key, size_t a_len, uint64_t a_seed) {
+                return murmur_hash64(a_key, a_len, unsigned(a_seed));
+            }
+            static hash_fun_t select() {
+#if defined(__x86_64__)
+                if (has_aes())   return &aes_hash64_hw;
+                if (has_sse42()) return &crc32c_hash64_hw;
+#endif
+                return &murmur;
+            }
+        };
+        static const hash_fun_t s_fun = dispatch::select();
+        return s_fun(a_key, a_len, a_seed);
+    }
+
+    template <typename T>
+    struct fast_hash_fun;
+
+    /// Hash functor using fast_hash64()
+    template <>
+    struct fast_hash_fun<std::string> {
+        size_t operator()(const std::string& a) const {
+            return fast_hash64(a.c_str(), a.size());
+        }
+    };
+
 } // namespace detail
 } // namespace utxx
\ No newline at end of file
@@ -0,0 +1,329 @@
+//----------------------------------------------------------------------------
+/// \file   mcast_receiver.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Sequence tracking of multicast market data channels.
+///
+/// The mcast_receiver class detects sequence gaps and out-of-order packets
+/// of a set of multicast channels, and maintains per-channel statistics.
+/// The sequence number of a packet is extracted by a Decoder policy class
+/// that implements:
+/// \code
+///     template <class Channel>
+///     long seqno(const Channel& a_ch, const char* a_buf, size_t a_size,
+///                bool& a_reset);
+/// \endcode
+/// returning 0 if the packet has no sequence number, and setting \a a_reset
+/// to true when the packet resets the channel's sequence.
+///
+/// The receiver doesn't own the sockets, so that it can be embedded in any
+/// I/O loop: the caller looks up the channel of a received datagram with
+/// find() and passes the datagram to process().
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <netinet/in.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <utxx/compiler_hints.hpp>
+
+namespace utxx {
+namespace io {
+
+/// Result of processing a packet by mcast_receiver
+enum class seqno_status {
+    NONE,           ///< Packet has no sequence number
+    OK,             ///< Packet is next in sequence (or resets the sequence)
+    GAP,            ///< Some packets preceding this one were lost
+    OUT_OF_ORDER    ///< Packet's sequence number is lower than expected
+};
+
+/// Statistics of a multicast channel
+struct mcast_stats {
+    uint64_t    bytes           = 0;
+    uint64_t    packets         = 0;
+    uint64_t    gaps            = 0;    ///< Number of detected gaps
+    uint64_t    lost            = 0;    ///< Number of packets missing in gaps
+    uint64_t    out_of_order    = 0;
+    long        last_seqno      = 0;
+    long        last_data_time  = 0;    ///< Time of last packet (nanoseconds)
+    long        last_gap_time   = 0;    ///< Time of last gap (nanoseconds)
+    long        last_ooo_time   = 0;    ///< Time of last out-of-order packet
+
+    mcast_stats& operator+=(const mcast_stats& a) {
+        bytes        += a.bytes;
+        packets      += a.packets;
+        gaps         += a.gaps;
+        lost         += a.lost;
+        out_of_order += a.out_of_order;
+        return *this;
+    }
+};
+
+/// Sequence state and statistics of a multicast channel.
+/// The state is updated only by the thread that calls
+/// mcast_receiver::process(), which reads it without synchronization.
+/// Other threads can take a consistent copy of the statistics with
+/// snapshot(), which never blocks the receiving thread.
+class mcast_channel {
+    template <class D, class C> friend class mcast_receiver;
+
+    // Odd value indicates that an update is in progress
+    std::atomic<uint32_t>   m_version       {0};
+    std::atomic<uint64_t>   m_bytes         {0};
+    std::atomic<uint64_t>   m_packets       {0};
+    std::atomic<uint64_t>   m_gaps          {0};
+    std::atomic<uint64_t>   m_lost          {0};
+    std::atomic<uint64_t>   m_ooo           {0};
+    std::atomic<long>       m_last_seqno    {0};
+    std::atomic<long>       m_last_data_time{0};
+    std::atomic<long>       m_last_gap_time {0};
+    std::atomic<long>       m_last_ooo_time {0};
+
+    template <class T>
+    static T    get(const std::atomic<T>& a) { return a.load(std::memory_order_relaxed); }
+    template <class T>
+    static void set(std::atomic<T>& a, T v)  { a.store(v, std::memory_order_relaxed); }
+    template <class T>
+    static void inc(std::atomic<T>& a, T n)  { set(a, get(a) + n); }
+
+    void begin_update() {
+        set(m_version, get(m_version)+1);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void end_update() {
+        m_version.store(get(m_version)+1, std::memory_order_release);
+    }
+
+public:
+    mcast_channel() {}
+    mcast_channel(const mcast_channel&) = delete;
+    mcast_channel& operator=(const mcast_channel&) = delete;
+
+    uint64_t bytes()          const { return get(m_bytes);          }
+    uint64_t packets()        const { return get(m_packets);        }
+    uint64_t gaps()           const { return get(m_gaps);           }
+    uint64_t lost()           const { return get(m_lost);           }
+    uint64_t out_of_order()   const { return get(m_ooo);            }
+    long     last_seqno()     const { return get(m_last_seqno);     }
+    long     last_data_time() const { return get(m_last_data_time); }
+    long     last_gap_time()  const { return get(m_last_gap_time);  }
+    long     last_ooo_time()  const { return get(m_last_ooo_time);  }
+
+    /// Get a consistent copy of the channel's statistics (can be called
+    /// by any thread)
+    mcast_stats snapshot() const {
+        mcast_stats res;
+        uint32_t    v1, v2;
+        do {
+            while ((v1 = m_version.load(std::memory_order_acquire)) & 1)
+                ;
+            res.bytes          = bytes();
+            res.packets        = packets();
+            res.gaps           = gaps();
+            res.lost           = lost();
+            res.out_of_order   = out_of_order();
+            res.last_seqno     = last_seqno();
+            res.last_data_time = last_data_time();
+            res.last_gap_time  = last_gap_time();
+            res.last_ooo_time  = last_ooo_time();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            v2 = get(m_version);
+        } while (v1 != v2);
+        return res;
+    }
+};
+
+/// Decoder of feeds without sequence numbers
+struct no_seqno_decoder {
+    template <class Channel>
+    long seqno(const Channel&, const char*, size_t, bool&) const { return 0; }
+};
+
+/// Decoder of MICEX FAST feeds (packets start with a 32-bit little-endian
+/// sequence number)
+struct micex_seqno_decoder {
+    template <class Channel>
+    long seqno(const Channel&, const char* a_buf, size_t a_size, bool&) const {
+        if (unlikely(a_size < 4))
+            return 0;
+        auto p = reinterpret_cast<const uint8_t*>(a_buf);
+        return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16
+             | (uint32_t)p[1] << 8  | (uint32_t)p[0];
+    }
+};
+
+/// Decoder of FORTS FAST feeds (the sequence number is the first field of
+/// a message following the presence map and the template id)
+struct forts_seqno_decoder {
+    /// Decode a stop-bit encoded unsigned integer of at most \a a_max - 1
+    /// bytes.  If no stop bit is found, \a a_val is set to 0, and \a a_buf
+    /// is not advanced.
+    static void decode_uint(const char*& a_buf, const char* a_end, size_t a_max,
+                            uint64_t& a_val)
+    {
+        auto end = std::min(a_end, a_buf + a_max - 1);
+        uint64_t n = 0;
+        for (auto p = a_buf; p < end; ++p) {
+            n = (n << 7) | (*p & 0x7F);
+            if (*p & 0x80) {
+                a_val = n;
+                a_buf = p+1;
+                return;
+            }
+        }
+        a_val = 0;
+    }
+
+    template <class Channel>
+    long seqno(const Channel&, const char* a_buf, size_t a_size, bool& a_reset) const {
+        const char* q   = a_buf;
+        const char* end = a_buf + a_size;
+        uint64_t    tid = 120, seq = 0, pmap;
+
+        while (tid == 120) {                // Reset message
+            decode_uint(q, end, 5, pmap);
+            decode_uint(q, end, 5, tid);
+        }
+
+        decode_uint(q, end, 5, seq);
+
+        // Sequence reset: parse new seqno
+        if (tid == 49) {
+            a_reset = true;
+            decode_uint(q, end, 10, tid);   // SendingTime
+            decode_uint(q, end, 5,  seq);   // NewSeqNo
+        }
+
+        return uint32_t(seq);
+    }
+};
+
+/// Sequence gap tracker of a set of multicast channels.
+/// @tparam Decoder policy extracting sequence numbers from packets
+/// @tparam Channel type derived from mcast_channel, that the application
+///                 can extend with its own channel's properties
+template <class Decoder, class Channel = mcast_channel>
+class mcast_receiver {
+public:
+    using channel_type = Channel;
+
+    /// Called on detection of a gap [a_first, a_last] of lost sequence
+    /// numbers in the channel (e.g. to request their retransmission)
+    using recovery_fun = std::function<void (Channel& a_ch, long a_first, long a_last)>;
+
+    explicit mcast_receiver(const Decoder& a_decoder = Decoder())
+        : m_decoder(a_decoder)
+    {}
+
+    Decoder&       decoder()       { return m_decoder; }
+    const Decoder& decoder() const { return m_decoder; }
+
+    /// Set the gap recovery callback
+    void on_gap(const recovery_fun& a_fun) { m_on_gap = a_fun; }
+
+    /// Register a channel (owned by the caller) receiving multicast
+    /// packets sent to \a a_addr:a_port (any byte order can be used as long
+    /// as it's consistent with calls to find())
+    void add(in_addr_t a_addr, uint16_t a_port, Channel& a_ch) {
+        m_index[key(a_addr, a_port)] = &a_ch;
+        m_channels.push_back(&a_ch);
+    }
+
+    /// Find a channel of a destination address and port
+    /// @return nullptr if the channel is not registered
+    Channel* find(in_addr_t a_addr, uint16_t a_port) const {
+        auto it = m_index.find(key(a_addr, a_port));
+        return likely(it != m_index.end()) ? it->second : nullptr;
+    }
+
+    /// All registered channels in the order of registration
+    const std::vector<Channel*>& channels() const { return m_channels; }
+
+    /// Update sequence state and statistics of \a a_ch with a packet
+    /// received at \a a_now time (in nanoseconds)
+    seqno_status process(Channel& a_ch, const char* a_buf, size_t a_size, long a_now) {
+        bool reset = false;
+        long seqno = m_decoder.seqno(a_ch, a_buf, a_size, reset);
+        long last  = a_ch.last_seqno();
+        auto res   = seqno ? seqno_status::OK : seqno_status::NONE;
+
+        a_ch.begin_update();
+        mcast_channel::set(a_ch.m_last_data_time, a_now);
+        mcast_channel::inc(a_ch.m_bytes,   uint64_t(a_size));
+        mcast_channel::inc(a_ch.m_packets, uint64_t(1));
+
+        if (seqno) {
+            long diff = seqno - last;
+            if (!last || reset)
+                ;
+            else if (diff < 0) {
+                mcast_channel::set(a_ch.m_last_ooo_time, a_now);
+                mcast_channel::inc(a_ch.m_ooo, uint64_t(1));
+                res = seqno_status::OUT_OF_ORDER;
+            } else if (diff > 1) {
+                mcast_channel::set(a_ch.m_last_gap_time, a_now);
+                mcast_channel::inc(a_ch.m_gaps, uint64_t(1));
+                mcast_channel::inc(a_ch.m_lost, uint64_t(diff-1));
+                res = seqno_status::GAP;
+            }
+            mcast_channel::set(a_ch.m_last_seqno, seqno);
+        }
+        a_ch.end_update();
+
+        if (unlikely(res == seqno_status::GAP) && m_on_gap)
+            m_on_gap(a_ch, last+1, seqno-1);
+
+        return res;
+    }
+
+    /// Sum of statistics of all channels (can be called by any thread)
+    mcast_stats totals() const {
+        mcast_stats res;
+        for (auto* ch : m_channels)
+            res += ch->snapshot();
+        return res;
+    }
+
+private:
+    Decoder                                 m_decoder;
+    recovery_fun                            m_on_gap;
+    std::unordered_map<uint64_t, Channel*>  m_index;
+    std::vector<Channel*>                   m_channels;
+
+    static uint64_t key(in_addr_t a_addr, uint16_t a_port) {
+        return uint64_t(a_addr) << 16 | a_port;
+    }
+};
+
+} // namespace io
+} // namespace utxx
@@ -56,9 +56,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/concurrent_mpsc_queue.hpp>
 #include <utxx/logger/logger_enums.hpp>
 #include <utxx/logger/logger_util.hpp>
+#include <utxx/logger/logger_deferred.hpp>
+#include <utxx/logger/logger_lanes.hpp>
+#include <utxx/logger/logger_category.hpp>
+#include <utxx/high_res_timer.hpp>
 #include <utxx/synch.hpp>
+#include <utxx/wait_strategy.hpp>
 #include <thread>
 #include <mutex>
+#include <cstring>
 
 #ifndef _MSC_VER
 #   include <utxx/synch.hpp>
@@ -159,15 +165,24 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 //------------------------------------------------------------------------------
 #define UTXX_LOG_SRCINFO UTXX_FILE_SRC_LOCATION, BOOST_CURRENT_FUNCTION
 
+//------------------------------------------------------------------------------
+/// Category argument of the logging macros resolved through a function-local
+/// cache, so that a string literal category is interned once per call site
+/// rather than looked up on every call (see utxx::log_category_site)
+//------------------------------------------------------------------------------
+#define UTXX_LOG_CATEGORY(Cat) \
+    ([]() -> utxx::log_category_site& { \
+        static utxx::log_category_site s_site; return s_site; }().get(Cat))
+
 /// We use the macro trickery below to implemenet a UTXX_LOG() macro that
 /// can optionally take the category as the second macro argument. The idea
 /// is to use a macro chooser that takes __VA_ARGS__ to select the
 /// UTXX_LOG_N_ARGS() macro depending on whether it was called with one
 /// or two arguments:
 #define UTXX_LOG_2_ARGS(SI, Level) \
-    utxx::logger::msg_streamer(utxx::LEVEL_##Level, "",  SI)
+    utxx::logger::msg_streamer(utxx::LEVEL_##Level, utxx::log_category(), SI)
 #define UTXX_LOG_3_ARGS(SI, Level, Cat) \
-    utxx::logger::msg_streamer(utxx::LEVEL_##Level, Cat, SI)
+    utxx::logger::msg_streamer(utxx::LEVEL_##Level, UTXX_LOG_CATEGORY(Cat), SI)
 
 #define UTXX_GET_3RD_ARG(arg1, arg2, arg3, ...) arg3
 #define UTXX_LOG_MACRO_CHOOSER(...) \
@@ -178,9 +193,21 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 /// the <printf> function: <(const char* fmt, ...)>
 //------------------------------------------------------------------------------
 #define UTXX_CLOG(Level, Cat, Fmt, ...) \
-    utxx::logger::instance().logfmt(Level, Cat, UTXX_LOG_SRCINFO, \
+    utxx::logger::instance().logfmt(Level, UTXX_LOG_CATEGORY(Cat), \
+                                    UTXX_LOG_SRCINFO, \
                                     Fmt, ##__VA_ARGS__)
 
+//------------------------------------------------------------------------------
+/// Same as UTXX_CLOG(), but <Fmt> is a "{}"-style format string literal that
+/// is parsed and checked against the arguments at compile time (see UTXX_FMT)
+//------------------------------------------------------------------------------
+#define UTXX_CLOGF(Level, Cat, Fmt, ...) \
+    utxx::logger::instance().logs(Level, UTXX_LOG_CATEGORY(Cat), \
+                                  UTXX_LOG_SRCINFO, \
+                                  UTXX_FMT(Fmt, ##__VA_ARGS__))
+
+#define UTXX_LOGF(Level, Fmt, ...) UTXX_CLOGF(Level, "", Fmt, ##__VA_ARGS__)
+
 //------------------------------------------------------------------------------
 /// Support for streaming version of the logger
 //------------------------------------------------------------------------------
@@ -262,12 +289,41 @@ struct logger : boost::noncopyable {
     using str_function   = function
         <std::string (const char* pfx, size_t plen, const char* sfx, size_t slen)>;
 
-    enum class payload_t { STR_FUN, CHAR_FUN, STR };
+    enum class payload_t { STR_FUN, CHAR_FUN, STR, DEFERRED };
 
+    /// Size limit (including the terminating '\0') of a message formatted
+    /// by logfmt(), whether it is formatted immediately or deferred
+    static const int s_max_fmt_size = 1024;
+
+    /// Identity of a logging thread, cached on first use by that thread
+    struct thread_info {
+        pthread_t     id;
+        char          name[16];
+
+        thread_info() : id(pthread_self()) { update(); }
+
+        /// Refetch the thread's name
+        void update() {
+            if (pthread_getname_np(id, name, sizeof(name)) != 0)
+                name[0] = '\0';
+        }
+
+        /// Get the calling thread's info
+        static thread_info& local() {
+            static thread_local thread_info s_info;
+            return s_info;
+        }
+    };
+
+    /// Log message.  The message's metadata (timestamp, category id,
+    /// thread id and name) doesn't require heap allocations.  In the
+    /// tsc_timestamp() mode the timestamp is captured as a CPU tick count,
+    /// and converted to wall-clock time by the logger's thread.
     class msg {
-        time_val      m_timestamp;
+        mutable time_val m_timestamp;
+        hrtime_t      m_tsc;
         log_level     m_level;
-        std::string   m_category;
+        uint32_t      m_category;
         std::size_t   m_src_loc_len;
         const char*   m_src_location;
         std::size_t   m_src_fun_len;
@@ -277,49 +333,61 @@ struct logger : boost::noncopyable {
         char          m_thread_name[16];
 
         union U {
-            char_function  cf;
-            str_function   sf;
-            std::string    str;
+            char_function    cf;
+            str_function     sf;
+            std::string      str;
+            deferred_payload df;
             U() : cf(nullptr) {}
-            U(const char_function& f) : cf(f)  {}
-            U(const str_function&  f) : sf(f)  {}
-            U(const std::string&   f) : str(f) {}
+            U(const char_function&    f) : cf(f)  {}
+            U(const str_function&     f) : sf(f)  {}
+            U(const std::string&      f) : str(f) {}
+            U(std::string&&           f) : str(std::move(f)) {}
+            U(const deferred_payload& f) : df(f)  {}
             ~U() {}
         } m_fun;
 
         friend struct logger;
 
         template <typename Fun>
-        msg(log_level a_ll, const std::string& a_category, payload_t a_type,
-            const Fun& a_fun,
+        msg(log_level a_ll, log_category a_category, payload_t a_type,
+            Fun&& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len
-        )   : m_timestamp   (now_utc())
-            , m_level       (a_ll)
-            , m_category    (a_category)
+        )   : m_level       (a_ll)
+            , m_category    (a_category.id())
             , m_src_loc_len (a_sloc_len)
             , m_src_location(a_src_loc)
             , m_src_fun_len (a_sfun_len)
             , m_src_fun     (a_src_fun)
             , m_type        (a_type)
-            , m_thread_id   (pthread_self())
-            , m_fun         (a_fun)
+            , m_fun         (std::forward<Fun>(a_fun))
         {
-            if (logger::instance().show_thread() != logger::thr_id_type::NAME ||
-                pthread_getname_np(m_thread_id, m_thread_name, sizeof(m_thread_name)) < 0)
+            auto& lg = logger::instance();
+            if (lg.tsc_timestamp())
+                m_tsc = high_res_timer::gettime();
+            else {
+                m_tsc = 0;
+                m_timestamp = now_utc();
+            }
+
+            auto& ti    = thread_info::local();
+            m_thread_id = ti.id;
+            if (lg.show_thread() == logger::thr_id_type::NAME)
+                memcpy(m_thread_name, ti.name, sizeof(m_thread_name));
+            else
                 m_thread_name[0] = '\0';
         }
 
     public:
 
-        msg(log_level a_ll, const std::string& a_cat, const char_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const char_function& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::CHAR_FUN, a_fun,
                   a_src_loc, a_sloc_len, a_src_fun, a_sfun_len)
         {}
 
-        msg(log_level a_ll, const std::string& a_cat, const str_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const str_function& a_fun,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::STR_FUN, a_fun,
@@ -327,37 +395,59 @@ struct logger : boost::noncopyable {
         {}
 
         template <int N, int M>
-        msg(log_level a_ll, const std::string& a_cat, const str_function& a_fun,
+        msg(log_level a_ll, log_category a_cat, const str_function& a_fun,
             const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : msg(a_ll, a_cat, payload_t::STR_FUN, a_fun,
                   a_src_loc, N-1, a_src_fun, M-1)
         {}
 
         template <int N, int M>
-        msg(log_level a_ll, const std::string& a_cat, const std::string& a_str,
+        msg(log_level a_ll, log_category a_cat, const std::string& a_str,
             const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : msg(a_ll, a_cat, payload_t::STR, a_str,
                   a_src_loc, N-1, a_src_fun, M-1)
         {}
 
-        msg(log_level a_ll, const std::string& a_cat, const std::string& a_str,
+        msg(log_level a_ll, log_category a_cat, const std::string& a_str,
             const char* a_src_loc, std::size_t a_sloc_len,
             const char* a_src_fun, std::size_t a_sfun_len)
             : msg(a_ll, a_cat, payload_t::STR, a_str,
                   a_src_loc, a_sloc_len, a_src_fun, a_sfun_len)
         {}
 
+        msg(log_level a_ll, log_category a_cat, std::string&& a_str,
+            const char* a_src_loc, std::size_t a_sloc_len,
+            const char* a_src_fun, std::size_t a_sfun_len)
+            : msg(a_ll, a_cat, payload_t::STR, std::move(a_str),
+                  a_src_loc, a_sloc_len, a_src_fun, a_sfun_len)
+        {}
+
+        msg(log_level a_ll, log_category a_cat, const deferred_payload& a_df,
+            const char* a_src_loc, std::size_t a_sloc_len,
+            const char* a_src_fun, std::size_t a_sfun_len)
+            : msg(a_ll, a_cat, payload_t::DEFERRED, a_df,
+                  a_src_loc, a_sloc_len, a_src_fun, a_sfun_len)
+        {}
+
         ~msg() {
             switch (m_type) {
                 case payload_t::STR_FUN:  m_fun.sf = nullptr;  break;
                 case payload_t::CHAR_FUN: m_fun.cf = nullptr;  break;
                 case payload_t::STR:      m_fun.str.~basic_string(); break;
+                case payload_t::DEFERRED: m_fun.df.release();  break;
             }
         }
 
+        /// Wall-clock time of the message (in the tsc_timestamp() mode it's
+        /// only known after the message is dequeued by the logger's thread)
         time_val      timestamp   () const { return m_timestamp;    }
+        /// CPU tick count of the message (0 unless in tsc_timestamp() mode)
+        hrtime_t      tsc         () const { return m_tsc;          }
         log_level     level       () const { return m_level;        }
-        std::string   category    () const { return m_category;     }
+        uint32_t      category_id () const { return m_category;     }
+        const std::string& category() const {
+            return log_categories::instance().name(m_category);
+        }
         std::size_t   src_loc_len () const { return m_src_loc_len;  }
         const char*   src_location() const { return m_src_location; }
         std::size_t   src_fun_len () const { return m_src_fun_len;  }
@@ -368,20 +458,20 @@ struct logger : boost::noncopyable {
     struct msg_streamer {
         detail::basic_buffered_print<512> data;
         log_level                         level;
-        std::string                       category;
+        log_category                      category;
         const char*                       src_loc;
         size_t                            src_loc_len;
         const char*                       src_fun;
         size_t                            src_fun_len;
 
-        msg_streamer(log_level a_ll, const std::string& a_cat, src_info&& a_si)
+        msg_streamer(log_level a_ll, log_category a_cat, src_info&& a_si)
             : level(a_ll), category(a_cat)
             , src_loc(a_si.srcloc()), src_loc_len(a_si.srcloc_len())
             , src_fun(a_si.fun()),    src_fun_len(a_si.fun_len())
         {}
 
         template <int N, int M>
-        msg_streamer(log_level a_ll, const std::string& a_cat,
+        msg_streamer(log_level a_ll, log_category a_cat,
                      const char (&a_src_loc)[N], const char (&a_src_fun)[M])
             : level(a_ll), category(a_cat)
             , src_loc(a_src_loc), src_loc_len(N-1)
@@ -463,14 +553,17 @@ struct logger : boost::noncopyable {
 private:
     using concurrent_queue = concurrent_mpsc_queue<msg>;
     using signal_delegate  = signal<on_msg_delegate_t>;
+    using lane             = basic_log_lane<msg>;
 
     std::unique_ptr<std::thread>    m_thread;
+    pthread_t                       m_thread_id             = 0;
     concurrent_queue                m_queue;
     bool                            m_abort                 = false;
     std::atomic<bool>               m_initialized;
     futex                           m_event;
     std::mutex                      m_mutex;
     struct timespec                 m_wait_timeout;
+    utxx::wait_strategy             m_wait_strategy;
 
     signal_delegate                 m_sig_slot[NLEVELS];
     unsigned int                    m_level_filter          = LEVEL_NO_DEBUG;
@@ -485,8 +578,27 @@ private:
     std::string                     m_ident;
     bool                            m_silent_finish         = false;
     int                             m_fatal_kill_signal     = 0;
-    long                            m_sched_yield_us        = 250;
     bool                            m_block_signals         = true;
+    bool                            m_deferred_format       = false;
+    uint32_t                        m_deferred_buffer_size  = 64*1024;
+    bool                            m_use_lanes             = false;
+    uint32_t                        m_lane_capacity         = 1024;
+    lane_overflow                   m_lane_overflow         = lane_overflow::DROP;
+    /// Lanes created by producers, but not yet seen by the logger's thread
+    std::atomic<lane*>              m_new_lanes{nullptr};
+    /// Lanes swept by the logger's thread
+    std::vector<lane*>              m_lanes;
+    std::vector<uint32_t>           m_lane_counts;
+    std::atomic<uint64_t>           m_dropped{0};
+    bool                            m_tsc_timestamp         = false;
+    /// Calibration of the tick counter against wall-clock time (maintained
+    /// by the logger's thread).  The origin is used to estimate the tick
+    /// rate, and the base is the most recent conversion point
+    hrtime_t                        m_tsc_origin            = 0;
+    time_val                        m_tsc_origin_time;
+    hrtime_t                        m_tsc_base              = 0;
+    time_val                        m_tsc_base_time;
+    double                          m_nsec_per_tick         = 1.0;
     std::atomic<bool>               m_finalizer_installed;
     config_macros                   m_macro_var_map;
 
@@ -522,20 +634,75 @@ private:
     void remove(log_level a_lvl, int a_id);
 
     void dolog_msg(const msg& a_msg);
+
+    /// Take a new pair of tick counter and wall-clock readings, and
+    /// recompute the tick rate (unless \a a_reset is true)
+    void tsc_calibrate(bool a_reset);
+
+    /// Convert a tick count of a message to wall-clock time
+    time_val tsc_to_time(hrtime_t a_tsc) const {
+        auto ns = double(int64_t(a_tsc - m_tsc_base)) * m_nsec_per_tick;
+        return m_tsc_base_time.add_nsec(long(ns));
+    }
     void dolog_fatal_msg(const char* buf, size_t sz);
 
     template<typename Fun>
-    bool dolog(log_level   a_ll, const std::string& a_cat, const Fun& a_fun,
+    bool dolog(log_level   a_ll, log_category a_cat, const Fun& a_fun,
                const char* a_src_loc,  std::size_t  a_src_loc_len,
                const char* a_src_fun,  std::size_t  a_src_fun_len);
 
-    bool dolog(log_level   a_ll, const std::string& a_cat,
+    bool dolog(log_level   a_ll, log_category a_cat,
                const char* a_buf,      std::size_t  a_size,
                const char* a_src_loc,  std::size_t  a_src_loc_len,
                const char* a_src_fun,  std::size_t  a_src_fun_len);
 
+    /// Result of an attempt to log a message with deferred formatting
+    enum class deferred_res {
+        OK,         ///< The message was enqueued
+        NO_SPACE,   ///< The arguments can't be saved - format them in place
+        DROPPED     ///< The message was dropped by a full lane
+    };
+
+    /// Enqueue a message with printf() arguments copied to the calling
+    /// thread's deferred_buffer.
+    /// @return NO_SPACE if the buffer doesn't have enough space
+    template<typename... Args>
+    deferred_res dolog_deferred(std::true_type,
+                        log_level   a_ll, log_category a_cat,
+                        const char* a_src_loc,  std::size_t  a_src_loc_len,
+                        const char* a_src_fun,  std::size_t  a_src_fun_len,
+                        const char* a_fmt,      const Args&... a_args);
+
+    /// Some arguments can't be serialized - format in the caller's context
+    template<typename... Args>
+    deferred_res dolog_deferred(std::false_type, Args&&...) { return deferred_res::NO_SPACE; }
+
+    /// Construct a message in the calling thread's lane or in the shared
+    /// queue (depending on the lanes() setting) and notify the logger's thread
+    template<typename... Args>
+    bool enqueue(Args&&... a_args);
+
+    /// Enqueue a message to the calling thread's lane applying the lane's
+    /// overflow policy when it is full.
+    template<typename... Args>
+    bool lane_push(Args&&... a_args);
+
+    /// Get the lane of the calling thread, creating it on first use
+    lane* local_lane();
+
+    /// Called by the logger's thread to pick up lanes of new threads
+    /// @return false if there are no messages pending in the lanes
+    bool lanes_pending();
+
+    /// Write messages pending in the lanes ordered by their timestamps
+    bool flush_lanes();
+
+    /// @return true if there are no pending messages in the queue and lanes
+    bool empty() { return m_queue.empty() && !lanes_pending(); }
+
     void run();
     bool flush();
+    void report_flush_error();
 
     friend class log_msg_info;
 
@@ -603,7 +770,64 @@ public:
     /// Occasionally when running processing thread on max priority the use of
     /// sched_yield() can cause system resource starvation.
     /// @param a_interval_us interval in microseconds (use -1 to disable)
-    void sched_yield_us(long a_interval_us) { m_sched_yield_us = a_interval_us; }
+    void sched_yield_us(long a_interval_us) {
+        m_wait_strategy.yield_us(std::max(0l, a_interval_us));
+    }
+
+    /// Policy of waiting for new messages in the logger's thread.
+    /// Use a spinning strategy to reduce the latency of writing messages
+    /// at the cost of burning a CPU core.
+    const utxx::wait_strategy& wait_policy() const { return m_wait_strategy; }
+    void wait_policy(const utxx::wait_strategy& a) { m_wait_strategy = a;    }
+
+    /// Enable deferred formatting of messages logged with logfmt() (i.e.
+    /// by the UTXX_LOG_*() macros). In this mode the calling thread only
+    /// copies the format string pointer and the raw bytes of the arguments
+    /// to a per-thread buffer of \a a_buf_size bytes, and sprintf() is
+    /// called by the logger's thread.
+    /// NOTE: the format string must have static storage duration (e.g. be
+    /// a string literal), since only its pointer is saved.
+    void deferred_format(bool a_enable, uint32_t a_buf_size = 64*1024);
+
+    /// @return true if deferred formatting of messages is enabled
+    bool deferred_format() const { return m_deferred_format; }
+
+    /// Enable per-thread lanes.  In this mode each producing thread enqueues
+    /// messages to its own bounded SPSC queue of \a a_capacity messages
+    /// instead of the shared MPSC queue, and the logger's thread merges
+    /// messages of all lanes by timestamp.
+    /// @param a_overflow default action taken when a lane is full
+    void lanes(bool a_enable, uint32_t a_capacity = 1024,
+               lane_overflow a_overflow = lane_overflow::DROP);
+
+    /// @return true if per-thread lanes are enabled
+    bool lanes() const { return m_use_lanes; }
+
+    /// Set the overflow policy of the calling thread's lane
+    void lane_overflow_policy(lane_overflow a_policy) { local_lane()->policy(a_policy); }
+
+    /// @return overflow policy of the calling thread's lane
+    lane_overflow lane_overflow_policy() { return local_lane()->policy(); }
+
+    /// @return number of messages dropped by the calling thread's lane
+    uint64_t lane_dropped() { return local_lane()->dropped(); }
+
+    /// @return total number of messages dropped because of full lanes
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /// When enabled, messages are timestamped by reading the CPU's tick
+    /// counter, and the logger's thread converts ticks to wall-clock time
+    /// using a periodically recalibrated rate.  This requires a constant
+    /// rate tick counter synchronized across CPUs.
+    /// NOTE: must be set before calling init().
+    void tsc_timestamp(bool a_enable) { m_tsc_timestamp = a_enable; }
+
+    /// @return true if messages are timestamped with the CPU's tick counter
+    bool tsc_timestamp() const { return m_tsc_timestamp; }
+
+    /// Refresh the calling thread's name cached for logging (call it when
+    /// a thread is renamed after it logged a message)
+    static void update_thread_name() { thread_info::local().update(); }
 
     /// Set a callback to be called on start of the logger's async thread
     void set_on_before_run(std::function<void()> a_cb) { m_on_before_run = a_cb; }
@@ -695,7 +919,7 @@ public:
     ///                  obtained by using UTXX_FILE_SRC_LOCATION macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template <int N, int M>
-    bool logcs(log_level a_level, const std::string& a_category,
+    bool logcs(log_level a_level, log_category a_category,
                const char* a_msg, size_t a_size,
                const char (&a_src_loc)[N] = "",
                const char (&a_src_fun)[M] = "");
@@ -704,6 +928,9 @@ public:
     /// Logged message will be limited in size to 1024 bytes.
     /// Formatting of the resulting string to be logged happens in the caller's
     /// context, but actual message logging is handled asynchronously.
+    /// If deferred_format() is enabled, formatting is done by the logger's
+    /// thread (unless some of \a a_args are not arithmetic types, pointers
+    /// or C-strings, or the calling thread's deferred buffer is full).
     /// Use the provided <LOG_*> macros instead of calling it directly.
     /// @param a_level is the log level to record
     /// @param a_cat is a category of the message (use NULL if undefined).
@@ -713,7 +940,7 @@ public:
     /// @param a_fmt is the format string passed to <sprintf()>
     /// @param args is the list of optional arguments passed to <args>
     template<int N, int M, typename... Args>
-    bool logfmt(log_level a_level, const std::string& a_cat,
+    bool logfmt(log_level a_level, log_category a_cat,
                 const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                 const char*  a_fmt, Args&&... a_args);
 
@@ -729,7 +956,7 @@ public:
     /// @param a_fmt   is the format string passed to <sprintf()>
     /// @param args    is the list of optional arguments passed to <args>
     template<int N, int M, typename... Args>
-    bool logs(log_level a_level, const std::string& a_cat,
+    bool logs(log_level a_level, log_category a_cat,
               const char (&a_src_loc)[N], const char (&a_src_fun)[M],
               Args&&... a_args);
 
@@ -742,7 +969,7 @@ public:
     /// @param a_si    identifies the source location of the event
     /// @param args    is the list of optional arguments passed to <args>
     template<typename... Args>
-    bool logs(log_level  a_level, const std::string& a_cat,
+    bool logs(log_level  a_level, log_category a_cat,
               src_info&& a_si,    Args&&... a_args);
 
     /// Log a message of given log level to registered implementations.
@@ -754,7 +981,7 @@ public:
     ///                  obtained by using UTXX_LOG_SRCINFO macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template <int N, int M>
-    bool log(utxx::log_level a_level, const std::string& a_cat,
+    bool log(utxx::log_level a_level, log_category a_cat,
              const std::string& a_msg,
              const char (&a_src_loc)[N] = "", const char (&a_src_fun)[M] = "");
 
@@ -764,7 +991,7 @@ public:
     /// @param a_cat   is a category of the message (use NULL if undefined).
     /// @param a_msg   is the message to be logged
     /// @param a_src   identifies the source location of the error
-    bool log(utxx::log_level  a_level, const std::string& a_cat,
+    bool log(utxx::log_level  a_level, log_category a_cat,
              const std::string& a_msg, src_info&&         a_src);
 
     /// Log a message of given log level to registered implementations.
@@ -780,7 +1007,7 @@ public:
     ///                  obtained by using UTXX_LOG_SRCINFO macro.
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     template<typename Fun, int N, int M>
-    bool async_logf(log_level a_level, const std::string& a_cat, const Fun& a_fun,
+    bool async_logf(log_level a_level, log_category a_cat, const Fun& a_fun,
                     const char (&a_src_loc)[N] = "", const char (&a_src_fun)[M] = "")
     { return dolog(a_level, a_cat, a_fun, a_src_loc, N-1, a_src_fun, M-1); }
 
@@ -792,7 +1019,7 @@ public:
     /// @param a_cat   is a category of the message (use NULL if undefined).
     /// @param args are the arguments to be converted to buffer and logged as string
     template<typename... Args>
-    bool async_logs(log_level a_level, const std::string& a_cat, Args&&... args)
+    bool async_logs(log_level a_level, log_category a_cat, Args&&... args)
     { return async_logs(a_level, a_cat, "", "", std::forward<Args>(args)...); }
 
     /// Log a message of given log level message to registered implementations.
@@ -806,7 +1033,7 @@ public:
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     /// @param args are the arguments to be converted to buffer and logged as string
     template<int N, int M, typename... Args>
-    bool async_logs(log_level a_level, const std::string& a_category,
+    bool async_logs(log_level a_level, log_category a_category,
                     const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                     Args&&... args);
 
@@ -823,7 +1050,7 @@ public:
     /// @param a_src_fun identifies the current function name (i.e. __func__).
     /// @param args is the list of optional arguments passed to <args>
     template<int N, int M, typename... Args>
-    bool async_logfmt(log_level a_level, const std::string& a_cat,
+    bool async_logfmt(log_level a_level, log_category a_cat,
                       const char (&a_src_loc)[N], const char (&a_src_fun)[M],
                       const char* a_fmt, Args&&... a_args);
 };
@@ -841,6 +1068,14 @@ struct logger_impl {
     /// Dump all settings to stream
     virtual std::ostream& dump(std::ostream& out, const std::string& a_prefix) const = 0;
 
+    /// Called by the logger's thread before writing a batch of messages
+    /// drained from the queue.  Back-ends may accumulate messages passed to
+    /// their delegates until end_batch() is called.
+    virtual void begin_batch() {}
+
+    /// Called by the logger's thread after the batch of messages is written
+    virtual void end_batch()   {}
+
     /// Called by logger upon reading initialization from configuration
     void set_log_mgr(logger* a_log_mgr) { m_log_mgr = a_log_mgr; }
 
@@ -39,10 +39,50 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 namespace utxx {
 
+template <typename... Args>
+inline bool logger::enqueue(Args&&... a_args)
+{
+    bool res = likely(!m_use_lanes)
+             ? m_queue.emplace(std::forward<Args>(a_args)...)
+             : lane_push(std::forward<Args>(a_args)...);
+    m_event.signal_fast();
+    return res;
+}
+
+template <typename... Args>
+inline bool logger::lane_push(Args&&... a_args)
+{
+    auto* ln = local_lane();
+    if (likely(ln->try_push(a_args...)))
+        return true;
+
+    // The lane is full. Unless the policy is to drop the message, wake up
+    // the logger's thread and wait for it to free up space (but not when
+    // called by the logger's thread itself or when the logger is stopped).
+    auto policy = ln->policy();
+    if (policy != lane_overflow::DROP && m_initialized && !m_abort &&
+        !pthread_equal(pthread_self(), m_thread_id))
+    {
+        if (policy == lane_overflow::OVERWRITE)
+            ln->request_evict();
+
+        while (m_initialized && !m_abort) {
+            m_event.signal();
+            sched_yield();
+            if (ln->try_push(a_args...))
+                return true;
+        }
+    }
+
+    ln->drop();
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
 template <typename Fun>
 inline bool logger::dolog(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const Fun&          a_fun,
     const char*         a_src_loc,
     std::size_t         a_src_loc_len,
@@ -52,16 +92,14 @@ inline bool logger::dolog(
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_fun,
-                               a_src_loc, a_src_loc_len,
-                               a_src_fun, a_src_fun_len);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_fun,
+                   a_src_loc, a_src_loc_len,
+                   a_src_fun, a_src_fun_len);
 }
 
 inline bool logger::dolog(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char*         a_buf,
     std::size_t         a_size,
     const char*         a_src_loc,
@@ -74,17 +112,49 @@ inline bool logger::dolog(
 
     std::string sbuf(a_buf, a_size);
 
-    bool res = m_queue.emplace(a_level, a_cat, sbuf,
-                               a_src_loc, a_src_loc_len,
-                               a_src_fun, a_src_fun_len);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, sbuf,
+                   a_src_loc, a_src_loc_len,
+                   a_src_fun, a_src_fun_len);
+}
+
+template <typename... Args>
+inline logger::deferred_res logger::dolog_deferred(
+    std::true_type,
+    log_level           a_level,
+    log_category        a_cat,
+    const char*         a_src_loc,
+    std::size_t         a_src_loc_len,
+    const char*         a_src_fun,
+    std::size_t         a_src_fun_len,
+    const char*         a_fmt,
+    const Args&...      a_args)
+{
+    auto*    buf = deferred_buffer::local(m_deferred_buffer_size);
+    auto     sz  = detail::deferred_args_size(a_args...);
+    uint32_t reserved;
+    char*    p   = likely(sz < buf->capacity()) ? buf->allocate(sz, reserved) : nullptr;
+
+    if (unlikely(!p))
+        return deferred_res::NO_SPACE;
+
+    detail::deferred_args_write(p, a_args...);
+
+    deferred_payload df{&detail::deferred_format<Args...>, a_fmt, p, buf, reserved};
+    if (!enqueue(a_level, a_cat, df,
+                 a_src_loc, a_src_loc_len,
+                 a_src_fun, a_src_fun_len))
+    {
+        // The message was already accounted for as dropped by the lane
+        buf->rollback(reserved);
+        return deferred_res::DROPPED;
+    }
+    return deferred_res::OK;
 }
 
 template <int N, int M>
 inline bool logger::logcs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char*         a_buf,
     std::size_t         a_size,
     const char        (&a_src_loc)[N],
@@ -95,8 +165,7 @@ inline bool logger::logcs(
 
 namespace {
     inline int do_copy(char* a_buf, size_t a_sz, const char* a_str) {
-        char* p = a_buf;
-        return stpncpy(p, a_str, a_sz) - a_buf;
+        return detail::format_no_args(a_buf, a_sz, a_str);
     }
     template <class... Args>
     inline int do_copy(char* a_buf, size_t a_sz, const char* a_fmt, Args&&... args) {
@@ -107,7 +176,7 @@ namespace {
 template <int N, int M, typename... Args>
 inline bool logger::logfmt(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     const char*         a_fmt,
@@ -116,21 +185,29 @@ inline bool logger::logfmt(
     if (!is_enabled(a_level))
         return false;
 
-    char buf[1024];
+    using deferrable = std::integral_constant
+        <bool, detail::deferred_args_supported<Args...>::value>;
+
+    if (m_deferred_format) {
+        auto res = dolog_deferred(deferrable(), a_level, a_cat, a_src_loc, N-1,
+                                  a_src_fun, M-1, a_fmt, a_args...);
+        if (res != deferred_res::NO_SPACE)
+            return res == deferred_res::OK;
+    }
+
+    char buf[s_max_fmt_size];
     int  n;
     // The condition below prevents the compiler warning about snprintf
     // when there are no arguments provides, since a_fmt is not a string literal
     n = do_copy(buf, sizeof(buf), a_fmt, std::forward<Args>(a_args)...);
-    std::string sbuf(buf, std::min<int>(n, sizeof(buf)-1));
-    bool res = m_queue.emplace(a_level, a_cat, sbuf, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    std::string sbuf(buf, std::max(0, std::min<int>(n, sizeof(buf)-1)));
+    return enqueue(a_level, a_cat, sbuf, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 template <typename... Args>
 inline bool logger::logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     src_info&&          a_si,
     Args&&...           a_args)
 {
@@ -139,17 +216,15 @@ inline bool logger::logs(
 
     detail::basic_buffered_print<1024> buf;
     buf.print(std::forward<Args>(a_args)...);
-    bool res = m_queue.emplace(a_level, a_cat, buf.to_string(),
-                               a_si.srcloc(), a_si.srcloc_len(),
-                               a_si.fun(), a_si.fun_len());
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, buf.to_string(),
+                   a_si.srcloc(), a_si.srcloc_len(),
+                   a_si.fun(), a_si.fun_len());
 }
 
 template <int N, int M, typename... Args>
 inline bool logger::logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     Args&&...           a_args)
@@ -159,16 +234,14 @@ inline bool logger::logs(
 
     detail::basic_buffered_print<1024> buf;
     buf.print(std::forward<Args>(a_args)...);
-    bool res = m_queue.emplace(a_level, a_cat, buf.to_string(),
-                               a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, buf.to_string(),
+                   a_src_loc, N-1, a_src_fun, M-1);
 }
 
 template <int N, int M>
 inline bool logger::log(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const std::string&  a_msg,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M])
@@ -176,34 +249,34 @@ inline bool logger::log(
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_msg, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_msg, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 inline bool logger::log(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const std::string&  a_msg,
     src_info&&          a_si)
 {
     if (!is_enabled(a_level))
         return false;
 
-    bool res = m_queue.emplace(a_level, a_cat, a_msg, a_si.srcloc(), a_si.srcloc_len(),
-                               a_si.fun(), a_si.fun_len());
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, a_msg, a_si.srcloc(), a_si.srcloc_len(),
+                   a_si.fun(), a_si.fun_len());
 }
 
 template <int N, int M, typename... Args>
 inline bool logger::async_logs(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char        (&a_src_loc)[N],
     const char        (&a_src_fun)[M],
     Args&&...           a_args)
 {
+    static_assert(!any_formatted<Args...>::value,
+                  "UTXX_FMT() holds its arguments by reference and cannot be "
+                  "logged asynchronously");
+
     if (!is_enabled(a_level))
         return false;
 
@@ -214,16 +287,14 @@ inline bool logger::async_logs(
         buf.sprint(sfx, ssz);
         return buf.to_string();
     };
-    bool res = m_queue.emplace(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 // TODO: make synchronous string formatting
 template <int N, int M, typename... Args>
 inline bool logger::async_logfmt(
     log_level           a_level,
-    const std::string&  a_cat,
+    log_category        a_cat,
     const char         (&a_src_loc)[N],
     const char         (&a_src_fun)[M],
     const char*         a_fmt,
@@ -235,9 +306,7 @@ inline bool logger::async_logfmt(
     auto fun = [=](char* a_buf, size_t a_size) {
         return snprintf(a_buf, a_size, a_fmt, std::forward<Args>(a_args)...);
     };
-    bool res = m_queue.emplace(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
-    m_event.signal_fast();
-    return res;
+    return enqueue(a_level, a_cat, fun, a_src_loc, N-1, a_src_fun, M-1);
 }
 
 } // namespace utxx
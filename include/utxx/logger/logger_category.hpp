@@ -0,0 +1,180 @@
+//------------------------------------------------------------------------------
+/// \file   logger_category.hpp
+/// \author Serge Aleynikov
+//------------------------------------------------------------------------------
+/// \brief Registry of logging categories.
+///
+/// Log messages refer to their category by a small integer id rather than
+/// by a copy of the category string.  The id of a category is looked up in
+/// a per-thread cache, so the global registry's lock is only taken the
+/// first time a thread uses a category.  To avoid the lookup on every
+/// message, register the category once and pass the log_category handle
+/// to the logging macros:
+/// \code
+/// static const utxx::log_category s_cat("Orders");
+/// CLOG_INFO(s_cat, "New order #%d", id);
+/// \endcode
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma  once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utxx/compiler_hints.hpp>
+
+namespace utxx {
+
+/// Registry mapping category names to integer ids.
+/// Category 0 is the empty (default) category.  Registered names are never
+/// removed, and their storage is never moved, so that the logger's thread
+/// can resolve an id without locking.
+class log_categories {
+    static const uint32_t s_chunk_bits = 8;
+    static const uint32_t s_chunk_size = 1u << s_chunk_bits;
+    static const uint32_t s_max_chunks = 256;
+
+    std::mutex                                  m_mutex;
+    std::unordered_map<std::string, uint32_t>   m_ids;
+    std::atomic<std::string*>                   m_chunks[s_max_chunks];
+    std::atomic<uint32_t>                       m_count;
+
+    /// NOTE: the destructor doesn't free the names, since messages
+    /// referring to them may still be written while the logger finalizes
+    /// at program exit.
+    log_categories();
+
+    /// Register \a a_name if needed (takes the registry's lock).
+    /// When the registry is full, returns the default category's id.
+    uint32_t add(const std::string& a_name);
+
+public:
+    /// Max number of categories
+    static constexpr uint32_t capacity() { return s_chunk_size * s_max_chunks; }
+
+    /// Id of the default (empty) category, which is also used for the
+    /// categories that don't fit in the registry
+    static constexpr uint32_t default_id() { return 0; }
+
+    static log_categories& instance() {
+        static log_categories s_instance;
+        return s_instance;
+    }
+
+    /// Get the id of the \a a_name category, registering it on first use.
+    uint32_t id(const std::string& a_name) {
+        if (a_name.empty())
+            return default_id();
+        static thread_local std::unordered_map<std::string, uint32_t> s_cache;
+        auto it = s_cache.find(a_name);
+        if (likely(it != s_cache.end()))
+            return it->second;
+        auto id = add(a_name);
+        s_cache.emplace(a_name, id);
+        return id;
+    }
+
+    /// Get the name of a category by the id returned from id()
+    const std::string& name(uint32_t a_id) const {
+        auto* chunk = m_chunks[a_id >> s_chunk_bits].load(std::memory_order_acquire);
+        return chunk[a_id & (s_chunk_size-1)];
+    }
+
+    /// Number of registered categories (including the default one)
+    uint32_t count() const { return m_count.load(std::memory_order_relaxed); }
+};
+
+/// Handle of a registered logging category passed to the logger's API.
+/// It is implicitly constructed from a category name, in which case the name
+/// is looked up in the registry.  That is the slow path kept for convenience:
+/// on hot paths either construct a handle once, or use the logging macros,
+/// which resolve a string literal category once per call site
+/// (see log_category_site).
+class log_category {
+    uint32_t m_id;
+public:
+    log_category() : m_id(log_categories::default_id()) {}
+
+    log_category(const char* a_name)
+        : m_id(a_name && *a_name ? log_categories::instance().id(a_name)
+                                 : log_categories::default_id())
+    {}
+
+    log_category(const std::string& a_name)
+        : m_id(log_categories::instance().id(a_name))
+    {}
+
+    /// Construct a handle from the id returned by log_categories::id()
+    explicit log_category(uint32_t a_id) : m_id(a_id) {}
+
+    uint32_t           id()   const { return m_id; }
+    const std::string& name() const { return log_categories::instance().name(m_id); }
+};
+
+/// Per-call-site cache of a category used by the logging macros
+/// (see UTXX_LOG_CATEGORY).  A category given as a string literal is looked
+/// up in the registry on the site's first call only.  Handles are passed
+/// through, and other strings (including a literal other than the one that
+/// was cached first, e.g. picked by a "?:" expression) take the slow path.
+class log_category_site {
+    enum { EMPTY, BUSY, READY };
+
+    std::atomic<int> m_state;
+    const char*      m_name;
+    uint32_t         m_id;
+public:
+    log_category_site() : m_state(EMPTY), m_name(nullptr), m_id(0) {}
+
+    template <size_t N>
+    log_category get(const char (&a_name)[N]) {
+        if (likely(m_state.load(std::memory_order_acquire) == READY)) {
+            if (likely(m_name == a_name))
+                return log_category(m_id);
+            return log_category(a_name);
+        }
+        log_category cat(a_name);
+        int  state = EMPTY;
+        if (m_state.compare_exchange_strong(state, BUSY,
+                                            std::memory_order_relaxed)) {
+            m_name = a_name;
+            m_id   = cat.id();
+            m_state.store(READY, std::memory_order_release);
+        }
+        return cat;
+    }
+
+    /// A mutable buffer's content may change between calls: never cached
+    template <size_t N>
+    log_category get(char (&a_name)[N]) { return log_category(a_name); }
+
+    log_category get(log_category a_cat) { return a_cat; }
+};
+
+} // namespace utxx
@@ -0,0 +1,327 @@
+//------------------------------------------------------------------------------
+/// \file   logger_deferred.hpp
+/// \author Serge Aleynikov
+//------------------------------------------------------------------------------
+/// \brief Support for deferred (binary) formatting of log messages.
+///
+/// In the deferred mode the calling thread doesn't call sprintf().  Instead
+/// it copies the format string pointer and the raw bytes of the arguments to
+/// a preallocated per-thread buffer, and the logger's thread does all the
+/// formatting work.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma  once
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <utxx/config.h>
+#include <utxx/compiler_hints.hpp>
+
+namespace utxx {
+
+namespace detail {
+
+    /// Serialization of a single printf() argument to the deferred buffer.
+    /// Arithmetic, enum and pointer arguments are copied as raw bytes.
+    template <class T, class Enable = void>
+    struct deferred_arg {
+        static constexpr bool supported = false;
+    };
+
+    template <class T>
+    struct deferred_arg<T, typename std::enable_if<
+        std::is_arithmetic<T>::value || std::is_enum<T>::value ||
+        (std::is_pointer<T>::value &&
+        !std::is_same<typename std::remove_cv<
+            typename std::remove_pointer<T>::type>::type, char>::value)>::type>
+    {
+        static constexpr bool supported = true;
+        using type = T;
+
+        static size_t size (T)                { return sizeof(T); }
+        static char*  write(char* p, T a)     { memcpy(p, &a, sizeof(T)); return p + sizeof(T); }
+        static T      read (const char*& p)   { T a; memcpy(&a, p, sizeof(T)); p += sizeof(T); return a; }
+    };
+
+    /// C-strings are copied by value (including the terminating '\0'),
+    /// since the pointer may not be valid by the time the logger thread
+    /// formats the message.
+    template <class T>
+    struct deferred_arg<T, typename std::enable_if<
+        std::is_pointer<T>::value &&
+        std::is_same<typename std::remove_cv<
+            typename std::remove_pointer<T>::type>::type, char>::value>::type>
+    {
+        static constexpr bool     supported = true;
+        static constexpr uint32_t s_null    = uint32_t(-1);
+        using type = const char*;
+
+        static size_t size(const char* a) {
+            return sizeof(uint32_t) + (a ? strlen(a)+1 : 0);
+        }
+        static char* write(char* p, const char* a) {
+            uint32_t n = a ? strlen(a) : s_null;
+            memcpy(p, &n, sizeof(n));
+            p += sizeof(n);
+            if (n == s_null)
+                return p;
+            memcpy(p, a, n+1);
+            return p + n+1;
+        }
+        static const char* read(const char*& p) {
+            uint32_t n;
+            memcpy(&n, p, sizeof(n));
+            p += sizeof(n);
+            if (n == s_null)
+                return nullptr;
+            auto s = p;
+            p += n+1;
+            return s;
+        }
+    };
+
+    template <class... Args>
+    struct deferred_args_supported;
+
+    template <>
+    struct deferred_args_supported<> { static constexpr bool value = true; };
+
+    template <class T, class... Args>
+    struct deferred_args_supported<T, Args...> {
+        static constexpr bool value =
+            deferred_arg<typename std::decay<T>::type>::supported &&
+            deferred_args_supported<Args...>::value;
+    };
+
+    inline size_t deferred_args_size() { return 0; }
+
+    template <class T, class... Args>
+    inline size_t deferred_args_size(const T& a, const Args&... args) {
+        return deferred_arg<typename std::decay<T>::type>::size(a)
+             + deferred_args_size(args...);
+    }
+
+    inline char* deferred_args_write(char* p) { return p; }
+
+    template <class T, class... Args>
+    inline char* deferred_args_write(char* p, const T& a, const Args&... args) {
+        p = deferred_arg<typename std::decay<T>::type>::write(p, a);
+        return deferred_args_write(p, args...);
+    }
+
+    template <class Tuple, size_t... I>
+    inline int deferred_snprintf(char* a_buf, size_t a_size, const char* a_fmt,
+                                 const Tuple& a_args, std::index_sequence<I...>)
+    {
+        return snprintf(a_buf, a_size, a_fmt, std::get<I>(a_args)...);
+    }
+
+    /// Function called by the logger thread to format a deferred message.
+    /// @param a_buf  output buffer
+    /// @param a_size size of the output buffer
+    /// @param a_fmt  printf() format string
+    /// @param a_args serialized argument bytes
+    /// @return number of bytes the formatted output would take (like snprintf)
+    using deferred_fmt_fun =
+        int (*)(char* a_buf, size_t a_size, const char* a_fmt, const char* a_args);
+
+    template <class... Args>
+    inline int deferred_format(char* a_buf, size_t a_size, const char* a_fmt,
+                               const char* a_args)
+    {
+        // Braced initialization guarantees left-to-right evaluation order
+        std::tuple<typename deferred_arg<typename std::decay<Args>::type>::type...>
+            args{deferred_arg<typename std::decay<Args>::type>::read(a_args)...};
+        return deferred_snprintf(a_buf, a_size, a_fmt, args,
+                                 std::index_sequence_for<Args...>());
+    }
+
+    /// Format a message that has no arguments the way snprintf() would,
+    /// i.e. with "%%" written as "%", but without interpreting any other
+    /// conversion specifiers, which have no matching arguments.
+    /// @return number of bytes the formatted output would take (like snprintf)
+    inline int format_no_args(char* a_buf, size_t a_size, const char* a_fmt)
+    {
+        char* p   = a_buf;
+        char* end = a_size ? a_buf + a_size - 1 : a_buf;
+        int   n   = 0;
+        for (const char* q = a_fmt; *q; ++q, ++n) {
+            if (*q == '%' && q[1] == '%')
+                ++q;
+            if (p < end)
+                *p++ = *q;
+        }
+        if (a_size)
+            *p = '\0';
+        return n;
+    }
+
+    template <>
+    inline int deferred_format<>(char* a_buf, size_t a_size, const char* a_fmt,
+                                 const char*)
+    {
+        return format_no_args(a_buf, a_size, a_fmt);
+    }
+
+} // namespace detail
+
+/// Per-thread ring buffer holding serialized arguments of log messages
+/// that are pending formatting by the logger's thread.
+///
+/// The producing thread reserves space with allocate(), and the logger's
+/// thread returns it with release() in the same order.  When a producing
+/// thread exits, its buffer is placed on the orphan list and gets reclaimed
+/// by the logger thread by a call to reap() after all pending messages
+/// referencing it have been written.
+class deferred_buffer {
+    const uint32_t                      m_capacity;     // Power of 2
+    char*                               m_data;
+    // Producer's state
+    uint64_t                            m_head;
+    uint64_t                            m_tail_cache;
+    char                                m_pad[UTXX_CL_SIZE];
+    // Consumer's state
+    std::atomic<uint64_t>               m_tail;
+    std::atomic<bool>                   m_orphan;
+    deferred_buffer*                    m_next;
+
+    static std::atomic<deferred_buffer*> s_orphans;
+
+    struct holder {
+        deferred_buffer* buf = nullptr;
+        ~holder() { if (buf) buf->orphan(); }
+    };
+
+    explicit deferred_buffer(uint32_t a_capacity)
+        : m_capacity  (a_capacity)
+        , m_data      (new char[a_capacity])
+        , m_head      (0)
+        , m_tail_cache(0)
+        , m_tail      (0)
+        , m_orphan    (false)
+        , m_next      (nullptr)
+    {
+        assert((a_capacity & (a_capacity-1)) == 0);
+    }
+
+    ~deferred_buffer() { delete [] m_data; }
+
+    /// Called when the owning thread exits
+    void orphan() {
+        m_orphan.store(true, std::memory_order_release);
+        auto* h = s_orphans.load(std::memory_order_relaxed);
+        do    { m_next = h; }
+        while (!s_orphans.compare_exchange_weak(h, this, std::memory_order_release));
+    }
+
+    bool drained() const {
+        return m_orphan.load(std::memory_order_acquire)
+            && m_tail.load(std::memory_order_relaxed) == m_head;
+    }
+
+public:
+    /// Get the buffer of the calling thread, creating it on first use.
+    /// @param a_capacity size of the buffer (power of 2) used on creation
+    static deferred_buffer* local(uint32_t a_capacity) {
+        static thread_local holder s_holder;
+        if (unlikely(!s_holder.buf))
+            s_holder.buf = new deferred_buffer(a_capacity);
+        return s_holder.buf;
+    }
+
+    /// Delete buffers of exited threads whose pending messages have been
+    /// written.  Must only be called by the logger thread.
+    static void reap() {
+        if (likely(!s_orphans.load(std::memory_order_relaxed)))
+            return;
+        for (auto* p = s_orphans.exchange(nullptr, std::memory_order_acquire), *next = p;
+             p; p = next)
+        {
+            next = p->m_next;
+            if (p->drained()) { delete p; continue; }
+            // Still has pending messages - put it back on the list
+            auto* h = s_orphans.load(std::memory_order_relaxed);
+            do    { p->m_next = h; }
+            while (!s_orphans.compare_exchange_weak(h, p, std::memory_order_release));
+        }
+    }
+
+    uint32_t capacity() const { return m_capacity; }
+
+    /// Reserve \a a_size contiguous bytes (called by the owning thread).
+    /// @param a_reserved total number of bytes taken from the buffer, which
+    ///                   must be passed to release()
+    /// @return nullptr if the buffer doesn't have enough free space
+    char* allocate(uint32_t a_size, uint32_t& a_reserved) {
+        auto pos   = uint32_t(m_head & (m_capacity-1));
+        // Skip the tail of the buffer if the data doesn't fit there
+        auto pad   = pos + a_size > m_capacity ? m_capacity - pos : 0;
+        auto total = pad + a_size;
+        if (unlikely(m_head + total - m_tail_cache > m_capacity)) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (m_head + total - m_tail_cache > m_capacity)
+                return nullptr;
+        }
+        m_head    += total;
+        a_reserved = total;
+        return m_data + (pad ? 0 : pos);
+    }
+
+    /// Undo the last allocate() call (called by the owning thread).
+    void rollback(uint32_t a_reserved) { m_head -= a_reserved; }
+
+    /// Return space previously reserved by allocate() (called by the
+    /// logger thread in the order of allocation).
+    void release(uint32_t a_reserved) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + a_reserved,
+                     std::memory_order_release);
+    }
+};
+
+/// Payload of a log message whose formatting is deferred to the logger thread
+struct deferred_payload {
+    detail::deferred_fmt_fun    fun;
+    const char*                 fmt;
+    const char*                 args;
+    deferred_buffer*            owner;
+    uint32_t                    reserved;
+
+    /// Format the message into \a a_buf (executed by the logger thread)
+    int  format(char* a_buf, size_t a_size) const { return fun(a_buf, a_size, fmt, args); }
+
+    /// Return the argument space to the owning thread's buffer
+    void release() const { owner->release(reserved); }
+};
+
+} // namespace utxx
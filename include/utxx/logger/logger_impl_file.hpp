@@ -76,6 +76,12 @@ class logger_impl_file: public logger_impl {
     int          m_split_part_last;
     int          m_split_parts_digits;
     size_t       m_split_filename_index;
+    size_t       m_file_size;
+    size_t       m_batch_size;
+    bool         m_sync;
+    bool         m_batching;
+    bool         m_unsynced;
+    std::string  m_batch;
 
     logger_impl_file(const char* a_name)
         : m_name(a_name), m_append(true)
@@ -85,10 +91,16 @@ class logger_impl_file: public logger_impl {
         , m_split_delim('_')
         , m_split_part(0), m_split_part_last(0)
         , m_split_parts_digits(0), m_split_filename_index(-1)
+        , m_file_size(0), m_batch_size(64*1024), m_sync(false), m_batching(false)
+        , m_unsynced(false)
     {}
 
     void finalize() {
-        if (m_fd > -1) { close(m_fd); m_fd = -1; }
+        if (m_fd < 0)
+            return;
+        try   { write_batch(); } catch (...) {}
+        close(m_fd);
+        m_fd = -1;
     }
 
     void        modify_file_name(bool increment = true);
@@ -97,6 +109,12 @@ class logger_impl_file: public logger_impl {
 
     void        create_symbolic_link();
     bool        open_file(bool rotated);
+    void        check_split();
+    void        write_data(const char* a_buf, size_t a_size, const char* a_src = "");
+    /// Write messages accumulated in the batch buffer
+    void        write_batch();
+    /// Call fdatasync() if sync is requested and data was written since last sync
+    void        sync_data();
 public:
     static logger_impl_file* create(const char* a_name) {
         return new logger_impl_file(a_name);
@@ -118,6 +136,10 @@ public:
 
     void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size);
 
+    /// Start accumulating messages in the batch buffer
+    void begin_batch() override;
+    /// Write accumulated messages to file (and sync if requested)
+    void end_batch()   override;
 
 };
 
@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------------
+/// \file  logger_impl_mmap.hpp
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin implementing memory-mapped log writer for the
+/// <tt>logger</tt> class.
+///
+/// Formatted records are copied to a preallocated memory-mapped segment
+/// file, and the write offset stored in the segment's header is advanced
+/// after each record, so writing a message doesn't involve any system
+/// calls.  Since the pages belong to the kernel's page cache, the records
+/// written before a crash of the process are not lost, and the header's
+/// offset marks the end of the last complete record.  When the segment
+/// is full, the logger rotates to a new segment file.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/config.h>
+#include <utxx/logger.hpp>
+#include <atomic>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace utxx {
+
+class logger_impl_mmap: public logger_impl {
+public:
+    /// Header located at the beginning of a segment file
+    struct header {
+        static const uint32_t s_version = 0x4c4f4731;   // "LOG1"
+
+        uint32_t                version;
+        uint32_t                header_size;    // Offset of the first record
+        uint64_t                capacity;       // Size of the data area
+        std::atomic<uint64_t>   offset;         // Size of written records
+        char                    pad[UTXX_CL_SIZE - 3*sizeof(uint64_t)];
+    };
+
+private:
+    std::string  m_name;
+    std::string  m_filename;
+    std::string  m_orig_filename;
+    bool         m_append;
+    uint32_t     m_levels;
+    mode_t       m_mode;
+    size_t       m_segment_size;
+    int          m_segments;
+    int          m_first_segment;
+    int          m_segment;
+    bool         m_populate;
+    int          m_fd;
+    header*      m_header;
+    char*        m_data;
+
+    logger_impl_mmap(const char* a_name)
+        : m_name(a_name), m_append(true)
+        , m_levels(LEVEL_NO_DEBUG)
+        , m_mode(0644), m_segment_size(64*1024*1024)
+        , m_segments(0), m_first_segment(1), m_segment(1), m_populate(true)
+        , m_fd(-1), m_header(nullptr), m_data(nullptr)
+    {}
+
+    void finalize();
+
+    /// Find the lowest and the highest index of existing segment files
+    /// (0 if there are none)
+    std::pair<int, int> find_segments() const;
+
+    /// Map segment file m_filename (creating it if needed)
+    void open_segment(bool a_append);
+    /// Unmap a segment and truncate its file to the written size
+    static void close_segment(int a_fd, header* a_header);
+    /// Close current segment and switch to the next one
+    void rotate();
+
+public:
+    static logger_impl_mmap* create(const char* a_name) {
+        return new logger_impl_mmap(a_name);
+    }
+
+    virtual ~logger_impl_mmap() {
+        finalize();
+    }
+
+    const std::string& name() const { return m_name; }
+
+    /// Name of the current segment file
+    const std::string& filename() const { return m_filename; }
+
+    /// Get file name of the given segment number
+    std::string get_file_name(int a_segment) const;
+
+    /// Dump all settings to stream
+    std::ostream& dump(std::ostream& out, const std::string& a_prefix) const;
+
+    bool init(const variant_tree& a_config);
+
+    void log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size);
+
+    /// Read complete records from a segment file (e.g. after a crash)
+    static std::string read_segment(const std::string& a_filename);
+};
+
+} // namespace utxx
@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+/// \file   logger_lanes.hpp
+/// \author Serge Aleynikov
+//------------------------------------------------------------------------------
+/// \brief Per-thread single-producer queues ("lanes") of the logger.
+///
+/// In the lane mode every producing thread enqueues messages to its own
+/// bounded SPSC ring instead of the shared MPSC queue, so that threads
+/// logging at the same time don't contend on a common queue head and
+/// don't allocate a node per message.  The logger's thread sweeps all
+/// lanes and merges pending messages by their timestamp.
+//------------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma  once
+
+#include <atomic>
+#include <string>
+#include <utxx/config.h>
+#include <utxx/compiler_hints.hpp>
+#include <utxx/concurrent_spsc_queue.hpp>
+
+namespace utxx {
+
+/// Action taken by a producer when its lane is full
+enum class lane_overflow {
+    DROP,       ///< Discard the new message
+    BLOCK,      ///< Wait until the logger's thread frees space in the lane
+    OVERWRITE   ///< Discard the oldest pending message of the lane
+};
+
+/// Parse lane overflow policy ("drop", "block", "overwrite").
+/// @return false if the string is not recognized
+inline bool parse_lane_overflow(const std::string& a_str, lane_overflow& a_res)
+{
+    if      (a_str == "drop")      a_res = lane_overflow::DROP;
+    else if (a_str == "block")     a_res = lane_overflow::BLOCK;
+    else if (a_str == "overwrite") a_res = lane_overflow::OVERWRITE;
+    else    return false;
+    return true;
+}
+
+inline const char* to_string(lane_overflow a_policy)
+{
+    switch (a_policy) {
+        case lane_overflow::DROP:      return "drop";
+        case lane_overflow::BLOCK:     return "block";
+        case lane_overflow::OVERWRITE: return "overwrite";
+    }
+    return "undefined";
+}
+
+/// Bounded queue of messages of a single producing thread.
+///
+/// The lane is created on the first message logged by a thread.  When the
+/// thread exits, the lane is marked as orphaned and the logger's thread
+/// deletes it once all pending messages are written.
+///
+/// Since only the logger's thread may remove entries from the queue, the
+/// OVERWRITE policy is implemented cooperatively: a producer finding the
+/// lane full posts an eviction request, and the logger's thread discards
+/// the oldest message (counting it as dropped) instead of writing it.
+template <class T>
+class basic_log_lane {
+    using queue_type = concurrent_spsc_queue<T, 0, spsc_layout::padded>;
+
+    // Producer's state
+    queue_type                          m_queue;
+    lane_overflow                       m_policy;
+    char                                m_pad[UTXX_CL_SIZE];
+    // Shared state
+    std::atomic<uint64_t>               m_dropped;
+    std::atomic<uint32_t>               m_evict;
+    std::atomic<bool>                   m_orphan;
+    basic_log_lane*                     m_next;
+
+public:
+    basic_log_lane(uint32_t a_capacity, lane_overflow a_policy)
+        : m_queue  (a_capacity)
+        , m_policy (a_policy)
+        , m_dropped(0)
+        , m_evict  (0)
+        , m_orphan (false)
+        , m_next   (nullptr)
+    {}
+
+    uint32_t        capacity() const  { return m_queue.capacity();   }
+    lane_overflow   policy()   const  { return m_policy;             }
+    uint64_t        dropped()  const  { return m_dropped.load(std::memory_order_relaxed); }
+    bool            orphan()   const  { return m_orphan.load(std::memory_order_acquire);  }
+
+    basic_log_lane* next()     const  { return m_next;               }
+    void            next(basic_log_lane* a_next) { m_next = a_next;  }
+
+    //--------------------------------------------------------------------------
+    // Producer's interface
+    //--------------------------------------------------------------------------
+
+    /// Set the overflow policy of this lane (called by the owning thread).
+    void policy(lane_overflow a_policy) { m_policy = a_policy; }
+
+    /// Construct a message at the tail of the lane.
+    /// @return false if the lane is full
+    template <class... Args>
+    bool try_push(Args&&... a_args) {
+        return m_queue.push(std::forward<Args>(a_args)...) != nullptr;
+    }
+
+    /// Ask the consumer to discard the oldest pending message.
+    void request_evict() { m_evict.fetch_add(1, std::memory_order_release); }
+
+    /// Account for a message that couldn't be enqueued.
+    void drop() { m_dropped.fetch_add(1, std::memory_order_relaxed); }
+
+    /// Called when the owning thread exits.
+    void release() { m_orphan.store(true, std::memory_order_release); }
+
+    //--------------------------------------------------------------------------
+    // Consumer's interface (logger's thread)
+    //--------------------------------------------------------------------------
+
+    bool     empty() const { return m_queue.empty();      }
+    T*       front()       { return m_queue.peek();       }
+    void     pop()         { m_queue.pop();               }
+
+    /// Number of messages pending in the lane
+    uint32_t count() const {
+        return m_queue.count(queue_type::side_t::consumer);
+    }
+
+    /// Serve eviction requests posted by the producer.
+    /// @return number of discarded messages
+    uint32_t evict() {
+        if (likely(!m_evict.load(std::memory_order_relaxed)))
+            return 0;
+        uint32_t n = m_evict.exchange(0, std::memory_order_acquire), i = 0;
+        for (; i < n && !m_queue.empty(); ++i)
+            m_queue.pop();
+        m_dropped.fetch_add(i, std::memory_order_relaxed);
+        return i;
+    }
+
+    /// @return true if the owning thread exited and all messages are written
+    bool drained() const { return orphan() && m_queue.empty(); }
+};
+
+} // namespace utxx
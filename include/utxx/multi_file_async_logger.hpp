@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/compiler_hints.hpp>
 #include <utxx/time_val.hpp>
 #include <utxx/logger.hpp>
+#include <utxx/wait_strategy.hpp>
 #include <iostream>
 #include <memory>
 #include <atomic>
@@ -164,7 +165,7 @@ private:
     int                                             m_last_version;
     double                                          m_reconnect_sec;
     err_handler                                     m_err_handler;
-    bool                                            m_use_sched_yield;
+    wait_strategy                                   m_wait;
 #ifdef PERF_STATS
     std::atomic<size_t>                             m_stats_enque_spins;
     std::atomic<size_t>                             m_stats_deque_spins;
@@ -330,10 +331,14 @@ public:
     /// Set a callback for reconnecting to stream
     void set_reconnect(file_id& a_id, stream_reconnecter a_reconnector);
 
-    /// Enable usage of sched_yield() instead of usleep() in the logging thread.
-    /// Occasionally when running processing thread on max priority the use of
-    /// sched_yield() can cause system resource starvation.
-    void use_sched_yield(bool a_enable) { m_use_sched_yield = a_enable; }
+    /// Enable usage of sched_yield() for 250us before sleeping in the logging
+    /// thread. Occasionally when running processing thread on max priority
+    /// the use of sched_yield() can cause system resource starvation.
+    void use_sched_yield(bool a_enable) { m_wait.yield_us(a_enable ? 250 : 0); }
+
+    /// Policy of waiting for new messages in the logging thread
+    const wait_strategy& wait_policy() const    { return m_wait; }
+    void wait_policy(const wait_strategy& a)    { m_wait = a;    }
 
     /// Close one log file
     /// @param a_id identifier of the file to be closed. After return the value
@@ -759,7 +764,7 @@ basic_multi_file_async_logger(
     , m_files(a_max_files, nullptr)
     , m_last_version(0)
     , m_reconnect_sec((double)a_reconnect_msec / 1000)
-    , m_use_sched_yield(true)
+    , m_wait(wait_strategy_type::FUTEX, 0, 250)
 #ifdef PERF_STATS
     , m_stats_enque_spins(0)
     , m_stats_deque_spins(0)
@@ -847,24 +852,12 @@ run() {
         UTXX_ASYNC_TRACE(( "Async thread commit result: %d (head: %p, cancel=%s)\n",
             rc, m_head.load(), m_cancel ? "true" : "false" ));
 
-        // CPU-friendly spin for 250us
-        time_val deadline(rel_time(0, 250));
-        while (!m_head.load(std::memory_order_relaxed)) {
-            if (m_cancel.load(std::memory_order_relaxed))
-                goto DONE;
-            if (now_utc() > deadline)
-                break;
-            // When running with maximum priority, occasionally excessive use of
-            // sched_yield may use to system slowdown, so this option is
-            // configurable:
-            if (m_use_sched_yield)
-                sched_yield();
-            else
-                usleep(50);
-        }
+        // Spinning/yielding for new messages is done by m_wait in commit()
+        if (m_cancel.load(std::memory_order_relaxed) &&
+           !m_head.  load(std::memory_order_relaxed))
+            break;
     }
 
-DONE:
     UTXX_ASYNC_TRACE(("Logger loop finished - calling close()\n"));
     internal_close();
     UTXX_ASYNC_DEBUG_TRACE(("Logger notifying all of exiting (%ld) active_files=%d\n",
@@ -1242,18 +1235,15 @@ commit(const struct timespec* tsp)
 {
     UTXX_ASYNC_TRACE(("Committing head: %p\n", m_head.load()));
 
-    int event_val = m_event.value();
-
-    while (!m_cancel.load(std::memory_order_relaxed) &&
-           !m_head.  load(std::memory_order_relaxed)) {
-        #ifdef DEBUG_ASYNC_LOGGER
-        wakeup_result n =
-        #endif
-        m_event.wait(tsp, &event_val);
+    auto ready = [this]() {
+        return m_cancel.load(std::memory_order_relaxed) ||
+               m_head.  load(std::memory_order_relaxed);
+    };
 
+    while (!m_wait.wait(ready, m_event, tsp)) {
         UTXX_ASYNC_DEBUG_TRACE(
-            ("  %s COMMIT awakened (res=%s, val=%d, futex=%d), cancel=%d, head=%p\n",
-             timestamp::to_string().c_str(), to_string(n), event_val, m_event.value(),
+            ("  %s COMMIT timed out (futex=%d), cancel=%d, head=%p\n",
+             timestamp::to_string().c_str(), m_event.value(),
              m_cancel.load(std::memory_order_relaxed), m_head.load())
         );
     }
@@ -0,0 +1,279 @@
+//----------------------------------------------------------------------------
+/// \file   page_backing.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Backing store of memory pages for page allocators.
+///
+/// The pages are carved out of large chunks mapped with mmap(2), which can
+/// be backed by huge pages (MAP_HUGETLB or transparent huge pages), bound
+/// to a NUMA node, locked in memory and prefaulted, so that the memory used
+/// by pools, queues and ring buffers is close to the consuming core and
+/// doesn't incur page faults on the critical path.
+///
+/// Each of these options is a best effort: when huge pages are not
+/// configured, the process lacks the privilege or RLIMIT_MEMLOCK to lock
+/// memory, or the kernel doesn't support NUMA, the backing falls back to
+/// regular pages, and the outcome can be checked with huge_tlb(), locked()
+/// and numa_bound().
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/error.hpp>
+#include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace utxx {
+namespace memory {
+
+/// Use of huge pages by page_backing
+enum class huge_pages {
+    NONE,           ///< Regular pages
+    TRANSPARENT,    ///< Advise the kernel to use transparent huge pages
+    HUGETLB         ///< Pages from the hugetlbfs pool (falls back to TRANSPARENT)
+};
+
+struct page_backing_options {
+    huge_pages huge       = huge_pages::TRANSPARENT;
+    bool       prefault   = true;   ///< Touch the pages when they are mapped
+    bool       lock       = false;  ///< Lock the pages in memory with mlock(2)
+    int        numa_node  = -1;     ///< NUMA node to bind the pages to (-1 - any)
+    size_t     chunk_size = 2*1024*1024;    ///< Size of a mapping
+};
+
+/// Thread-safe pool of memory pages of a fixed size aligned on the page
+/// size.  The pages are mapped in chunks of page_backing_options::chunk_size,
+/// and the freed pages are kept for reuse until the backing is destroyed.
+/// The backing must outlive all allocators using it.
+class page_backing : private boost::noncopyable {
+public:
+    static const size_t s_huge_page_size = 2*1024*1024;
+
+    /// @param a_page_size size of a page (power of 2)
+    explicit page_backing(size_t a_page_size,
+                          const page_backing_options& a_opts = page_backing_options())
+        : m_page_size(a_page_size), m_opts(a_opts), m_free(NULL)
+        , m_free_count(0), m_mapped(0), m_huge_tlb(false), m_locked(false)
+        , m_numa_bound(false)
+    {
+        if (!a_page_size || (a_page_size & (a_page_size-1)))
+            UTXX_THROW_BADARG_ERROR("Page size must be a power of 2: ", a_page_size);
+    }
+
+    ~page_backing() {
+        for (auto& c : m_chunks)
+            unmap(c.first, c.second);
+    }
+
+    size_t page_size()  const { return m_page_size; }
+    size_t mapped()     const { return m_mapped;    }
+    size_t free_pages() const { return m_free_count; }
+
+    /// True if any chunk is backed by pages from the hugetlbfs pool
+    bool   huge_tlb()   const { return m_huge_tlb;   }
+    /// True if all chunks are locked in memory
+    bool   locked()     const { return m_locked;     }
+    /// True if all chunks are bound to the requested NUMA node
+    bool   numa_bound() const { return m_numa_bound; }
+
+    const page_backing_options& options() const { return m_opts; }
+
+    /// Allocate a page of page_size() bytes aligned on page_size()
+    void* allocate() {
+        std::lock_guard<std::mutex> g(m_mutex);
+        if (!m_free)
+            map_chunk(chunk_size(1));
+        return pop();
+    }
+
+    void deallocate(void* a_page) {
+        std::lock_guard<std::mutex> g(m_mutex);
+        push(a_page);
+    }
+
+    /// Map enough memory for \a a_pages pages to avoid mapping (and
+    /// faulting) memory later.
+    void reserve(size_t a_pages) {
+        std::lock_guard<std::mutex> g(m_mutex);
+        if (a_pages > m_free_count)
+            map_chunk(chunk_size(a_pages - m_free_count));
+    }
+
+    /// NUMA node of the CPU the calling thread runs on (-1 if unknown)
+    static int this_numa_node() {
+        #if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu, node;
+        if (::syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+            return node;
+        #endif
+        return -1;
+    }
+
+private:
+    typedef std::pair<void*, size_t> chunk;
+
+    size_t               m_page_size;
+    page_backing_options m_opts;
+    std::mutex           m_mutex;
+    std::vector<chunk>   m_chunks;
+    void*                m_free;        ///< List of free pages linked by their first word
+    size_t               m_free_count;
+    size_t               m_mapped;
+    bool                 m_huge_tlb;
+    bool                 m_locked;
+    bool                 m_numa_bound;
+
+    void push(void* a_page) {
+        *static_cast<void**>(a_page) = m_free;
+        m_free = a_page;
+        ++m_free_count;
+    }
+
+    void* pop() {
+        void* p = m_free;
+        m_free  = *static_cast<void**>(p);
+        --m_free_count;
+        return p;
+    }
+
+    size_t chunk_size(size_t a_pages) const {
+        size_t n = std::max(a_pages * m_page_size, m_opts.chunk_size);
+        size_t align = std::max(m_page_size,
+                                m_opts.huge == huge_pages::NONE ? 1 : s_huge_page_size);
+        return (n + align - 1) & ~(align - 1);
+    }
+
+    static void unmap(void* a_addr, size_t a_size) {
+        #ifdef __linux__
+        ::munmap(a_addr, a_size);
+        #else
+        ::free(a_addr);
+        #endif
+    }
+
+    void map_chunk(size_t a_size) {
+        void* p = map(a_size);
+        m_chunks.push_back(chunk(p, a_size));
+        bool first = m_chunks.size() == 1;
+        m_mapped  += a_size;
+
+        bool bound  = bind(p, a_size);
+        m_numa_bound = (first || m_numa_bound) && bound;
+
+        // Locking a mapping faults in its pages, so prefault only if it failed
+        bool locked = m_opts.lock && ::mlock(p, a_size) == 0;
+        m_locked    = (first || m_locked) && locked;
+        if (m_opts.prefault && !locked)
+            prefault(p, a_size);
+
+        for (size_t off = a_size; off; off -= m_page_size)
+            push(static_cast<char*>(p) + off - m_page_size);
+    }
+
+    void* map(size_t a_size) {
+        #ifdef __linux__
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+        #ifdef MAP_HUGETLB
+        if (m_opts.huge == huge_pages::HUGETLB && m_page_size <= s_huge_page_size) {
+            void* p = ::mmap(NULL, a_size, PROT_READ | PROT_WRITE,
+                             flags | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                m_huge_tlb = true;
+                return p;
+            }
+        }
+        #endif
+
+        // Map an extra alignment worth of memory, and trim the unaligned ends
+        size_t align = std::max(m_page_size, m_opts.huge == huge_pages::NONE
+                                           ? size_t(::getpagesize()) : s_huge_page_size);
+        size_t size  = a_size + align;
+        char*  p     = static_cast<char*>(::mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                                 flags, -1, 0));
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+
+        char* begin = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(p) + align - 1) & ~(align - 1));
+        if (begin != p)
+            ::munmap(p, begin - p);
+        if (begin + a_size != p + size)
+            ::munmap(begin + a_size, p + size - begin - a_size);
+
+        #ifdef MADV_HUGEPAGE
+        if (m_opts.huge != huge_pages::NONE)
+            ::madvise(begin, a_size, MADV_HUGEPAGE);
+        #endif
+        return begin;
+        #else
+        void* p;
+        if (posix_memalign(&p, m_page_size, a_size) != 0)
+            throw std::bad_alloc();
+        return p;
+        #endif
+    }
+
+    /// Bind the memory to the NUMA node before it's faulted in
+    bool bind(void* a_addr, size_t a_size) {
+        if (m_opts.numa_node < 0)
+            return false;
+        #if defined(__linux__) && defined(SYS_mbind)
+        const int      mpol_bind    = 2;        // MPOL_BIND
+        const unsigned mpol_mf_move = 1 << 1;   // MPOL_MF_MOVE
+        const size_t   bits         = 8 * sizeof(unsigned long);
+
+        std::vector<unsigned long> mask(m_opts.numa_node / bits + 1);
+        mask[m_opts.numa_node / bits] = 1ul << (m_opts.numa_node % bits);
+
+        return ::syscall(SYS_mbind, a_addr, a_size, mpol_bind, mask.data(),
+                         mask.size() * bits + 1, mpol_mf_move) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    static void prefault(void* a_addr, size_t a_size) {
+        // Write rather than read, so that the kernel doesn't map the zero page
+        volatile char* p = static_cast<volatile char*>(a_addr);
+        for (size_t i = 0, n = ::getpagesize(); i < a_size; i += n)
+            p[i] = 0;
+    }
+};
+
+} // namespace memory
+} // namespace utxx
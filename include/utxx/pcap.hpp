@@ -532,22 +532,31 @@ struct pcap {
 
     /// @param a_mask is an IP address mask in network byte order.
     bool match_dst_ip(uint32_t a_ip_mask, uint16_t a_port = 0) {
-        uint8_t b = a_ip_mask >> 24 & 0xFF;
         // Note the IP frame's part is identical and port info is also
         // positioned the same in UDP/TCP, so it's irrelevant if we
         // reference udp or tcp in the union:
-        if (b != 0 && (b != (m_frame.u.ip.daddr >> 24 & 0xFF)))
+        return match_dst(m_frame.u.ip.daddr, m_frame.u.udp.dest, a_ip_mask, a_port);
+    }
+
+    /// Match destination address \a a_daddr and port \a a_dport of a packet
+    /// against the IP address mask \a a_ip_mask, in which 0 octets match any
+    /// value, and the port \a a_port (0 matches any port).
+    /// All arguments are in network byte order.
+    static bool match_dst(uint32_t a_daddr,   uint16_t a_dport,
+                          uint32_t a_ip_mask, uint16_t a_port = 0) {
+        uint8_t b = a_ip_mask >> 24 & 0xFF;
+        if (b != 0 && (b != (a_daddr >> 24 & 0xFF)))
             return false;
         b = a_ip_mask >> 16 & 0xFF;
-        if (b != 0 && (b != (m_frame.u.ip.daddr >> 16 & 0xFF)))
+        if (b != 0 && (b != (a_daddr >> 16 & 0xFF)))
             return false;
         b = a_ip_mask >> 8 & 0xFF;
-        if (b != 0 && (b != (m_frame.u.ip.daddr >> 8 & 0xFF)))
+        if (b != 0 && (b != (a_daddr >> 8 & 0xFF)))
             return false;
         b = a_ip_mask & 0xFF;
-        if (b != 0 && (b != (m_frame.u.ip.daddr & 0xFF)))
+        if (b != 0 && (b != (a_daddr & 0xFF)))
             return false;
-        if (a_port != 0 && (a_port != m_frame.u.udp.dest))
+        if (a_port != 0 && (a_port != a_dport))
             return false;
         return true;
     }
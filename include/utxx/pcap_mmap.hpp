@@ -0,0 +1,529 @@
+//----------------------------------------------------------------------------
+/// \file   pcap_mmap.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Zero-copy reader of PCAP files backed by a memory-mapped file.
+///
+/// Packets are iterated in place: a packet view refers to the header and
+/// frame in the mapped file, so nothing is copied.  An optional sidecar
+/// index file (by default "<file>.idx") stores the offset and timestamp of
+/// every packet, which gives O(1) seek by packet number and O(log N) seek
+/// by time.
+/// \code
+///     pcap_mmap f("capture.pcap");
+///     f.index();                          // Load or build the sidecar index
+///     for (auto it = f.seek(time_val(...)); it != f.end(); ++it)
+///         if (auto udp = it->udp())
+///             process(it->ts(), it->payload(), it->payload_size());
+/// \endcode
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iterator>
+#include <utxx/pcap.hpp>
+#include <utxx/scope_exit.hpp>
+
+namespace utxx {
+
+/**
+ * Memory-mapped PCAP file reader
+ */
+class pcap_mmap {
+public:
+    /// View of a packet in the mapped file
+    class packet {
+        friend class pcap_mmap;
+
+        const pcap_mmap*    m_file;
+        const char*         m_begin;    // Packet header in the mapped file
+        pcap::packet_header m_header;   // Packet header in host byte order
+
+        const char* frame() const { return data() + m_file->frame_offset(); }
+
+    public:
+        packet() : m_file(nullptr), m_begin(nullptr), m_header{0,0,0,0} {}
+
+        /// Packet header converted to host byte order
+        const pcap::packet_header& header() const { return m_header; }
+
+        /// Offset of the packet header from the beginning of the file
+        uint64_t    offset()       const { return m_begin - m_file->m_begin;   }
+        /// Captured packet data starting with the link-layer header
+        const char* data()         const { return m_begin + sizeof(pcap::packet_header); }
+        /// Number of captured bytes of the packet
+        size_t      size()         const { return m_header.incl_len;           }
+        /// Offset of the next packet from the beginning of the file
+        uint64_t    next_offset()  const { return offset() + sizeof(pcap::packet_header) + size(); }
+
+        time_val    ts()           const { return nsecs(ts_nsec());            }
+        long        ts_nsec()      const {
+            return m_file->to_nsec(m_header.ts_sec, m_header.ts_usec);
+        }
+
+        /// @return IP frame or nullptr if the packet is too short
+        const pcap::ip_frame* ip() const {
+            return size() < m_file->frame_offset() + sizeof(pcap::ip_frame)
+                 ? nullptr : reinterpret_cast<const pcap::ip_frame*>(frame());
+        }
+
+        pcap::proto protocol() const {
+            auto p = ip();
+            if (!p) return pcap::proto::undefined;
+            switch (p->protocol()) {
+                case IPPROTO_TCP: return pcap::proto::tcp;
+                case IPPROTO_UDP: return pcap::proto::udp;
+                default:          return pcap::proto::other;
+            }
+        }
+
+        /// @return UDP frame or nullptr if this is not a UDP packet
+        const pcap::udp_frame* udp() const {
+            return protocol() == pcap::proto::udp &&
+                   size() >= m_file->frame_offset() + sizeof(pcap::udp_frame)
+                 ? reinterpret_cast<const pcap::udp_frame*>(frame()) : nullptr;
+        }
+
+        /// @return TCP frame or nullptr if this is not a TCP packet
+        const pcap::tcp_frame* tcp() const {
+            return protocol() == pcap::proto::tcp &&
+                   size() >= m_file->frame_offset() + sizeof(pcap::tcp_frame)
+                 ? reinterpret_cast<const pcap::tcp_frame*>(frame()) : nullptr;
+        }
+
+        /// Offset of the transport payload from data(), or size() if the
+        /// packet is neither TCP nor UDP
+        size_t payload_offset() const {
+            size_t n = m_file->frame_offset();
+            if (auto p = udp())
+                n += p->ip.ihl * 4 + sizeof(udphdr);
+            else if (auto p = tcp())
+                n += p->ip.ihl * 4 + p->tcp.doff * 4;
+            else
+                return size();
+            return std::min(n, size());
+        }
+
+        /// Transport payload of a TCP/UDP packet
+        const char* payload()      const { return data() + payload_offset(); }
+        size_t      payload_size() const { return size()  - payload_offset(); }
+
+        /// Destination port in network byte order (0 if the packet is
+        /// neither TCP nor UDP)
+        uint16_t dst_port() const {
+            if (auto p = udp()) return p->udp.dest;
+            if (auto p = tcp()) return p->tcp.dest;
+            return 0;
+        }
+
+        /// @param a_mask is an IP address mask in network byte order, with
+        ///        0 octets matching any value.
+        /// @param a_port is a destination port in network byte order, or 0.
+        /// @see pcap::match_dst()
+        bool match_dst_ip(uint32_t a_ip_mask, uint16_t a_port = 0) const {
+            auto p = ip();
+            return p && pcap::match_dst(p->ip.daddr, dst_port(), a_ip_mask, a_port);
+        }
+    };
+
+    /// Forward iterator over packets of the mapped file
+    class iterator {
+        friend class pcap_mmap;
+
+        packet m_pkt;
+        size_t m_num;
+
+        iterator(const pcap_mmap* a_file, uint64_t a_offset, size_t a_num)
+            : m_num(a_num)
+        {
+            m_pkt.m_file = a_file;
+            m_pkt.m_begin = a_file->m_begin + a_offset;
+            decode();
+        }
+
+        void decode() {
+            if (!m_pkt.m_file->decode(m_pkt.m_begin, m_pkt.m_header))
+                m_pkt.m_begin = m_pkt.m_file->m_end;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = const packet;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const packet*;
+        using reference         = const packet&;
+
+        iterator() : m_num(0) {}
+
+        /// Number of the packet (counting from 0), or the number of packets
+        /// iterated over since the starting point of iteration when
+        /// iteration didn't start at a known packet number
+        size_t          number()     const { return m_num;   }
+
+        const packet&   operator*()  const { return m_pkt;   }
+        const packet*   operator->() const { return &m_pkt; }
+
+        iterator& operator++() {
+            m_pkt.m_begin += sizeof(pcap::packet_header) + m_pkt.size();
+            ++m_num;
+            decode();
+            return *this;
+        }
+        iterator operator++(int) { auto it = *this; ++*this; return it; }
+
+        bool operator==(const iterator& a) const { return m_pkt.m_begin == a.m_pkt.m_begin; }
+        bool operator!=(const iterator& a) const { return m_pkt.m_begin != a.m_pkt.m_begin; }
+    };
+
+    /// Record of the sidecar index file
+    struct index_entry {
+        uint64_t offset;            ///< Offset of the packet header in the file
+        int64_t  ts_nsec;           ///< Packet's timestamp in nanoseconds
+    };
+
+    /// Header of the sidecar index file
+    struct index_header {
+        static constexpr uint64_t s_magic   = 0x5844495041435058ul; // "XPCAPIDX"
+        static const     uint32_t s_version = 1;
+
+        uint64_t magic;
+        uint32_t version;
+        uint32_t entry_size;
+        uint64_t file_size;         ///< Size of the indexed PCAP file
+        uint64_t count;             ///< Number of index entries
+    };
+
+    pcap_mmap() {}
+    explicit pcap_mmap(const std::string& a_filename) { open(a_filename); }
+    ~pcap_mmap() { close(); }
+
+    pcap_mmap(const pcap_mmap&) = delete;
+    pcap_mmap& operator=(const pcap_mmap&) = delete;
+
+    /// Map the PCAP file in memory.
+    /// Throws io_error if the file cannot be mapped, and runtime_error if
+    /// it's not in the PCAP format.
+    void open(const std::string& a_filename) {
+        close();
+
+        auto p = map_file(a_filename, m_size);
+        m_filename = a_filename;
+        m_begin    = static_cast<const char*>(p);
+        m_end      = m_begin + m_size;
+
+        const char* h = m_begin;
+        if (m_parser.read_file_header(h, m_size) < 0) {
+            close();
+            UTXX_THROW_RUNTIME_ERROR("File ", a_filename, " is not in PCAP format!");
+        }
+        m_data_offset = h - m_begin;
+        advise(MADV_SEQUENTIAL);
+    }
+
+    void close() {
+        close_index();
+        if (m_begin)
+            ::munmap(const_cast<char*>(m_begin), m_size);
+        m_begin = m_end = nullptr;
+        m_size  = 0;
+    }
+
+    bool                      is_open()       const { return m_begin != nullptr;  }
+    const std::string&        filename()      const { return m_filename;          }
+    /// Size of the mapped file
+    uint64_t                  size()          const { return m_size;              }
+
+    /// PCAP file header and its properties
+    const pcap::file_header&  header()        const { return m_parser.header();   }
+    pcap::link_type           link_type()     const { return m_parser.get_link_type(); }
+    bool                      big_endian()    const { return m_parser.big_endian(); }
+    bool                      nsec_time()     const { return m_parser.nsec_time();  }
+    size_t                    frame_offset()  const { return m_parser.frame_offset(); }
+
+    /// Mapped content of the file
+    const char*               begin_ptr()     const { return m_begin;             }
+    const char*               end_ptr()       const { return m_end;               }
+
+    /// Give the kernel a paging hint about the access pattern to the file
+    /// (e.g. MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED)
+    void advise(int a_advice, uint64_t a_offset = 0, uint64_t a_len = 0) const {
+        auto page = uint64_t(::sysconf(_SC_PAGESIZE));
+        auto from = a_offset & ~(page-1);
+        auto len  = a_len ? a_len + (a_offset - from) : m_size - from;
+        ::madvise(const_cast<char*>(m_begin) + from, std::min(len, m_size - from), a_advice);
+    }
+
+    iterator begin() const { return iterator(this, m_data_offset, 0); }
+    iterator end()   const { return iterator(this, m_size, count_or_zero()); }
+
+    /// Iterator pointing to a packet header at \a a_offset from the
+    /// beginning of the file (e.g. obtained by packet::offset())
+    /// @param a_num number assigned to the packet at \a a_offset
+    iterator at(uint64_t a_offset, size_t a_num = 0) const {
+        if (a_offset < m_data_offset || a_offset > m_size)
+            UTXX_THROW_BADARG_ERROR("Invalid packet offset ", a_offset,
+                                    " in file ", m_filename);
+        return iterator(this, a_offset, a_num);
+    }
+
+    /// Position at the packet number \a a_num (counting from 0).
+    /// The complexity is O(1) if the index is loaded, and O(N) otherwise.
+    iterator seek(size_t a_num) const {
+        if (m_index)
+            return a_num < m_index_hdr->count
+                 ? iterator(this, m_index[a_num].offset, a_num) : end();
+        auto it = begin();
+        for (auto e = end(); it != e && it.number() < a_num; ++it);
+        return it;
+    }
+
+    /// Position at the first packet with the timestamp not less than \a a_ts.
+    /// The complexity is O(log N) if the index is loaded, and O(N) otherwise.
+    /// NOTE: the binary search assumes that packets are sorted by time.
+    iterator seek(time_val a_ts) const {
+        long ts = a_ts.nanoseconds();
+        if (m_index) {
+            auto e  = m_index + m_index_hdr->count;
+            auto it = std::lower_bound(m_index, e, ts,
+                        [](const index_entry& a, long b) { return a.ts_nsec < b; });
+            return it == e ? end() : iterator(this, it->offset, it - m_index);
+        }
+        auto it = begin();
+        for (auto e = end(); it != e && it->ts_nsec() < ts; ++it);
+        return it;
+    }
+
+    /// Position at the first packet starting at or after \a a_offset from
+    /// the beginning of the file (e.g. to split the file in chunks processed
+    /// in parallel).
+    /// With the index the packet is found by binary search.  Otherwise the
+    /// file is scanned for the first position, at which a chain of
+    /// \a a_depth plausible packet headers starts (this is a heuristic,
+    /// since packet headers have no signature), and the iterator's number()
+    /// is 0.
+    iterator sync(uint64_t a_offset, int a_depth = 8) const {
+        if (a_offset <= m_data_offset)
+            return begin();
+        if (a_offset >= m_size)
+            return end();
+        if (m_index) {
+            auto e  = m_index + m_index_hdr->count;
+            auto it = std::lower_bound(m_index, e, a_offset,
+                        [](const index_entry& a, uint64_t b) { return a.offset < b; });
+            return it == e ? end() : iterator(this, it->offset, it - m_index);
+        }
+        for (auto p = m_begin + a_offset; p < m_end; ++p)
+            if (is_packet_chain(p, a_depth))
+                return iterator(this, p - m_begin, 0);
+        return end();
+    }
+
+    //--------------------------------------------------------------------------
+    // Sidecar index
+    //--------------------------------------------------------------------------
+
+    /// Default name of the sidecar index file
+    std::string index_filename() const { return m_filename + ".idx"; }
+
+    bool                has_index()   const { return m_index != nullptr; }
+    /// Index entries (valid only if has_index() is true)
+    const index_entry*  index_data()  const { return m_index; }
+
+    /// Number of packets in the file.
+    /// The complexity is O(1) if the index is loaded, and O(N) otherwise.
+    size_t count() const {
+        if (m_index) return m_index_hdr->count;
+        size_t n = 0;
+        for (auto it = begin(), e = end(); it != e; ++it, ++n);
+        return n;
+    }
+
+    /// Load the index if it exists and is up to date, or build it otherwise
+    /// @param a_rebuild force building the index
+    void index(bool a_rebuild = false, const std::string& a_idx_file = "") {
+        if (a_rebuild || !load_index(a_idx_file))
+            build_index(a_idx_file);
+    }
+
+    /// Map an existing index file.
+    /// @return false if the index doesn't exist or doesn't match the file
+    bool load_index(const std::string& a_idx_file = "") {
+        close_index();
+        auto file = a_idx_file.empty() ? index_filename() : a_idx_file;
+        if (::access(file.c_str(), R_OK) < 0)
+            return false;
+
+        uint64_t sz;
+        auto p   = map_file(file, sz);
+        auto hdr = static_cast<const index_header*>(p);
+        bool ok  = sz >= sizeof(index_header)
+                && hdr->magic      == index_header::s_magic
+                && hdr->version    == index_header::s_version
+                && hdr->entry_size == sizeof(index_entry)
+                && hdr->file_size  == m_size
+                && sz >= sizeof(index_header) + hdr->count * sizeof(index_entry);
+        if (!ok) {
+            ::munmap(p, sz);
+            return false;
+        }
+        m_index_hdr  = hdr;
+        m_index_size = sz;
+        m_index      = reinterpret_cast<const index_entry*>(hdr + 1);
+        return true;
+    }
+
+    /// Scan the file and save the offset and timestamp of every packet to
+    /// the index file, then load the index
+    void build_index(const std::string& a_idx_file = "") {
+        close_index();
+        auto file = a_idx_file.empty() ? index_filename() : a_idx_file;
+        auto tmp  = file + ".tmp";
+        auto f    = ::fopen(tmp.c_str(), "wb");
+        if (!f)
+            UTXX_THROW_IO_ERROR(errno, "Error creating index file ", tmp);
+
+        scope_exit guard([f, &tmp]() { ::fclose(f); ::unlink(tmp.c_str()); });
+
+        index_header hdr{index_header::s_magic, index_header::s_version,
+                         sizeof(index_entry), m_size, 0};
+        bool ok = ::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+
+        for (auto it = begin(), e = end(); ok && it != e; ++it, ++hdr.count) {
+            index_entry rec{it->offset(), it->ts_nsec()};
+            ok = ::fwrite(&rec, sizeof(rec), 1, f) == 1;
+        }
+
+        ok = ok && ::fseek(f, 0, SEEK_SET) == 0
+                && ::fwrite(&hdr, sizeof(hdr), 1, f) == 1
+                && ::fflush(f) == 0;
+        if (!ok)
+            UTXX_THROW_IO_ERROR(errno, "Error writing index file ", tmp);
+
+        guard.disable();
+        ::fclose(f);
+
+        if (::rename(tmp.c_str(), file.c_str()) < 0) {
+            int err = errno;
+            ::unlink(tmp.c_str());
+            UTXX_THROW_IO_ERROR(err, "Error renaming index file ", tmp, " to ", file);
+        }
+
+        if (!load_index(file))
+            UTXX_THROW_RUNTIME_ERROR("Invalid index file ", file);
+    }
+
+    void close_index() {
+        if (m_index_hdr)
+            ::munmap(const_cast<index_header*>(m_index_hdr), m_index_size);
+        m_index_hdr  = nullptr;
+        m_index      = nullptr;
+        m_index_size = 0;
+    }
+
+private:
+    std::string         m_filename;
+    const char*         m_begin       = nullptr;
+    const char*         m_end         = nullptr;
+    uint64_t            m_size        = 0;
+    uint64_t            m_data_offset = 0;
+    pcap                m_parser;       // Holds the decoded file header
+    const index_header* m_index_hdr   = nullptr;
+    const index_entry*  m_index       = nullptr;
+    uint64_t            m_index_size  = 0;
+
+    static void* map_file(const std::string& a_filename, uint64_t& a_size) {
+        int fd = ::open(a_filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error opening file ", a_filename);
+
+        scope_exit fd_guard([fd]() { ::close(fd); });
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0)
+            UTXX_THROW_IO_ERROR(errno, "Error reading file size: ", a_filename);
+        if (st.st_size == 0)
+            UTXX_THROW_RUNTIME_ERROR("File ", a_filename, " is empty!");
+
+        a_size = st.st_size;
+        auto p = ::mmap(nullptr, a_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            UTXX_THROW_IO_ERROR(errno, "Error mapping file ", a_filename);
+        return p;
+    }
+
+    /// Check if \a a_p points to a chain of \a a_depth plausible packet
+    /// headers (or to fewer headers ending exactly at the end of file)
+    bool is_packet_chain(const char* a_p, int a_depth) const {
+        auto snaplen  = std::max<uint32_t>(header().snaplen, 256*1024);
+        auto max_frac = nsec_time() ? 1000000000u : 1000000u;
+        pcap::packet_header hdr, prev;
+        for (int i=0; i < a_depth; ++i) {
+            if (a_p == m_end)
+                return i > 0;
+            if (!decode(a_p, hdr)          ||
+                hdr.incl_len > snaplen     ||
+                hdr.incl_len > hdr.orig_len||
+                hdr.ts_usec  >= max_frac   ||
+                (i && (hdr.ts_sec > prev.ts_sec + 3600 ||
+                       prev.ts_sec > hdr.ts_sec + 3600)))
+                return false;
+            prev = hdr;
+            a_p += sizeof(pcap::packet_header) + hdr.incl_len;
+        }
+        return true;
+    }
+
+    size_t count_or_zero() const { return m_index ? m_index_hdr->count : 0; }
+
+    long to_nsec(uint32_t a_sec, uint32_t a_frac) const {
+        return long(a_sec) * 1000000000L + (nsec_time() ? a_frac : a_frac * 1000L);
+    }
+
+    /// Decode the packet header at \a a_p.
+    /// @return false if there's no complete packet at \a a_p
+    bool decode(const char* a_p, pcap::packet_header& a_hdr) const {
+        if (unlikely(size_t(m_end - a_p) < sizeof(pcap::packet_header)))
+            return false;
+        a_hdr = *reinterpret_cast<const pcap::packet_header*>(a_p);
+        if (big_endian()) {
+            a_hdr.ts_sec   = ntohl(a_hdr.ts_sec);
+            a_hdr.ts_usec  = ntohl(a_hdr.ts_usec);
+            a_hdr.incl_len = ntohl(a_hdr.incl_len);
+            a_hdr.orig_len = ntohl(a_hdr.orig_len);
+        }
+        // Truncated last packet is not returned
+        return size_t(m_end - a_p) - sizeof(pcap::packet_header) >= a_hdr.incl_len;
+    }
+};
+
+} // namespace utxx
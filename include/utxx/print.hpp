@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <type_traits>
 #include <cstdarg>
 #include <iomanip>
+#include <tuple>
 #include <utxx/scope_exit.hpp>
 #include <utxx/compiler_hints.hpp>
 #include <utxx/convert.hpp>
@@ -62,7 +63,9 @@ private:
 };
 
 //------------------------------------------------------------------------------
-/// Output a float to stream formatted with fixed precision
+/// Output a float to stream formatted with fixed precision.
+/// Negative precision selects the shortest number of decimals that converts
+/// back to the same value (e.g. 123.45 rather than 123.450000).
 //------------------------------------------------------------------------------
 struct fixed {
     fixed(double a_val, int a_digits, int a_precision, char a_fill = ' ')
@@ -82,7 +85,7 @@ struct fixed {
             utxx::ftoa_right(a.value(), buf, a.digits(), a.precision(), a.fill());
             out.write(buf, a.digits());
         } else {
-            char buf[256];
+            char buf[detail::FTOA::FIXED_SIZE + 64];
             int n = utxx::ftoa_left(a.value(), buf, sizeof(buf), a.precision(), true);
             if (likely(n >= 0))
                 out.write(buf, n);
@@ -229,6 +232,205 @@ private:
 template <int Width, alignment Align, typename T>
 width<Width,Align,T> make_width(T a, char a_pad = ' ') { return width<Width, Align, T>(a, a_pad); }
 
+//------------------------------------------------------------------------------
+/// Compile-time format strings
+//------------------------------------------------------------------------------
+namespace detail {
+    /// Replacement field of a format string:
+    /// "{[:[[fill]align][0][width][.precision][type]]}" or "{:stamp}"
+    struct fmt_spec {
+        char fill;      // Padding char
+        char align;     // '<', '>' or '\0' (default alignment)
+        bool zero;      // Pad a number with zeros after its sign
+        int  width;     // Field width (0 - not set)
+        int  precision; // Number of decimals (-1 - not set)
+        char type;      // 'd', 'f', 's', '\0' (not set) or '?' (invalid spec)
+        int  stamp;     // utxx::stamp_type of a timestamp (-1 - not set)
+    };
+
+    /// Result of scanning the format string for the next replacement field
+    struct fmt_token {
+        int  text_end;  // End of literal text preceding the field
+        int  next;      // Position past the field (-1 on error)
+        bool field;     // True if there is a replacement field at text_end
+    };
+
+    /// Names of timestamp specs in the order of utxx::stamp_type values
+    constexpr const char* fmt_stamp_name(int a_idx) {
+        constexpr const char* s_names[] = {
+            "none", "date", "date-time", "date-time-msec", "date-time-usec",
+            "date-time-nsec", "time", "time-msec", "time-usec", "time-nsec"
+        };
+        return s_names[a_idx];
+    }
+
+    constexpr bool fmt_equal(const char* a_fmt, int a_begin, int a_end,
+                             const char* a_str) {
+        for (; a_begin < a_end; ++a_begin, ++a_str)
+            if (*a_str != a_fmt[a_begin]) return false;
+        return *a_str == '\0';
+    }
+
+    constexpr bool fmt_digit(char c) { return c >= '0' && c <= '9'; }
+    constexpr bool fmt_align(char c) { return c == '<' || c == '>'; }
+
+    /// Position of '}' closing the field that starts at \a a_pos, or -1
+    constexpr int fmt_field_end(const char* a_fmt, int a_pos) {
+        for (int i = a_pos+1; a_fmt[i]; ++i)
+            if      (a_fmt[i] == '}') return i;
+            else if (a_fmt[i] == '{') return -1;
+        return -1;
+    }
+
+    /// Parse the replacement field that starts at \a a_pos
+    constexpr fmt_spec fmt_parse_spec(const char* a_fmt, int a_pos) {
+        fmt_spec r{' ', '\0', false, 0, -1, '\0', -1};
+        int e = fmt_field_end(a_fmt, a_pos);
+        int i = a_pos+1;
+        if (i == e)
+            return r;
+        if (e < 0 || a_fmt[i++] != ':') {
+            r.type = '?';
+            return r;
+        }
+        for (int k = 1; k < 10; ++k)
+            if (fmt_equal(a_fmt, i, e, fmt_stamp_name(k))) {
+                r.stamp = k;
+                return r;
+            }
+        if (i+1 < e && fmt_align(a_fmt[i+1])) {
+            r.fill  = a_fmt[i++];
+            r.align = a_fmt[i++];
+        } else if (i < e && fmt_align(a_fmt[i]))
+            r.align = a_fmt[i++];
+        else if (i+1 < e && a_fmt[i] == '0' && fmt_digit(a_fmt[i+1])) {
+            r.fill  = '0';
+            r.align = '>';
+            r.zero  = true;
+            ++i;
+        }
+        for (; i < e && fmt_digit(a_fmt[i]); ++i)
+            r.width = r.width*10 + (a_fmt[i] - '0');
+        if (i < e && a_fmt[i] == '.') {
+            if (++i == e || !fmt_digit(a_fmt[i])) {
+                r.type = '?';
+                return r;
+            }
+            for (r.precision = 0; i < e && fmt_digit(a_fmt[i]); ++i)
+                r.precision = r.precision*10 + (a_fmt[i] - '0');
+        }
+        if (i < e && (a_fmt[i] == 'd' || a_fmt[i] == 'f' || a_fmt[i] == 's'))
+            r.type = a_fmt[i++];
+        if (i != e || (r.align && !r.width))
+            r.type = '?';
+        return r;
+    }
+
+    /// Scan literal text starting at \a a_pos up to the next replacement
+    /// field or the end of string.  Escaped "{{" and "}}" end the text
+    /// after the first brace.
+    constexpr fmt_token fmt_next(const char* a_fmt, int a_pos) {
+        int i = a_pos;
+        for (; a_fmt[i]; ++i) {
+            char c = a_fmt[i];
+            if (c != '{' && c != '}')
+                continue;
+            if (a_fmt[i+1] == c)
+                return fmt_token{i+1, i+2, false};
+            if (c == '}')
+                return fmt_token{i, -1, false};
+            int e = fmt_field_end(a_fmt, i);
+            return fmt_token{i, e < 0 ? -1 : e+1, true};
+        }
+        return fmt_token{i, i, false};
+    }
+
+    /// Number of replacement fields in \a a_fmt, or -1 if it's malformed
+    constexpr int fmt_count(const char* a_fmt) {
+        int n = 0;
+        for (int i = 0; a_fmt[i];) {
+            auto t = fmt_next(a_fmt, i);
+            if (t.next < 0)
+                return -1;
+            if (t.field) {
+                if (fmt_parse_spec(a_fmt, t.text_end).type == '?')
+                    return -1;
+                ++n;
+            }
+            i = t.next;
+        }
+        return n;
+    }
+} // namespace detail
+
+/// Arguments bound to a compile-time format string (see UTXX_FMT).
+/// Lvalue arguments are held by reference, rvalues by value, so an instance
+/// must not outlive the expression that creates it (e.g. it must not be
+/// passed to logger::async_logs()).
+template <class Fmt, class... Args>
+struct formatted {
+    std::tuple<Args...> args;
+};
+
+template <class T>
+struct is_formatted : std::false_type {};
+
+template <class Fmt, class... Args>
+struct is_formatted<formatted<Fmt, Args...>> : std::true_type {};
+
+/// True if any of Args is formatted<...>
+template <class... Args>
+struct any_formatted : std::false_type {};
+
+template <class T, class... Args>
+struct any_formatted<T, Args...> : std::integral_constant<bool,
+    is_formatted<typename std::decay<T>::type>::value ||
+    any_formatted<Args...>::value> {};
+
+template <class Fmt, class... Args>
+formatted<Fmt, Args...> make_formatted(Fmt, Args&&... a_args) {
+    static_assert(detail::fmt_count(Fmt::str()) >= 0,
+                  "Invalid format string");
+    static_assert(detail::fmt_count(Fmt::str()) == int(sizeof...(Args)),
+                  "Number of arguments doesn't match the format string");
+    return formatted<Fmt, Args...>{
+        std::tuple<Args...>(std::forward<Args>(a_args)...)};
+}
+
+//------------------------------------------------------------------------------
+/// Format arguments using a format string parsed and validated at compile time.
+/// The result is printed by basic_buffered_print (and therefore by print(),
+/// to_string() and logger::logs()) with no parsing at run time:
+/// \code
+///   auto s = utxx::to_string(UTXX_FMT("{} {:<6}|{:>8.2f}|{:time-usec}",
+///                                     "px", "IBM", 12.345, now));
+/// \endcode
+/// The format string must be a string literal with "{}" replacement fields
+/// ("{{" and "}}" are escaped braces) in the form
+/// "{[:[[fill]align][0][width][.precision][type]]}":
+///   - fill:      padding char (default ' ');
+///   - align:     '<' (default for strings) or '>' (default for numbers);
+///   - 0:         pad a number with zeros after its sign (as printf("%05d"));
+///   - width:     minimum field width: a shorter value is padded, and a
+///                longer one is written in full;
+///   - precision: decimals of a floating point number (see fixed);
+///   - type:      'd' (integer), 'f' (floating point), or 's' (other).
+/// A time_val argument can be formatted in UTC by the name of stamp_type
+/// (e.g. "{:date-time-msec}", "{:time-usec}").  A field without a spec
+/// prints the argument same as basic_buffered_print::print().
+///
+/// Lvalue arguments are bound by reference, so the result must be printed
+/// before they go out of scope.  In particular, it must not be passed to
+/// logger::async_logs(), which formats its arguments later in another thread.
+//------------------------------------------------------------------------------
+#define UTXX_FMT(Fmt, ...)                                                  \
+    utxx::make_formatted([] {                                               \
+        struct fmt_string {                                                 \
+            static constexpr const char* str() { return Fmt; }              \
+        };                                                                  \
+        return fmt_string();                                                \
+    }(), ##__VA_ARGS__)
+
 //------------------------------------------------------------------------------
 /// Efficient fast printer stream
 //------------------------------------------------------------------------------
@@ -263,37 +465,34 @@ namespace detail {
         }
         void do_print(uint64_t a) {
             reserve(32);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_uint(m_pos, a);
         }
         void do_print(long a) {
             reserve(32);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_int (m_pos, a);
         }
         void do_print(uint32_t a) {
             reserve(16);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_uint(m_pos, a);
         }
         void do_print(int a) {
             reserve(16);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_int (m_pos, a);
         }
         void do_print(uint16_t a) {
             reserve(8);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_uint(m_pos, a);
         }
         void do_print(int16_t a) {
             reserve(8);
-            itoa(a, out(m_pos));
+            m_pos = detail::write_int (m_pos, a);
         }
         void do_print(double a)
         {
             int n = ftoa_left(a, m_pos, capacity(), m_precision, true);
             if (unlikely(n < 0)) {
-                n = snprintf(m_pos, capacity(), "%.*f", m_precision, a);
-                if (unlikely(m_pos + n > m_end)) {
-                    reserve(n);
-                    snprintf(m_pos, capacity(), "%.*f", m_precision, a);
-                }
+                reserve(detail::FTOA::FIXED_SIZE + std::max(m_precision, 0) + 1);
+                n = ftoa_left(a, m_pos, capacity(), m_precision, true);
             }
             m_pos += n;
         }
@@ -304,8 +503,11 @@ namespace detail {
                 m_pos += a.digits();
             } else {
                 int n = ftoa_left(a.value(), m_pos, capacity(), a.precision(), true);
-                if (likely(n >= 0))
-                    m_pos += n;
+                if (unlikely(n < 0)) {
+                    reserve(detail::FTOA::FIXED_SIZE + std::max(a.precision(), 0) + 1);
+                    n = ftoa_left(a.value(), m_pos, capacity(), a.precision(), true);
+                }
+                m_pos += n;
             }
         }
         template <int Width, alignment Align, class T>
@@ -382,6 +584,145 @@ namespace detail {
             std::stringstream s; s << a;
             print(s.str());
         }
+        template <class Fmt, class... Args>
+        void do_print(const formatted<Fmt, Args...>& a) {
+            do_format<Fmt, 0, 0>(a.args, fmt_at_end<Fmt, 0>());
+        }
+
+        //----------------------------------------------------------------------
+        // Compile-time format strings (see UTXX_FMT).  The format string is
+        // unrolled by recursion over (position, argument index), so that
+        // literal text is copied with constant sizes and every field calls
+        // its printer directly.
+        //----------------------------------------------------------------------
+        enum fmt_kind { FMT_PRINT, FMT_STAMP, FMT_FIXED, FMT_WIDTH };
+
+        template <class Fmt, int Pos>
+        using fmt_at_end = std::integral_constant<bool, Fmt::str()[Pos] == '\0'>;
+
+        template <class Fmt, int Pos, int I, class Tuple>
+        void do_format(const Tuple&, std::true_type) {}
+
+        template <class Fmt, int Pos, int I, class Tuple>
+        void do_format(const Tuple& a_args, std::false_type) {
+            constexpr auto t = detail::fmt_next(Fmt::str(), Pos);
+            if (t.text_end > Pos)
+                sprint(Fmt::str() + Pos, t.text_end - Pos);
+            do_format_field<Fmt, t.text_end, I>
+                (a_args, std::integral_constant<bool, t.field>());
+            do_format<Fmt, t.next, I + t.field>(a_args, fmt_at_end<Fmt, t.next>());
+        }
+
+        template <class Fmt, int Pos, int I, class Tuple>
+        void do_format_field(const Tuple&, std::false_type) {}
+
+        template <class Fmt, int Pos, int I, class Tuple>
+        void do_format_field(const Tuple& a_args, std::true_type) {
+            constexpr auto s = detail::fmt_parse_spec(Fmt::str(), Pos);
+            using T = typename std::decay<decltype(std::get<I>(a_args))>::type;
+            static_assert(s.type != 'd' || std::is_integral<T>::value,
+                          "Format type 'd' requires an integer argument");
+            static_assert(s.type != 'f' || std::is_arithmetic<T>::value,
+                          "Format type 'f' requires a numeric argument");
+            static_assert(s.type != 's' || !std::is_arithmetic<T>::value,
+                          "Format type 's' requires a non-numeric argument");
+            constexpr fmt_kind kind =
+                s.stamp >= 0                          ? FMT_STAMP :
+                s.type == 'f' || s.precision >= 0     ? FMT_FIXED :
+                s.width > 0                           ? FMT_WIDTH : FMT_PRINT;
+            constexpr alignment align =
+                s.align == '<' ? LEFT  :
+                s.align == '>' ? RIGHT :
+                std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+                !std::is_same<T, char>::value ? RIGHT : LEFT;
+            do_format_arg<s.width, align, s.zero, s.precision, s.stamp>
+                (std::get<I>(a_args), s.fill, std::integral_constant<fmt_kind, kind>());
+        }
+
+        template <int W, alignment A, bool Zero, int Prec, int Stamp, class T>
+        void do_format_arg(const T& a, char, std::integral_constant<fmt_kind, FMT_PRINT>) {
+            print(a);
+        }
+
+        template <int W, alignment A, bool Zero, int Prec, int Stamp, class T>
+        void do_format_arg(const T& a, char, std::integral_constant<fmt_kind, FMT_STAMP>) {
+            // Found by ADL (e.g. fmt_write_stamp(char*, const time_val&, int))
+            reserve(40);
+            m_pos = fmt_write_stamp(m_pos, a, Stamp);
+        }
+
+        template <int W, alignment A, bool Zero, int Prec, int Stamp, class T>
+        void do_format_arg(const T& a, char a_fill, std::integral_constant<fmt_kind, FMT_FIXED>) {
+            static_assert(std::is_arithmetic<T>::value,
+                          "Precision requires a numeric argument");
+            // Unlike fixed, keep trailing zeros as printf("%.*f") does
+            auto start = size();
+            do_format_double(double(a), Prec < 0 ? 6 : Prec, false);
+            do_format_pad<W, A, Zero>(start, a_fill);
+        }
+
+        template <int W, alignment A, bool Zero, int Prec, int Stamp, class T>
+        void do_format_arg(const T& a, char a_fill, std::integral_constant<fmt_kind, FMT_WIDTH>) {
+            auto start = size();
+            do_format_value(a);
+            do_format_pad<W, A, Zero>(start, a_fill);
+        }
+
+        template <class T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type
+        do_format_value(T a) { do_format_double(a, -1, true); }
+
+        template <class T>
+        using fmt_is_int = std::integral_constant<bool,
+            std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+            !std::is_same<T, char>::value>;
+
+        template <class T>
+        typename std::enable_if<fmt_is_int<T>::value>::type
+        do_format_value(T a) {
+            // Print (u)int8_t as a number rather than a char
+            using U = typename std::conditional<std::is_signed<T>::value, long, ulong>::type;
+            do_print(U(a));
+        }
+
+        template <class T>
+        typename std::enable_if<!std::is_floating_point<T>::value &&
+                                !fmt_is_int<T>::value>::type
+        do_format_value(const T& a) { print(a); }
+
+        /// Write \a a with given precision (negative - the shortest decimals
+        /// that convert back to the same value)
+        void do_format_double(double a, int a_precision, bool a_compact) {
+            int n = ftoa_left(a, m_pos, capacity(), a_precision, a_compact);
+            if (unlikely(n < 0)) {
+                reserve(2*detail::FTOA::FIXED_SIZE + std::max(a_precision, 0) + 1);
+                n = ftoa_left(a, m_pos, capacity(), a_precision, a_compact);
+            }
+            m_pos += n;
+        }
+
+        /// Pad the field written starting at offset \a a_start to at least
+        /// W chars.  Zero padding goes after the sign of a number.
+        template <int W, alignment A, bool Zero>
+        void do_format_pad(size_t a_start, char a_fill) {
+            size_t n = size() - a_start;
+            if (W <= 0 || n >= size_t(W))
+                return;
+            size_t pad = W - n;
+            reserve(pad);
+            char* p = m_begin + a_start;
+            if (A == LEFT)
+                memset(m_pos, a_fill, pad);
+            else {
+                if (Zero && n > 0 && (*p == '-' || *p == '+')) {
+                    ++p;
+                    --n;
+                }
+                memmove(p + pad, p, n);
+                memset(p, a_fill, pad);
+            }
+            m_pos += pad;
+        }
     public:
         explicit basic_buffered_print(const Alloc& a_alloc = Alloc())
             : Alloc(a_alloc)
@@ -418,7 +759,8 @@ namespace detail {
 
         /// Max depth of src_info scope printed
         void        max_src_scope(int a) { m_max_src_scope = a; }
-        /// Precision of floating point (default: 6)
+        /// Precision of floating point (default: 6).  Negative precision
+        /// prints the shortest decimals that convert back to the same value
         void        precision    (int a) { m_precision     = a; }
 
         /// Reserve space in the buffer to hold additional \a a_sz bytes
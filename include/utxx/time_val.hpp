@@ -460,6 +460,8 @@ namespace utxx {
         char* write(char* a_buf, stamp_type a_tp,
                     char a_ddelim = '\0', char a_tdelim = ':', char a_ssep = '.') const {
             auto pair = split();
+            if (a_tp == DATE)
+                return write_date(pair.first, a_buf, a_ddelim ? 10 : 8, a_ddelim);
             auto p = ((a_tp > NO_TIMESTAMP) && (a_tp < TIME))
                    ? std::make_pair(write_date(pair.first, a_buf, 0, a_ddelim),stamp_type(a_tp+4))
                    : std::make_pair(a_buf, a_tp);
@@ -570,6 +572,12 @@ namespace utxx {
     /// Same as gettimeofday() call
     inline time_val now_utc() { return time_val::universal_time(); }
 
+    /// Write UTC timestamp of \a a_tv formatted as stamp_type \a a_tp.
+    /// This is the writer of "{:date-time-usec}"-like fields of UTXX_FMT().
+    inline char* fmt_write_stamp(char* a_buf, const time_val& a_tv, int a_tp) {
+        return a_tv.write(a_buf, stamp_type(a_tp));
+    }
+
     /// Convert time_val to boost::posix_time::ptime
     inline boost::posix_time::ptime
     to_ptime (time_val a_tv) {
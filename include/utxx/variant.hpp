@@ -42,6 +42,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <boost/static_assert.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/property_tree/detail/info_parser_utils.hpp>
+#include <utxx/convert.hpp>
 #include <stdexcept>
 #include <string.h>
 #include <stdio.h>
@@ -233,7 +234,7 @@ public:
             case TYPE_NULL:     *this = null(); break;
             case TYPE_BOOL:     *this = a == "true" || a == "yes";      break;
             case TYPE_INT:      *this = boost::lexical_cast<long>(a);   break;
-            case TYPE_DOUBLE:   *this = boost::lexical_cast<double>(a); break;
+            case TYPE_DOUBLE:   *this = parse_double(a);                break;
             case TYPE_STRING:   *this = a;
             default:            throw_type_error(type());
         }
@@ -281,6 +282,15 @@ public:
     }
 
 private:
+    /// Parse a double using the fast parser, and fall back to lexical_cast
+    /// for what it doesn't accept (e.g. "nan") and for error reporting
+    static double parse_double(const std::string& a) {
+        double d;
+        auto   end = a.c_str() + a.size();
+        return !a.empty() && a[0] != ' ' && atof(a.c_str(), end, d) == end
+             ? d : boost::lexical_cast<double>(a);
+    }
+
     static void throw_type_error(value_type v) {
         std::stringstream s;
         s << "Unknown type " << v;
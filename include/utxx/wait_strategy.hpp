@@ -0,0 +1,282 @@
+//----------------------------------------------------------------------------
+/// \file   wait_strategy.hpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Configurable policy of waiting for a condition set by another thread.
+///
+/// A consumer thread that runs out of work (e.g. the logger's thread or a
+/// reader of a blocking fifo) waits in up to three phases:
+///   1. spin on the condition, calling cpu_relax() between checks;
+///   2. call sched_yield() between checks;
+///   3. park on an event (futex) until the producer signals it, or sleep
+///      with an exponential backoff.
+/// The wait_strategy_type tells which of the phases is final, and the
+/// durations of the first two phases are configurable, so that
+/// latency-critical deployments can trade a burned core for the wakeup
+/// latency without changing the code.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <utxx/futex.hpp>
+#include <sched.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace utxx {
+
+/// Tell the CPU that the calling thread is in a spin-wait loop.
+/// On x86 this is the PAUSE instruction, which saves power and avoids the
+/// memory order violation penalty on exit from the loop.
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+/// Final phase of waiting for a condition
+enum class wait_strategy_type {
+    BUSY_SPIN,  ///< Spin on the condition with cpu_relax() (burns a core)
+    YIELD,      ///< Call sched_yield() between checks of the condition
+    FUTEX,      ///< Park the thread on the event until it's signaled
+    BACKOFF     ///< Sleep between checks, doubling the interval each time
+};
+
+/// Parse wait strategy type ("spin", "yield", "futex", "backoff").
+/// @return false if the string is not recognized
+inline bool parse_wait_strategy(const std::string& a_str, wait_strategy_type& a_res)
+{
+    if      (a_str == "spin")    a_res = wait_strategy_type::BUSY_SPIN;
+    else if (a_str == "yield")   a_res = wait_strategy_type::YIELD;
+    else if (a_str == "futex")   a_res = wait_strategy_type::FUTEX;
+    else if (a_str == "backoff") a_res = wait_strategy_type::BACKOFF;
+    else    return false;
+    return true;
+}
+
+inline const char* to_string(wait_strategy_type a_type)
+{
+    switch (a_type) {
+        case wait_strategy_type::BUSY_SPIN: return "spin";
+        case wait_strategy_type::YIELD:     return "yield";
+        case wait_strategy_type::FUTEX:     return "futex";
+        case wait_strategy_type::BACKOFF:   return "backoff";
+    }
+    return "undefined";
+}
+
+/// Policy of waiting for a condition set by another thread.
+///
+/// The waiting side calls wait() with a condition check, and the event that
+/// the signaling side notifies (futex::signal() or futex_event::notify())
+/// after making the condition true.  Only the FUTEX strategy parks on the
+/// event, other strategies merely poll the condition, so that the producers'
+/// signal() calls stay free of system calls.
+class wait_strategy {
+    wait_strategy_type m_type;
+    long               m_spin_us;
+    long               m_yield_us;
+    long               m_max_sleep_us;
+
+    static const int64_t s_forever = std::numeric_limits<int64_t>::max();
+
+    static int64_t now_nsec() {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    static timespec to_timespec(int64_t a_nsec) {
+        return timespec{time_t(a_nsec / 1000000000), long(a_nsec % 1000000000)};
+    }
+
+    /// Poll \a a_ready until \a a_until, reading the clock once per
+    /// \a a_batch checks
+    template <class Cond, class Pause>
+    static bool poll(const Cond& a_ready, int64_t a_until, int64_t& a_now,
+                     int a_batch, const Pause& a_pause)
+    {
+        while (a_now < a_until) {
+            for (int i = 0; i < a_batch; ++i) {
+                if (a_ready())
+                    return true;
+                a_pause();
+            }
+            a_now = now_nsec();
+        }
+        return a_ready();
+    }
+
+    template <class Cond, class Event>
+    static bool park(const Cond& a_ready, Event& a_event, int64_t a_deadline,
+                     int64_t a_now)
+    {
+        while (true) {
+            // Read the event's value before checking the condition, so that
+            // a signal delivered after the check makes the wait return
+            int val = a_event.value();
+            if (a_ready())
+                return true;
+            if (a_now >= a_deadline)
+                return false;
+            timespec ts, *pts = nullptr;
+            if (a_deadline != s_forever) {
+                ts  = to_timespec(a_deadline - a_now);
+                pts = &ts;
+            }
+            a_event.wait(pts, &val);
+            a_now = now_nsec();
+        }
+    }
+
+    template <class Cond>
+    static bool park(const Cond& a_ready, futex_event& a_event,
+                     int64_t a_deadline, int64_t a_now)
+    {
+        if (a_deadline == s_forever)
+            return a_event.wait(a_ready, nullptr, 0);
+        if (a_now >= a_deadline)
+            return a_ready();
+        timespec ts = to_timespec(a_deadline - a_now);
+        return a_event.wait(a_ready, &ts, 0);
+    }
+
+    template <class Cond>
+    bool sleep(const Cond& a_ready, int64_t a_deadline, int64_t a_now) const
+    {
+        long sleep_us = 1;
+        while (!a_ready()) {
+            if (a_now >= a_deadline)
+                return false;
+            timespec ts = to_timespec(std::min<int64_t>(sleep_us * 1000,
+                                                        a_deadline - a_now));
+            ::nanosleep(&ts, nullptr);
+            sleep_us = std::min(sleep_us * 2, std::max(1l, m_max_sleep_us));
+            a_now    = now_nsec();
+        }
+        return true;
+    }
+
+public:
+    /// @param a_type         final phase of waiting
+    /// @param a_spin_us      duration of busy spinning before the final phase
+    /// @param a_yield_us     duration of yielding before the final phase
+    /// @param a_max_sleep_us max sleep interval of the BACKOFF strategy
+    explicit wait_strategy(wait_strategy_type a_type = wait_strategy_type::FUTEX,
+                           long a_spin_us = 0, long a_yield_us = 0,
+                           long a_max_sleep_us = 1000)
+        : m_type(a_type), m_spin_us(a_spin_us), m_yield_us(a_yield_us)
+        , m_max_sleep_us(a_max_sleep_us)
+    {}
+
+    /// Spin on the condition without ever giving up the CPU
+    static wait_strategy busy_spin() {
+        return wait_strategy(wait_strategy_type::BUSY_SPIN);
+    }
+    /// Spin for \a a_spin_us, and then keep calling sched_yield()
+    static wait_strategy spin_yield(long a_spin_us = 10) {
+        return wait_strategy(wait_strategy_type::YIELD, a_spin_us);
+    }
+    /// Spin for \a a_spin_us, yield for \a a_yield_us, and then park
+    static wait_strategy spin_futex(long a_spin_us = 10, long a_yield_us = 0) {
+        return wait_strategy(wait_strategy_type::FUTEX, a_spin_us, a_yield_us);
+    }
+    /// Sleep between checks, doubling the interval up to \a a_max_sleep_us
+    static wait_strategy backoff(long a_max_sleep_us = 1000, long a_spin_us = 0) {
+        return wait_strategy(wait_strategy_type::BACKOFF, a_spin_us, 0,
+                             a_max_sleep_us);
+    }
+
+    wait_strategy_type type()         const { return m_type;         }
+    long               spin_us()      const { return m_spin_us;      }
+    long               yield_us()     const { return m_yield_us;     }
+    long               max_sleep_us() const { return m_max_sleep_us; }
+
+    void type(wait_strategy_type a_type)    { m_type         = a_type; }
+    void spin_us(long a_us)                 { m_spin_us      = a_us;   }
+    void yield_us(long a_us)                { m_yield_us     = a_us;   }
+    void max_sleep_us(long a_us)            { m_max_sleep_us = a_us;   }
+
+    /// Wait until \a a_ready returns true.
+    /// @param a_ready   condition check (called repeatedly)
+    /// @param a_event   event signaled by the producer (futex or futex_event)
+    /// @param a_timeout relative timeout (nullptr - wait indefinitely)
+    /// @return false on timeout
+    template <class Cond, class Event>
+    bool wait(const Cond& a_ready, Event& a_event,
+              const timespec* a_timeout = nullptr) const
+    {
+        if (a_ready())
+            return true;
+
+        int64_t now      = now_nsec();
+        int64_t deadline = a_timeout
+                         ? now + a_timeout->tv_sec * 1000000000 + a_timeout->tv_nsec
+                         : s_forever;
+
+        auto phase_end = [&](long a_us, wait_strategy_type a_final) {
+            return m_type == a_final ? deadline
+                                     : std::min(deadline, now + a_us * 1000);
+        };
+
+        if ((m_spin_us > 0 || m_type == wait_strategy_type::BUSY_SPIN) &&
+            poll(a_ready, phase_end(m_spin_us, wait_strategy_type::BUSY_SPIN),
+                 now, 64, &cpu_relax))
+            return true;
+        if (m_type == wait_strategy_type::BUSY_SPIN)
+            return false;
+
+        if ((m_yield_us > 0 || m_type == wait_strategy_type::YIELD) &&
+            poll(a_ready, phase_end(m_yield_us, wait_strategy_type::YIELD),
+                 now, 1, &::sched_yield))
+            return true;
+
+        switch (m_type) {
+            case wait_strategy_type::FUTEX:
+                return park(a_ready, a_event, deadline, now);
+            case wait_strategy_type::BACKOFF:
+                return sleep(a_ready, deadline, now);
+            default:
+                return false;
+        }
+    }
+};
+
+} // namespace utxx
@@ -40,6 +40,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/compiler_hints.hpp>
 #include <utxx/synch.hpp>
 #include <utxx/bits.hpp>
+#include <utxx/scope_exit.hpp>
+#include <utxx/math.hpp>
 #include <utxx/logger/logger.hpp>
 #include <utxx/logger/logger_util.hpp>
 #include <utxx/logger/logger_crash_handler.hpp>
@@ -71,6 +73,45 @@ void finalize_logger_at_exit()
     try { logger::instance().finalize(); } catch(...) {}
 }
 
+//-----------------------------------------------------------------------------
+// log_categories
+//-----------------------------------------------------------------------------
+log_categories::log_categories()
+    : m_count(1)
+{
+    for (auto& c : m_chunks)
+        c.store(nullptr, std::memory_order_relaxed);
+    // Category 0 is the default (empty) category
+    m_chunks[0].store(new std::string[s_chunk_size], std::memory_order_release);
+    m_ids.emplace("", 0);
+}
+
+uint32_t log_categories::add(const std::string& a_name)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto it = m_ids.find(a_name);
+    if (it != m_ids.end())
+        return it->second;
+
+    // Messages of the categories that don't fit are logged uncategorized
+    auto id = m_count.load(std::memory_order_relaxed);
+    if (id >= capacity())
+        return default_id();
+
+    auto& c     = m_chunks[id >> s_chunk_bits];
+    auto* chunk = c.load(std::memory_order_relaxed);
+    if (!chunk)
+        chunk   = new std::string[s_chunk_size];
+
+    chunk[id & (s_chunk_size-1)] = a_name;
+    c.store(chunk, std::memory_order_release);
+
+    m_ids.emplace(a_name, id);
+    m_count.store(id+1, std::memory_order_release);
+    return id;
+}
+
 
 int logger::level_to_signal_slot(log_level level) noexcept
 {
@@ -115,6 +156,7 @@ log_level logger::signal_slot_to_level(int slot) noexcept
 
 const char* logger::default_log_levels = "INFO|NOTICE|WARNING|ERROR|ALERT|FATAL";
 std::atomic<sigset_t*> logger::m_crash_sigset;
+std::atomic<deferred_buffer*> deferred_buffer::s_orphans;
 
 void logger::add_macro(const std::string& a_macro, const std::string& a_value)
 {
@@ -185,9 +227,28 @@ void logger::init(const config_tree& a_cfg, const sigset_t* a_ignore_signals,
         set_min_level_filter(parse_log_level(ls));
         long timeout_ms  = a_cfg.get<int>        ("logger.wait-timeout-ms", 1000);
         m_wait_timeout   = timespec{timeout_ms / 1000, timeout_ms % 1000 *  1000000L};
-        m_sched_yield_us = a_cfg.get<long>       ("logger.sched-yield-us",  -1);
+        auto ws          = a_cfg.get<std::string>("logger.wait-strategy",   "futex");
+        wait_strategy_type wait_type;
+        if (!parse_wait_strategy(ws, wait_type))
+            UTXX_THROW_RUNTIME_ERROR("Invalid logger wait-strategy setting: ", ws);
+        m_wait_strategy  = utxx::wait_strategy
+            (wait_type,
+             a_cfg.get<long>                     ("logger.wait-spin-us",    0),
+             std::max(0l, a_cfg.get<long>        ("logger.sched-yield-us",  -1)),
+             a_cfg.get<long>                     ("logger.wait-backoff-max-us", 1000));
         m_silent_finish  = a_cfg.get<bool>       ("logger.silent-finish",   false);
         m_block_signals  = a_cfg.get<bool>       ("logger.block-signals",   true);
+        m_tsc_timestamp  = a_cfg.get<bool>       ("logger.tsc-timestamp",   m_tsc_timestamp);
+        deferred_format(a_cfg.get<bool>          ("logger.deferred-format", false),
+                        a_cfg.get<int>           ("logger.deferred-buffer-size",
+                                                  64*1024));
+        auto lo          = a_cfg.get<std::string>("logger.lane-overflow",   "drop");
+        lane_overflow lane_policy;
+        if (!parse_lane_overflow(lo, lane_policy))
+            UTXX_THROW_RUNTIME_ERROR("Invalid logger lane-overflow setting: ", lo);
+        lanes(a_cfg.get<bool>                    ("logger.lanes",           false),
+              a_cfg.get<int>                     ("logger.lane-capacity",   1024),
+              lane_policy);
 
         if ((int)m_timestamp_type < 0)
             UTXX_THROW_RUNTIME_ERROR("Invalid logger timestamp type: ", ts);
@@ -276,40 +337,27 @@ void logger::run()
     if (m_on_before_run)
         m_on_before_run();
 
+    m_thread_id = pthread_self();
+
+    if (m_tsc_timestamp)
+        tsc_calibrate(true);
+
     if (!m_ident.empty())
         pthread_setname_np(pthread_self(), m_ident.c_str());
 
-    int  event_val;
     bool ok = true;
+    auto ready = [this]() { return m_abort || !empty(); };
 
     while (!m_abort && ok) {
-        event_val = m_event.value();
-        //wakeup_result rc = wakeup_result::TIMEDOUT;
-
-        while (!m_abort && m_queue.empty()) {
-            m_event.wait(&m_wait_timeout, &event_val);
-
+        // Wake up every m_wait_timeout to check if the logger was aborted
+        while (!m_wait_strategy.wait(ready, m_event, &m_wait_timeout)) {
             ASYNC_DEBUG_TRACE(
-                ("  %s LOGGER awakened (res=%s, val=%d, futex=%d), abort=%d, head=%s\n",
-                 timestamp::to_string().c_str(), to_string(rc).c_str(),
-                 event_val, m_event.value(), m_abort,
-                 m_queue.empty() ? "empty" : "data")
+                ("  %s LOGGER wait timed out (futex=%d), abort=%d\n",
+                 timestamp::to_string().c_str(), m_event.value(), m_abort)
             );
         }
 
-        // When running with maximum priority, occasionally excessive use of
-        // sched_yield may cause a system slowdown, so this option is
-        // configurable by m_sched_yield_us:
-        if (m_queue.empty() && m_sched_yield_us >= 0) {
-            time_val deadline(rel_time(0, m_sched_yield_us));
-            while (!m_abort && m_queue.empty()) {
-                if (now_utc() > deadline)
-                    break;
-                sched_yield();
-            }
-        }
-
-        // Lastly, flush the queue of pending messages
+        // Flush the queue of pending messages
         ok = flush();
     }
 
@@ -324,12 +372,72 @@ void logger::run()
         try { dolog_msg(msg); } catch (...) {}
     }
 
+    m_thread_id = 0;
+
     if (m_on_after_run)
         m_on_after_run();
 }
 
+void logger::report_flush_error()
+{
+    // Unhandled error writing data to some destination
+    // Print error report to stderr (can't do anything better --
+    // the error happened in the m_on_error callback!)
+    const msg msg(LEVEL_INFO, "",
+                  std::string("Fatal exception in logger"),
+                  UTXX_LOG_SRCINFO);
+    detail::basic_buffered_print<1024> buf;
+    char  pfx[256], sfx[256];
+    char* p = format_header(msg, pfx, pfx + sizeof(pfx));
+    char* q = format_footer(msg, sfx, sfx + sizeof(sfx));
+    auto ps = p - pfx;
+    auto qs = q - sfx;
+    buf.reserve(msg.m_fun.str.size() + ps + qs + 1);
+    buf.sprint(pfx, ps);
+    buf.print(msg.m_fun.str);
+    buf.sprint(sfx, qs);
+    std::cerr << buf.str() << std::endl;
+
+    m_abort = true;
+}
+
+void logger::tsc_calibrate(bool a_reset)
+{
+    // Attribute the wall-clock reading to the midpoint of two tick readings
+    auto t1  = high_res_timer::gettime();
+    auto now = now_utc();
+    auto t2  = high_res_timer::gettime();
+    auto tsc = t1 + (t2 - t1) / 2;
+
+    if (a_reset || !m_tsc_origin) {
+        m_tsc_origin      = tsc;
+        m_tsc_origin_time = now;
+        m_nsec_per_tick   = 1000.0 / std::max(1u, high_res_timer::global_scale_factor());
+    } else if (tsc > m_tsc_origin) {
+        m_nsec_per_tick   = double((now - m_tsc_origin_time).nanoseconds())
+                          / double(tsc - m_tsc_origin);
+    }
+
+    m_tsc_base      = tsc;
+    m_tsc_base_time = now;
+}
+
 bool logger::flush()
 {
+    // Keep the conversion of ticks to wall-clock time from drifting
+    if (m_tsc_timestamp && now_utc() - m_tsc_base_time >= msecs(100))
+        tsc_calibrate(false);
+
+    // Let back-ends coalesce writes of the messages drained below
+    for (auto& impl : m_implementations)
+        impl->begin_batch();
+
+    // If draining fails, still make the back-ends leave the batching mode
+    scope_exit batch_guard([this]() {
+        for (auto& impl : m_implementations)
+            try { impl->end_batch(); } catch (...) {}
+    });
+
     // Get all pending items from the queue
     for (auto* item = m_queue.pop_all(), *next=item; item; item = next) {
         next = item->next();
@@ -337,25 +445,7 @@ bool logger::flush()
         try   { dolog_msg(item->data()); }
         catch ( std::exception const& e  )
         {
-            // Unhandled error writing data to some destination
-            // Print error report to stderr (can't do anything better --
-            // the error happened in the m_on_error callback!)
-            const msg msg(LEVEL_INFO, "",
-                          std::string("Fatal exception in logger"),
-                          UTXX_LOG_SRCINFO);
-            detail::basic_buffered_print<1024> buf;
-            char  pfx[256], sfx[256];
-            char* p = format_header(msg, pfx, pfx + sizeof(pfx));
-            char* q = format_footer(msg, sfx, sfx + sizeof(sfx));
-            auto ps = p - pfx;
-            auto qs = q - sfx;
-            buf.reserve(msg.m_fun.str.size() + ps + qs + 1);
-            buf.sprint(pfx, ps);
-            buf.print(msg.m_fun.str);
-            buf.sprint(sfx, qs);
-            std::cerr << buf.str() << std::endl;
-
-            m_abort = true;
+            report_flush_error();
 
             // TODO: implement attempt to store transient messages to some
             // other medium
@@ -364,7 +454,7 @@ bool logger::flush()
             while (item) {
                 m_queue.free(item);
                 item = next;
-                next = item->next();
+                next = item ? item->next() : nullptr;
             }
 
             return false;
@@ -374,9 +464,140 @@ bool logger::flush()
         item = next;
     }
 
+    if (!flush_lanes())
+        return false;
+
+    batch_guard.disable();
+
+    try {
+        for (auto& impl : m_implementations)
+            impl->end_batch();
+    } catch (std::exception const& e) {
+        if (!m_error) {
+            report_flush_error();
+            return false;
+        }
+        m_error(e.what());
+    }
+
+    // Reclaim deferred buffers of terminated threads
+    deferred_buffer::reap();
+
+    return true;
+}
+
+logger::lane* logger::local_lane()
+{
+    struct holder {
+        lane* ptr = nullptr;
+        ~holder() { if (ptr) ptr->release(); }
+    };
+    static thread_local holder s_holder;
+
+    if (likely(s_holder.ptr))
+        return s_holder.ptr;
+
+    auto* ln = new lane(m_lane_capacity, m_lane_overflow);
+    auto* h  = m_new_lanes.load(std::memory_order_relaxed);
+    do    { ln->next(h); }
+    while (!m_new_lanes.compare_exchange_weak(h, ln, std::memory_order_release));
+    return s_holder.ptr = ln;
+}
+
+bool logger::lanes_pending()
+{
+    // Pick up lanes created by new threads
+    if (unlikely(m_new_lanes.load(std::memory_order_relaxed)))
+        for (auto* p = m_new_lanes.exchange(nullptr, std::memory_order_acquire), *next = p;
+             p; p = next)
+        {
+            next = p->next();
+            m_lanes.push_back(p);
+        }
+
+    for (auto* ln : m_lanes)
+        if (!ln->empty())
+            return true;
+    return false;
+}
+
+bool logger::flush_lanes()
+{
+    if (!lanes_pending() && m_lanes.empty())
+        return true;
+
+    // Take a snapshot of the number of pending messages in each lane, so
+    // that producers that keep logging can't starve the merge loop
+    auto  n      = m_lanes.size();
+    auto& counts = m_lane_counts;
+    counts.resize(n);
+
+    for (size_t i=0; i < n; ++i) {
+        if (auto k = m_lanes[i]->evict())
+            m_dropped.fetch_add(k, std::memory_order_relaxed);
+        counts[i] = m_lanes[i]->count();
+    }
+
+    // Each lane is ordered by time, so merging the lanes only requires
+    // picking the lane with the oldest message at the front
+    while (true) {
+        int   k  = -1;
+        msg*  m  = nullptr;
+        for (size_t i=0; i < n; ++i) {
+            if (!counts[i])
+                continue;
+            auto* f = m_lanes[i]->front();
+            if (!m || (f->m_tsc && m->m_tsc ? f->m_tsc       < m->m_tsc
+                                            : f->timestamp() < m->timestamp())) {
+                k = i;
+                m = f;
+            }
+        }
+
+        if (k < 0)
+            break;
+
+        try   { dolog_msg(*m); }
+        catch ( std::exception const& e  )
+        {
+            report_flush_error();
+            m_lanes[k]->pop();
+            return false;
+        }
+
+        m_lanes[k]->pop();
+        --counts[k];
+    }
+
+    // Delete lanes of terminated threads
+    m_lanes.erase(std::remove_if(m_lanes.begin(), m_lanes.end(), [](lane* ln) {
+        if (!ln->drained())
+            return false;
+        delete ln;
+        return true;
+    }), m_lanes.end());
+
     return true;
 }
 
+void logger::lanes(bool a_enable, uint32_t a_capacity, lane_overflow a_overflow)
+{
+    if (a_capacity < 2)
+        UTXX_THROW_BADARG_ERROR("Invalid logger lane capacity: ", a_capacity);
+    m_use_lanes     = a_enable;
+    // Usable capacity of concurrent_spsc_queue is one less than its size
+    m_lane_capacity = math::upper_power(a_capacity+1, 2);
+    m_lane_overflow = a_overflow;
+}
+
+void logger::deferred_format(bool a_enable, uint32_t a_buf_size)
+{
+    if (a_buf_size < 1024)
+        UTXX_THROW_BADARG_ERROR("Invalid logger deferred buffer size: ", a_buf_size);
+    m_deferred_format      = a_enable;
+    m_deferred_buffer_size = math::upper_power(a_buf_size, 2);
+}
+
 void logger::finalize()
 {
     if (!m_initialized)
@@ -436,8 +657,10 @@ format_header(const logger::msg& a_msg, char* a_buf, const char* a_end)
         *p++ = '|';
     }
     if (show_category()) {
-        if (!a_msg.m_category.empty())
-            p = stpncpy(p, a_msg.m_category.c_str(), a_msg.m_category.size());
+        if (a_msg.m_category) {
+            auto& cat = a_msg.category();
+            p = stpncpy(p, cat.c_str(), cat.size());
+        }
         *p++ = '|';
     }
 
@@ -474,6 +697,9 @@ format_footer(const logger::msg& a_msg, char* a_buf, const char* a_end)
 }
 
 void logger::dolog_msg(const logger::msg& a_msg) {
+    if (a_msg.m_tsc)
+        a_msg.m_timestamp = tsc_to_time(a_msg.m_tsc);
+
     try {
         switch (a_msg.m_type) {
             case payload_t::CHAR_FUN: {
@@ -494,6 +720,29 @@ void logger::dolog_msg(const logger::msg& a_msg) {
 
                 break;
             }
+            case payload_t::DEFERRED: {
+                char  buf[4096];
+                auto* end = buf + sizeof(buf);
+                char*   p = format_header(a_msg, buf,  end);
+                // Leave room for the footer (source location and newline),
+                // and truncate the message the same way logfmt() does
+                int   max = std::max<int>(0, end - p - 256);
+                if (max > s_max_fmt_size)
+                    max = s_max_fmt_size;
+                int     n = a_msg.m_fun.df.format(p, max);
+                n         = std::max(0, std::min(n, max-1));
+                while (n && p[n-1] == '\n') --n;
+                p = format_footer(a_msg, p+n,  end);
+                m_sig_slot[level_to_signal_slot(a_msg.level())](
+                    on_msg_delegate_t::invoker_type(a_msg, buf, p - buf));
+
+                if (fatal_kill_signal() && a_msg.level() == LEVEL_FATAL) {
+                    m_abort = true;
+                    dolog_fatal_msg(buf, p - buf);
+                }
+
+                break;
+            }
             case payload_t::STR_FUN: {
                 assert(a_msg.m_fun.cf);
                 char  pfx[256], sfx[256];
@@ -618,7 +867,15 @@ std::ostream& logger::dump(std::ostream& out) const
                                             m_show_thread==thr_id_type::NAME ? "name" :
                                             "false")                    << '\n'
         << "    ident               = " << m_ident                      << '\n'
-        << "    timestamp-type      = " << to_string(m_timestamp_type)  << '\n';
+        << "    timestamp-type      = " << to_string(m_timestamp_type)  << '\n'
+        << "    tsc-timestamp       = " << val(m_tsc_timestamp)         << '\n'
+        << "    deferred-format     = " << val(m_deferred_format)       << '\n'
+        << "    lanes               = " << val(m_use_lanes)             << '\n'
+        << "    lane-capacity       = " << m_lane_capacity              << '\n'
+        << "    lane-overflow       = " << to_string(m_lane_overflow)   << '\n'
+        << "    wait-strategy       = " << to_string(m_wait_strategy.type())<< '\n'
+        << "    wait-spin-us        = " << m_wait_strategy.spin_us()     << '\n'
+        << "    sched-yield-us      = " << m_wait_strategy.yield_us()    << '\n';
 
     // Check the list of registered implementations. If corresponding
     // configuration section is found, initialize the implementation.
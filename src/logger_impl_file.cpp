@@ -65,6 +65,8 @@ std::ostream& logger_impl_file::dump(std::ostream& out,
             << a_prefix << "      order        = " << m_split_order << '\n'
             << a_prefix << "      delimiter    = " << m_split_delim << '\n';
     }
+    out << a_prefix << "    batch-size     = " << m_batch_size << '\n'
+        << a_prefix << "    sync           = " << (m_sync ? "true" : "false")          << '\n';
     return out;
 }
 
@@ -88,6 +90,8 @@ bool logger_impl_file::init(const variant_tree& a_config)
     m_split_parts  = a_config.get("logger.file.split-parts",     0);
     m_split_delim  = a_config.get("logger.file.split-delim",   "_")[0];
     m_split_order  = split_ord::from_string(a_config.get("logger.file.split-order", "last"), true);
+    m_batch_size   = a_config.get("logger.file.batch-size", 64*1024);
+    m_sync         = a_config.get("logger.file.sync",        false);
 
     if (m_split_size  < 0)
         UTXX_THROW_BADARG_ERROR("logger.file.split-size cannot be negative: ",  m_split_size);
@@ -305,21 +309,97 @@ void logger_impl_file::create_symbolic_link()
     }
 }
 
+void logger_impl_file::check_split()
+{
+    if (m_split_size && m_file_size >= m_split_size) {
+        sync_data();
+        close(m_fd);
+        m_fd = -1;
+        modify_file_name();
+        open_file(true);
+    }
+}
+
+void logger_impl_file::write_data(const char* a_buf, size_t a_size, const char* a_src)
+{
+    check_split();
+
+    while (a_size) {
+        auto n = write(m_fd, a_buf, a_size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            UTXX_THROW_IO_ERROR(errno, "Error writing to file: ", m_filename, ' ', a_src);
+        }
+        a_buf       += n;
+        a_size      -= n;
+        m_file_size += n;
+        m_unsynced   = true;
+    }
+}
+
+void logger_impl_file::write_batch()
+{
+    if (m_batch.empty())
+        return;
+
+    // Clear the buffer even if writing fails, so that the same data is not
+    // written twice
+    try   { write_data(m_batch.c_str(), m_batch.size()); }
+    catch (...) { m_batch.clear(); throw; }
+    m_batch.clear();
+}
+
+void logger_impl_file::begin_batch()
+{
+    m_batching = m_batch_size > 0 && m_fd > -1;
+}
+
+void logger_impl_file::end_batch()
+{
+    if (!m_batching)
+        return;
+
+    m_batching = false;
+    write_batch();
+    sync_data();
+}
+
+void logger_impl_file::sync_data()
+{
+    if (!m_sync || !m_unsynced)
+        return;
+
+    m_unsynced = false;
+
+    if (fdatasync(m_fd) < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error syncing file: ", m_filename);
+}
+
 void logger_impl_file::log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
 {
-    if (m_split_size) {
-        struct stat stat_buf;
-        int rc = fstat(m_fd, &stat_buf);
-        if (rc < 0)
-            UTXX_THROW_RUNTIME_ERROR("Unable to read file size for file "+m_filename);
-        if ((size_t)stat_buf.st_size >= m_split_size) {
-            finalize();
-            modify_file_name();
-            open_file(true);
+    // In the batching mode the message is appended to the buffer, and the
+    // whole batch drained from the logger's queue is written by a single
+    // system call in end_batch(). When a file is split, it may exceed the
+    // split-size by up to one batch.
+    if (m_batching) {
+        // Messages of a batch must all belong to the same file part
+        if (m_batch.size() + a_size > m_batch_size ||
+           (m_split_size && m_file_size + m_batch.size() >= m_split_size))
+            write_batch();
+        if (a_size < m_batch_size) {
+            if (m_batch.capacity() < m_batch_size)
+                m_batch.reserve(m_batch_size);
+            m_batch.append(a_buf, a_size);
+            return;
         }
     }
-    if (write(m_fd, a_buf, a_size) < 0)
-        UTXX_THROW_IO_ERROR(errno, "Error writing to file: ", m_filename, ' ', a_msg.src_location());
+
+    write_data(a_buf, a_size, a_msg.src_location());
+
+    // Outside of a batch each message is synced individually
+    if (!m_batching)
+        sync_data();
 }
 
 bool logger_impl_file::open_file(bool rotated)
@@ -337,6 +417,11 @@ bool logger_impl_file::open_file(bool rotated)
     // Write field information
     write_file_header(exists, rotated);
 
+    struct stat stat_buf;
+    if (fstat(m_fd, &stat_buf) < 0)
+        UTXX_THROW_IO_ERROR(errno, "Unable to read file size for file ", m_filename);
+    m_file_size = stat_buf.st_size;
+
     return exists;
 }
 
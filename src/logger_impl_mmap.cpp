@@ -0,0 +1,305 @@
+//----------------------------------------------------------------------------
+/// \file  logger_impl_mmap.cpp
+//----------------------------------------------------------------------------
+/// \brief Back-end plugin implementing memory-mapped log writer for the
+/// <tt>logger</tt> class.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <utxx/logger/logger_impl_mmap.hpp>
+#include <utxx/logger/logger_impl.hpp>
+#include <utxx/path.hpp>
+#include <utxx/scope_exit.hpp>
+#include <cstring>
+
+namespace utxx {
+
+static logger_impl_mgr::impl_callback_t f = &logger_impl_mmap::create;
+static logger_impl_mgr::registrar reg("mmap", f);
+
+static_assert(sizeof(logger_impl_mmap::header) == UTXX_CL_SIZE,
+              "Invalid header size");
+
+std::ostream& logger_impl_mmap::dump(std::ostream& out,
+    const std::string& a_prefix) const
+{
+    out << a_prefix << "logger." << name() << '\n'
+        << a_prefix << "    filename       = " << m_filename << '\n'
+        << a_prefix << "    append         = " << (m_append ? "true" : "false")   << '\n'
+        << a_prefix << "    mode           = " << m_mode << '\n'
+        << a_prefix << "    levels         = " << log_levels_to_str(m_levels)   << '\n'
+        << a_prefix << "    segment-size   = " << m_segment_size << '\n'
+        << a_prefix << "    segments       = " << m_segments << '\n'
+        << a_prefix << "    populate       = " << (m_populate ? "true" : "false") << '\n';
+    return out;
+}
+
+bool logger_impl_mmap::init(const variant_tree& a_config)
+{
+    BOOST_ASSERT(this->m_log_mgr);
+    finalize();
+
+    try {
+        m_orig_filename = a_config.get<std::string>("logger.mmap.filename");
+        m_orig_filename = m_log_mgr->replace_macros(m_orig_filename);
+    } catch (boost::property_tree::ptree_bad_data&) {
+        UTXX_THROW_BADARG_ERROR("logger.mmap.filename not specified");
+    }
+
+    m_append       = a_config.get("logger.mmap.append",       true);
+    m_mode         = a_config.get("logger.mmap.mode",         0644);
+    m_segment_size = a_config.get("logger.mmap.segment-size", 64*1024*1024);
+    m_segments     = a_config.get("logger.mmap.segments",        0);
+    m_populate     = a_config.get("logger.mmap.populate",     true);
+
+    if (m_segment_size < 4096)
+        UTXX_THROW_BADARG_ERROR("logger.mmap.segment-size is too small: ", m_segment_size);
+    if (m_segments < 0)
+        UTXX_THROW_BADARG_ERROR("logger.mmap.segments cannot be negative: ", m_segments);
+
+    auto levels = a_config.get("logger.mmap.levels", "");
+
+    m_levels = levels.empty()
+             ? m_log_mgr->level_filter()
+             : parse_log_levels(levels);
+
+    if (m_levels == NOLOGGING)
+        return true;
+
+    // Older segments may have been pruned by rotate(), so the existing ones
+    // don't necessarily start at 1
+    auto range = find_segments();
+
+    if (!m_append) {
+        for (int i=range.first; i && i <= range.second; ++i)
+            path::file_unlink(get_file_name(i));
+        range = std::make_pair(0, 0);
+    }
+
+    // Continue writing to the most recent segment
+    m_first_segment = std::max(1, range.first);
+    m_segment       = std::max(1, range.second);
+    m_filename      = get_file_name(m_segment);
+    open_segment(m_append);
+
+    // Install log_msg callbacks from appropriate levels
+    for(int lvl = 0; lvl < logger::NLEVELS; ++lvl) {
+        log_level level = logger::signal_slot_to_level(lvl);
+        if ((m_levels & static_cast<int>(level)) != 0)
+            this->add(level,
+                logger::on_msg_delegate_t::from_method
+                    <logger_impl_mmap, &logger_impl_mmap::log_msg>(this));
+    }
+    return true;
+}
+
+std::string logger_impl_mmap::get_file_name(int a_segment) const
+{
+    char sfx[32];
+    sprintf(sfx, "_%d", a_segment);
+
+    auto s = m_orig_filename;
+    auto i = s.find_last_of('.');
+    auto d = s.find_last_of('/');
+    if (i == std::string::npos || (d != std::string::npos && i < d))
+        i = s.size();
+    s.insert(i, sfx);
+    return s;
+}
+
+std::pair<int, int> logger_impl_mmap::find_segments() const
+{
+    // Segment files are named "<stem>_<N><ext>" (see get_file_name())
+    auto   dir_file = path::split(m_orig_filename);
+    auto&  name     = dir_file.second;
+    auto   i        = name.find_last_of('.');
+    if (i == std::string::npos)
+        i = name.size();
+    auto   pfx      = name.substr(0, i) + '_';
+    auto   ext      = name.substr(i);
+    auto   dir      = !dir_file.first.empty()   ? dir_file.first
+                    : m_orig_filename[0] == '/' ? std::string(1, '/')
+                    : std::string(".");
+
+    auto on_file = [&](auto& /*dir*/, auto& file, auto& /*stat*/, bool) {
+        if (file.size() <= pfx.size() + ext.size() ||
+            file.compare(file.size() - ext.size(), ext.size(), ext) != 0)
+            return 0;
+        int  n = 0;
+        auto e = file.size() - ext.size();
+        for (auto j = pfx.size(); j < e; ++j) {
+            if (file[j] < '0' || file[j] > '9' || n > 100000000)
+                return 0;
+            n = n*10 + (file[j] - '0');
+        }
+        return n;
+    };
+
+    auto files = path::list_files<int>(on_file, dir, pfx, FileMatchT::PREFIX);
+    auto res   = std::make_pair(0, 0);
+
+    for (auto n : files.second) {
+        if (!n) continue;
+        if (!res.first || n < res.first) res.first  = n;
+        if (n > res.second)              res.second = n;
+    }
+    return res;
+}
+
+void logger_impl_mmap::open_segment(bool a_append)
+{
+    int fd = open(m_filename.c_str(), O_CREAT|O_RDWR, m_mode);
+    if (fd < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error opening file ", m_filename);
+
+    scope_exit fd_guard([fd]() { ::close(fd); });
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error reading file size: ", m_filename);
+
+    // Existing segment with a valid header is appended to
+    header hdr;
+    bool   reuse = a_append && size_t(st.st_size) >= sizeof(header) &&
+                   ::pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+                   hdr.version == header::s_version &&
+                   hdr.header_size == sizeof(header);
+
+    size_t capacity = reuse ? hdr.capacity : m_segment_size - sizeof(header);
+    size_t size     = sizeof(header) + capacity;
+
+    if (ftruncate(fd, size) < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error allocating ", size, " bytes for file ", m_filename);
+
+    int  flags = MAP_SHARED | (m_populate ? MAP_POPULATE : 0);
+    auto p     = mmap(nullptr, size, PROT_READ|PROT_WRITE, flags, fd, 0);
+    if (p == MAP_FAILED)
+        UTXX_THROW_IO_ERROR(errno, "Error mapping file ", m_filename);
+
+    fd_guard.disable();
+
+    m_fd     = fd;
+    m_header = static_cast<header*>(p);
+    m_data   = static_cast<char*>(p) + sizeof(header);
+
+    if (!reuse) {
+        m_header->version     = header::s_version;
+        m_header->header_size = sizeof(header);
+        m_header->capacity    = capacity;
+        m_header->offset.store(0, std::memory_order_release);
+    } else if (m_header->offset.load(std::memory_order_relaxed) > capacity)
+        m_header->offset.store(capacity, std::memory_order_release);
+}
+
+void logger_impl_mmap::close_segment(int a_fd, header* a_header)
+{
+    // Release the unused space of the segment
+    auto size = sizeof(header) + a_header->offset.load(std::memory_order_acquire);
+    munmap(a_header, sizeof(header) + a_header->capacity);
+    if (ftruncate(a_fd, size) < 0) {}
+    close(a_fd);
+}
+
+void logger_impl_mmap::finalize()
+{
+    if (!m_header)
+        return;
+
+    close_segment(m_fd, m_header);
+
+    m_fd     = -1;
+    m_header = nullptr;
+    m_data   = nullptr;
+}
+
+void logger_impl_mmap::rotate()
+{
+    // Map the next segment before closing the current one, so that if it
+    // fails, m_header still points to a valid (full) segment
+    auto old_fd     = m_fd;
+    auto old_header = m_header;
+    auto old_file   = m_filename;
+
+    m_filename = get_file_name(m_segment+1);
+    try {
+        open_segment(false);
+    } catch (...) {
+        m_filename = old_file;
+        throw;
+    }
+
+    close_segment(old_fd, old_header);
+    ++m_segment;
+
+    while (m_segments && m_segment - m_first_segment >= m_segments)
+        path::file_unlink(get_file_name(m_first_segment++));
+}
+
+void logger_impl_mmap::log_msg(const logger::msg& a_msg, const char* a_buf, size_t a_size)
+{
+    auto offset = m_header->offset.load(std::memory_order_relaxed);
+
+    if (unlikely(offset + a_size > m_header->capacity)) {
+        rotate();
+        offset = 0;
+        a_size = std::min<size_t>(a_size, m_header->capacity);
+    }
+
+    memcpy(m_data + offset, a_buf, a_size);
+
+    // The record becomes visible to readers (and survives a crash of the
+    // process) only after it is completely copied
+    m_header->offset.store(offset + a_size, std::memory_order_release);
+}
+
+std::string logger_impl_mmap::read_segment(const std::string& a_filename)
+{
+    int fd = open(a_filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error opening file ", a_filename);
+
+    scope_exit fd_guard([fd]() { ::close(fd); });
+
+    header hdr;
+    if (::pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        hdr.version != header::s_version || hdr.header_size != sizeof(header))
+        UTXX_THROW_RUNTIME_ERROR("Invalid log segment file: ", a_filename);
+
+    auto size = std::min<uint64_t>(hdr.offset.load(std::memory_order_relaxed),
+                                   hdr.capacity);
+    std::string res(size, '\0');
+    auto n = ::pread(fd, &res[0], size, sizeof(header));
+    if (n < 0)
+        UTXX_THROW_IO_ERROR(errno, "Error reading file ", a_filename);
+    res.resize(n);
+    return res;
+}
+
+} // namespace utxx
@@ -23,6 +23,7 @@
 #include <limits.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -38,14 +39,12 @@
 #include <unistd.h>
 #include <utxx/time_val.hpp>
 #include <utxx/pcap.hpp>
+#include <utxx/io/mcast_receiver.hpp>
 #include <vector>
 #include <map>
 #include <unordered_map>
 #include <string>
 
-#define unlikely(expr) __builtin_expect(!!(expr), 0)
-#define likely(expr)   __builtin_expect(!!(expr), 1)
-
 enum data_fmt_t {
   UNDEFINED = 0,
   FORTS     = 'f',
@@ -53,9 +52,11 @@ enum data_fmt_t {
 };
 
 const int MEGABYTE = 1024*1024;
+const int PKT_SIZE = 16*1024;   /* max size of a received datagram      */
+const int CTL_SIZE = 256;       /* size of ancillary data of a datagram */
 //const int MILLION  = 1000000;
 
-struct address {
+struct address : public utxx::io::mcast_channel {
   int                   id;             /* url order in the config */
   char                  url[256];
   char*                 title;
@@ -69,15 +70,6 @@ struct address {
   uint16_t              port;
   int                   fd;
   data_fmt_t            data_format;    /* (m)icex, (f)orts */
-  long                  last_data_time; /* time of the last gap detected */
-  long                  last_seqno;
-  long                  last_ooo_time;  /* time of the last gap detected */
-  long                  last_gap_time;  /* time of the last gap detected */
-
-  long                  bytes_cnt;      /* total byte count */
-  int                   pkt_count;      /* total pkt count  */
-  int                   gap_count;      /* number of lost packets (due to seq gaps) */
-  int                   ooo_count;      /* out-of-order packet count */
 
   // Total summary reports
   int                   last_srep_pkt_count;
@@ -106,40 +98,48 @@ struct listener {
   {}
 };
 
-struct addr_port {
-  addr_port() : addr(0), port(0) {}
-  addr_port(in_addr_t addr, uint16_t port) : addr(addr), port(port) {}
-
-  in_addr_t             addr;
-  uint16_t              port;
-};
-
-struct cmp_addr_port {
-  // Comparator for std::map
-  bool operator()(addr_port const& a, addr_port const& b) const {
-    return a.addr < b.addr || (a.addr == b.addr && a.port < b.port);
+/* Extracts sequence numbers of packets according to the channel's format */
+struct market_decoder {
+  long seqno(const address& a, const char* buf, size_t n, bool& reset) const {
+    switch (a.data_format) {
+      case MICEX: return utxx::io::micex_seqno_decoder().seqno(a, buf, n, reset);
+      case FORTS: return utxx::io::forts_seqno_decoder().seqno(a, buf, n, reset);
+      default:    return 0;
+    }
   }
 };
 
-namespace std {
-  template <> struct hash<addr_port> {
-    size_t operator()(const addr_port& a) const {
-      return hash<in_addr_t>()(a.addr) ^ hash<uint16_t>()(a.port);
+using receiver_t = utxx::io::mcast_receiver<market_decoder, address>;
+
+/* Buffers of datagrams received by a single recvmmsg() call */
+struct rx_batch {
+  std::vector<mmsghdr>     msgs;
+  std::vector<iovec>       iovs;
+  std::vector<sockaddr_in> peers;
+  std::vector<char>        data;
+  std::vector<char>        ctl;
+
+  void init(int n) {
+    msgs.resize(n);  iovs.resize(n);  peers.resize(n);
+    data.resize(size_t(n) * PKT_SIZE);
+    ctl.resize (size_t(n) * CTL_SIZE);
+    for (int i=0; i < n; ++i) {
+      iovs[i].iov_base = &data[size_t(i) * PKT_SIZE];
+      iovs[i].iov_len  = PKT_SIZE;
+      msghdr& m        = msgs[i].msg_hdr;
+      m                = msghdr();
+      m.msg_name       = &peers[i];
+      m.msg_iov        = &iovs[i];
+      m.msg_iovlen     = 1;
+      m.msg_control    = &ctl[size_t(i) * CTL_SIZE];
     }
-  };
-  template <> struct equal_to<addr_port> {
-    bool operator()(addr_port const& a, addr_port const& b) const {
-      return a.addr == b.addr && a.port == b.port;
-    }
-  };
-}
-
-using addr_map_t = std::unordered_map<addr_port, address*>;
+  }
+};
 
 sigjmp_buf              jbuf;
 struct address          addrs[1024];
 std::vector<listener*>  listener_idx;     // Maps fd -> listener*
-addr_map_t              address_idx;      // Maps {mcast_addr,port} -> address*
+receiver_t              receiver;         // Maps {mcast_addr,port} -> address*
 struct address**        sorted_addrs[4];  // For report stats sorting
 
 std::unordered_map<uint16_t, listener>     listeners;
@@ -174,6 +174,10 @@ const char* output_file               = nullptr;
 const char* write_file                = nullptr;
 bool        pcap_format               = false;
 auto        pcap_file                 = utxx::pcap(true, true);
+int         batch_size                = 1;
+int         kernel_tstamps            = 0;
+int         busy_poll_cpu             = -1;
+rx_batch    rx;
 
 void usage(const char* program) {
   printf("Listen to multicast traffic from a given (source addr) address:port\n\n"
@@ -181,7 +185,8 @@ void usage(const char* program) {
          "          [-a Addr] [-n Mcastaddr -p Port [-s SourceAddr]] [-v] [-q] [-e false]\n"
          "          [-i ReportingIntervalSec] [-I SockReportInterval]\n"
          "          [-d DurationSec] [-b RecvBufSize] [-L MaxChannelReportLines]\n"
-         "          [-l ReportingLabel] [-r PrintPacketSize] [-o OutputFile]\n\n"
+         "          [-l ReportingLabel] [-r PrintPacketSize] [-o OutputFile]\n"
+         "          [-B BatchSize] [-T] [-S Core]\n\n"
          "      -c CfgAddrs - Filename containing list of addresses to process\n"
          "                    (use \"-\" for stdin)\n"
          "      -a Addr     - Optional interface address or multicast address\n"
@@ -195,6 +200,11 @@ void usage(const char* program) {
          "                       'ip route get...'\n"
          "      -e false    - Don't use epoll() (default: true)\n"
          "      -b Size     - Socket receive buffer size\n"
+         "      -B Size     - Max number of packets read by one recvmmsg() call\n"
+         "                    (default: 1)\n"
+         "      -T          - Measure latency using kernel receive timestamps of\n"
+         "                    all packets (SO_TIMESTAMPNS) instead of sampling\n"
+         "      -S Core     - Busy-poll the sockets (no epoll) on the given CPU core\n"
          "      -i Sec      - Reporting interval (default: 5s)\n"
          "      -I Lines    - Socket reporting interval (default: 50)\n"
          "      -L Lines    - Max number of channel-level report lines (default: 10)\n"
@@ -272,7 +282,8 @@ char* data_fmt_string(data_fmt_t fmt, char* pfx, char* sfx, char* def) {
 }
 
 void print_report();
-void process_packet(address* addr, const char* buf, long n);
+void process_packet(address* addr, const char* buf, long n, long rx_time);
+int  receive_packets(listener* l, int flags);
 
 double scale(long n, long multiplier) {
   long g = multiplier*multiplier*multiplier;
@@ -300,27 +311,8 @@ long get_time() {
   return long(ts.tv_sec) * 1000000000l + ts.tv_nsec;
 }
 
-void      test_forts_decode();
-uint32_t  decode_forts_seqno(const char* buf, int n, long last_seqno, int* seq_reset);
 in_addr_t get_ifaddr(int fd, const std::string& addr);
 
-long get_seqno(struct address* addr, const char* buf, int n, long last_seqno, int* seq_reset) {
-  switch (addr->data_format) {
-    case MICEX: {
-      uint32_t a = (uint8_t)buf[0],
-               b = (uint8_t)buf[1],
-               c = (uint8_t)buf[2],
-               d = (uint8_t)buf[3];
-      return (uint32_t)d << 24 | (uint32_t)c << 16 | (uint32_t)b << 8 | a;
-    }
-    case FORTS:
-      return decode_forts_seqno(buf, n, last_seqno, seq_reset);
-    default:
-      break;
-  }
-  return 0;
-}
-
 void inc_addrs() {
   if (++addrs_count == sizeof(addrs)/sizeof(addrs[0])) {
     fprintf(stderr, "Too many addresses provided (max=%lu)\n",
@@ -342,9 +334,9 @@ void parse_addr(char* s) {
   uint16_t*         port        = &paddr->port;
   data_fmt_t*       data_format = &paddr->data_format;
 
-  memset(paddr, 0, sizeof(struct address));
-
   paddr->id                     = addrs_count;
+  paddr->title                  = nullptr;
+  paddr->data_format            = UNDEFINED;
   paddr->fd                     = -1;
   *iface                        = INADDR_NONE;
   *mcast_addr                   = INADDR_NONE;
@@ -494,6 +486,12 @@ int main(int argc, char *argv[])
       isrc_addr = argv[++i];
     else if (!strcmp(argv[i], "-b") && i < argc-1)
       bsize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-B") && i < argc-1)
+      batch_size = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-S") && i < argc-1)
+      busy_poll_cpu = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-T"))
+      kernel_tstamps = 1;
     else if (!strcmp(argv[i], "-i") && i < argc-1)
       interval = atoi(argv[++i]);
     else if (!strcmp(argv[i], "-I") && i < argc-1)
@@ -569,8 +567,7 @@ int main(int argc, char *argv[])
     it->second.addresses.push_back(&addrs[i]);
 
     // NOTE: address lookup map is based on the NETWORK address byte order
-    auto key = addr_port(addrs[i].mcast_addr, addrs[i].port);
-    address_idx.emplace(std::make_pair(key, &addrs[i]));
+    receiver.add(addrs[i].mcast_addr, addrs[i].port, addrs[i]);
 
     if (inserted && verbose > 1)
       printf("Preparing listener address %s:%d on %s\n",
@@ -607,7 +604,27 @@ int main(int argc, char *argv[])
     }
   }
 
-  if (addrs_count > 1 && !use_epoll) {
+  if (batch_size < 1 || batch_size > 1024) {
+    fprintf(stderr, "Invalid batch size (-B): %d\n", batch_size);
+    exit(1);
+  }
+
+  rx.init(batch_size);
+
+  if (busy_poll_cpu >= 0) {
+    // Sockets are polled in a loop, so the reporting is driven by the loop
+    use_epoll = 0;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(busy_poll_cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+      perror("sched_setaffinity");
+      exit(1);
+    }
+    if (verbose > 1)
+      printf("Busy-polling on CPU core %d\n", busy_poll_cpu);
+  } else if (addrs_count > 1 && !use_epoll) {
     if (verbose)
       printf("Enabling epoll since more than one url provided!\n");
     use_epoll = 1;
@@ -721,9 +738,17 @@ int main(int argc, char *argv[])
           exit(1);
         }
       }
+
+      // Have the kernel stamp each packet with the time of its arrival
+      on = 1;
+      if (kernel_tstamps &&
+          setsockopt(listener.fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+        perror("setsockopt(SO_TIMESTAMPNS) failed");
+        exit(1);
+      }
     }
 
-    if (use_epoll)
+    if (use_epoll || busy_poll_cpu >= 0)
       non_blocking(listener.fd);
 
     {
@@ -808,7 +833,9 @@ int main(int argc, char *argv[])
     if (verbose > 2)
       printf("Reporting timer setup in %ld seconds\n",
         timeout.it_value.tv_sec - start_time/1000000000l);
+  }
 
+  if (tfd > 0 || (busy_poll_cpu >= 0 && interval)) {
     for (i=0; i < (int)(sizeof(sorted_addrs) / sizeof(sorted_addrs[0])); i++) {
       int j, sz = addrs_count * sizeof(address*);
       sorted_addrs[i] = (address**)malloc(static_cast<size_t>(sz));
@@ -824,10 +851,26 @@ int main(int argc, char *argv[])
   srand(static_cast<unsigned int>(time(NULL)));
   setjmp(jbuf);
 
+  if (busy_poll_cpu >= 0) {
+    long next_report = interval ? start_time + interval * 1000000000l : LONG_MAX;
+
+    while (!terminate) {
+      for (auto& ls : listeners)
+        receive_packets(&ls.second, MSG_DONTWAIT);
+
+      if (interval) {
+        long now = get_time();
+        if (now >= next_report) {
+          now_time     = now;
+          next_report += interval * 1000000000l;
+          print_report();
+        }
+      }
+    }
+  }
+
   while (!terminate) {
-    char databuf[16*1024];
     int  events_count;
-    long n;
 
     if (use_epoll) {
       if (verbose  > 4) printf("  Calling epoll(%d)...\n", efd);
@@ -842,9 +885,6 @@ int main(int argc, char *argv[])
       }
     } else {
       int fd = addrs[0].fd;
-      if (verbose > 4) printf("  Calling read(%d, size=%ld)...\n", fd, sizeof(databuf));
-      n = read(fd, databuf, sizeof(databuf));
-      if (verbose > 4) printf("  Got %ld bytes\n", n);
       events_count = 1;
       events[0].data.fd = fd;
       events[0].events  = EPOLLIN;
@@ -867,83 +907,14 @@ int main(int argc, char *argv[])
       auto   listener = listener_idx[events[i].data.fd];
       assert(listener->fd == events[i].data.fd);
 
-      char        ctlbuf[256];
-      iovec       iov[1];
-      msghdr      msg = {};
-      sockaddr_in peeraddr = {}; // Remote/src addr goes here
-
-      if (use_epoll) {
-        msg.msg_name        = (void*)&peeraddr;
-        msg.msg_namelen     = sizeof (peeraddr);
-        msg.msg_iov         = iov;
-        msg.msg_iovlen      = 1;
-        msg.msg_flags       = 0;
-        msg.msg_control     = ctlbuf;
-        msg.msg_controllen  = sizeof(ctlbuf);
-      }
-
-      do {
-        if (!use_epoll)
-          n = read(listener->fd, databuf, sizeof(databuf));
-        else {
-          do {
-            // http://man7.org/linux/man-pages/man2/recvmmsg.2.html
-            iov[0].iov_base = databuf;
-            iov[0].iov_len  = sizeof(databuf);
-            n = ::recvmsg(listener->fd, &msg, 0);
-          } while (n < 0 && errno == EINTR);
-
-          auto      src_addr = peeraddr.sin_addr.s_addr;
-          auto      src_port = peeraddr.sin_port;
-          in_addr_t dst_addr = 0;
-
-          if (n > 0) {
-            // Successful read returning 0 or more bytes read.
-            // Dst addr doesn't get sent by PKTINFO. Need to obtain it by getsockname()
-            // Control messages are always accessed via macros
-            // http://www.kernel.org/doc/man-pages/online/pages/man3/cmsg.3.html
-            for(auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
-              // ignore the control headers that don't match what we want
-              if (cm->cmsg_level == IPPROTO_IP &&
-                  cm->cmsg_type  == IP_PKTINFO)
-              {
-                in_pktinfo* pi = (in_pktinfo*)CMSG_DATA(cm);
-                //addr->if_addr = pi->ipi_spec_dst.s_addr; // Iface addr
-                dst_addr  = pi->ipi_addr.s_addr;     // Mcast addr
-                break;
-              }
-            }
-          } else {
-            // If it's 0 - on connected sockets this means that it got disconnected.
-            // errno == EGAIN means that no more data is available.
-            // Action is not to be invoked here if there is no new data:
-            if (errno != EAGAIN) {
-                if (!terminate) {
-                    perror("read");
-                    terminate = 1;
-                }
-                close(listener->fd);
-            }
-            break;
-          }
-
-          auto it = address_idx.find(addr_port(dst_addr, listener->port));
-
-          if (it == address_idx.end()) {
-            // Skip this packet
-            listener->skipped_packets++;
-            tot_skipped++;
-            continue;
-          }
-
-          auto addr      = it->second;
-          addr->src_addr = src_addr;
-          addr->src_port = src_port;
-          addr->dst_addr = dst_addr;     // Mcast addr
-
-          process_packet(addr, databuf, n);
-        }
-      } while (use_epoll);
+      if (!use_epoll) {
+        // Blocking read of the only socket
+        if (verbose > 4) printf("  Calling recvmmsg(%d, batch=%d)...\n", listener->fd, batch_size);
+        int cnt = receive_packets(listener, MSG_WAITFORONE);
+        if (verbose > 4) printf("  Got %d packets\n", cnt);
+      } else
+        // The socket is edge-triggered, so read it until it's drained
+        while (receive_packets(listener, 0) > 0 && !terminate);
     }
   }
 
@@ -976,26 +947,26 @@ static int intcmpa(long a, long b) { return a < b ? -1 : a > b; }
 static int intcmpd(long a, long b) { return a > b ? -1 : a < b; }
 
 static int crep_ooo_count(const struct address* a) {
-  return a->ooo_count - a->last_crep_ooo_count;
+  return a->out_of_order() - a->last_crep_ooo_count;
 }
 static int crep_gap_count(const struct address* a) {
-  return a->gap_count - a->last_crep_gap_count;
+  return a->gaps() - a->last_crep_gap_count;
 }
 static int crep_pkt_count(const struct address* a) {
-  return a->pkt_count - a->last_crep_pkt_count;
+  return a->packets() - a->last_crep_pkt_count;
 }
 
 int sort_by_bytes(const void* a, const void* b) {
   struct address* lhs = *(struct address**)a;
   struct address* rhs = *(struct address**)b;
-  int n = intcmpd(lhs->bytes_cnt, rhs->bytes_cnt);
+  int n = intcmpd(lhs->bytes(), rhs->bytes());
   return n ? n : intcmpa(lhs->port, rhs->port);
 }
 
 int sort_by_packets(const void* a, const void* b) {
   struct address* lhs = *(struct address**)a;
   struct address* rhs = *(struct address**)b;
-  int n = intcmpd(lhs->pkt_count, rhs->pkt_count);
+  int n = intcmpd(lhs->packets(), rhs->packets());
   return n ? n : intcmpa(lhs->port, rhs->port);
 }
 
@@ -1036,15 +1007,16 @@ void report_socket_stats() {
   static const int seqno_width = 9;
   const        int pad_title   = max_title_width - 5;
 
-  int i, max_ooo_count = 0, max_pkt_count = 0, max_bytes = 0, max_gap_count = 0;
+  int i;
+  uint64_t max_ooo_count = 0, max_pkt_count = 0, max_bytes = 0, max_gap_count = 0;
   int n = addrs_count > max_channel_report_lines ? max_channel_report_lines : addrs_count;
 
   for(i = 0; i < addrs_count; i++) {
     struct address* p = addrs + i;
-    if (p->bytes_cnt > max_bytes    ) max_bytes     = p->bytes_cnt;
-    if (p->pkt_count > max_pkt_count) max_pkt_count = p->pkt_count;
-    if (p->ooo_count > max_ooo_count) max_ooo_count = p->ooo_count;
-    if (p->gap_count > max_gap_count) max_gap_count = p->gap_count;
+    if (p->bytes() > max_bytes    ) max_bytes     = p->bytes();
+    if (p->packets() > max_pkt_count) max_pkt_count = p->packets();
+    if (p->out_of_order() > max_ooo_count) max_ooo_count = p->out_of_order();
+    if (p->gaps() > max_gap_count) max_gap_count = p->gaps();
   }
 
   for (i=0; i < (int)(sizeof(sort_funs)/sizeof(sort_funs[0])); i++)
@@ -1057,16 +1029,16 @@ void report_socket_stats() {
   for(i=0; i < n; i++) {
     struct address* pbytes = sorted_addrs[0][i];
     struct address* ppkts  = sorted_addrs[1][i];
-    if (!pbytes->bytes_cnt && !ppkts->pkt_count)
+    if (!pbytes->bytes() && !ppkts->packets())
       break;
-    //int gbytes = max_bytes     ? (int)(seqno_width * pbytes->bytes_cnt / max_bytes) : 0;
-    //int gpkts  = max_pkt_count ? (int)(seqno_width * ppkts->pkt_count / max_pkt_count) : 0;
+    //int gbytes = max_bytes     ? (int)(seqno_width * pbytes->bytes() / max_bytes) : 0;
+    //int gpkts  = max_pkt_count ? (int)(seqno_width * ppkts->packets() / max_pkt_count) : 0;
 
     printf("#C|%*s|%8.1f|%*ld|%*s|%9d|%*ld|\n",
-      max_title_width, pbytes->title, (double)pbytes->bytes_cnt/MEGABYTE,
-      seqno_width, pbytes->last_seqno,
-      max_title_width, ppkts ->title, ppkts->pkt_count,
-      seqno_width, ppkts->last_seqno);
+      max_title_width, pbytes->title, (double)pbytes->bytes()/MEGABYTE,
+      seqno_width, pbytes->last_seqno(),
+      max_title_width, ppkts ->title, (int)ppkts->packets(),
+      seqno_width, ppkts->last_seqno());
   }
 
   // Has any non-zero data?
@@ -1086,9 +1058,9 @@ void report_socket_stats() {
 
       printf("#c|%*s|%8d|%*ld|%*s|%9d|%*ld|\n",
         max_title_width,    gap_count ? pgaps ->title     : "", gap_count,
-        seqno_width,        gap_count ? pgaps->last_seqno : 0,
+        seqno_width,        gap_count ? pgaps->last_seqno() : 0,
         max_title_width,    ooo_count ? pooo  ->title     : "", ooo_count,
-        seqno_width,        ooo_count ? pooo->last_seqno  : 0);
+        seqno_width,        ooo_count ? pooo->last_seqno()  : 0);
     }
   }
 
@@ -1122,9 +1094,9 @@ void report_socket_stats() {
   for(i=0; i < addrs_count; i++) {
     struct address* a = &addrs[i];
     a->last_crep_pkt_changed = crep_pkt_count(a) > 0;
-    a->last_crep_ooo_count = a->ooo_count;
-    a->last_crep_gap_count = a->gap_count;
-    a->last_crep_pkt_count = a->pkt_count;
+    a->last_crep_ooo_count = a->out_of_order();
+    a->last_crep_gap_count = a->gaps();
+    a->last_crep_pkt_count = a->packets();
   }
 
   printf("#C|%*.*s|\n", width, width, SEP);
@@ -1167,13 +1139,13 @@ void print_report() {
 
     for(i = 0; i < addrs_count; i++) {
       struct address* addr = addrs + i;
-      if (addr->ooo_count - addr->last_srep_ooo_count)    socks_with_ooo++;
-      if (addr->gap_count - addr->last_srep_gap_count)    socks_with_gaps++;
-      if (!(addr->pkt_count - addr->last_srep_pkt_count)) socks_with_nodata++;
+      if (addr->out_of_order() - addr->last_srep_ooo_count)    socks_with_ooo++;
+      if (addr->gaps() - addr->last_srep_gap_count)    socks_with_gaps++;
+      if (!(addr->packets() - addr->last_srep_pkt_count)) socks_with_nodata++;
 
-      addr->last_srep_ooo_count = addr->ooo_count;
-      addr->last_srep_gap_count = addr->gap_count;
-      addr->last_srep_pkt_count = addr->pkt_count;
+      addr->last_srep_ooo_count = addr->out_of_order();
+      addr->last_srep_gap_count = addr->gaps();
+      addr->last_srep_pkt_count = addr->packets();
     }
 
     if (sec == 0.0) sec = 1.0;
@@ -1275,34 +1247,106 @@ in_addr_t get_ifaddr(int fd, const std::string& addr) {
   return a.s_addr;
 }
 
-void process_packet(address* addr, const char* buf, long n) {
-  long seqno;
+/*
+ * Read up to batch_size packets from the listener's socket with a single
+ * recvmmsg() call.
+ * Returns the number of packets read, 0 if there's no data, or -1 on error.
+ */
+int receive_packets(listener* l, int flags) {
+  for (int i=0; i < batch_size; ++i) {
+    msghdr& m         = rx.msgs[i].msg_hdr;
+    m.msg_namelen     = sizeof(sockaddr_in);
+    m.msg_controllen  = CTL_SIZE;
+    m.msg_flags       = 0;
+  }
+
+  int cnt;
+  do {
+    // http://man7.org/linux/man-pages/man2/recvmmsg.2.html
+    cnt = ::recvmmsg(l->fd, &rx.msgs[0], batch_size, flags, nullptr);
+  } while (cnt < 0 && errno == EINTR);
+
+  if (cnt <= 0) {
+    // errno == EGAIN means that no more data is available.
+    // Action is not to be invoked here if there is no new data:
+    if (cnt < 0 && errno == EAGAIN)
+      return 0;
+    if (!terminate) {
+      perror("recvmmsg");
+      terminate = 1;
+    }
+    close(l->fd);
+    return -1;
+  }
+
+  for (int i=0; i < cnt; ++i) {
+    msghdr&   msg      = rx.msgs[i].msg_hdr;
+    auto      src_addr = rx.peers[i].sin_addr.s_addr;
+    auto      src_port = rx.peers[i].sin_port;
+    in_addr_t dst_addr = 0;
+    long      rx_time  = 0;
+
+    // Dst addr doesn't get sent by PKTINFO. Need to obtain it by getsockname()
+    // Control messages are always accessed via macros
+    // http://www.kernel.org/doc/man-pages/online/pages/man3/cmsg.3.html
+    for(auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_PKTINFO) {
+        in_pktinfo* pi = (in_pktinfo*)CMSG_DATA(cm);
+        //addr->if_addr = pi->ipi_spec_dst.s_addr; // Iface addr
+        dst_addr  = pi->ipi_addr.s_addr;     // Mcast addr
+      } else if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+        timespec* ts = (timespec*)CMSG_DATA(cm);
+        rx_time   = ts->tv_sec * 1000000000l + ts->tv_nsec;
+      }
+    }
+
+    auto addr = receiver.find(dst_addr, l->port);
 
+    if (!addr) {
+      // Skip this packet
+      l->skipped_packets++;
+      tot_skipped++;
+      continue;
+    }
+
+    addr->src_addr = src_addr;
+    addr->src_port = src_port;
+    addr->dst_addr = dst_addr;     // Mcast addr
+
+    process_packet(addr, (const char*)msg.msg_iov->iov_base, rx.msgs[i].msg_len, rx_time);
+  }
+
+  return cnt;
+}
+
+void process_packet(address* addr, const char* buf, long n, long rx_time) {
   now_time = get_time();
 
-  /* Get timestamp of the packet */
-  if ((last_pkts < 1000 && pkts < 1000) || (rand() % 100) < 10) {
-    struct timespec ts1;
-    ioctl(addr->fd, SIOCGSTAMPNS, &ts1);
-    pkt_time = now_time - (ts1.tv_sec * 1000000000l + ts1.tv_nsec);
+  /* Get timestamp of the packet (kernel timestamps are available for all
+   * packets with -T, otherwise the latency is sampled) */
+  if (rx_time || (last_pkts < 1000 && pkts < 1000) || (rand() % 100) < 10) {
+    long ts = rx_time;
+    if (!ts) {
+      struct timespec ts1;
+      ioctl(addr->fd, SIOCGSTAMPNS, &ts1);
+      ts = ts1.tv_sec * 1000000000l + ts1.tv_nsec;
+    }
+    pkt_time = now_time - ts;
     sum_pkt_time += pkt_time;
     if (pkt_time < min_pkt_time) min_pkt_time = pkt_time;
     if (pkt_time > max_pkt_time) max_pkt_time = pkt_time;
     pkt_time_count++;
   }
 
-  addr->last_data_time = now_time;
-  addr->bytes_cnt += n;
-  addr->pkt_count++;
+  long last_seqno = addr->last_seqno();
+  auto status     = receiver.process(*addr, buf, n, now_time);
+  long seqno      = addr->last_seqno();
 
   tot_bytes += n;
   tot_pkts++;
   bytes += n;
   pkts++;
 
-  int seq_reset;
-  seqno = get_seqno(addr, buf, n, addr->last_seqno, &seq_reset);
-
   if (display_packets) {
     fprintf(stderr, "  %02d (fmt=%c) seqno=%ld (pkt size=%ld):\n   {",
       addr->id, addr->data_format, seqno, n);
@@ -1325,7 +1369,7 @@ void process_packet(address* addr, const char* buf, long n) {
   if (wfd != -1) {
     int rc;
     if (pcap_format) {
-      rc = pcap_file.write_packet(true, utxx::nsecs(now_time),
+      rc = pcap_file.write_packet(true, utxx::nsecs(rx_time ? rx_time : now_time),
                                   utxx::pcap::proto::udp,
                                   addr->src_addr, addr->src_port,
                                   addr->dst_addr, addr->dst_port,
@@ -1340,196 +1384,31 @@ void process_packet(address* addr, const char* buf, long n) {
     }
   }
 
-  if (seqno) {
-    if (addr->last_seqno) {
-      int diff = static_cast<int>(seqno - addr->last_seqno);
-      if (!seq_reset) {
-        if (diff < 0) {
-          if (verbose > 1)
-            printf("  %02d Out of order seqno (last=%ld, now=%ld): %d (%s)\n",
-              addr->id, addr->last_seqno, seqno, diff, addr->title);
-          addr->last_ooo_time = now_time;
-          addr->ooo_count++;
-          tot_ooo_count++;  /* out of order */
-          ooo_count++;
-        } else if (diff > 1) {
-          addr->last_gap_time = now_time;
-          addr->gap_count++;
-          tot_gap_count++;
-          gap_count++;
-          if (verbose > 1)
-            printf("  %02d Gap detected in seqno (last=%ld, now=%ld): %d (%s)\n",
-              addr->id, addr->last_seqno, seqno, diff, addr->title);
-        }
-
-      }
-    }
-    if (verbose > 3)
-      printf("%02d -> %ld (last_seqno=%ld)\n", addr->id, seqno, addr->last_seqno);
-
-    addr->last_seqno = seqno;
+  switch (status) {
+    case utxx::io::seqno_status::OUT_OF_ORDER:
+      if (verbose > 1)
+        printf("  %02d Out of order seqno (last=%ld, now=%ld): %ld (%s)\n",
+          addr->id, last_seqno, seqno, seqno - last_seqno, addr->title);
+      tot_ooo_count++;  /* out of order */
+      ooo_count++;
+      break;
+    case utxx::io::seqno_status::GAP:
+      tot_gap_count++;
+      gap_count++;
+      if (verbose > 1)
+        printf("  %02d Gap detected in seqno (last=%ld, now=%ld): %ld (%s)\n",
+          addr->id, last_seqno, seqno, seqno - last_seqno, addr->title);
+      break;
+    default:
+      break;
   }
 
+  if (verbose > 3 && status != utxx::io::seqno_status::NONE)
+    printf("%02d -> %ld (last_seqno=%ld)\n", addr->id, seqno, last_seqno);
+
   if (tot_pkts >= max_pkts)
     terminate = 1;
 
   if (verbose > 2)
     printf("Received %6ld bytes, %ld packets (%s)\n", n, tot_pkts, addr->title);
 }
-
-/*
-static int u32_to_size (uint32_t n)
-{
-  static const int s_table[] = {
-    5, 5, 5, 5,
-    4, 4, 4, 4, 4, 4, 4,
-    3, 3, 3, 3, 3, 3, 3, 
-    2, 2, 2, 2, 2, 2, 2,
-    1, 1, 1, 1, 1, 1, 1
-  };
-  int first_bit = n ? 31 : __builtin_clz(n);
-  return s_table[first_bit];
-}
-*/
-
-static int find_stopbit_byte(const char* buff, const char* end) {
-    const uint64_t s_mask = 0x8080808080808080ul;
-    const uint64_t*     p = (const uint64_t*)buff;
-
-    uint64_t unmasked = *p & s_mask;
-    int pos;
-
-    if (likely(unmasked)) {
-        pos = __builtin_ffsl(unmasked) >> 3;
-    } else {
-        // In case the stop bit is not found in 64 bits,
-        // we need to check next bytes
-        unmasked = *(++p) & s_mask;
-        pos = 8 + (__builtin_ffsl(unmasked) >> 3);
-    }
-
-    if (buff + pos < end)
-      return pos;
-
-    return 0;
-}
-
-
-int decode_uint_loop(const char** buff, const char* end, uint64_t* val) {
-  const char* p = *buff;
-  int e, i = 0;
-  uint64_t n = 0;
-
-  int len = find_stopbit_byte(p, end);
-
-  //printf("find_stopbit_byte(%02x) -> %d\n", (uint8_t)*p, len);
-
-  for (p += len-1, e = len*7; i < e; i += 7, --p) {
-    uint64_t m = (uint64_t)(*p & 0x7F) << i;
-    n |= m;
-    //printf(" %2d| 0x%02x, m=%lu, n=%lu\n", i / 7, (uint8_t)*p, m, n);
-  }
-
-  *val  = n;
-  *buff += len;
-  return len;
-}
-
-int unmask_7bit_uint56(const char** buff, const char* end, uint64_t* value) {
-    static const uint64_t s_mask   = 0x8080808080808080ul;
-    static const uint64_t s_unmask = 0x7F7F7F7F7F7F7F7Ful;
-
-    uint64_t v    = *(const uint64_t*)*buff;
-    uint64_t stop = v & s_mask;
-    if (stop) {
-        int      pos  = __builtin_ffsl(stop);
-        uint64_t shft = pos == 64 ? -1ul : (1ul << pos)-1;
-        pos  >>= 3;
-        *value = v & s_unmask & shft;
-        *buff += pos;
-        return pos;
-    }
-
-    *value = v & s_unmask;
-    *buff += 8;
-    return 0;
-}
-
-//-------------------------------------------------------------------------//
-// Extracting "PMap" and TemplateID:                                       //
-//-------------------------------------------------------------------------//
-// NB: "PMap" bits are stored in the resulting "uint64" in the order of incr-
-// easing significance, from 0 to 62 (bit 63 is unused).
-// Also note: "tid" may be NULL, in which case we get only the "PMap" (useful
-// for processing Sequences):
-//
-uint32_t decode_forts_seqno(const char* buff, int n, long last_seqno, int* seq_reset) {
-    const char* q = buff;
-    uint64_t  tid = 120, seq = 0, pmap;
-
-    while (tid == 120) { // reset
-      decode_uint_loop(&q, q+5, &pmap);
-      decode_uint_loop(&q, q+5, &tid);
-    }
-
-    //printf("PMAP=%x, TID=%d, *p=0x%02x\n", pmap, tid, (uint8_t)*q);
-    decode_uint_loop(&q, q+5, &seq);
-
-    // If sequence reset, parse new seqno
-    if (tid == 49) {
-      *seq_reset = 1;
-      decode_uint_loop(&q, q+10, &tid); // SendingTime
-      decode_uint_loop(&q, q+5,  &seq); // NewSeqNo
-    }
-
-    return seq;
-}
-
-void test_forts_decode() {
-  const uint8_t buffers0[] = 
-    {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xd8,0x23,0x63,0x2d,0x12,0x54,0x66,0x6d,0xf4,0x87,0x98
-    ,0xb1,0x30,0x2d,0x44,0xc7,0x22,0xec,0x0f,0x0a,0xc8,0x95,0x82,0x80,0xff,0x00,0x62
-    ,0xa7,0x89,0x80,0x00,0x52,0x11,0x55,0xeb,0x80,0x80,0x80,0x80,0x80,0xc0,0x81,0xb1
-    ,0x81,0x0f,0x0a,0xc9,0x83,0x80,0xff,0x00,0x62,0xa8,0x00,0xf1,0x80,0x80,0x80,0x80
-    ,0x80,0x80,0x80,0x80,0xb1,0x81,0x0f,0x0a,0xca,0x85,0x80,0xff,0x00,0x62,0xaa,0x00
-    ,0xe5,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0xb1,0x74,0x03,0x32,0x80,0x15,0x4f
-    ,0xec,0x83,0x80,0x82,0x00,0x68,0x9f,0x89,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80
-    ,0xb1,0x81,0x15,0x4f,0xed,0x84,0x80,0x82,0x00,0x68,0xa0,0x8d,0x80,0x81,0x80,0x80
-    ,0x80,0x80,0x80,0x80,0xb1,0x81,0x15,0x4f,0xee,0x85,0x80,0x82,0x00,0x68,0xa1,0x88
-    ,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0xb1,0x0f,0x0e,0x52,0x81,0x1c,0x21,0xc4
-    ,0x82,0x80,0x81,0x00,0x4c,0x9b,0x8c,0x80,0x80,0x80,0x80,0x80,0x80,0x80};
-
-  const uint8_t buffers1[] =
-    {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xd9,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0x82,0x81,0xd8
-    ,0x81,0xb1,0x33,0x3f,0x48,0xc7,0x22,0xec,0x1c,0x21,0xc5,0x95,0x82,0x80,0x81,0x00
-    ,0x4c,0x9b,0x8b,0x80,0x00,0x52,0x11,0x55,0xfd,0x80,0x80,0x80,0x80,0x80};
-
-  const uint8_t buffers2[] =
-    {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xda,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0x90,0x85,0xd8
-    ,0x82,0xb1,0x33,0x3f,0x48,0xc7,0x22,0xec,0x1c,0x21,0xc6,0x95,0x82,0x80,0x81,0x00
-    ,0x4c,0x9b,0x81,0x80,0x00,0x52,0x11,0x55,0xfd,0x80,0x80,0x80,0x80,0x80,0xc0,0x80
-    ,0xb1,0x81,0x1c,0x21,0xc7,0x95,0x80,0x81,0x00,0x4c,0xaf,0x04,0xaa,0x80,0x7f,0x0b
-    ,0x6d,0xb6,0x80,0x80,0x80,0x80,0x80,0x80,0xb0,0x7c,0x6d,0x74,0x80,0x1e,0x6b,0xef
-    ,0x82,0x80,0x82,0x00,0x73,0xf1,0x87,0x80,0x00,0x74,0x12,0xda,0x80,0x80,0x80,0x80
-    ,0x80,0x80,0xb0,0x81,0x1e,0x6b,0xf0,0x83,0x80,0x82,0x00,0x73,0xf0,0x86,0x80,0xfc
-    ,0x80,0x80,0x80,0x80,0x80,0xc0,0x81,0xb0,0x81,0x1e,0x6b,0xf1,0x84,0x80,0x82,0x00
-    ,0x73,0xef,0x89,0x80,0x84,0x80,0x80,0x80,0x80,0x80};
-
-  const uint8_t buffers3[] =
-    {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xdb,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0xd9,0x82,0xd8
-    ,0x82,0xb0,0x30,0x2d,0x3c,0xc7,0x22,0xec,0x1e,0x6b,0xf2,0x95,0x83,0x80,0x82,0x00
-    ,0x73,0xf0,0x81,0x80,0x00,0x52,0x11,0x56,0xdb,0x80,0x80,0x80,0x80,0x80,0xc0,0x80
-    ,0xb0,0x81,0x1e,0x6b,0xf3,0x95,0x80,0x82,0x00,0x71,0xe5,0x82,0x80,0x72,0x7b,0x1a
-    ,0xde,0x80,0x80,0x80,0x80,0x80};
-
-  const uint8_t* buffers[] = {buffers0, buffers1, buffers2, buffers3};
-
-  int i;
-  for (i=0; i < (int)(sizeof(buffers)/sizeof(buffers[0])); i++) {
-    const char* q = (const char*)buffers[i];
-    long last = 0;
-    int seq_reset;
-    uint32_t res = decode_forts_seqno(q, 40, last, &seq_reset);
-    printf("#%d res=%d\n", i, res);
-  }
-}
@@ -0,0 +1,396 @@
+//------------------------------------------------------------------------------
+/// \file  pcapreplay.cpp
+//------------------------------------------------------------------------------
+/// \brief Utility for replaying UDP payloads of a pcap file
+///
+/// The payloads are sent to a multicast group (or the packets' original
+/// destinations) or to a unix datagram socket, either at the original
+/// inter-packet timing, at a speed multiple of it, or at maximum rate.
+/// The timing is kept by busy-waiting on the CPU's tick counter.
+//------------------------------------------------------------------------------
+// Copyright (c) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//------------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <utxx/pcap_mmap.hpp>
+#include <utxx/high_res_timer.hpp>
+#include <utxx/path.hpp>
+#include <utxx/get_option.hpp>
+#include <utxx/timestamp.hpp>
+#include <utxx/version.hpp>
+#include <vector>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+void usage(std::string const& err="")
+{
+    auto prog = utxx::path::basename(
+        utxx::path::program::name().c_str(),
+        utxx::path::program::name().c_str() + utxx::path::program::name().size()
+    );
+
+    if (!err.empty())
+        cerr << "Invalid option: " << err << "\n\n";
+    else {
+        cerr << prog <<
+        " - Tool for replaying UDP packets of a pcap file\n"
+        "Copyright (c) 2026 Serge Aleynikov\n"  <<
+        VERSION() << "\n\n"                     <<
+        "Usage: " << prog                       <<
+        "[-V] [-h] -f InputFile [-m Addr:Port | -u UnixSocket] [-i IfAddr] [-t TTL]"
+                    " [-x Speed | -M] [-B BatchSize] [-l Loops] [-v]\n\n"
+        "   -V|--version            - Version\n"
+        "   -h|--help               - Help screen\n"
+        "   -f InputFile            - Input file name\n"
+        "   -m|--mcast Addr:Port    - Send all packets to this multicast group\n"
+        "                             (default: packet's original destination)\n"
+        "   -u|--unix  Path         - Send all packets to this unix datagram socket\n"
+        "   -i|--iface IfAddr       - Address of the interface sending multicast packets\n"
+        "   -t|--ttl   TTL          - Multicast time-to-live (default: 1)\n"
+        "   -x|--speed Speed        - Replay speed multiplier of original packet timing\n"
+        "                             (default: 1.0)\n"
+        "   -M|--max                - Send at maximum rate ignoring packet timing\n"
+        "   -B|--batch BatchSize    - Max number of packets sent by one sendmmsg() call\n"
+        "                             (default: 64). With packet timing, only packets due\n"
+        "                             at the same time are batched\n"
+        "   -l|--loop  Loops        - Number of times to replay the file (default: 1)\n"
+        "   -v                      - Verbose\n\n";
+    }
+
+    exit(1);
+}
+
+//------------------------------------------------------------------------------
+void unhandled_exception() {
+  auto p = current_exception();
+  try    { rethrow_exception(p); }
+  catch  ( exception& e ) { cerr << e.what() << endl; }
+  catch  ( ... )          { cerr << "Unknown exception" << endl; }
+  exit(1);
+}
+
+//------------------------------------------------------------------------------
+/// Histogram of timing errors (the delay of sending a packet after its
+/// scheduled time) in decimal buckets
+//------------------------------------------------------------------------------
+struct timing_histogram {
+    static const int s_buckets = 8;
+
+    uint64_t count[s_buckets] = {0};
+    uint64_t total  = 0;
+    long     sum    = 0;
+    long     max    = 0;
+
+    void add(long a_nsec) {
+        int  i = 0;
+        for (long n = 100; i < s_buckets-1 && a_nsec >= n; ++i, n *= 10);
+        ++count[i];
+        ++total;
+        sum += a_nsec;
+        if (a_nsec > max) max = a_nsec;
+    }
+
+    void print(FILE* a_out) const {
+        static const char* s_labels[] = {
+            "< 100ns", "< 1us", "< 10us", "< 100us", "< 1ms", "< 10ms", "< 100ms", ">= 100ms"
+        };
+        fprintf(a_out, "Timing error (send time - scheduled time):\n");
+        uint64_t cum = 0;
+        for (int i=0; i < s_buckets; ++i) {
+            cum += count[i];
+            fprintf(a_out, "  %-9s %12lu  %6.2f%%  (cum: %6.2f%%)\n", s_labels[i], count[i],
+                    total ? 100.0*count[i]/total : 0.0, total ? 100.0*cum/total : 0.0);
+        }
+        fprintf(a_out, "  Mean: %.3fus  Max: %.3fus\n",
+                total ? double(sum)/total/1000 : 0.0, double(max)/1000);
+    }
+};
+
+//------------------------------------------------------------------------------
+/// Convert "Addr:Port" to a socket address
+//------------------------------------------------------------------------------
+sockaddr_in parse_addr(const string& a_addr)
+{
+    auto        colon = a_addr.find(':');
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    if (colon == string::npos ||
+        inet_aton(a_addr.substr(0, colon).c_str(), &sa.sin_addr) == 0)
+        throw std::runtime_error("Invalid address: " + a_addr);
+    int port = atoi(a_addr.c_str() + colon + 1);
+    if (port <= 0 || port > 65535)
+        throw std::runtime_error("Invalid port: " + a_addr);
+    sa.sin_port = htons(port);
+    return sa;
+}
+
+//------------------------------------------------------------------------------
+/// Calibrate the tick counter against the monotonic clock
+/// @return number of ticks per nanosecond
+//------------------------------------------------------------------------------
+double ticks_per_nsec()
+{
+    auto now = []() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000L + ts.tv_nsec;
+    };
+    long     t0 = now();
+    auto     h0 = utxx::high_res_timer::gettime();
+    usleep(200000);
+    long     t1 = now();
+    auto     h1 = utxx::high_res_timer::gettime();
+    return double(utxx::high_res_timer::elapsed_hrtime(h1, h0)) / (t1 - t0);
+}
+
+//------------------------------------------------------------------------------
+//  MAIN
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    string in_file;
+    string mcast;
+    string unix_path;
+    string iface;
+    int    ttl         = 1;
+    double speed       = 1.0;
+    bool   max_rate    = false;
+    int    batch_size  = 64;
+    int    loops       = 1;
+    bool   verbose     = false;
+
+    set_terminate (&unhandled_exception);
+
+    utxx::opts_parser opts(argc, argv);
+
+    while (opts.next()) {
+        if (opts.match("-f", "",        &in_file))    continue;
+        if (opts.match("-m", "--mcast", &mcast))      continue;
+        if (opts.match("-u", "--unix",  &unix_path))  continue;
+        if (opts.match("-i", "--iface", &iface))      continue;
+        if (opts.match("-t", "--ttl",   &ttl))        continue;
+        if (opts.match("-x", "--speed", &speed))      continue;
+        if (opts.match("-M", "--max",   &max_rate))   continue;
+        if (opts.match("-B", "--batch", &batch_size)) continue;
+        if (opts.match("-l", "--loop",  &loops))      continue;
+        if (opts.match("-v", "",        &verbose))    continue;
+        if (opts.match("-V", "--version")) throw std::runtime_error(VERSION());
+        if (opts.is_help())                           usage();
+
+        usage(opts());
+    }
+
+    if (in_file.empty())
+        throw std::runtime_error("Must specify -f option!");
+    else if (!mcast.empty() && !unix_path.empty())
+        throw std::runtime_error("Cannot specify both -m and -u options!");
+    else if (speed <= 0)
+        throw std::runtime_error("Speed (-x) must be greater than 0!");
+    else if (batch_size < 1 || batch_size > 1024)
+        throw std::runtime_error("Batch size (-B) must be in the range [1..1024]!");
+    else if (loops < 1)
+        throw std::runtime_error("Number of loops (-l) must be greater than 0!");
+    else if (unix_path.size() >= sizeof(sockaddr_un::sun_path))
+        throw std::runtime_error("Unix socket path is too long: " + unix_path);
+
+    utxx::pcap_mmap fin(in_file);
+
+    //--------------------------------------------------------------------------
+    // Create the sending socket
+    //--------------------------------------------------------------------------
+    bool        use_unix = !unix_path.empty();
+    sockaddr_in mcast_addr;
+    sockaddr_un unix_addr;
+
+    int fd = socket(use_unix ? AF_UNIX : AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(string("Error creating socket: ") + strerror(errno));
+
+    int bufsz = 8*1024*1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsz, sizeof(bufsz));
+
+    if (use_unix) {
+        memset(&unix_addr, 0, sizeof(unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        strcpy(unix_addr.sun_path, unix_path.c_str());
+    } else {
+        if (!mcast.empty())
+            mcast_addr = parse_addr(mcast);
+
+        u_char loop = 1, mttl = ttl;
+        if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL,  &mttl, sizeof(mttl)) < 0)
+            throw std::runtime_error(string("Error setting multicast options: ") + strerror(errno));
+
+        if (!iface.empty()) {
+            in_addr ifa;
+            if (inet_aton(iface.c_str(), &ifa) == 0)
+                throw std::runtime_error("Invalid interface address: " + iface);
+            if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifa, sizeof(ifa)) < 0)
+                throw std::runtime_error(string("Error setting multicast interface: ")
+                                         + strerror(errno));
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Replay
+    //--------------------------------------------------------------------------
+    vector<mmsghdr>     msgs (batch_size);
+    vector<iovec>       iovs (batch_size);
+    vector<sockaddr_in> addrs(batch_size);
+    vector<long>        sched(batch_size);  // Scheduled send time of packets
+
+    double   tpn        = ticks_per_nsec();
+    uint64_t packets    = 0;
+    uint64_t bytes      = 0;
+    uint64_t skipped    = 0;
+    uint64_t send_calls = 0;
+    long     pcap_time  = 0;    // Duration of the capture (per loop)
+
+    timing_histogram hist;
+
+    if (verbose)
+        fprintf(stderr, "Replaying %s (%.3f ticks/ns, speed %.2fx%s)\n",
+                in_file.c_str(), tpn, speed, max_rate ? ", max rate" : "");
+
+    // Times below are in ticks since the start of replay
+    auto start = utxx::high_res_timer::gettime();
+    auto now   = [start]() { return long(utxx::high_res_timer::gettime() - start); };
+    auto to_ns = [tpn](long a_ticks) { return long(a_ticks / tpn); };
+
+    for (int loop = 0; loop < loops; ++loop) {
+        auto it  = fin.begin();
+        auto end = fin.end();
+        if (it == end)
+            break;
+
+        // Packets of a loop are scheduled relative to its start
+        long first_ts   = it->ts_nsec();
+        long loop_start = now();
+        auto due_time   = [=](const utxx::pcap_mmap::packet& a_pkt) {
+            return loop_start + long((a_pkt.ts_nsec() - first_ts) / speed * tpn);
+        };
+        long time_now   = loop_start;
+
+        while (it != end) {
+            if (!max_rate) {
+                // Wait until the next packet is due: sleep if it's far away,
+                // and busy-wait the remaining time
+                long due = due_time(*it);
+                long ahead;
+                while ((ahead = due - (time_now = now())) > 0)
+                    if (to_ns(ahead) > 2000000)
+                        usleep(to_ns(ahead) / 1000 - 1000);
+            }
+
+            int n = 0;
+            for (; it != end && n < batch_size; ++it) {
+                auto& pkt = *it;
+                long  due = max_rate ? 0 : due_time(pkt);
+                if (due > time_now)
+                    break;
+
+                auto udp = pkt.udp();
+                if (!udp) {
+                    ++skipped;
+                    continue;
+                }
+
+                auto& m = msgs[n].msg_hdr;
+                memset(&m, 0, sizeof(m));
+                iovs[n].iov_base = const_cast<char*>(pkt.payload());
+                iovs[n].iov_len  = pkt.payload_size();
+                m.msg_iov        = &iovs[n];
+                m.msg_iovlen     = 1;
+
+                if (use_unix) {
+                    m.msg_name    = &unix_addr;
+                    m.msg_namelen = sizeof(unix_addr);
+                } else if (!mcast.empty()) {
+                    m.msg_name    = &mcast_addr;
+                    m.msg_namelen = sizeof(mcast_addr);
+                } else {
+                    auto& a = addrs[n];
+                    memset(&a, 0, sizeof(a));
+                    a.sin_family      = AF_INET;
+                    a.sin_addr.s_addr = udp->ip.daddr;
+                    a.sin_port        = udp->udp.dest;
+                    m.msg_name        = &a;
+                    m.msg_namelen     = sizeof(a);
+                }
+                sched[n++] = due;
+                pcap_time  = pkt.ts_nsec() - first_ts;
+            }
+
+            for (int i = 0; i < n; ) {
+                long sent = max_rate ? 0 : now();
+                int  rc   = sendmmsg(fd, &msgs[i], n - i, 0);
+                ++send_calls;
+                if (rc < 0) {
+                    if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS)
+                        continue;
+                    throw std::runtime_error(string("Error sending packets: ") + strerror(errno));
+                }
+                if (!max_rate)
+                    for (int j = i; j < i + rc; ++j)
+                        hist.add(to_ns(sent - sched[j]));
+                for (int j = i; j < i + rc; ++j)
+                    bytes += iovs[j].iov_len;
+                i       += rc;
+                packets += rc;
+            }
+        }
+    }
+
+    long elapsed = to_ns(now());
+    close(fd);
+
+    //--------------------------------------------------------------------------
+    // Report
+    //--------------------------------------------------------------------------
+    double secs = elapsed / 1e9;
+    printf("Sent %lu packets (%lu bytes) in %.6fs using %lu send calls, skipped %lu non-UDP packets\n",
+           packets, bytes, secs, send_calls, skipped);
+    printf("Rate: %.0f pkts/s, %.3f MB/s\n",
+           secs > 0 ? packets / secs : 0.0, secs > 0 ? bytes / secs / 1e6 : 0.0);
+    if (!max_rate) {
+        printf("Capture duration: %.6fs per loop (expected replay time: %.6fs)\n",
+               pcap_time / 1e9, pcap_time / 1e9 / speed * loops);
+        hist.print(stdout);
+    }
+
+    return 0;
+}
@@ -39,12 +39,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/wait.h>
 #include <signal.h>
 #include <utxx/pcap.hpp>
+#include <utxx/pcap_mmap.hpp>
 #include <utxx/string.hpp>
 #include <utxx/path.hpp>
 #include <utxx/get_option.hpp>
 #include <utxx/buffer.hpp>
 #include <utxx/timestamp.hpp>
 #include <utxx/version.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -65,7 +71,8 @@ void usage(std::string const& err="")
         VERSION() << "\n\n"                     <<
         "Usage: " << prog                       <<
         "[-V] [-h] -f InputFile -s StartPktNum -e EndPktNum [-n NumPkts] [-c|--count]"
-                    " [-p|--print] [-o|-O OutputFile] [-h]\n\n"
+                    " [-i|--index] [--from Time] [--to Time] [-d|--dst IP[:Port]]"
+                    " [-j|--threads N] [-p|--print] [-o|-O OutputFile] [-h]\n\n"
         "   -V|--version            - Version\n"
         "   -h|--help               - Help screen\n"
         "   -f InputFile            - Input file name\n"
@@ -74,8 +81,20 @@ void usage(std::string const& err="")
         "   -s|--start StartPktNum  - Starting packet number (counting from 1)\n"
         "   -e|--end   EndPktNum    - Ending packet number (must be >= StartPktNum)\n"
         "   -n|--num   TotNumPkts   - Number of packets to save\n"
+        "   --from Time             - Select packets with timestamp >= Time\n"
+        "   --to   Time             - Select packets with timestamp <  Time\n"
+        "                             (Time format: YYYYMMDD-hh:mm:ss[.sss[sss]]\n"
+        "                             in local time zone)\n"
+        "   -d|--dst IP[:Port]      - Select packets sent to the IP address and port\n"
+        "                             (0 octets of IP and 0 Port match any value,\n"
+        "                             e.g. '239.0.0.0:5000', this option can be repeated)\n"
         "   -r|--raw                - Output raw packet payload only without pcap format\n"
-        "   -c|--count              - Count number of packets in the file\n"
+        "   -c|--count              - Count number of selected packets in the file\n"
+        "   -i|--index              - Use (or create) InputFile.idx index of packets\n"
+        "                             for fast positioning at StartPktNum/Time\n"
+        "   -j|--threads N          - Number of threads counting/saving packets\n"
+        "                             (with -i the file is processed in chunks in\n"
+        "                             parallel, otherwise it's read sequentially)\n"
         "   -p|--print              - Print packet source, destination, size\n"
         "   -P                      - Print decimal payload\n"
         "   -X                      - Print hexadecimal payload\n"
@@ -94,26 +113,84 @@ void unhandled_exception() {
   exit(1);
 }
 
+//------------------------------------------------------------------------------
+/// Destination filter (in network byte order) used with pcap::match_dst()
+//------------------------------------------------------------------------------
+struct dst_filter {
+    uint32_t ip_mask;
+    uint16_t port;
+};
+
+dst_filter parse_dst(const char* a_dst)
+{
+    auto   colon = strchr(a_dst, ':');
+    string addr  = colon ? string(a_dst, colon - a_dst) : string(a_dst);
+    int    port  = colon ? atoi(colon+1) : 0;
+    in_addr ip{0};
+    if ((!addr.empty() && inet_aton(addr.c_str(), &ip) == 0) || port < 0 || port > 65535)
+        throw std::runtime_error(string("Invalid destination address: ") + a_dst);
+    return dst_filter{ip.s_addr, htons(uint16_t(port))};
+}
+
+//------------------------------------------------------------------------------
+/// Packet selection criteria
+//------------------------------------------------------------------------------
+struct selector {
+    long               from = 0;        // Time range [from, to) in nanoseconds
+    long               to   = 0;
+    vector<dst_filter> dst;
+
+    bool operator()(const utxx::pcap_mmap::packet& a_pkt) const {
+        auto ts = a_pkt.ts_nsec();
+        if (ts < from || (to && ts >= to))
+            return false;
+        if (dst.empty())
+            return true;
+        for (auto& f : dst)
+            if (a_pkt.match_dst_ip(f.ip_mask, f.port))
+                return true;
+        return false;
+    }
+};
+
+//------------------------------------------------------------------------------
+/// Part of the input file processed by a worker thread.  Chunks start at
+/// packet boundaries, and the selected data is written in the chunk order.
+//------------------------------------------------------------------------------
+struct chunk {
+    uint64_t                            begin = 0;  // Offset of first packet
+    uint64_t                            end   = 0;  // Offset past last packet
+    size_t                              count = 0;  // Number of selected packets
+    vector<pair<const char*, size_t>>   data;       // Selected data to write
+    bool                                done  = false;
+};
+
 //------------------------------------------------------------------------------
 //  MAIN
 //------------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
-    string in_file;
-    string out_file;
-    size_t pk_start    = 1, pk_end = 0, pk_cnt = 0;
-    bool   overwrite   = false;
-    bool   raw_mode    = false;
-    bool   count       = false;
-    bool   verbose     = false;
-    bool   print       = false;
-    bool   payload     = false;
-    bool   payload_hex = false;
+    string   in_file;
+    string   out_file;
+    string   from, to;
+    selector select;
+    size_t   pk_start    = 1, pk_end = 0, pk_cnt = 0;
+    bool     overwrite   = false;
+    bool     raw_mode    = false;
+    bool     count       = false;
+    bool     verbose     = false;
+    bool     print       = false;
+    bool     payload     = false;
+    bool     payload_hex = false;
+    bool     use_index   = false;
+    int      threads     = 1;
 
     set_terminate (&unhandled_exception);
 
     utxx::opts_parser opts(argc, argv);
 
+    auto add_dst = [&select](const char* a) { select.dst.push_back(parse_dst(a)); };
+
     while (opts.next()) {
         if (opts.match("-f", "",        &in_file))  continue;
         if (opts.match("-o", "",        &out_file)) continue;
@@ -122,7 +199,12 @@ int main(int argc, char *argv[])
         if (opts.match("-s", "--start", &pk_start)) continue;
         if (opts.match("-e", "--end",   &pk_end))   continue;
         if (opts.match("-n", "--num",   &pk_cnt))   continue;
+        if (opts.match("",   "--from",  &from))     continue;
+        if (opts.match("",   "--to",    &to))       continue;
+        if (opts.match("-d", "--dst",   add_dst))   continue;
         if (opts.match("-c", "--count", &count))    continue;
+        if (opts.match("-i", "--index", &use_index))continue;
+        if (opts.match("-j", "--threads",&threads)) continue;
         if (opts.match("-v", "",        &verbose))  continue;
         if (opts.match("-p", "--print", &print))    continue;
         if (opts.match("-P", "",        &print))  { payload=true; continue; }
@@ -133,15 +215,26 @@ int main(int argc, char *argv[])
         usage(opts());
     }
 
+    if (!from.empty())
+        select.from = utxx::timestamp::from_string(from.c_str(), from.size(), false).nanoseconds();
+    if (!to.empty())
+        select.to   = utxx::timestamp::from_string(to.c_str(),   to.size(),   false).nanoseconds();
+
+    bool filtered = select.from || select.to || !select.dst.empty();
+
     if (pk_end > 0 && pk_cnt > 0)
         throw std::runtime_error("Cannot specify both -n and -e options!");
-    else if (!pk_end && !pk_cnt && !count && !print)
-        throw std::runtime_error("Must specify either -n or -e option!");
-    else if (!pk_start && !count)
+    else if (!pk_end && !pk_cnt && !count && !print && !filtered)
+        throw std::runtime_error("Must specify either -n, -e, --from, --to or -d option!");
+    else if (!pk_start)
         throw std::runtime_error("PktStartNumber (-s) must be greater than 0!");
     else if (pk_end && pk_end < pk_start)
         throw std::runtime_error
              ("Ending packet number (-e) must not be less than starting packet number (-s)!");
+    else if (select.to && select.to <= select.from)
+        throw std::runtime_error("Ending time (--to) must be greater than starting time (--from)!");
+    else if (threads < 1)
+        throw std::runtime_error("Number of threads (-j) must be greater than 0!");
     else if (in_file.empty() || (!count && !print && out_file.empty()))
         throw std::runtime_error("Must specify -f and -o options!");
     else if (!count && !out_file.empty() && utxx::path::file_exists(out_file)) {
@@ -157,113 +250,186 @@ int main(int argc, char *argv[])
         pk_cnt = 0;
     }
 
-    utxx::pcap fin;
-    if (fin.open_read(in_file) < 0)
-        throw std::runtime_error("Error opening " + in_file + ": " + strerror(errno));
-    else if (fin.read_file_header() < 0)
-        throw std::runtime_error("File " + in_file + " is not in PCAP format!");
+    utxx::pcap_mmap fin(in_file);
+
+    if (use_index)
+        fin.index();
 
     int n = 0;
     utxx::pcap fout(fin.big_endian(), fin.nsec_time());
 
-    if (!count && !out_file.empty()) {
+    if (!count && !print && !out_file.empty()) {
         n = raw_mode ? fout.open(out_file.c_str(), "wb")
-                    : fout.open_write(out_file, false, fin.get_link_type());
+                    : fout.open_write(out_file, false, fin.link_type());
         if (n < 0)
             throw std::runtime_error("Error creating file " + out_file + ": " + strerror(errno));
     }
 
-    utxx::basic_io_buffer<(1024*1024)> buf;
+    // Packets before pk_start are skipped without reading them when the
+    // index is available
+    auto first = fin.seek(pk_start-1);
+    auto last  = pk_end ? fin.seek(pk_end) : fin.end();
+
+    // With the index the time range is located by binary search
+    if (fin.has_index() && select.from) {
+        auto it = fin.seek(utxx::nsecs(select.from));
+        if (it.number() > first.number()) first = it;
+    }
+    if (fin.has_index() && select.to) {
+        auto it = fin.seek(utxx::nsecs(select.to));
+        if (it.number() < last.number())  last  = it;
+    }
 
     if (print || verbose) {
         printf("# Time                   %-20s %-20s %10s %10s",
                "Source", "Destination", "Pkt", "Bytes");
         if (verbose)
-            printf(" %7s %10s %10s", "FrameSz", "BufSz", "BufPos");
+            printf(" %7s %10s", "FrameSz", "Offset");
         putchar('\n');
     }
 
-    while ((n = fin.read(buf.wr_ptr(), buf.capacity())) > 0) {
-        buf.commit(n);
-        if (verbose)
-            cerr << "Read "    << n   << " bytes from source file (offset="
-                 << fin.tell() << ") BufPos=" << (buf.rd_ptr()-buf.address())
-                 << " BufSz="  << buf.size()  << " BufCap=" << buf.capacity()
-                 << endl;
-
-        int sz = 0;
-
-        while (buf.size() > sizeof(utxx::pcap::packet_header)) {
-            const char*       header;
-            const char*       begin  = header = buf.rd_ptr();
-            int               frame_sz;
-            utxx::pcap::proto proto;
-
-            // sz - total size of payload including frame_sz
-            std::tie(frame_sz, sz, proto) = fin.read_packet_hdr_and_frame(begin, n);
-
-            if (frame_sz < 0 || int(buf.size()) < sz) { // Not enough data in the buffer
-                if (verbose && frame_sz < 0)
-                    cerr << "Pkt#" << (pk_cnt+1) << ": Cannot read frame size of packet\n";
-                break;
-            }
+    if (print) {
+        for (auto it = first; it != last; ++it) {
+            auto& pkt = *it;
 
-            if (print || verbose) {
-                char src[32], dst[32];
-                if (fin.uframe().ip.protocol == IPPROTO_UDP) {
-                    fin.uframe().src(src);
-                    fin.uframe().dst(dst);
-                } else {
-                    fin.tframe().src(src);
-                    fin.tframe().dst(dst);
-                }
-                cout << utxx::time_val(fin.packet().ts_sec,fin.packet().ts_usec)
-                     << ' ' << setw(20) << std::left  << src
-                     << ' ' << setw(20) << std::left  << dst
-                     << ' ' << setw(10) << std::right << (pk_cnt+1)
-                     << ' ' << setw(7)  << frame_sz
-                     << ' ' << setw(10) << (sz-frame_sz);
-                if (verbose)
-                    cout << ' '  << setw(10) << buf.size()
-                         << ' '  << setw(10) << (buf.rd_ptr()-buf.address());
-                cout << endl;
-                if (payload) {
-                    cout << utxx::to_bin_string(buf.rd_ptr()+frame_sz, sz-frame_sz, payload_hex, true, true);
-                }
+            if (filtered && !select(pkt))
+                continue;
 
+            char src[32] = "", dst[32] = "";
+            if (auto p = pkt.udp()) {
+                p->src(src);
+                p->dst(dst);
+            } else if (auto p = pkt.tcp()) {
+                p->src(src);
+                p->dst(dst);
             }
+            cout << pkt.ts()
+                 << ' ' << setw(20) << std::left  << src
+                 << ' ' << setw(20) << std::left  << dst
+                 << ' ' << setw(10) << std::right << (it.number()+1)
+                 << ' ' << setw(10) << pkt.payload_size();
+            if (verbose)
+                cout << ' '  << setw(7)  << pkt.payload_offset()
+                     << ' '  << setw(10) << pkt.offset();
+            cout << endl;
+            if (payload)
+                cout << utxx::to_bin_string(pkt.payload(), pkt.payload_size(),
+                                            payload_hex, true, true);
+        }
+        return 0;
+    }
 
-            if (++pk_cnt >= pk_start && (!count && !print)) {
-                if (pk_cnt > pk_end)
-                    goto DONE;
-
-                // Write to the output file
-                if (!raw_mode) {
-                    fout.write_packet_header(fin.packet());
-                    buf.read(sizeof(utxx::pcap::packet_header));
-                    sz    -= sizeof(utxx::pcap::packet_header);
-                } else {
-                    buf.read(frame_sz);
-                    sz    -= frame_sz;
-                }
-                if (fout.write(buf.rd_ptr(), sz) < 0)
-                    throw std::runtime_error(string("Error writing to file: ") + strerror(errno));
-            }
+    // The index has the number of packets in the range
+    if (count && !filtered && fin.has_index()) {
+        cout << (last.number() - first.number()) << " packets\n";
+        return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    // Split the selected range of the file in chunks at packet boundaries,
+    // filter the chunks on worker threads, and write the selected data of
+    // the chunks in order on this thread
+    //--------------------------------------------------------------------------
+    static const uint64_t s_chunk_size = 64*1024*1024;
+
+    // Exact packet boundaries are only known from the index (without it
+    // pcap_mmap::sync() may take a packet header in the payload for a real
+    // one), so otherwise the file is read sequentially as a single chunk
+    if (threads > 1 && !fin.has_index()) {
+        if (verbose)
+            cerr << "No index (-i): reading the file sequentially" << endl;
+        threads = 1;
+    }
+
+    uint64_t begin  = first->offset();
+    uint64_t end    = last == fin.end() ? fin.size() : last->offset();
+    size_t   window = 4 * threads;  // Max number of chunks pending output
+
+    vector<chunk> chunks;
+    for (auto off = begin; off < end; ) {
+        chunk c;
+        c.begin = off;
+        if (threads > 1) {
+            auto it = fin.sync(c.begin + s_chunk_size);
+            c.end   = it == fin.end() ? end : std::min(end, it->offset());
+        } else
+            c.end   = end;
+        chunks.push_back(std::move(c));
+        off     = chunks.back().end;
+    }
 
-            buf.read(sz);
+    if (verbose)
+        cerr << "Processing " << (end - begin) << " bytes in " << chunks.size()
+             << " chunks on " << threads << " threads" << endl;
+
+    mutex              mtx;
+    condition_variable cv;
+    atomic<size_t>     next_chunk{0};
+    size_t             written = 0;
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next_chunk++) < chunks.size()) {
+            {
+                unique_lock<mutex> g(mtx);
+                cv.wait(g, [&]() { return i < written + window; });
+            }
+            auto& c = chunks[i];
+            for (auto it = fin.at(c.begin); it != fin.end() && it->offset() < c.end; ++it) {
+                auto& pkt = *it;
+                if (filtered && !select(pkt))
+                    continue;
+                ++c.count;
+                if (count)
+                    continue;
+                auto   data = raw_mode ? pkt.payload() : fin.begin_ptr() + pkt.offset();
+                size_t sz   = raw_mode ? pkt.payload_size()
+                                       : sizeof(utxx::pcap::packet_header) + pkt.size();
+                // Adjacent selected packets are written with a single call
+                if (!c.data.empty() && c.data.back().first + c.data.back().second == data)
+                    c.data.back().second += sz;
+                else if (sz)
+                    c.data.emplace_back(data, sz);
+            }
+            lock_guard<mutex> g(mtx);
+            c.done = true;
+            cv.notify_all();
         }
+    };
 
-        buf.crunch();
-        if (sz >= 0)
-            buf.reserve(sz);
+    vector<thread> workers;
+    for (int i=0; i < threads; ++i)
+        workers.emplace_back(worker);
+
+    size_t total = 0;
+
+    for (size_t i=0; i < chunks.size(); ++i) {
+        auto& c = chunks[i];
+        {
+            unique_lock<mutex> g(mtx);
+            cv.wait(g, [&c]() { return c.done; });
+        }
+        for (auto& d : c.data)
+            if (fout.write(d.first, d.second) < 0)
+                throw std::runtime_error(string("Error writing to file: ") + strerror(errno));
+        total += c.count;
+        vector<pair<const char*, size_t>>().swap(c.data);
+
+        lock_guard<mutex> g(mtx);
+        written = i+1;
+        cv.notify_all();
     }
 
-  DONE:
+    for (auto& t : workers)
+        t.join();
+
     fout.close();
     fin.close();
 
     if (count)
-        cout << pk_cnt << " packets\n";
+        cout << total << " packets\n";
+    else if (verbose)
+        cerr << "Saved " << total << " packets" << endl;
 
     return 0;
 }
@@ -42,7 +42,18 @@ template<> double variant::to<double>() const {
         case TYPE_BOOL:     return to_bool() ? 1.0 : 0.0;
         case TYPE_INT:      return (double)to_int();
         case TYPE_DOUBLE:   return to_double();
-        case TYPE_STRING:   return std::atof(c_str());
+        case TYPE_STRING:   {
+            // Same as std::atof(): leading white space is skipped, and 0.0
+            // is returned if the string doesn't start with a number.
+            // Special values ("inf", "nan", hex) are left to strtod()
+            auto& s = to_str();
+            auto  p = s.c_str(), end = p + s.size();
+            while (p < end && isspace(*p)) ++p;
+            double res = 0.0;
+            if (atof(p, end, res) == p)
+                res = strtod(p, nullptr);
+            return res;
+        }
         default:            UTXX_THROW_RUNTIME_ERROR("Unsupported variant type: ", type());
     }
 }
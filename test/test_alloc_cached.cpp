@@ -0,0 +1,211 @@
+//----------------------------------------------------------------------------
+/// \file   test_alloc_cached.cpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Test cases for the cached allocator.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+#include <utxx/alloc_cached.hpp>
+#include <utxx/time_val.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace utxx;
+using namespace utxx::memory;
+
+namespace {
+    typedef cached_allocator<char>                              mag_alloc;
+    typedef cached_allocator<char, std::allocator<char>, 24, 21, 0> nomag_alloc;
+}
+
+BOOST_AUTO_TEST_CASE( test_alloc_cached_size_classes )
+{
+    mag_alloc a;
+
+    // Small objects use the min size class, objects of 2^SizeClasses and
+    // larger bypass the cache
+    char* p = a.allocate(1);
+    BOOST_CHECK_EQUAL(5u, mag_alloc::size_class(p));
+    char* q = a.allocate(1 << 21);
+    BOOST_CHECK_EQUAL(22u, mag_alloc::size_class(q));
+    BOOST_CHECK_EQUAL(1u, a.large_objects());
+    a.free(q);
+    BOOST_CHECK_EQUAL(0u, a.large_objects());
+
+    memset(p, 'x', 16);
+    p = static_cast<char*>(a.reallocate(p, 100));
+    BOOST_CHECK_EQUAL(7u, mag_alloc::size_class(p));
+    BOOST_CHECK_EQUAL(std::string(16, 'x'), std::string(p, 16));
+    a.free(p);
+
+    BOOST_CHECK_EQUAL(32u, mag_alloc::magazine_size(5));
+    BOOST_CHECK_EQUAL(16u, mag_alloc::magazine_size(12));
+    BOOST_CHECK_EQUAL(0u,  mag_alloc::magazine_size(16));
+    BOOST_CHECK_EQUAL(0u,  nomag_alloc::magazine_size(5));
+
+    // Freed chunks are reused by the thread in LIFO order
+    std::vector<char*> v;
+    for (int i = 0; i < 10; ++i) v.push_back(a.allocate(40));
+    for (auto c : v) a.free(c);
+    for (int i = 9; i >= 0; --i) BOOST_CHECK(v[i] == a.allocate(40));
+    for (auto c : v) a.free(c);
+
+    auto st = a.stats(6);
+    BOOST_CHECK_EQUAL(10u, st.hits);
+    BOOST_CHECK_EQUAL(10u, st.misses);
+    BOOST_CHECK_EQUAL(0u,  st.refills);
+    BOOST_CHECK_EQUAL(0u,  st.flushes);
+}
+
+BOOST_AUTO_TEST_CASE( test_alloc_cached_magazines )
+{
+    mag_alloc a;
+    const size_t sc = 6, M = mag_alloc::magazine_size(sc);
+
+    // A thread freeing 2*M chunks returns a full magazine to the depot
+    std::vector<char*> v;
+    for (size_t i = 0; i < 2*M; ++i) v.push_back(a.allocate(40));
+    for (auto c : v) a.free(c);
+    BOOST_CHECK_EQUAL(1u, a.stats(sc).flushes);
+
+    // Another thread takes the magazine, and returns the remaining chunks on
+    // exit
+    std::vector<char*> w;
+    mag_alloc::class_stats st;
+    std::thread t([&]() {
+        for (size_t i = 0; i < M; ++i) w.push_back(a.allocate(40));
+        st = a.stats(sc);
+        for (size_t i = 0; i < M/2; ++i) a.free(w[i]);
+    });
+    t.join();
+    BOOST_CHECK_EQUAL(1u, st.refills);
+    BOOST_CHECK_EQUAL(2*M + 1, st.misses);
+    BOOST_CHECK_EQUAL(M - 1, st.hits);
+
+    st = a.stats(sc);
+    BOOST_CHECK_EQUAL(2u, st.flushes);
+    BOOST_CHECK_EQUAL(2*M + 1, st.misses);
+
+    // All chunks were allocated once, and are reused
+    for (size_t i = 0; i < M; ++i)
+        BOOST_CHECK(std::find(v.begin(), v.end(), w[i]) != v.end());
+    std::vector<char*> x;
+    for (size_t i = 0; i < M + M/2; ++i) x.push_back(a.allocate(40));
+    for (size_t i = M/2; i < M; ++i) x.push_back(w[i]);
+    std::sort(x.begin(), x.end());
+    std::sort(v.begin(), v.end());
+    BOOST_CHECK(v == x);
+    for (auto c : x) a.free(c);
+}
+
+namespace {
+    // Producer threads allocate messages and pass them to a consumer that
+    // frees them, so that the chunks migrate between threads' magazines
+    template <class Alloc>
+    void produce_consume(int a_producers, long a_count)
+    {
+        Alloc a;
+        const int      QSZ = 1024;
+        std::atomic<char*> queue[QSZ];
+        for (auto& q : queue) q = nullptr;
+        std::atomic<long>  done(0), errors(0);
+
+        std::thread consumer([&]() {
+            long n = 0;
+            for (int i = 0; n < a_count * a_producers; i = (i+1) % QSZ)
+                if (char* p = queue[i].exchange(nullptr)) {
+                    if (*p != 'm') ++errors;
+                    a.free(p);
+                    ++n;
+                } else
+                    std::this_thread::yield();
+            done = n;
+        });
+
+        std::vector<std::thread> producers;
+        for (int k = 0; k < a_producers; ++k)
+            producers.emplace_back([&, k]() {
+                for (long i = 0; i < a_count; ++i) {
+                    char* p = a.allocate(40);
+                    *p = 'm';
+                    for (int j = (k + i) % QSZ; ; j = (j+1) % QSZ) {
+                        char* expected = nullptr;
+                        if (queue[j].compare_exchange_weak(expected, p)) break;
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        for (auto& p : producers) p.join();
+        consumer.join();
+        BOOST_CHECK_EQUAL(a_count * a_producers, done.load());
+        BOOST_CHECK_EQUAL(0, errors.load());
+
+        auto st = a.stats(6);
+        BOOST_CHECK_EQUAL(st.refills * Alloc::magazine_size(6) > 0,
+                          Alloc::magazine_size(6) > 0);
+    }
+
+    // Each thread allocates a burst of short-lived objects of mixed sizes
+    // and frees them
+    template <class Alloc>
+    double churn(int a_threads, long a_count)
+    {
+        Alloc a;
+        timer t;
+        std::vector<std::thread> threads;
+        for (int k = 0; k < a_threads; ++k)
+            threads.emplace_back([&]() {
+                char* p[64];
+                for (long i = 0; i < a_count; i += 64) {
+                    for (int j = 0; j < 64; ++j) p[j] = a.allocate(16 + (j & 3) * 40);
+                    for (int j = 0; j < 64; ++j) a.free(p[j]);
+                }
+            });
+        for (auto& th : threads) th.join();
+        return t.latency_nsec(a_count * a_threads);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_alloc_cached_threads )
+{
+    produce_consume<nomag_alloc>(3, 50000);
+    produce_consume<mag_alloc>  (3, 50000);
+
+    const long N = getenv("ITERATIONS") ? atol(getenv("ITERATIONS")) : 2000000;
+
+    for (int threads : {1, 4}) {
+        double t1 = churn<nomag_alloc>(threads, N);
+        double t2 = churn<mag_alloc>(threads, N);
+        BOOST_TEST_MESSAGE("cached_allocator with " << threads
+                           << " threads: alloc+free " << t1 << " ns (no magazines), "
+                           << t2 << " ns (magazines)");
+    }
+}
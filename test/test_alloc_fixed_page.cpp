@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <boost/test/unit_test.hpp>
 #include <utxx/alloc_fixed_page.hpp>
 #include <utxx/verbosity.hpp>
+#include <utxx/time_val.hpp>
 #include <vector>
 #include <iostream>
 
@@ -64,3 +65,64 @@ BOOST_AUTO_TEST_CASE( test_alloc_fixed_page )
 
 }
 
+BOOST_AUTO_TEST_CASE( test_alloc_fixed_page_backing )
+{
+    using namespace memory;
+    const size_t page_sz = 64*1024;
+
+    // The options degrade gracefully where huge pages, locking or NUMA
+    // aren't available
+    for (auto huge : {huge_pages::NONE, huge_pages::TRANSPARENT, huge_pages::HUGETLB}) {
+        page_backing_options opts;
+        opts.huge      = huge;
+        opts.lock      = true;
+        opts.numa_node = page_backing::this_numa_node();
+        page_backing backing(page_sz, opts);
+        backing.reserve(40);
+        BOOST_REQUIRE(backing.free_pages() >= 40);
+        if (huge != huge_pages::NONE)
+            BOOST_REQUIRE_EQUAL(0u, backing.mapped() % page_backing::s_huge_page_size);
+        size_t free_pages = backing.free_pages();
+
+        {
+            aligned_page_allocator<test, page_sz> alloc(&backing);
+            BOOST_REQUIRE(alloc.backing() == &backing);
+            std::vector<test*> v;
+            for (int i = 0; i < 20000; i++) {
+                test* p = alloc.allocate(1);
+                memset(p, i, sizeof(test));
+                v.push_back(p);
+            }
+            BOOST_REQUIRE(backing.free_pages() < free_pages - 10);
+            for (auto p : v)
+                alloc.deallocate(p, 1);
+        }
+        BOOST_REQUIRE_EQUAL(free_pages, backing.free_pages());
+
+        BOOST_TEST_MESSAGE("page_backing(huge=" << int(huge)
+                           << "): hugetlb=" << backing.huge_tlb()
+                           << ", locked=" << backing.locked()
+                           << ", numa_node=" << opts.numa_node
+                           << " (bound=" << backing.numa_bound() << ")");
+    }
+
+    // Mismatching page size
+    page_backing backing(4096);
+    BOOST_REQUIRE_THROW((aligned_page_allocator<test, page_sz>(&backing)),
+                        utxx::badarg_error);
+    BOOST_REQUIRE_THROW(page_backing(1000), utxx::badarg_error);
+
+    // Cost of page faults avoided by prefaulting
+    for (bool prefault : {false, true}) {
+        page_backing_options opts;
+        opts.huge     = huge_pages::NONE;
+        opts.prefault = prefault;
+        page_backing b(page_sz, opts);
+        b.reserve(256);
+        timer t;
+        for (int i = 0; i < 256; i++)
+            memset(b.allocate(), 1, page_sz);
+        BOOST_TEST_MESSAGE("Writing 256 pages of 64K with prefault=" << prefault
+                           << ": " << t.elapsed() * 1e3 << " ms");
+    }
+}
@@ -23,7 +23,9 @@
 #include <sys/time.h>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <sstream>
 
 using std::vector;
 using std::string;
@@ -593,3 +595,234 @@ BOOST_AUTO_TEST_CASE( test_atomic_hash_map_atomic_hash_array_insert_race) {
             BOOST_CHECK_EQUAL(arr->size(), uintptr_t(statuses[j]));
     }
 }
+
+BOOST_AUTO_TEST_CASE( test_atomic_hash_map_rehash ) {
+    const int numEntries = 10000;
+
+    AHMapT m(numEntries / 8, config);
+    for (int i = 0; i < numEntries; ++i)
+        BOOST_REQUIRE(m.insert(RecordT(i, genVal(i))).second);
+    BOOST_CHECK(m.num_submaps() > 1);
+
+    // Erased keys leave tombstones behind that aren't reused by inserts
+    for (int i = 0; i < numEntries; i += 2)
+        BOOST_REQUIRE_EQUAL(1u, m.erase(i));
+    size_t room = m.remaining_space();
+
+    m.rehash();
+    BOOST_CHECK(!m.rehashing());
+    BOOST_CHECK_EQUAL(1u, m.rehash_count());
+    BOOST_CHECK_EQUAL(1u, m.num_submaps());
+    BOOST_CHECK(m.remaining_space() > room + numEntries / 4);
+    BOOST_CHECK_EQUAL(size_t(numEntries / 2), m.size());
+
+    bool success = true;
+    for (int i = 0; i < numEntries; ++i) {
+        auto it = m.find(i);
+        if (i & 1)
+            success &= it != m.end() && it->second == genVal(i)
+                    && m.find_at(it.index())->first == i;
+        else
+            success &= it == m.end();
+    }
+    BOOST_CHECK(success);
+
+    // Incremental rehash: the map is fully functional while entries are
+    // being moved
+    BOOST_REQUIRE(m.begin_rehash(numEntries * 2));
+    BOOST_CHECK(m.rehashing());
+    BOOST_CHECK(!m.begin_rehash());
+    BOOST_REQUIRE(!m.migrate(100));
+
+    success = true;
+    for (int i = numEntries; i < numEntries + 100; ++i)
+        success &= m.insert(RecordT(i, genVal(i))).second;
+    for (int i = 1; i < numEntries; i += 2) {
+        success &= !m.insert(RecordT(i, 0)).second;
+        success &= m.find(i)->second == genVal(i);
+    }
+    for (int i = 1; i < 1000; i += 2)
+        success &= m.erase(i) == 1;
+    BOOST_CHECK(success);
+
+    size_t n = 0;
+    for (auto& r : m) {
+        BOOST_CHECK_EQUAL(genVal(r.first), r.second);
+        ++n;
+    }
+    BOOST_CHECK_EQUAL(m.size(), n);
+
+    // Indices of the entries of the new submap refer to them both during
+    // and after the rehash
+    std::vector<std::pair<int, uint32_t>> indices;
+    for (int i = numEntries + 100; i < numEntries + 110; ++i) {
+        auto res = m.insert(RecordT(i, genVal(i)));
+        BOOST_REQUIRE(res.second);
+        indices.emplace_back(i, res.first.index());
+        BOOST_CHECK_EQUAL(i, m.find_at(res.first.index())->first);
+        BOOST_CHECK_EQUAL(i, m.idx_to_rec(m.find(i).index()).first);
+    }
+
+    while (!m.migrate());
+    for (auto& p : indices) {
+        BOOST_CHECK_EQUAL(p.first, m.find_at(p.second)->first);
+        BOOST_CHECK_EQUAL(genVal(p.first), m.idx_to_rec(p.second).second);
+    }
+    for (auto& p : indices)
+        BOOST_REQUIRE_EQUAL(1u, m.erase(p.first));
+    m.reclaim();
+    BOOST_CHECK(!m.rehashing());
+    BOOST_CHECK_EQUAL(2u, m.rehash_count());
+    BOOST_CHECK_EQUAL(size_t(numEntries / 2 - 500 + 100), m.size());
+    for (int i = 1001; i < numEntries; i += 2)
+        success &= m.find(i)->second == genVal(i);
+    BOOST_CHECK(success);
+}
+
+BOOST_AUTO_TEST_CASE( test_atomic_hash_map_rehash_indices ) {
+    const int numEntries = 1000;
+
+    AHMapT m(numEntries, config);
+    for (int i = 0; i < numEntries; ++i)
+        BOOST_REQUIRE(m.insert(RecordT(i, genVal(i))).second);
+
+    // Indices of entries inserted into the target of a rehash keep referring
+    // to them through back-to-back rehashes until the next rehash moves them
+    std::vector<std::pair<int, uint32_t>> indices;
+    for (int r = 0; r < 4; ++r) {
+        BOOST_REQUIRE(m.begin_rehash());
+        for (auto& p : indices) {
+            BOOST_CHECK_EQUAL(p.first, m.find_at(p.second)->first);
+            BOOST_CHECK_EQUAL(genVal(p.first), m.idx_to_rec(p.second).second);
+        }
+        indices.clear();
+
+        for (int i = numEntries * (r+1); i < numEntries * (r+1) + 10; ++i) {
+            auto res = m.insert(RecordT(i, genVal(i)));
+            BOOST_REQUIRE(res.second);
+            indices.emplace_back(i, res.first.index());
+        }
+        while (!m.migrate());
+
+        BOOST_CHECK_EQUAL(size_t(r+1), m.rehash_count());
+        for (auto& p : indices) {
+            BOOST_CHECK_EQUAL(p.first, m.find_at(p.second)->first);
+            // Indices obtained after the rehash refer to the primary submap
+            BOOST_CHECK_EQUAL(p.first, m.find_at(m.find(p.first).index())->first);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_atomic_hash_map_rehash_threads ) {
+    // Writers insert and erase their own keys while the map keeps rehashing
+    // itself, and readers verify that live keys are never missing
+    const int  numWriters = 2;
+    const int  numKeys    = 50000;
+    const int  window     = 2000;
+
+    AHMapT m(window, config);
+    m.auto_rehash(4);
+
+    for (int i = 0; i < window; ++i)
+        m.insert(RecordT(i, genVal(i)));
+
+    std::atomic<bool> done(false);
+    std::atomic<int>  errors(0);
+    std::vector<std::thread> threads;
+
+    for (int w = 0; w < numWriters; ++w)
+        threads.emplace_back([&, w]() {
+            for (int i = window + w; i < numKeys; i += numWriters) {
+                if (!m.insert(RecordT(i, genVal(i))).second)
+                    ++errors;
+                if (m.erase(i - window) != 1)
+                    ++errors;
+            }
+        });
+    threads.emplace_back([&]() {
+        // The first keys of each writer's window are erased last
+        while (!done.load(std::memory_order_relaxed))
+            for (int i = numKeys - window; i < numKeys - window + 50; ++i) {
+                auto it = m.find(i);
+                if (it != m.end() && it->second != genVal(i))
+                    ++errors;
+            }
+    });
+    for (int w = 0; w < numWriters; ++w)
+        threads[w].join();
+    done = true;
+    threads.back().join();
+
+    BOOST_CHECK_EQUAL(0, errors.load());
+    BOOST_CHECK_EQUAL(size_t(window), m.size());
+    BOOST_CHECK(m.rehash_count() > 0);
+    bool success = true;
+    for (int i = numKeys - window; i < numKeys; ++i)
+        success &= m.find(i)->second == genVal(i);
+    BOOST_CHECK(success);
+    BOOST_TEST_MESSAGE("Rehashed " << m.rehash_count() << " times, ended up with "
+                       << m.num_submaps() << " submaps");
+}
+
+namespace {
+    // Sequential order ids hashed by std::hash (identity) fill contiguous
+    // runs of cells, so mix the bits
+    struct order_id_hash {
+        size_t operator()(KeyT a_id) const {
+            return (uint64_t(uint32_t(a_id)) * 0x9E3779B97F4A7C15ull) >> 16;
+        }
+    };
+    using OrderMapT = atomic_hash_map<KeyT, ValueT, order_id_hash,
+                                      std::equal_to<KeyT>, std::allocator<char>>;
+}
+
+BOOST_AUTO_TEST_CASE( test_atomic_hash_map_order_churn_perf ) {
+    // Simulate a trading day: order ids are assigned sequentially, orders
+    // live for a while and get erased, so that the number of live orders
+    // stays constant.  Without rehashing the tombstones of erased orders
+    // accumulate until the map runs out of submaps.
+    const long orders = getenv("ITERATIONS") ? atol(getenv("ITERATIONS")) : 2400000;
+    const int  live   = 10000;
+    const int  hours  = 24;
+
+    for (uint32_t rehash : {0u, 4u}) {
+        OrderMapT m(live);
+        m.auto_rehash(rehash);
+
+        long   id = 0, found = 0, lookups = 0;
+        std::stringstream out;
+        try {
+            for (int h = 0; h < hours; ++h) {
+                long   n  = lookups;
+                double ns = 0;
+                for (long end = orders * (h+1) / hours; id < end; ++id) {
+                    m.insert(RecordT(id, genVal(id)));
+                    if (id >= live)
+                        m.erase(id - live);
+                    if ((id & 7) == 0) {
+                        // Look up a batch of live orders
+                        auto t = std::chrono::high_resolution_clock::now();
+                        for (long k = std::max(0l, id - live + 1); k <= id; k += live / 16)
+                            found += m.find(k) != m.end(), ++lookups;
+                        ns += std::chrono::duration<double, std::nano>
+                              (std::chrono::high_resolution_clock::now() - t).count();
+                    }
+                }
+                out << ' ' << int(ns / (lookups - n));
+                // No other thread is using the map
+                m.reclaim();
+            }
+        } catch (utxx::atomic_hash_map_full_error&) {
+            out << " ... full after " << id << " orders";
+        }
+        BOOST_TEST_MESSAGE("Order churn (auto_rehash=" << rehash << "): "
+                           << m.num_submaps() << " submaps, "
+                           << m.rehash_count() << " rehashes, hourly lookup ns:"
+                           << out.str());
+        BOOST_CHECK_EQUAL(lookups, found);
+        if (rehash) {
+            BOOST_CHECK_EQUAL(orders, id);
+            BOOST_CHECK_EQUAL(size_t(live), m.size());
+        }
+    }
+}
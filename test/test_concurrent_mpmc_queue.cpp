@@ -0,0 +1,303 @@
+//----------------------------------------------------------------------------
+/// \file   test_concurrent_mpmc_queue.cpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Test cases for the bounded MPMC queue.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+#include <utxx/concurrent_mpmc_queue.hpp>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace utxx;
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_basic )
+{
+    concurrent_mpmc_queue<int> q(5);
+    BOOST_REQUIRE_EQUAL(8u, q.capacity());
+    BOOST_REQUIRE(q.empty());
+
+    int v;
+    BOOST_REQUIRE(!q.try_pop(v));
+
+    // Wrap around the ring a few times
+    for (int lap = 0; lap < 3; ++lap) {
+        for (int i = 0; i < 8; ++i)
+            BOOST_REQUIRE(q.try_push(lap*10 + i));
+        BOOST_REQUIRE(!q.try_push(-1));
+        BOOST_REQUIRE_EQUAL(8u, q.size());
+        for (int i = 0; i < 8; ++i) {
+            BOOST_REQUIRE(q.try_pop(v));
+            BOOST_REQUIRE_EQUAL(lap*10 + i, v);
+        }
+        BOOST_REQUIRE(!q.try_pop(v));
+    }
+
+    // Non-trivial items are moved in and out, and leftovers are destructed
+    auto s = std::make_shared<int>(1);
+    {
+        concurrent_mpmc_queue<std::shared_ptr<int>> sq(4);
+        BOOST_REQUIRE(sq.try_emplace(s));
+        BOOST_REQUIRE(sq.try_push(s));
+        BOOST_REQUIRE_EQUAL(3, s.use_count());
+        std::shared_ptr<int> p;
+        BOOST_REQUIRE(sq.try_pop(p));
+        BOOST_REQUIRE_EQUAL(3, s.use_count());
+    }
+    BOOST_REQUIRE_EQUAL(1, s.use_count());
+
+    // Timed blocking calls fail on empty/full queue
+    auto start = std::chrono::steady_clock::now();
+    BOOST_REQUIRE(!q.pop(v, std::chrono::milliseconds(20)));
+    for (int i = 0; i < 8; ++i)
+        BOOST_REQUIRE(q.push(i, std::chrono::milliseconds(20)));
+    BOOST_REQUIRE(!q.push(8, std::chrono::milliseconds(20)));
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(40));
+}
+
+namespace {
+    // Item without a default ctor, whose converting ctor may throw
+    struct throwing_item {
+        static int s_live;
+        int        m_val;
+
+        throwing_item(int a) : m_val(a) {
+            if (a < 0) throw std::invalid_argument("negative");
+            ++s_live;
+        }
+        throwing_item(throwing_item&& a) noexcept : m_val(a.m_val) { ++s_live; }
+        throwing_item& operator=(throwing_item&&) = default;
+        ~throwing_item() { --s_live; }
+    };
+
+    int throwing_item::s_live;
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_throwing_ctor )
+{
+    {
+        concurrent_mpmc_queue<throwing_item> q(4);
+        BOOST_REQUIRE(q.try_emplace(1));
+        BOOST_REQUIRE_THROW(q.try_emplace(-1), std::invalid_argument);
+        BOOST_REQUIRE_EQUAL(1u, q.size());
+        BOOST_REQUIRE(q.try_emplace(2));
+        BOOST_REQUIRE(q.push(throwing_item(3), std::chrono::milliseconds(20)));
+
+        // A failed ctor must not leave a claimed cell that blocks consumers
+        throwing_item v(0);
+        BOOST_REQUIRE(q.try_pop(v));
+        BOOST_REQUIRE_EQUAL(1, v.m_val);
+        BOOST_REQUIRE(q.try_pop(v));
+        BOOST_REQUIRE_EQUAL(2, v.m_val);
+        BOOST_REQUIRE_EQUAL(1u, q.size());
+        BOOST_REQUIRE_EQUAL(2, throwing_item::s_live);   // v and item 3
+    }
+    // The leftover item is destructed with the queue
+    BOOST_REQUIRE_EQUAL(0, throwing_item::s_live);
+}
+
+namespace {
+    // Producers push disjoint ranges of numbers, and consumers verify that
+    // every number is received once, and in order of each producer's range
+    template <class Queue>
+    void mpmc_run(Queue& a_q, int a_producers, int a_consumers, long a_count,
+                  bool a_blocking)
+    {
+        static const long s_stride = 1l << 40;
+        std::vector<std::thread>        threads;
+        std::vector<std::vector<long>>  received(a_consumers);
+        std::atomic<long>               left(a_count * a_producers);
+
+        for (int c = 0; c < a_consumers; ++c)
+            threads.emplace_back([&, c]() {
+                auto& res = received[c];
+                long  v;
+                while (left.load(std::memory_order_relaxed) > 0) {
+                    bool ok = a_blocking
+                            ? a_q.pop(v, std::chrono::milliseconds(10))
+                            : a_q.try_pop(v);
+                    if (!ok) {
+                        if (!a_blocking) std::this_thread::yield();
+                        continue;
+                    }
+                    res.push_back(v);
+                    left.fetch_sub(1, std::memory_order_relaxed);
+                }
+            });
+
+        for (int p = 0; p < a_producers; ++p)
+            threads.emplace_back([&, p]() {
+                for (long i = 0; i < a_count; ++i) {
+                    long v = p * s_stride + i;
+                    if (a_blocking)
+                        a_q.push(v);
+                    else
+                        while (!a_q.try_push(v))
+                            std::this_thread::yield();
+                }
+            });
+
+        for (auto& t : threads) t.join();
+
+        std::vector<long> next(a_producers, 0);
+        std::vector<long> last(a_producers);
+        long total = 0;
+        for (auto& res : received) {
+            std::fill(last.begin(), last.end(), -1);
+            for (auto v : res) {
+                int  p = v / s_stride;
+                long i = v % s_stride;
+                BOOST_REQUIRE(p < a_producers);
+                BOOST_REQUIRE(i > last[p]);     // Per-producer FIFO order
+                last[p] = i;
+                ++next[p];
+            }
+            total += res.size();
+        }
+        BOOST_REQUIRE_EQUAL(a_count * a_producers, total);
+        for (auto n : next)
+            BOOST_REQUIRE_EQUAL(a_count, n);
+        BOOST_REQUIRE(a_q.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_threads )
+{
+    for (bool blocking : {false, true}) {
+        concurrent_mpmc_queue<long> q(64);
+        mpmc_run(q, 1, 1, 100000, blocking);
+        mpmc_run(q, 4, 1, 50000,  blocking);
+        mpmc_run(q, 1, 4, 100000, blocking);
+        mpmc_run(q, 4, 4, 50000,  blocking);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_blocking )
+{
+    // Consumers parked on an empty queue are woken up by producers
+    concurrent_mpmc_queue<int> q(2);
+    std::atomic<int> sum(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 3; ++i)
+        consumers.emplace_back([&]() {
+            int v;
+            if (q.pop(v, std::chrono::seconds(5)))
+                sum += v;
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (int i = 1; i <= 3; ++i)
+        q.push(i);
+    for (auto& t : consumers) t.join();
+    BOOST_REQUIRE_EQUAL(6, sum);
+
+    // A producer parked on a full queue is woken up by a consumer
+    BOOST_REQUIRE(q.try_push(1));
+    BOOST_REQUIRE(q.try_push(2));
+    std::thread producer([&]() { q.push(3); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    int v;
+    for (int i = 1; i <= 3; ++i) {
+        BOOST_REQUIRE(q.pop(v, std::chrono::seconds(5)));
+        BOOST_REQUIRE_EQUAL(i, v);
+    }
+    producer.join();
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_shared )
+{
+    typedef concurrent_mpmc_queue<long> queue;
+
+    BOOST_CHECK_THROW(queue(nullptr, 16, true), badarg_error);
+
+    size_t size = queue::memory_size(256);
+    void*  mem  = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    BOOST_REQUIRE(mem != MAP_FAILED);
+
+    {
+        queue q(mem, size, true);
+        BOOST_REQUIRE_EQUAL(256u, q.capacity());
+        BOOST_REQUIRE(q.try_push(1));
+
+        // Another instance attached to the same storage sees the same queue
+        queue q2(mem, size, false);
+        BOOST_REQUIRE_EQUAL(256u, q2.capacity());
+        long v;
+        BOOST_REQUIRE(q2.try_pop(v));
+        BOOST_REQUIRE_EQUAL(1, v);
+        BOOST_CHECK_THROW(queue(mem, size/2, false), badarg_error);
+    }
+
+    // Producer and consumer in separate processes, blocking on a futex in
+    // shared memory
+    const long N = 200000;
+    pid_t pid = ::fork();
+    BOOST_REQUIRE(pid >= 0);
+    if (pid == 0) {
+        queue q(mem, size, false);
+        for (long i = 0; i < N; ++i)
+            q.push(i);
+        ::_exit(0);
+    }
+
+    queue q(mem, size, false);
+    long v, errors = 0;
+    for (long i = 0; i < N; ++i)
+        if (!q.pop(v, std::chrono::seconds(5)) || v != i)
+            ++errors;
+    int status;
+    ::waitpid(pid, &status, 0);
+    BOOST_REQUIRE_EQUAL(0, errors);
+    BOOST_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ::munmap(mem, size);
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpmc_queue_perf )
+{
+    const long N = getenv("ITERATIONS") ? atol(getenv("ITERATIONS")) : 1000000;
+
+    for (int n : {1, 2, 4}) {
+        concurrent_mpmc_queue<long> q(1024);
+        auto start = std::chrono::high_resolution_clock::now();
+        mpmc_run(q, n, n, N / n, true);
+        std::chrono::duration<double> sec =
+            std::chrono::high_resolution_clock::now() - start;
+        double rate = N / sec.count() / 1e6;
+        BOOST_TEST_MESSAGE("MPMC queue " << n << 'x' << n << ": "
+                           << rate << " Mops/s");
+    }
+}
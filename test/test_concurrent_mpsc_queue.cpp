@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 #include <utxx/concurrent_mpsc_queue.hpp>
 
+#include <cstdlib>
 #include <vector>
 #include <atomic>
 #include <chrono>
@@ -76,4 +77,122 @@ BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue ) {
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue_pool ) {
+    typedef detail::mpsc_block_pool<32, std::allocator<char>> pool;
+
+    // Blocks freed by the consumer are cached and then handed to producers
+    std::vector<void*> blocks;
+    for (int i = 0; i < 200; ++i)
+        blocks.push_back(pool::allocate());
+    unsigned cached = pool::cached();
+    for (auto p : blocks)
+        pool::deallocate(p);
+    BOOST_REQUIRE(pool::cached() >= 64 && pool::cached() < 128 + cached);
+
+    std::thread([]() {
+        // The producer's cache is empty and gets a batch from the depot
+        BOOST_REQUIRE_EQUAL(0u, pool::cached());
+        void* p = pool::allocate();
+        BOOST_REQUIRE_EQUAL(63u, pool::cached());
+        pool::deallocate(p);
+    }).join();
+
+    // Size classes
+    typedef detail::mpsc_sized_pool<std::allocator<char>> sized_pool;
+    BOOST_REQUIRE_EQUAL(0u, sized_pool::size_class(1));
+    BOOST_REQUIRE_EQUAL(0u, sized_pool::size_class(32));
+    BOOST_REQUIRE_EQUAL(1u, sized_pool::size_class(33));
+    BOOST_REQUIRE_EQUAL(7u, sized_pool::size_class(4096));
+    BOOST_REQUIRE_EQUAL(8u, sized_pool::size_class(4097));
+
+    BOOST_REQUIRE( concurrent_mpsc_queue<long>().pooled());
+    BOOST_REQUIRE(!concurrent_mpsc_queue<long>({}, false).pooled());
+    BOOST_REQUIRE( concurrent_mpsc_queue<char>().pooled());
+}
+
+namespace {
+    struct alignas(8) message {
+        long    producer;
+        long    seqno;
+        char    data[48];
+
+        message(long p, long n) : producer(p), seqno(n) {}
+    };
+
+    typedef concurrent_mpsc_queue<message> typed_queue;
+    typedef concurrent_mpsc_queue<char>    var_queue;
+
+    bool put(typed_queue& q, long p, long i) { return q.emplace(p, i); }
+    bool put(var_queue&   q, long p, long i) { return q.emplace<message>(p, i); }
+
+    const message& get(typed_queue::node* n) { return n->data(); }
+    const message& get(var_queue::node*   n) { return n->to<message>(); }
+
+    // Each of a_producers threads pushes a_count messages, and the consumer
+    // checks their order and frees the nodes
+    template <bool Var>
+    double mpsc_run(bool a_pooled, int a_producers, long a_count) {
+        typedef typename std::conditional<Var, var_queue, typed_queue>::type queue;
+        typedef typename queue::node node;
+
+        queue q({}, a_pooled);
+        BOOST_REQUIRE_EQUAL(a_pooled, q.pooled());
+
+        std::atomic<int> ready(0);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < a_producers; ++p)
+            producers.emplace_back([&, p]() {
+                ++ready;
+                while (ready.load() < a_producers);
+                for (long i = 0; i < a_count; ++i)
+                    while (!put(q, p, i));
+            });
+
+        auto start = std::chrono::high_resolution_clock::now();
+        long total = 0, errors = 0, n = long(a_producers) * a_count;
+        std::vector<long> next(a_producers, 0);
+        while (total < n) {
+            node* h = q.pop_all();
+            if (!h) { std::this_thread::yield(); continue; }
+            for (node* t; h; h = t) {
+                t = h->next();
+                auto& m = get(h);
+                if (m.seqno != next[m.producer]++) ++errors;
+                q.free(h);
+                ++total;
+            }
+        }
+        for (auto& t : producers) t.join();
+        std::chrono::duration<double> sec =
+            std::chrono::high_resolution_clock::now() - start;
+
+        BOOST_REQUIRE_EQUAL(0, errors);
+        BOOST_REQUIRE(q.empty());
+        return n / sec.count() / 1e6;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue_pooled ) {
+    for (bool pooled : {false, true}) {
+        mpsc_run<false>(pooled, 4, 50000);
+        mpsc_run<true> (pooled, 4, 50000);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_mpsc_queue_pooled_perf ) {
+    long n = getenv("ITERATIONS") ? atol(getenv("ITERATIONS")) : 1000000;
+
+    for (int producers : {1, 4, 16})
+        for (bool var : {false, true}) {
+            long   count = n / producers;
+            double mall  = var ? mpsc_run<true>(false, producers, count)
+                               : mpsc_run<false>(false, producers, count);
+            double pool  = var ? mpsc_run<true>(true,  producers, count)
+                               : mpsc_run<false>(true,  producers, count);
+            BOOST_TEST_MESSAGE("MPSC queue<" << (var ? "char" : "T") << "> "
+                               << producers << " producers: malloc "
+                               << mall << " Mops/s, pooled " << pool << " Mops/s");
+        }
+}
+
 } // namespace utxx
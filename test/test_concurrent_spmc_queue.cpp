@@ -0,0 +1,269 @@
+//----------------------------------------------------------------------------
+/// \file   test_concurrent_spmc_queue.cpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Test cases for the SPMC broadcast queue.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+#include <utxx/concurrent_spmc_queue.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace utxx;
+
+namespace {
+    struct tick {
+        long    seqno;
+        double  px;
+        long    check;
+
+        tick() {}
+        tick(long n) : seqno(n), px(n * 0.5), check(~n) {}
+        bool valid() const { return check == ~seqno && px == seqno * 0.5; }
+    };
+
+    typedef concurrent_spmc_queue<tick> queue;
+
+    struct aligned_buf {
+        void*  mem;
+        size_t size;
+        aligned_buf(size_t a_size) : size(a_size) {
+            if (::posix_memalign(&mem, UTXX_CL_SIZE, size) != 0) throw std::bad_alloc();
+        }
+        ~aligned_buf() { ::free(mem); }
+    };
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_queue_block )
+{
+    aligned_buf buf(queue::memory_size(8, 4));
+    queue q(buf.mem, buf.size, true, 4);
+    BOOST_REQUIRE_EQUAL(8u, q.capacity());
+    BOOST_REQUIRE_EQUAL(4u, q.max_consumers());
+    BOOST_REQUIRE(spmc_overflow::block == q.overflow());
+
+    // Without consumers items are discarded
+    for (int i = 0; i < 20; ++i)
+        BOOST_REQUIRE(q.try_push(tick(i)));
+
+    auto c1 = q.subscribe();
+    auto c2 = q.subscribe();
+    BOOST_REQUIRE_EQUAL(2u, q.consumers());
+    BOOST_REQUIRE(c1.empty());
+
+    tick t;
+    BOOST_REQUIRE(!c1.try_pop(t));
+
+    for (int i = 0; i < 8; ++i)
+        BOOST_REQUIRE(q.try_push(tick(i)));
+    BOOST_REQUIRE(!q.try_push(tick(8)));    // Full
+    BOOST_REQUIRE_EQUAL(8u, c1.size());
+
+    // The slowest consumer holds back the producer
+    for (int i = 0; i < 8; ++i) {
+        BOOST_REQUIRE(c1.try_pop(t));
+        BOOST_REQUIRE_EQUAL(i, t.seqno);
+    }
+    BOOST_REQUIRE(!c1.try_pop(t));
+    BOOST_REQUIRE(!q.try_push(tick(8)));
+    BOOST_REQUIRE(c2.try_pop(t));
+    BOOST_REQUIRE_EQUAL(0, t.seqno);
+    BOOST_REQUIRE(q.try_push(tick(8)));
+    BOOST_REQUIRE(!q.try_push(tick(9)));
+
+    // Unsubscribed consumer no longer holds back the producer
+    c2.unsubscribe();
+    BOOST_REQUIRE_EQUAL(1u, q.consumers());
+    BOOST_REQUIRE(q.try_push(tick(9)));
+    BOOST_REQUIRE(c1.try_pop(t));
+    BOOST_REQUIRE_EQUAL(8, t.seqno);
+
+    // Max consumers
+    auto c3 = q.subscribe();
+    auto c4 = q.subscribe();
+    auto c5 = q.subscribe();
+    BOOST_CHECK_THROW(q.subscribe(), runtime_error);
+    q.evict(c5.id());
+    BOOST_REQUIRE_EQUAL(3u, q.consumers());
+
+    // Timed wait
+    BOOST_REQUIRE(!c3.pop(t, std::chrono::milliseconds(10)));
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_queue_overwrite )
+{
+    aligned_buf buf(queue::memory_size(8, 2));
+    queue q(buf.mem, buf.size, true, 2, spmc_overflow::overwrite);
+    BOOST_REQUIRE_EQUAL(8u, q.capacity());
+
+    auto c1 = q.subscribe();
+    auto c2 = q.subscribe();
+
+    // The producer never blocks and the lagging consumer gets lapped
+    for (int i = 0; i < 20; ++i)
+        BOOST_REQUIRE(q.try_push(tick(i)));
+
+    tick t;
+    BOOST_REQUIRE_EQUAL(8u, c1.size());
+    for (int i = 12; i < 20; ++i) {
+        BOOST_REQUIRE(c1.try_pop(t));
+        BOOST_REQUIRE_EQUAL(i, t.seqno);
+    }
+    BOOST_REQUIRE(!c1.try_pop(t));
+    BOOST_REQUIRE_EQUAL(12u, c1.lost());
+
+    for (int i = 20; i < 23; ++i)
+        BOOST_REQUIRE(q.try_push(tick(i)));
+    BOOST_REQUIRE(c2.try_pop(t));
+    BOOST_REQUIRE_EQUAL(15, t.seqno);
+    BOOST_REQUIRE_EQUAL(15u, c2.lost());
+    BOOST_REQUIRE(c1.try_pop(t));
+    BOOST_REQUIRE_EQUAL(20, t.seqno);
+    BOOST_REQUIRE_EQUAL(12u, c1.lost());
+}
+
+namespace {
+    // Consumers verify that items arrive in order, and that every item either
+    // arrives intact or is accounted for as lost
+    void spmc_run(spmc_overflow a_ovf, int a_consumers, long a_count)
+    {
+        aligned_buf buf(queue::memory_size(256, a_consumers));
+        queue q(buf.mem, buf.size, true, a_consumers, a_ovf);
+
+        std::vector<queue::consumer> subs;
+        for (int i = 0; i < a_consumers; ++i)
+            subs.push_back(q.subscribe());
+
+        std::vector<long>        errors(a_consumers, 0), received(a_consumers, 0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < a_consumers; ++i)
+            threads.emplace_back([&, i]() {
+                auto& c    = subs[i];
+                long  next = 0;
+                tick  t;
+                while (next < a_count) {
+                    if (!c.pop(t, std::chrono::seconds(5))) { ++errors[i]; break; }
+                    if (!t.valid() || t.seqno < next) ++errors[i];
+                    next = t.seqno + 1;
+                    ++received[i];
+                }
+            });
+
+        for (long i = 0; i < a_count; ++i)
+            q.push(tick(i));
+        for (auto& t : threads) t.join();
+
+        for (int i = 0; i < a_consumers; ++i) {
+            BOOST_REQUIRE_EQUAL(0, errors[i]);
+            BOOST_REQUIRE_EQUAL(a_count, received[i] + long(subs[i].lost()));
+            if (a_ovf == spmc_overflow::block)
+                BOOST_REQUIRE_EQUAL(0u, subs[i].lost());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_queue_threads )
+{
+    spmc_run(spmc_overflow::block,     1, 200000);
+    spmc_run(spmc_overflow::block,     4, 200000);
+    spmc_run(spmc_overflow::overwrite, 1, 200000);
+    spmc_run(spmc_overflow::overwrite, 4, 200000);
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_queue_file )
+{
+    auto filename = "/tmp/test_spmc_queue.bin";
+    ::unlink(filename);
+
+    queue q;
+    BOOST_REQUIRE(q.init(filename, 1000, 4));
+    BOOST_REQUIRE_EQUAL(1024u, q.capacity());
+
+    // Consumer processes attach to the file, and receive all items
+    const int  N = 3;
+    const long M = 100000;
+    std::vector<pid_t> pids;
+    for (int i = 0; i < N; ++i) {
+        pid_t pid = ::fork();
+        BOOST_REQUIRE(pid >= 0);
+        if (pid == 0) {
+            queue qc;
+            bool  ok = !qc.init(filename, 0) && qc.capacity() == 1024;
+            auto  c  = qc.subscribe();
+            tick  t;
+            for (long n = 0; ok && n < M; ++n)
+                ok = c.pop(t, std::chrono::seconds(5)) && t.valid() && t.seqno == n;
+            c.unsubscribe();
+            ::_exit(ok ? 0 : 1);
+        }
+        pids.push_back(pid);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (q.consumers() < N && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    BOOST_REQUIRE_EQUAL(uint32_t(N), q.consumers());
+
+    for (long n = 0; n < M; ++n)
+        BOOST_REQUIRE(q.push(tick(n), std::chrono::seconds(5)));
+
+    for (auto pid : pids) {
+        int status;
+        ::waitpid(pid, &status, 0);
+        BOOST_REQUIRE(WIFEXITED(status));
+        BOOST_REQUIRE_EQUAL(0, WEXITSTATUS(status));
+    }
+    BOOST_REQUIRE_EQUAL(0u, q.consumers());
+    BOOST_REQUIRE_EQUAL(uint64_t(M), q.pushed());
+
+    // Reopening the file preserves the queue's state
+    queue q2;
+    BOOST_REQUIRE(!q2.init(filename, 16));
+    BOOST_REQUIRE_EQUAL(1024u, q2.capacity());
+    BOOST_REQUIRE_EQUAL(uint64_t(M), q2.pushed());
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spmc_queue_perf )
+{
+    const long N = getenv("ITERATIONS") ? atol(getenv("ITERATIONS")) : 1000000;
+    for (int n : {1, 2, 4}) {
+        auto start = std::chrono::high_resolution_clock::now();
+        spmc_run(spmc_overflow::block, n, N);
+        std::chrono::duration<double> sec =
+            std::chrono::high_resolution_clock::now() - start;
+        double rate = N / sec.count() / 1e6;
+        BOOST_TEST_MESSAGE("SPMC queue 1x" << n << ": " << rate << " Mitems/s");
+    }
+}
@@ -7,6 +7,8 @@
 #include <memory>
 #include <thread>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 
 namespace utxx {
 
@@ -164,10 +166,11 @@ struct CorrectnessTest {
     std::atomic<bool>   done_;
 };
 
-template<class T, size_t Size, bool Pop = false>
+template<class T, size_t Size, bool Pop = false,
+         spsc_layout Layout = spsc_layout::compact>
 void correctnessTestType(const std::string& type) {
     BOOST_TEST_MESSAGE("Type: " << type);
-    doTest<CorrectnessTest<concurrent_spsc_queue<T>,Size,Pop> >(
+    doTest<CorrectnessTest<concurrent_spsc_queue<T,0,Layout>,Size,Pop> >(
         "ProducerConsumerQueue");
 }
 
@@ -208,6 +211,11 @@ BOOST_AUTO_TEST_CASE( test_concurrent_spsc_correctness ) {
     correctnessTestType<std::string,0xffff>("string");
     correctnessTestType<int, 0xffff>("int");
     correctnessTestType<unsigned long long, 0xfffe>("unsigned long long");
+
+    static const auto padded = spsc_layout::padded;
+    correctnessTestType<std::string,0xfffe,true,padded>("string (front+pop, padded)");
+    correctnessTestType<std::string,0xffff,false,padded>("string (padded)");
+    correctnessTestType<int, 0xffff, false, padded>("int (padded)");
 }
 
 BOOST_AUTO_TEST_CASE( test_concurrent_spsc_perf ) {
@@ -308,4 +316,181 @@ BOOST_AUTO_TEST_CASE( test_concurrent_spsc_iterator )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_concurrent_spsc_padded ) {
+    using queue = concurrent_spsc_queue<int, 0, spsc_layout::padded>;
+
+    BOOST_REQUIRE(queue::memory_size(0) >= 2*UTXX_CL_SIZE);
+    BOOST_REQUIRE(concurrent_spsc_queue<int>::memory_size(0) < UTXX_CL_SIZE);
+
+    queue q(4);
+    BOOST_REQUIRE(q.empty());
+    BOOST_REQUIRE(q.push(1));
+    BOOST_REQUIRE(q.push(2));
+    BOOST_REQUIRE(q.push(3));
+    BOOST_REQUIRE(q.full());
+    BOOST_REQUIRE(!q.push(4));
+    BOOST_REQUIRE_EQUAL(3u, q.count());
+
+    int v;
+    BOOST_REQUIRE(q.pop(v));  BOOST_REQUIRE_EQUAL(1, v);
+    BOOST_REQUIRE(!q.full());
+    BOOST_REQUIRE(q.push(4));
+    BOOST_REQUIRE(q.pop(v));  BOOST_REQUIRE_EQUAL(2, v);
+    BOOST_REQUIRE(q.pop(v));  BOOST_REQUIRE_EQUAL(3, v);
+    BOOST_REQUIRE(q.pop(v));  BOOST_REQUIRE_EQUAL(4, v);
+    BOOST_REQUIRE(q.empty());
+    BOOST_REQUIRE(!q.pop(v));
+
+    // Batch operations wrapping around the end of the buffer
+    queue b(8);
+    int in[16], out[16];
+    for (int i=0; i < 16; ++i) in[i] = i;
+
+    for (int k=0; k < 10; ++k) {
+        BOOST_REQUIRE_EQUAL(5u, b.push_n(in, 5));
+        BOOST_REQUIRE_EQUAL(2u, b.push_n(in+5, 4));     // Only 7 slots usable
+        BOOST_REQUIRE_EQUAL(0u, b.push_n(in, 1));
+        BOOST_REQUIRE_EQUAL(3u, b.pop_n(out, 3));
+        BOOST_REQUIRE_EQUAL(3u, b.push_n(in+7, 3));
+        BOOST_REQUIRE_EQUAL(7u, b.count());
+        BOOST_REQUIRE_EQUAL(7u, b.pop_n(out+3, 16));
+        BOOST_REQUIRE_EQUAL(0u, b.pop_n(out, 16));
+        for (int i=0; i < 10; ++i)
+            BOOST_REQUIRE_EQUAL(i, out[i]);
+    }
+
+    // Non-trivial type is moved out
+    concurrent_spsc_queue<std::string, 0, spsc_layout::padded> sq(16);
+    std::vector<std::string> strs{"a", "b", "c"}, res(3);
+    BOOST_REQUIRE_EQUAL(3u, sq.push_n(strs.begin(), 3));
+    BOOST_REQUIRE_EQUAL(3u, sq.pop_n(res.begin(), 3));
+    BOOST_REQUIRE(strs == res);
+}
+
+namespace {
+    void pin_thread(int a_cpu) {
+        int n = std::thread::hardware_concurrency();
+        if (n < 2) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(a_cpu % n, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // Producer/consumer sides of a queue either located in the heap, or in
+    // external storage shared by separate producer and consumer instances
+    template <spsc_layout Layout>
+    struct spsc_pair {
+        using queue = concurrent_spsc_queue<long, 0, Layout>;
+
+        std::vector<char>       storage;
+        std::unique_ptr<queue>  heap, prod, cons;
+
+        spsc_pair(uint32_t a_capacity, bool a_shared) {
+            if (!a_shared) {
+                heap.reset(new queue(a_capacity));
+                return;
+            }
+            storage.resize(queue::memory_size(a_capacity));
+            prod.reset(new queue(&storage[0], storage.size(), queue::side_t::producer));
+            cons.reset(new queue(&storage[0], storage.size(), queue::side_t::consumer));
+        }
+
+        queue& producer() { return heap ? *heap : *prod; }
+        queue& consumer() { return heap ? *heap : *cons; }
+    };
+
+    // Transfer the items (in batches of a_batch > 1 using push_n/pop_n) and
+    // verify their order
+    template <spsc_layout Layout>
+    double spsc_throughput(bool a_shared, long a_count, uint32_t a_batch) {
+        spsc_pair<Layout> q(1024, a_shared);
+        auto& prod = q.producer();
+        auto& cons = q.consumer();
+        long  sum  = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::thread consumer([&]() {
+            pin_thread(1);
+            long buf[64];
+            for (long i = 0; i < a_count; ) {
+                uint32_t n = a_batch > 1 ? cons.pop_n(buf, a_batch) : cons.pop(buf[0]);
+                if (!n) { sched_yield(); continue; }
+                for (uint32_t j = 0; j < n; ++j, ++i)
+                    if (buf[j] != i) { sum = -1; return; }
+                sum += n;
+            }
+        });
+
+        pin_thread(0);
+        long buf[64];
+        for (long i = 0; i < a_count; ) {
+            uint32_t n = std::min<long>(a_batch, a_count - i);
+            for (uint32_t j = 0; j < n; ++j) buf[j] = i + j;
+            n = a_batch > 1 ? prod.push_n(buf, n) : (prod.push(buf[0]) ? 1 : 0);
+            if (!n) sched_yield();
+            i += n;
+        }
+        consumer.join();
+
+        std::chrono::duration<double> sec =
+            std::chrono::high_resolution_clock::now() - start;
+        BOOST_REQUIRE_EQUAL(a_count, sum);
+        return a_count / sec.count();
+    }
+
+    // Average round-trip time of a ping-pong over two queues (in nsec)
+    template <spsc_layout Layout>
+    double spsc_latency(bool a_shared, long a_count) {
+        spsc_pair<Layout> ping(64, a_shared), pong(64, a_shared);
+
+        std::thread echo([&]() {
+            pin_thread(1);
+            long v;
+            for (long i = 0; i < a_count; ++i) {
+                while (!ping.consumer().pop(v)) sched_yield();
+                while (!pong.producer().push(v)) sched_yield();
+            }
+        });
+
+        pin_thread(0);
+        auto start = std::chrono::high_resolution_clock::now();
+        long v;
+        for (long i = 0; i < a_count; ++i) {
+            while (!ping.producer().push(i)) sched_yield();
+            while (!pong.consumer().pop(v))  sched_yield();
+            BOOST_REQUIRE_EQUAL(i, v);
+        }
+        std::chrono::duration<double, std::nano> ns =
+            std::chrono::high_resolution_clock::now() - start;
+        echo.join();
+        return ns.count() / a_count;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_spsc_layout_perf ) {
+    long n   = iterations() ? iterations() : 1 << 22;
+    long rtt = std::max(n / 256, 1000L);
+
+    BOOST_TEST_MESSAGE("SPSC queue layouts (" << n << " items, "
+                       << std::thread::hardware_concurrency() << " cores)");
+
+    for (bool shared : {false, true}) {
+        const char* mode = shared ? "shared" : "heap  ";
+        auto ct = spsc_throughput<spsc_layout::compact>(shared, n, 1);
+        auto cl = spsc_latency   <spsc_layout::compact>(shared, rtt);
+        auto pt = spsc_throughput<spsc_layout::padded> (shared, n, 1);
+        auto pl = spsc_latency   <spsc_layout::padded> (shared, rtt);
+        auto bt = spsc_throughput<spsc_layout::padded> (shared, n, 32);
+
+        BOOST_TEST_MESSAGE("  " << mode << " compact: " << size_t(ct) << " ops/s, "
+                           << size_t(cl) << " ns rtt");
+        BOOST_TEST_MESSAGE("  " << mode << " padded:  " << size_t(pt) << " ops/s, "
+                           << size_t(pl) << " ns rtt");
+        BOOST_TEST_MESSAGE("  " << mode << " padded:  " << size_t(bt) << " ops/s"
+                           << " (push_n/pop_n of 32)");
+    }
+}
+
 } // namespace utxx
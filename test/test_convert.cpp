@@ -42,7 +42,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #ifdef UTXX_HAVE_BOOST_TIMER_TIMER_HPP
 #include <boost/timer/timer.hpp>
 #endif
+#include <utxx/time_val.hpp>
+#include <functional>
+#include <iomanip>
 #include <limits>
+#include <random>
 
 using namespace utxx;
 
@@ -437,6 +441,111 @@ BOOST_AUTO_TEST_CASE( test_convert_unsafe_fixed_atol )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_convert_fixed_atoul )
+{
+    uint64_t u = 0;
+    BOOST_CHECK(fixed_atoul<6>("001234", u));   BOOST_CHECK_EQUAL(1234u, u);
+    BOOST_CHECK(fixed_atoul<6>("  1234", u));   BOOST_CHECK_EQUAL(1234u, u);
+    BOOST_CHECK(fixed_atoul<1>("7", u));        BOOST_CHECK_EQUAL(7u, u);
+    BOOST_CHECK(fixed_atoul<16>("1234567890123456", u));
+    BOOST_CHECK_EQUAL(1234567890123456u, u);
+    BOOST_CHECK(fixed_atoul<19>("      1234567890123", u));
+    BOOST_CHECK_EQUAL(1234567890123u, u);
+    BOOST_CHECK(fixed_atoul<20>("18446744073709551615", u));
+    BOOST_CHECK_EQUAL(18446744073709551615u, u);
+    u = 5;
+    BOOST_CHECK(!fixed_atoul<6>("      ", u));
+    BOOST_CHECK(!fixed_atoul<6>("12 345", u));
+    BOOST_CHECK(!fixed_atoul<6>("1234  ", u));
+    BOOST_CHECK(!fixed_atoul<6>(" -1234", u));
+    BOOST_CHECK(!fixed_atoul<6>("12345A", u));
+    BOOST_CHECK(!fixed_atoul<12>("12345678901:", u));
+    BOOST_CHECK(!fixed_atoul<16>("123456789012345/", u));
+    BOOST_CHECK_EQUAL(5u, u);
+
+    // Random fields of all widths
+    std::mt19937_64 rnd(1);
+    char buf[32];
+    int  bad = 0;
+    auto check = [&](auto a_n) {
+        const int N = decltype(a_n)::value;
+        for (int i = 0; i < 10000; ++i) {
+            int k = rnd() % N;   // Leading spaces
+            for (int j = 0; j < N; ++j)
+                buf[j] = j < k ? ' ' : char('0' + rnd() % 10);
+            if (rnd() % 4 == 0)
+                buf[k + rnd() % (N - k)] = "- .:/A\0"[rnd() % 7];
+
+            uint64_t res = 0, exp = 0;
+            bool     valid = buf[N-1] != ' ';
+            for (int j = 0; j < N; ++j) {
+                exp    = exp * 10 + (buf[j] & 0x0F);
+                valid &= isdigit(buf[j]) || (buf[j] == ' ' && (!j || buf[j-1] == ' '));
+            }
+            bad += fixed_atoul<N>(buf, res) != valid;
+            bad += valid && res != exp;
+
+            const char* p = buf;
+            bad += valid && (unsafe_fixed_atoul<N>(p) != exp || p != buf + N);
+        }
+    };
+    check(std::integral_constant<int, 1>());  check(std::integral_constant<int, 3>());
+    check(std::integral_constant<int, 4>());  check(std::integral_constant<int, 5>());
+    check(std::integral_constant<int, 7>());  check(std::integral_constant<int, 8>());
+    check(std::integral_constant<int, 9>());  check(std::integral_constant<int, 12>());
+    check(std::integral_constant<int, 15>()); check(std::integral_constant<int, 16>());
+    check(std::integral_constant<int, 17>()); check(std::integral_constant<int, 19>());
+    BOOST_CHECK_EQUAL(0, bad);
+}
+
+namespace {
+    // Convert a fixed-width field one char at a time
+    template <int N>
+    uint64_t scalar_fixed_atoul(const char* p) {
+        uint64_t n = 0;
+        for (int i = 0; i < N; ++i)
+            n = n*10 + (p[i] & 0x0F);
+        return n;
+    }
+
+    template <int N>
+    void bench_fixed_atoul(long a_iterations) {
+        // Records of fixed-width fields right-justified with spaces
+        std::mt19937_64 rnd(1);
+        std::string     data;
+        for (int i = 0; i < 4096; ++i) {
+            auto s = std::to_string(rnd() % utxx::pow<10, N-1>::value);
+            data  += std::string(N - s.size(), ' ') + s;
+        }
+        auto run = [&](const std::function<uint64_t(const char*)>& a_fun) {
+            timer    t;
+            uint64_t sum = 0;
+            for (long i = 0; i < a_iterations; i++)
+                sum += a_fun(data.c_str() + (i & 4095) * N);
+            return std::make_pair(t.latency_nsec(a_iterations), sum);
+        };
+        auto r1 = run(&scalar_fixed_atoul<N>);
+        auto r2 = run([](const char* p) { return unsafe_fixed_atoul<N>(p); });
+        auto r3 = run([](const char* p) { uint64_t n = 0; fixed_atoul<N>(p, n); return n; });
+        BOOST_CHECK_EQUAL(r1.second, r2.second);
+        BOOST_CHECK_EQUAL(r1.second, r3.second);
+        BOOST_TEST_MESSAGE("fixed_atoul<" << std::setw(2) << N << ">: byte loop "
+                           << r1.first << " ns, unsafe_fixed_atoul " << r2.first
+                           << " ns, fixed_atoul " << r3.first << " ns");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_convert_fixed_atoul_speed )
+{
+    const long ITERATIONS = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 1000000;
+
+    bench_fixed_atoul<6> (ITERATIONS);
+    bench_fixed_atoul<8> (ITERATIONS);
+    bench_fixed_atoul<12>(ITERATIONS);
+    bench_fixed_atoul<16>(ITERATIONS);
+    bench_fixed_atoul<18>(ITERATIONS);
+}
+
 BOOST_AUTO_TEST_CASE( test_convert_fast_atoi )
 {
     long n;
@@ -702,6 +811,273 @@ BOOST_AUTO_TEST_CASE( test_convert_ftoa )
     BOOST_CHECK_EQUAL("-123.82494", std::string(buf, 10));
 }
 
+BOOST_AUTO_TEST_CASE( test_convert_ftoa_shortest )
+{
+    char buf[64];
+
+    const std::pair<double, const char*> s_cases[] = {
+        {0.0,           "0.0"},
+        {-0.0,          "-0.0"},
+        {1.0,           "1.0"},
+        {100.0,         "100.0"},
+        {123.45,        "123.45"},
+        {-0.3,          "-0.3"},
+        {2.0/3,         "0.6666666666666666"},
+        {0.0001,        "0.0001"},
+        {0.00001,       "1e-05"},
+        {1e15,          "1000000000000000.0"},
+        {1e16,          "1e+16"},
+        {1.2345e-100,   "1.2345e-100"},
+        {5e-324,        "5e-324"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+        {std::numeric_limits<double>::infinity(),  "inf"},
+        {-std::numeric_limits<double>::infinity(), "-inf"},
+        {std::numeric_limits<double>::quiet_NaN(), "nan"},
+    };
+    for (auto& c : s_cases) {
+        int n = ftoa_shortest(c.first, buf);
+        BOOST_CHECK_EQUAL(c.second, buf);
+        BOOST_CHECK_EQUAL(int(strlen(c.second)), n);
+    }
+    ftoa_shortest(1.1f, buf);
+    BOOST_CHECK_EQUAL("1.1", buf);
+    ftoa_shortest(3.4028235e38f, buf);
+    BOOST_CHECK_EQUAL("3.4028235e+38", buf);
+
+    // Random numbers convert back exactly, with the fewest digits
+    std::mt19937_64 rnd(1);
+    const int N = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) / 10 : 100000;
+    for (int i = 0; i < N; i++) {
+        union { double d; uint64_t u; } x;
+        x.u = rnd();
+        if (i % 2)
+            x.d = double(rnd() % 100000000) / 10000;
+        else if (std::isnan(x.d) || std::isinf(x.d))
+            continue;
+        ftoa_shortest(x.d, buf);
+        BOOST_REQUIRE_EQUAL(x.d, strtod(buf, nullptr));
+
+        // Number of significant digits
+        std::string sig;
+        for (char* p = buf; *p && *p != 'e'; p++)
+            if (isdigit(*p) && (*p != '0' || !sig.empty())) sig += *p;
+        sig.erase(sig.find_last_not_of('0') + 1);
+
+        // The fewest digits converting back to the number
+        char ref[32];
+        int  digits = 1;
+        for (; digits < 17; digits++) {
+            snprintf(ref, sizeof(ref), "%.*e", digits-1, x.d);
+            if (strtod(ref, nullptr) == x.d) break;
+        }
+        BOOST_REQUIRE_EQUAL(digits, std::max<int>(1, sig.size()));
+
+        union { float f; uint32_t u; } y;
+        y.u = uint32_t(rnd());
+        if (std::isnan(y.f) || std::isinf(y.f))
+            continue;
+        ftoa_shortest(y.f, buf);
+        BOOST_REQUIRE_EQUAL(y.f, strtof(buf, nullptr));
+    }
+
+    // Shortest precision in fixed notation
+    BOOST_CHECK_EQUAL(6, ftoa_left(123.45, buf, sizeof(buf), -1));
+    BOOST_CHECK_EQUAL("123.45", buf);
+    BOOST_CHECK_EQUAL(24, ftoa_left(1e21, buf, sizeof(buf), -1));
+    BOOST_CHECK_EQUAL("1000000000000000000000.0", buf);
+    BOOST_CHECK_EQUAL(-1, ftoa_left(1e100, buf, sizeof(buf), -1));
+    BOOST_CHECK_EQUAL(8, ftoa_left(0.000001, buf, sizeof(buf), -1));
+    BOOST_CHECK_EQUAL("0.000001", buf);
+    BOOST_CHECK_EQUAL(23, ftoa_left(1.5e-20, buf, sizeof(buf), 21, false));
+    BOOST_CHECK_EQUAL("0.000000000000000000015", std::string(buf, 23));
+    BOOST_CHECK_EQUAL(24, ftoa_left(1e20, buf, sizeof(buf), 2, false));
+    BOOST_CHECK_EQUAL("100000000000000000000.00", buf);
+    ftoa_right(-1.25, buf, 8, -1, ' ');
+    BOOST_CHECK_EQUAL("   -1.25", std::string(buf, 8));
+    ftoa_right(1e20, buf, 25, 2, '0');
+    BOOST_CHECK_EQUAL("0100000000000000000000.00", std::string(buf, 25));
+    BOOST_CHECK_THROW(ftoa_right(1e20, buf, 20, 2), std::invalid_argument);
+
+    // Large numbers and high precisions are formatted exactly as "%.*f" does
+    BOOST_CHECK_EQUAL(21, ftoa_left(-2.1847062606175414e17, buf, sizeof(buf), 1, false));
+    BOOST_CHECK_EQUAL("-218470626061754144.0", buf);
+    BOOST_CHECK_EQUAL(25, ftoa_left(4.0124017722723313e18, buf, sizeof(buf), 5, false));
+    BOOST_CHECK_EQUAL("4012401772272331264.00000", buf);
+    ftoa_right(4.0124017722723313e18, buf, 26, 5, ' ');
+    BOOST_CHECK_EQUAL(" 4012401772272331264.00000", std::string(buf, 26));
+    BOOST_CHECK_EQUAL(21, ftoa_left(0.1, buf, sizeof(buf), 19, false));
+    BOOST_CHECK_EQUAL("0.1000000000000000056", buf);
+    ftoa_right(-0.1, buf, 23, 20, ' ');
+    BOOST_CHECK_EQUAL("-0.10000000000000000555", std::string(buf, 23));
+
+    for (auto x : {-2.1847062606175414e17, 4.0124017722723313e18, 1.2345678901234567e25,
+                   9007199254740993.0, 0.3, 123.456})
+        for (int prec : {0, 1, 5, 19, 25}) {
+            char exp[128];
+            int  len = snprintf(exp, sizeof(exp), "%.*f", prec, x);
+            if (std::abs(x) <= 9007199254740992.0 && prec < 19)
+                continue;   // Fast path
+            BOOST_CHECK_EQUAL(len, ftoa_left(x, buf, sizeof(buf), prec, false));
+            BOOST_CHECK_EQUAL(exp, buf);
+        }
+}
+
+BOOST_AUTO_TEST_CASE( test_convert_ftoa_speed )
+{
+    const long ITERATIONS = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 1000000;
+
+    // Prices and quantities
+    std::mt19937_64 rnd(1);
+    std::vector<double> prices(1024);
+    for (auto& p : prices)
+        p = double(rnd() % 10000000) / (rnd() % 2 ? 100 : 10000);
+
+    char buf[64];
+    auto bench = [&](const char* a_name, const std::function<int(double)>& a_fun) {
+        timer t;
+        long  n = 0;
+        for (long i = 0; i < ITERATIONS; i++)
+            n += a_fun(prices[i & 1023]);
+        BOOST_TEST_MESSAGE(std::setw(22) << a_name << " time: "
+                           << t.latency_nsec(ITERATIONS) << " ns/call");
+        return n;
+    };
+
+    auto n1 = bench("snprintf(%.17g)",    [&](double d) { return snprintf(buf, sizeof(buf), "%.17g", d); });
+    bench("snprintf(%.6f)",               [&](double d) { return snprintf(buf, sizeof(buf), "%.6f",  d); });
+    bench("ftoa_left(6)",                 [&](double d) { return ftoa_left(d, buf, sizeof(buf), 6);    });
+    auto n4 = bench("ftoa_left(shortest)",[&](double d) { return ftoa_left(d, buf, sizeof(buf), -1);   });
+    auto n5 = bench("ftoa_shortest",      [&](double d) { return ftoa_shortest(d, buf);                });
+
+    // The shortest representation is never longer than the %.17g one
+    BOOST_CHECK_LE(n4, n1);
+    BOOST_CHECK_LE(n5, n1);
+}
+
+namespace {
+    // Parse \a a_str with atof() and strtod(), and compare the results bitwise
+    template <typename T>
+    bool same_as_strtod(const char* a_str, const char* a_end = nullptr) {
+        if (!a_end) a_end = a_str + strlen(a_str);
+        T    res = T(-12345), exp;
+        auto p   = atof(a_str, a_end, res);
+        char* e;
+        exp = std::is_same<T, double>::value ? strtod(a_str, &e) : strtof(a_str, &e);
+        if (e == a_str) { e = const_cast<char*>(a_str); res = exp; }
+        return p == e && memcmp(&res, &exp, sizeof(T)) == 0;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_convert_atof )
+{
+    const char* s_cases[] = {
+        "0", "-0", "1", "+1.5", "0.1", "-123.456", ".5", "5.", "000001234.50000",
+        "1e10", "1E-10", "-2.5e+3", "1e", "1e+", "1.5e|", "12|34",
+        "1.00000000000000011102230246251565404236316680908203125",  // Halfway
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "9007199254740993", "9007199254740992.5", "123456789012345678901234567890",
+        "0.000000000000000000000000000000000000001234",
+        "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+        "1.7976931348623157e308", "1.7976931348623159e308", "1e400",
+        "3.4028235e38", "3.4028236e38", "1.4e-45", "7e-46", "7.038531e-26",
+        "12345678.12345678", "1234567812345678.5", "12345678123456781234.5678",
+    };
+    for (auto s : s_cases) {
+        BOOST_CHECK_MESSAGE(same_as_strtod<double>(s), s);
+        BOOST_CHECK_MESSAGE(same_as_strtod<float> (s), s);
+    }
+
+    // Leading spaces are skipped, and nothing is parsed from a non-number
+    double d = 1.0;
+    const char s1[] = "  12.5 ", s2[] = " -.e5", s3[] = "12.5";
+    BOOST_CHECK(atof(s1, s1+7, d) == s1+6);
+    BOOST_CHECK_EQUAL(12.5, d);
+    BOOST_CHECK(atof(s2, s2+5, d) == s2);
+    BOOST_CHECK_EQUAL(12.5, d);
+    BOOST_CHECK(atof(s3, s3+2, d) == s3+2);  // The end is respected
+    BOOST_CHECK_EQUAL(12.0, d);
+
+    // Random doubles and digit strings followed by other fields
+    std::mt19937_64 rnd(1);
+    char buf[128];
+    int  bad = 0;
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t bits = rnd();
+        memcpy(&d, &bits, sizeof(d));
+        if (std::isfinite(d)) {
+            int n = snprintf(buf, sizeof(buf), i & 1 ? "%.*e|1234567890123456" : "%.*g",
+                             1 + int(rnd() % 17), d);
+            bad += !same_as_strtod<double>(buf, buf + n);
+        }
+
+        int k   = rnd() % 2 ? sprintf(buf, "-") : 0;
+        int n   = 1 + rnd() % 30;
+        int dot = rnd() % (n + 1);
+        for (int j = 0; j < n; ++j) {
+            if (j == dot) buf[k++] = '.';
+            buf[k++] = char('0' + rnd() % 10);
+        }
+        if (rnd() % 3 == 0)
+            k += sprintf(buf + k, "e%d", int(rnd() % 700) - 350);
+        k += sprintf(buf + k, "%s", rnd() % 2 ? "" : "\x01" "44=1234.5\x01");
+        bad += !same_as_strtod<double>(buf, buf + k);
+        bad += !same_as_strtod<float> (buf, buf + k);
+    }
+    BOOST_CHECK_EQUAL(0, bad);
+
+    // Sweep over positive floats: their shortest and 9-digit representations
+    // must be parsed back to the same float
+    for (uint32_t bits = 1; bits < 0x7f800000; bits += 4099) {
+        float f, r = 0;
+        memcpy(&f, &bits, sizeof(f));
+        int n = ftoa_shortest<false>(f, buf);
+        bad  += atof(buf, buf + n, r) != buf + n || r != f;
+        n     = snprintf(buf, sizeof(buf), "%.9g", f);
+        bad  += atof(buf, buf + n, r) != buf + n || r != f;
+    }
+    BOOST_CHECK_EQUAL(0, bad);
+}
+
+BOOST_AUTO_TEST_CASE( test_convert_atof_speed )
+{
+    const long ITERATIONS = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 1000000;
+
+    // FIX-like message with price and quantity fields: "44=1234.5678<SOH>"
+    std::mt19937_64  rnd(1);
+    std::string      msg;
+    std::vector<int> fields;
+    for (int i = 0; i < 65536; ++i) {
+        char buf[32];
+        msg += i & 1 ? "44=" : "38=";
+        fields.push_back(msg.size());
+        snprintf(buf, sizeof(buf), "%.*f\x01", int(rnd() % 5), double(rnd() % 10000000) / 100);
+        msg += buf;
+    }
+    const char* end = msg.c_str() + msg.size();
+
+    auto bench = [&](const char* a_name, const std::function<double(const char*)>& a_fun) {
+        timer  t;
+        double sum = 0;
+        for (long i = 0; i < ITERATIONS; i++)
+            sum += a_fun(msg.c_str() + fields[i & 65535]);
+        BOOST_TEST_MESSAGE(std::setw(22) << a_name << " time: "
+                           << t.latency_nsec(ITERATIONS) << " ns/call");
+        return sum;
+    };
+
+    auto s1 = bench("strtod", [](const char* p) { return strtod(p, nullptr); });
+    auto s2 = bench("atof<double>", [=](const char* p) {
+        double d = 0; atof(p, end, d); return d;
+    });
+    auto s3 = bench("atof<float>",  [=](const char* p) {
+        float  f = 0; atof(p, end, f); return double(f);
+    });
+    BOOST_CHECK_EQUAL(s1, s2);
+    BOOST_CHECK_CLOSE(s1, s3, 0.0001);
+}
+
 BOOST_AUTO_TEST_CASE( test_convert_itoa_right_string )
 {
     BOOST_CHECK_EQUAL("0001", (itoa_right<int, 4>(1, '0')));
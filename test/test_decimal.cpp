@@ -102,4 +102,39 @@ BOOST_AUTO_TEST_CASE( test_decimal )
                                   BOOST_CHECK_EQUAL("1.256789012345678",d.to_string());}
 }
 
+BOOST_AUTO_TEST_CASE( test_decimal_from_string )
+{
+    auto parse = [](const char* s, int a_exp, long a_mant) {
+        decimal d;
+        auto    e = s + strlen(s);
+        BOOST_CHECK_MESSAGE(d.from_string(s, e) == e, s);
+        BOOST_CHECK_MESSAGE(decimal(a_exp, a_mant) == d,
+                            s << ": " << d.exp() << ", " << d.mantissa());
+    };
+
+    parse("0",                    0,  0);
+    parse("-0.000",               0,  0);
+    parse("1234.5",              -1,  12345);
+    parse("-1234.50",            -1, -12345);
+    parse("+0.00125",            -5,  125);
+    parse("1200",                 2,  12);
+    parse("1.5e-3",              -4,  15);
+    parse("1.25678901234",      -11,  125678901234);
+    parse("1.256789012345678",  -15,  1256789012345678);
+    parse("12345678901234567890",   4, 1234567890123457);  // Rounded to 16 digits
+    parse("0.999999999999999999",   0, 1);
+    // 17-digit mantissas don't fit in 56 bits with a sign
+    parse("99999999999999999",     17, 1);
+    parse("36028797018963968",      1, 3602879701896397);
+    parse("-36028797018963967",     1, -3602879701896397);
+    parse("9999999999999999",       0, 9999999999999999);
+
+    decimal d(-2, 1);
+    const char s1[] = "abc", s2[] = "1e200";
+    BOOST_CHECK(d.from_string(s1, s1+3) == s1);
+    BOOST_CHECK(d.from_string(s2, s2+5) == s2);   // Out of range exponent
+    BOOST_CHECK_EQUAL(decimal(-2, 1), d);
+    BOOST_CHECK_EQUAL(decimal(-2, 15), (d.from_string(std::string("0.15|")), d));
+}
+
 #endif
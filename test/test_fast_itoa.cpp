@@ -34,6 +34,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <boost/test/unit_test.hpp>
 #include <utxx/fast_itoa.hpp>
+#include <utxx/convert.hpp>
+#include <utxx/print.hpp>
+#include <utxx/time_val.hpp>
+#include <functional>
+#include <random>
+#include <vector>
 
 using namespace utxx;
 
@@ -65,4 +71,117 @@ BOOST_AUTO_TEST_CASE( test_fast_itoa )
     BOOST_CHECK_EQUAL(16, p - buf);
 }
 
+BOOST_AUTO_TEST_CASE( test_fast_itoa_formatters )
+{
+    // All formatters sharing the engine are checked against snprintf
+    std::mt19937_64 rnd(1);
+    char buf[64], ref[64];
+
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t u = rnd() >> (rnd() % 64);
+        int64_t  s = int64_t(rnd()) >> (rnd() % 64);
+        if (i < 4) {
+            u = i & 1 ? std::numeric_limits<uint64_t>::max() : 0;
+            s = i & 2 ? std::numeric_limits<int64_t>::min()
+                      : std::numeric_limits<int64_t>::max();
+        }
+
+        snprintf(ref, sizeof(ref), "%lu", u);
+        auto p = fast_itoa(u, buf);
+        BOOST_REQUIRE_EQUAL(ref, buf);
+        BOOST_REQUIRE_EQUAL(strlen(ref), size_t(p - buf));
+        char* q = buf;
+        itoa(u, q);
+        BOOST_REQUIRE_EQUAL(ref, buf);
+        BOOST_REQUIRE_EQUAL(strlen(ref), size_t(q - buf));
+
+        snprintf(ref, sizeof(ref), "%ld", s);
+        p = fast_itoa(s, buf);
+        BOOST_REQUIRE_EQUAL(ref, buf);
+        BOOST_REQUIRE_EQUAL(strlen(ref), size_t(p - buf));
+
+        // Fixed width with padding
+        char l[21], r[21];
+        itoa_left (l, s, ' ');
+        itoa_right(r, s, ' ');
+        snprintf(ref, sizeof(ref), "%-21ld", s);
+        BOOST_REQUIRE_EQUAL(ref, std::string(l, sizeof(l)));
+        snprintf(ref, sizeof(ref), "%21ld", s);
+        BOOST_REQUIRE_EQUAL(ref, std::string(r, sizeof(r)));
+
+        int32_t  n = int32_t(s);
+        snprintf(ref, sizeof(ref), "%d", n);
+        p = fast_itoa(n, buf);
+        BOOST_REQUIRE_EQUAL(ref, buf);
+        BOOST_REQUIRE_EQUAL(ref, int_to_string(n));
+    }
+
+    detail::basic_buffered_print<> b;
+    b.print(0L, ' ', -1, ' ', 12345678u, ' ', std::numeric_limits<long>::min(), ' ',
+            std::numeric_limits<uint64_t>::max(), ' ', int16_t(-32768));
+    BOOST_CHECK_EQUAL("0 -1 12345678 -9223372036854775808 18446744073709551615 -32768",
+                      b.to_string());
+}
+
+namespace {
+    // Scalar conversion one digit at a time (the former itoa() loop)
+    char* scalar_itoa(uint64_t a_val, char* a_buf) {
+        char tmp[20], *p = tmp + sizeof(tmp);
+        do { *--p = char('0' + a_val % 10); a_val /= 10; } while (a_val);
+        size_t n = tmp + sizeof(tmp) - p;
+        memcpy(a_buf, p, n);
+        return a_buf + n;
+    }
+
+    double bench_itoa(const std::vector<uint64_t>& a_vals, int a_iterations,
+                      const std::function<size_t (uint64_t, char*)>& a_fun)
+    {
+        char buf[32];
+        size_t sum = 0;
+        timer  t;
+        for (int i = 0; i < a_iterations; ++i)
+            for (auto v : a_vals)
+                sum += a_fun(v, buf);
+        double ns = t.latency_nsec(a_iterations * a_vals.size());
+        BOOST_CHECK(sum > 0);
+        return ns;
+    }
+}
 
+BOOST_AUTO_TEST_CASE( test_fast_itoa_speed )
+{
+    const int N = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 100;
+    std::mt19937_64 rnd(1);
+    detail::basic_buffered_print<> b;
+
+    for (int digits : {1, 2, 4, 6, 8, 10, 12, 16, 19, 20}) {
+        std::vector<uint64_t> vals(4096);
+        uint64_t lo = detail::pow10u(digits-1) - (digits == 1);
+        for (auto& v : vals) {
+            v = lo + rnd() % (digits < 20 ? detail::pow10u(digits) - lo : ~lo);
+            BOOST_REQUIRE_EQUAL(digits, detail::decimal_length(v));
+        }
+
+        auto t1 = bench_itoa(vals, N, [](uint64_t v, char* p) {
+            return size_t(snprintf(p, 32, "%lu", v));
+        });
+        auto t2 = bench_itoa(vals, N, [](uint64_t v, char* p) {
+            return size_t(scalar_itoa(v, p) - p);
+        });
+        auto t3 = bench_itoa(vals, N, [](uint64_t v, char* p) {
+            return size_t(fast_itoa(v, p) - p);
+        });
+        auto t4 = bench_itoa(vals, N, [](uint64_t v, char* p) {
+            return size_t(itoa_right<uint64_t, 20>(p, v, '0') - p + 2);
+        });
+        auto t5 = bench_itoa(vals, N, [&b](uint64_t v, char*) {
+            b.reset();
+            b.print(v);
+            return b.size();
+        });
+        BOOST_TEST_MESSAGE("itoa " << std::setw(2) << digits << " digits: snprintf "
+                           << t1 << " ns, scalar " << t2 << " ns, fast_itoa " << t3
+                           << " ns, itoa_right<20> " << t4 << " ns, buffered_print "
+                           << t5 << " ns");
+    }
+}
@@ -0,0 +1,246 @@
+//----------------------------------------------------------------------------
+/// \file   test_flat_hash_map.cpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Test cases for the flat (open-addressing) hash map.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+#include <utxx/container/flat_hash_map.hpp>
+#include <utxx/time_val.hpp>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace utxx;
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_basic )
+{
+    flat_hash_map<int, int> m;
+    BOOST_REQUIRE(m.empty());
+    BOOST_REQUIRE(m.find(1) == m.end());
+    BOOST_REQUIRE(m.begin() == m.end());
+    BOOST_REQUIRE_EQUAL(0u, m.erase(1));
+
+    BOOST_REQUIRE(m.insert(std::make_pair(1, 10)).second);
+    BOOST_REQUIRE(!m.insert(std::make_pair(1, 20)).second);
+    BOOST_REQUIRE_EQUAL(10, m.at(1));
+    BOOST_REQUIRE(m.emplace(2, 20).second);
+    m[3] = 30;
+    BOOST_REQUIRE_EQUAL(3u, m.size());
+    BOOST_REQUIRE_EQUAL(30, m.find(3)->second);
+    BOOST_REQUIRE(m.contains(2));
+    BOOST_REQUIRE_THROW(m.at(4), utxx::runtime_error);
+    m.insert_or_assign(1, 11);
+    BOOST_REQUIRE_EQUAL(11, m[1]);
+
+    int sum = 0;
+    for (auto& v : m) sum += v.second;
+    BOOST_REQUIRE_EQUAL(61, sum);
+
+    // Erase while iterating
+    for (auto it = m.begin(); it != m.end(); )
+        it = it->first == 2 ? m.erase(it) : std::next(it);
+    BOOST_REQUIRE_EQUAL(2u, m.size());
+    BOOST_REQUIRE(!m.contains(2));
+
+    // Copy and move
+    auto c = m;
+    BOOST_REQUIRE_EQUAL(2u, c.size());
+    BOOST_REQUIRE_EQUAL(30, c.at(3));
+    auto d = std::move(c);
+    BOOST_REQUIRE(c.empty());
+    BOOST_REQUIRE_EQUAL(11, d.at(1));
+    c = d;
+    BOOST_REQUIRE_EQUAL(2u, c.size());
+
+    m.clear();
+    BOOST_REQUIRE(m.empty());
+    BOOST_REQUIRE(m.begin() == m.end());
+    BOOST_REQUIRE(!m.contains(1));
+}
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_random )
+{
+    // Random inserts and erases verified against std::unordered_map, with
+    // non-trivial values to check that they are moved and destroyed
+    flat_hash_map<long, std::string>      m;
+    std::unordered_map<long, std::string> ref;
+    std::mt19937_64 rnd(1);
+
+    for (int i = 0; i < 200000; ++i) {
+        long k = rnd() % 20000;
+        switch (rnd() % 3) {
+            case 0:
+            case 1: {
+                auto v = std::to_string(k) + std::string(k % 40, 'x');
+                BOOST_REQUIRE_EQUAL(ref.emplace(k, v).second, m.try_emplace(k, v).second);
+                break;
+            }
+            default:
+                BOOST_REQUIRE_EQUAL(ref.erase(k), m.erase(k));
+        }
+    }
+    BOOST_REQUIRE_EQUAL(ref.size(), m.size());
+    BOOST_REQUIRE(m.load_factor() <= m.max_load_factor());
+    for (auto& v : ref) {
+        auto it = m.find(v.first);
+        BOOST_REQUIRE(it != m.end());
+        BOOST_REQUIRE_EQUAL(v.second, it->second);
+    }
+    size_t n = 0;
+    for (auto& v : m) {
+        BOOST_REQUIRE_EQUAL(ref[v.first], v.second);
+        ++n;
+    }
+    BOOST_REQUIRE_EQUAL(ref.size(), n);
+
+    // Erasing all keys and inserting new ones reuses the slots
+    size_t cap = m.capacity();
+    for (long j = 0, off = 0; j < 10; ++j, off += 100000) {
+        for (auto& v : ref) BOOST_REQUIRE_EQUAL(1u, m.erase(v.first + off));
+        BOOST_REQUIRE(m.empty());
+        for (auto& v : ref)
+            BOOST_REQUIRE(m.insert(std::make_pair(v.first + off + 100000, v.second)).second);
+        BOOST_REQUIRE_EQUAL(ref.size(), m.size());
+    }
+    BOOST_REQUIRE_EQUAL(cap, m.capacity());
+
+    m.rehash(0);
+    BOOST_REQUIRE_EQUAL(ref.size(), m.size());
+    m.reserve(100000);
+    BOOST_REQUIRE(m.capacity() * m.max_load_factor() >= 100000);
+}
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_heterogeneous )
+{
+    flat_hash_map<name_t, int> names;
+    names[name_t("IBM")]  = 1;
+    names[name_t("MSFT")] = 2;
+    BOOST_REQUIRE_EQUAL(1, names.find("IBM")->second);
+    BOOST_REQUIRE_EQUAL(2, names.at(std::string("MSFT")));
+    BOOST_REQUIRE(names.find("AAPL") == names.end());
+    BOOST_REQUIRE(!names.contains("INVALID_NAME_TOO_LONG"));
+    BOOST_REQUIRE(!names.contains("IB$"));
+    BOOST_REQUIRE_EQUAL(1u, names.erase("IBM"));
+    BOOST_REQUIRE_EQUAL(1u, names.size());
+
+    using sstring = basic_short_string<char>;
+    flat_hash_map<sstring, int> strs;
+    strs[sstring("ESZ6")]  = 1;
+    strs[sstring("NQH7")]  = 2;
+    strs[sstring(std::string(100, 'a'))] = 3;   // Allocated string
+    BOOST_REQUIRE_EQUAL(1, strs.find("ESZ6")->second);
+    BOOST_REQUIRE_EQUAL(2, strs.at(std::string("NQH7")));
+    BOOST_REQUIRE_EQUAL(3, strs.at(std::string(100, 'a')));
+    BOOST_REQUIRE(!strs.contains("ESZ"));
+    BOOST_REQUIRE(!strs.contains(std::string("ESZ6\0", 5)));
+    BOOST_REQUIRE_EQUAL(1u, strs.erase("NQH7"));
+    BOOST_REQUIRE_EQUAL(2u, strs.size());
+}
+
+namespace {
+    template <class Map, class Keys, class Lookup>
+    double bench_lookups(Map& a_map, const Keys& a_keys, const Lookup& a_lookup,
+                         int a_iterations)
+    {
+        long found = 0;
+        timer t;
+        for (int i = 0; i < a_iterations; ++i)
+            for (auto& k : a_keys)
+                found += a_lookup(a_map, k);
+        double ns = t.latency_nsec(a_iterations * a_keys.size());
+        BOOST_CHECK_EQUAL(long(a_iterations * a_keys.size()), found);
+        return ns;
+    }
+
+    template <class Map, class Key>
+    size_t find(const Map& a_map, const Key& a_key) {
+        return a_map.find(a_key) != a_map.end();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_perf )
+{
+    const int N = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10;
+
+    // Order lookups by id
+    {
+        const int count = 200000;
+        std::mt19937_64    rnd(1);
+        std::vector<long>  ids(count);
+        for (auto& id : ids) id = rnd() >> 1;
+
+        flat_hash_map<long, long>        fm;
+        std::unordered_map<long, long>   um;
+        for (auto id : ids) { fm[id] = id; um[id] = id; }
+        std::shuffle(ids.begin(), ids.end(), rnd);
+
+        auto fns = bench_lookups(fm, ids, &find<decltype(fm), long>, N);
+        auto uns = bench_lookups(um, ids, &find<decltype(um), long>, N);
+        BOOST_TEST_MESSAGE("Order id lookup (" << count << " orders): flat_hash_map "
+                           << fns << " ns, unordered_map " << uns << " ns");
+    }
+
+    // Symbol lookups
+    {
+        using sstring = basic_short_string<char>;
+        const int count = 5000;
+        std::vector<std::string> syms;
+        for (int i = 0; i < count; ++i) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "S%c%c%d", 'A' + i % 26, 'A' + i / 26 % 26, i);
+            syms.push_back(buf);
+        }
+        std::vector<name_t>  names;
+        for (auto& s : syms) names.emplace_back(s);
+
+        flat_hash_map<name_t, int>             fn;
+        std::unordered_map<name_t, int>        un;
+        std::map<name_t, int>                  om;
+        flat_hash_map<sstring, int>            fs;
+        std::unordered_map<std::string, int>   us;
+        for (int i = 0; i < count; ++i) {
+            fn[names[i]] = un[names[i]] = om[names[i]] = i;
+            fs[sstring(syms[i])] = us[syms[i]] = i;
+        }
+
+        int n = N * 20;
+        auto t1 = bench_lookups(fn, names, &find<decltype(fn), name_t>, n);
+        auto t2 = bench_lookups(un, names, &find<decltype(un), name_t>, n);
+        auto t3 = bench_lookups(om, names, &find<decltype(om), name_t>, n);
+        auto t4 = bench_lookups(fs, syms,  &find<decltype(fs), std::string>, n);
+        auto t5 = bench_lookups(us, syms,  &find<decltype(us), std::string>, n);
+        BOOST_TEST_MESSAGE("Symbol lookup (" << count << " symbols): name_t keys: "
+                           << "flat_hash_map " << t1 << " ns, unordered_map "
+                           << t2 << " ns, map " << t3 << " ns; string keys: "
+                           << "flat_hash_map<short_string> " << t4
+                           << " ns, unordered_map<string> " << t5 << " ns");
+    }
+}
@@ -33,6 +33,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <utxx/hashmap.hpp>
 #include <utxx/time_val.hpp>
 #include <utxx/verbosity.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
 #if defined(__GNUC__) && __cplusplus >= 201103L
 #include <bits/functional_hash.h>
 #endif
@@ -147,3 +151,185 @@ BOOST_AUTO_TEST_CASE( test_hashmap )
 
     BOOST_TEST_MESSAGE((boost::format("Ratio: %.3f") % (elapsed4 / elapsed2)).str());
 }
+
+BOOST_AUTO_TEST_CASE( test_hashmap_crc32c )
+{
+    BOOST_REQUIRE_EQUAL(0u,          detail::crc32c_sw("", 0));
+    BOOST_REQUIRE_EQUAL(0xE3069283u, detail::crc32c_sw("123456789", 9));
+    BOOST_REQUIRE_EQUAL(0xE3069283u, detail::crc32c("123456789", 9));
+
+    // Chained computation
+    uint32_t crc = detail::crc32c("1234", 4);
+    BOOST_REQUIRE_EQUAL(0xE3069283u, detail::crc32c("56789", 5, crc));
+
+#if defined(__x86_64__)
+    if (!detail::has_sse42()) {
+        BOOST_TEST_MESSAGE("SSE4.2 is not supported by the CPU");
+        return;
+    }
+    // Hardware and software implementations agree for all lengths and
+    // alignments
+    char buf[128];
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = rand();
+    for (size_t off = 0; off < 8; ++off)
+        for (size_t len = 0; len < sizeof(buf) - off; ++len)
+            BOOST_REQUIRE_EQUAL(detail::crc32c_sw(buf+off, len, off),
+                                detail::crc32c_hw(buf+off, len, off));
+#endif
+}
+
+namespace {
+    struct hash_info {
+        const char* name;
+        uint64_t  (*fun)(const void*, size_t, uint64_t);
+        bool        good;   // Expected to pass the quality checks
+    };
+
+    uint64_t hsieh(const void* k, size_t n, uint64_t)
+        { return detail::hsieh_hash((const char*)k, n); }
+    uint64_t murmur(const void* k, size_t n, uint64_t s)
+        { return detail::murmur_hash64(k, n, s); }
+    uint64_t crapwow(const void* k, size_t n, uint64_t s)
+        { return detail::crapwow((const char*)k, n, s); }
+#if defined(__GNUC__) && __cplusplus >= 201103L
+    uint64_t std_hash(const void* k, size_t n, uint64_t s)
+        { return std::_Hash_impl::hash(k, n, s); }
+#endif
+    uint64_t fast(const void* k, size_t n, uint64_t s)
+        { return detail::fast_hash64(k, n, s); }
+
+    std::vector<hash_info> hash_functions() {
+        std::vector<hash_info> res {
+            {"hsieh_hash",    &hsieh,   false},
+            {"murmur_hash64", &murmur,  true},
+            {"crapwow",       &crapwow, false},
+#if defined(__GNUC__) && __cplusplus >= 201103L
+            {"std::hash",     &std_hash,false},
+#endif
+            {"fast_hash64",   &fast,    true},
+        };
+#if defined(__x86_64__)
+        if (detail::has_sse42())
+            res.push_back({"crc32c_hash64", &detail::crc32c_hash64_hw, false});
+        if (detail::has_aes())
+            res.push_back({"aes_hash64",    &detail::aes_hash64_hw,    true});
+#endif
+        return res;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hashmap_hash_speed )
+{
+    const int ITERATIONS = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 10;
+    const int COUNT      = 4096;
+
+    for (size_t len : {4, 8, 16, 32, 64}) {
+        std::vector<char> data(COUNT * len);
+        for (auto& c : data) c = ' ' + rand() % 95;
+
+        std::stringstream out;
+        out << "Key length " << std::setw(2) << len << ':';
+        for (auto& h : hash_functions()) {
+            uint64_t sum = 0;
+            timer perf;
+            for (int i = 0; i < ITERATIONS * 100; ++i)
+                for (const char* p = &data[0], *e = p + data.size(); p != e; p += len)
+                    sum += h.fun(p, len, 0);
+            double ns = perf.elapsed_nsec() / (COUNT * ITERATIONS * 100);
+            out << ' ' << h.name << '=' << std::fixed << std::setprecision(2)
+                << ns << "ns";
+            BOOST_CHECK(sum != 0);
+        }
+        BOOST_TEST_MESSAGE(out.str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hashmap_hash_quality )
+{
+    // Bucket collisions of keys, which look like order ids, in a table with
+    // as many buckets as keys.  Expected number of colliding keys is M/e.
+    const size_t M = 1 << 18;
+    std::vector<std::string> keys(M);
+    for (size_t i = 0; i < M; ++i) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "ORD%010zu", i * 7);
+        keys[i] = buf;
+    }
+    const double expected = M / exp(1.0);
+
+    // Avalanche: flipping any input bit should flip every output bit with
+    // probability 0.5
+    const int  SAMPLES = 1000;
+    const int  KEY_LEN = 16;
+
+    for (auto& h : hash_functions()) {
+        std::vector<uint8_t> buckets(M);
+        for (auto& k : keys)
+            buckets[h.fun(k.c_str(), k.size(), 0) & (M-1)] = 1;
+        size_t used      = std::count(buckets.begin(), buckets.end(), 1);
+        double collision = (M - used) / expected;
+
+        std::vector<int> flips(KEY_LEN * 8 * 64);
+        for (int i = 0; i < SAMPLES; ++i) {
+            uint8_t key[KEY_LEN];
+            for (auto& c : key) c = rand();
+            uint64_t h0 = h.fun(key, KEY_LEN, 0);
+            for (int bit = 0; bit < KEY_LEN * 8; ++bit) {
+                key[bit / 8] ^= 1 << (bit % 8);
+                uint64_t diff = h0 ^ h.fun(key, KEY_LEN, 0);
+                key[bit / 8] ^= 1 << (bit % 8);
+                for (int j = 0; j < 64; ++j)
+                    flips[bit * 64 + j] += (diff >> j) & 1;
+            }
+        }
+        // Only the low 32 bits are meaningful in 32-bit hashes
+        bool   is64 = h.fun != &hsieh && h.fun != &crapwow;
+        double bias = 0;
+        for (int bit = 0; bit < KEY_LEN * 8; ++bit)
+            for (int j = 0; j < (is64 ? 64 : 32); ++j)
+                bias = std::max(bias, fabs(double(flips[bit * 64 + j]) / SAMPLES - 0.5));
+
+        BOOST_TEST_MESSAGE((boost::format
+            ("%-14s bucket collisions: %.3f of expected, avalanche worst bias: %.3f")
+            % h.name % collision % bias).str());
+        if (h.good) {
+            BOOST_CHECK_MESSAGE(collision < 1.05 && collision > 0.95, h.name);
+            BOOST_CHECK_MESSAGE(bias < 0.1, h.name);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hashmap_jch_chash )
+{
+    const int COUNT = 200000;
+    std::vector<unsigned long> keys(COUNT);
+    for (int i = 0; i < COUNT; ++i)
+        keys[i] = detail::murmur_hash64(&i, sizeof(i), 0);
+
+    for (int n : {10, 100, 1000}) {
+        std::vector<int> buckets(n);
+        for (auto k : keys)
+            ++buckets[detail::jch_chash(k, n)];
+        auto   mm   = std::minmax_element(buckets.begin(), buckets.end());
+        double mean = double(COUNT) / n;
+
+        // Growing the number of buckets by one moves 1/(n+1) of the keys,
+        // all of them to the new bucket
+        int moved = 0;
+        for (auto k : keys) {
+            int b = detail::jch_chash(k, n+1);
+            if (b != detail::jch_chash(k, n)) {
+                ++moved;
+                BOOST_REQUIRE_EQUAL(n, b);
+            }
+        }
+        double expected = double(COUNT) / (n+1);
+        BOOST_CHECK_CLOSE(expected, double(moved), 10.0);
+
+        BOOST_TEST_MESSAGE((boost::format
+            ("jch_chash %4d buckets: min %+.1f%%, max %+.1f%% of mean, "
+             "moved on growth: %d (expected %.0f)")
+            % n % (100.0 * (*mm.first - mean) / mean)
+            % (100.0 * (*mm.second - mean) / mean) % moved % expected).str());
+    }
+}
@@ -36,10 +36,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iostream>
 #include <utxx/logger.hpp>
 #include <utxx/logger/logger_impl_console.hpp>
+#include <utxx/logger/logger_impl_mmap.hpp>
+#include <utxx/logger/logger_impl.hpp>
 #include <utxx/verbosity.hpp>
 #include <utxx/variant_tree.hpp>
 #include <signal.h>
+#include <sys/wait.h>
 #include <string.h>
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <time.h>
 
 //#define BOOST_TEST_MAIN
 
@@ -492,6 +500,737 @@ BOOST_AUTO_TEST_CASE( test_logger2 )
 
     log.finalize();
 }
+
+BOOST_AUTO_TEST_CASE( test_logger_deferred_format )
+{
+    const char* filename = "/tmp/logger.deferred.log";
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+
+    auto write_test_data = [&](bool a_deferred) {
+        pt.put("logger.deferred-format", a_deferred);
+        if (log.initialized())
+            log.finalize();
+        log.init(pt, nullptr, false);
+        BOOST_CHECK_EQUAL(a_deferred, log.deferred_format());
+
+        std::string s("temporary");
+        char        buf[16];
+        strcpy(buf, "on stack");
+
+        for (int i=0; i < 3; i++) {
+            LOG_INFO  ("Int=%d, long=%ld, char=%c", i, -10000000000l, 'x');
+            LOG_INFO  ("Double=%.3f, float=%.2f", 1.2345*i, 0.5f);
+            LOG_INFO  ("Str=%s, %s, %s", "literal", s.c_str(), buf);
+            LOG_INFO  ("No arguments\n");
+            LOG_INFO  ("No arguments 100%%");
+            LOG_INFO  ("Args %d%%", 100);
+            CLOG_ERROR("Cat", "Error #%u", 100u+i);
+        }
+        // Messages exceeding the size limit are truncated the same way
+        std::string long_str(2000, 'x');
+        LOG_INFO("Long=%s", long_str.c_str());
+        s = "modified"; strcpy(buf, "modified");
+
+        // Messages from a thread that exits before they are written
+        std::thread([&]() { LOG_INFO("From thread: %d", 1); }).join();
+
+        log.finalize();
+        return path::read_file(filename);
+    };
+
+    auto exp = write_test_data(false);
+    auto res = write_test_data(true);
+
+    BOOST_CHECK(exp.find("I|Str=literal, temporary, on stack\n") != std::string::npos);
+    BOOST_CHECK(exp.find("I|From thread: 1\n")                  != std::string::npos);
+    BOOST_CHECK(exp.find("I|No arguments 100%\n")               != std::string::npos);
+    BOOST_CHECK(exp.find("I|Args 100%\n")                       != std::string::npos);
+    auto   pos = exp.find("I|Long=");
+    BOOST_REQUIRE(pos != std::string::npos);
+    BOOST_CHECK_EQUAL(int(logger::s_max_fmt_size)-1, int(exp.find('\n', pos) - pos - 2));
+    BOOST_CHECK_EQUAL(exp, res);
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_format )
+{
+    const char* filename = "/tmp/logger.format.log";
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+    if (log.initialized())
+        log.finalize();
+    log.init(pt, nullptr, false);
+
+    std::string s("ESZ6");
+    time_val    tv(2014, 7, 10, 11, 12, 13, 123456, true);
+    for (int i=0; i < 2; i++) {
+        UTXX_LOGF (utxx::LEVEL_INFO, "Order #{:03}: {} {:<5}|{:8.2f}", i, "BUY", s, 2042.25);
+        UTXX_CLOGF(utxx::LEVEL_ERROR, "Cat", "Error #{} at {:time-msec}", 100u+i, tv);
+    }
+    UTXX_LOGF(utxx::LEVEL_DEBUG, "Not logged {}", 1);
+
+    log.finalize();
+    auto res = path::read_file(filename);
+    BOOST_CHECK_EQUAL("I|Order #000: BUY ESZ6 | 2042.25\n"
+                      "E|Error #100 at 11:12:13.123\n"
+                      "I|Order #001: BUY ESZ6 | 2042.25\n"
+                      "E|Error #101 at 11:12:13.123\n", res);
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_deferred_format_perf )
+{
+    const char* filename   = "/tmp/logger.deferred.log";
+    const int   iterations = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 100000;
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("time-usec"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.deferred-buffer-size",  4*1024*1024);
+    pt.put("logger.wait-timeout-ms",       1);
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    auto run = [&](bool a_deferred) {
+        pt.put("logger.deferred-format", a_deferred);
+        if (log.initialized())
+            log.finalize();
+        log.init(pt, nullptr, false);
+
+        // Measure CPU time of the calling thread, so that the work done by
+        // the logger thread is excluded even if both share the same core
+        auto cpu_now = []() {
+            struct timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return ts.tv_sec * 1000000000l + ts.tv_nsec;
+        };
+        auto start = cpu_now();
+        for (int i=0; i < iterations; i++)
+            LOG_INFO("Order #%d: %s %s %d @ %.4f", i, "BUY", "ESZ6", 10, 2042.25);
+        auto ns = cpu_now() - start;
+
+        log.finalize();
+
+        BOOST_TEST_MESSAGE("  " << (a_deferred ? "deferred" : "regular ")
+                         << " formatting: " << iterations << " msgs, "
+                         << (double(ns) / iterations) << " ns/msg");
+    };
+
+    run(false);
+    run(true);
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_msg_metadata )
+{
+    const char* filename = "/tmp/logger.metadata.log";
+
+    auto& cats = log_categories::instance();
+    auto  id   = cats.id("Cat1");
+    BOOST_CHECK_EQUAL(0u,     cats.id(""));
+    BOOST_CHECK_EQUAL("",     cats.name(0));
+    BOOST_CHECK_EQUAL(id,     cats.id("Cat1"));
+    BOOST_CHECK_EQUAL("Cat1", cats.name(id));
+    BOOST_CHECK_NE   (id,     cats.id("Cat2"));
+    BOOST_CHECK_EQUAL("Cat2", cats.name(cats.id("Cat2")));
+
+    const log_category cat1("Cat1");
+    BOOST_CHECK_EQUAL(id,     cat1.id());
+    BOOST_CHECK_EQUAL("Cat1", cat1.name());
+    BOOST_CHECK_EQUAL(0u,     log_category().id());
+    BOOST_CHECK_EQUAL(0u,     log_category("").id());
+    BOOST_CHECK_EQUAL(id,     log_category(std::string("Cat1")).id());
+
+    // Macros resolve a literal category once per call site, and only reuse
+    // it for the same literal
+    auto cat2 = cats.id("Cat2");
+    auto nreg = cats.count();
+    for (int i = 0; i < 4; ++i) {
+        BOOST_CHECK_EQUAL(id,   UTXX_LOG_CATEGORY("Cat1").id());
+        BOOST_CHECK_EQUAL(i & 1 ? id : cat2,
+                          UTXX_LOG_CATEGORY(i & 1 ? "Cat1" : "Cat2").id());
+        BOOST_CHECK_EQUAL(cat2, UTXX_LOG_CATEGORY(std::string("Cat2")).id());
+        BOOST_CHECK_EQUAL(id,   UTXX_LOG_CATEGORY(cat1).id());
+    }
+    char buf[8];
+    for (int i = 0; i < 2; ++i) {
+        strcpy(buf, i ? "Cat1" : "Cat2");
+        BOOST_CHECK_EQUAL(i ? id : cat2, UTXX_LOG_CATEGORY(buf).id());
+    }
+    BOOST_CHECK_EQUAL(nreg, cats.count());
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("date-time-usec"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.show-category",      true);
+    pt.put("logger.show-thread",        variant("name"));
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.tsc-timestamp",      true);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+    if (log.initialized())
+        log.finalize();
+    log.init(pt, nullptr, false);
+    BOOST_CHECK(log.tsc_timestamp());
+
+    const int N = 100;
+    time_val start = now_utc();
+
+    std::thread([&]() {
+        pthread_setname_np(pthread_self(), "worker");
+        for (int i=0; i < N; i++)
+            CLOG_INFO(i & 1 ? "Cat1" : "Cat2", "Msg %d", i);
+        // The thread's name is cached until it's explicitly refreshed
+        pthread_setname_np(pthread_self(), "renamed");
+        CLOG_INFO(cat1, "Msg %d", N);
+        logger::update_thread_name();
+        CLOG_INFO("Cat1", "Msg %d", N+1);
+    }).join();
+
+    time_val end = now_utc();
+    log.finalize();
+
+    // Restore the settings that are retained across calls to init()
+    pt.put("logger.show-category",      false);
+    pt.put("logger.show-thread",        false);
+    pt.put("logger.tsc-timestamp",      false);
+    pt.put("logger.file.filename",      variant(std::string(filename) + ".tmp"));
+    log.init(pt, nullptr, false);
+    log.finalize();
+    ::unlink((std::string(filename) + ".tmp").c_str());
+
+    std::ifstream in(filename);
+    std::string   line;
+    time_val      last;
+    int           i = 0;
+
+    for (; std::getline(in, line); ++i) {
+        // YYYYmmdd-HH:MM:SS.tttttt|I|Thread|Category|Message
+        BOOST_REQUIRE(line.size() > 25);
+        auto ts = timestamp::from_string(line.c_str(), 24);
+        auto ln = line.substr(25);
+        auto cat = i & 1 || i >= N ? "Cat1" : "Cat2";
+        auto thr = i <= N ? "worker" : "renamed";
+        char exp[64];
+        sprintf(exp, "I|%s|%s|Msg %d", thr, cat, i);
+        BOOST_CHECK_EQUAL(exp, ln);
+        // Converted timestamps are monotonic and close to the wall-clock time
+        BOOST_CHECK(last <= ts);
+        BOOST_CHECK(start - msecs(5) <= ts && ts <= end + msecs(5));
+        last = ts;
+    }
+
+    BOOST_CHECK_EQUAL(N+2, i);
+
+    // Categories that don't fit in the registry fall back to the default one
+    for (auto n = cats.count(); n < log_categories::capacity(); ++n)
+        cats.id("Cat#" + std::to_string(n));
+    BOOST_CHECK_EQUAL(log_categories::capacity(),   cats.count());
+    BOOST_CHECK_EQUAL(log_categories::default_id(), cats.id("One too many"));
+    BOOST_CHECK_EQUAL(id,                           cats.id("Cat1"));
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_lanes )
+{
+    const char* filename = "/tmp/logger.lanes.log";
+    const int   threads  = 4;
+    const int   count    = 1000;
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.lanes",              true);
+    pt.put("logger.lane-capacity",      64);
+    pt.put("logger.lane-overflow",      variant("block"));
+    pt.put("logger.wait-timeout-ms",    1);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+
+    // Messages of two threads taking turns are merged by timestamp.
+    // The logger's thread is held until both threads are done, so that
+    // all messages are written in one sweep of the lanes.
+    {
+        std::atomic<bool> go(false);
+        log.set_on_before_run([&]() { while (!go) sched_yield(); });
+
+        if (log.initialized())
+            log.finalize();
+        log.init(pt, nullptr, false);
+        BOOST_CHECK(log.lanes());
+
+        std::atomic<int> turn(0);
+        auto f = [&](int a_id) {
+            for (int i=a_id; i < 6; i += 2) {
+                while (turn != i) sched_yield();
+                LOG_INFO("Turn %d", i);
+                ++turn;
+            }
+        };
+        std::thread t1(f, 0), t2(f, 1);
+        t1.join();
+        t2.join();
+        go = true;
+
+        log.finalize();
+        log.set_on_before_run(nullptr);
+
+        BOOST_CHECK_EQUAL("I|Turn 0\nI|Turn 1\nI|Turn 2\nI|Turn 3\nI|Turn 4\nI|Turn 5\n",
+                          path::read_file(filename));
+    }
+
+    // Concurrent producers with the blocking overflow policy
+    log.init(pt, nullptr, false);
+
+    auto dropped = log.dropped();
+
+    std::vector<std::thread> thr;
+    for (int t=0; t < threads; t++)
+        thr.emplace_back([=]() {
+            for (int i=0; i < count; i++)
+                LOG_INFO("Thread %d msg %d", t, i);
+        });
+    for (auto& t : thr)
+        t.join();
+
+    log.finalize();
+    BOOST_CHECK_EQUAL(dropped, log.dropped());
+
+    // All messages are written, and each thread's messages are in order
+    std::ifstream in(filename);
+    std::string   line;
+    int           next[threads] = {0};
+    int           lines = 0;
+    while (std::getline(in, line)) {
+        int t, i;
+        BOOST_REQUIRE(sscanf(line.c_str(), "I|Thread %d msg %d", &t, &i) == 2);
+        BOOST_REQUIRE(t >= 0 && t < threads);
+        BOOST_CHECK_EQUAL(next[t]++, i);
+        lines++;
+    }
+    BOOST_CHECK_EQUAL(threads * count, lines);
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_wait_strategy )
+{
+    const char* filename = "/tmp/logger.wait.log";
+    const int   count    = 1000;
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+    if (log.initialized())
+        log.finalize();
+
+    pt.put("logger.wait-strategy",      variant("sleep"));
+    BOOST_CHECK_THROW(log.init(pt, nullptr, false), utxx::runtime_error);
+    log.finalize();
+
+    for (auto ws : {"spin", "yield", "futex", "backoff"}) {
+        pt.put("logger.wait-strategy",       variant(ws));
+        pt.put("logger.wait-spin-us",        20);
+        pt.put("logger.sched-yield-us",      20);
+        pt.put("logger.wait-backoff-max-us", 100);
+        log.init(pt, nullptr, false);
+
+        BOOST_CHECK_EQUAL(ws, to_string(log.wait_policy().type()));
+        BOOST_CHECK_EQUAL(20, log.wait_policy().spin_us());
+        BOOST_CHECK_EQUAL(20, log.wait_policy().yield_us());
+
+        for (int i=0; i < count; i++)
+            LOG_INFO("msg %d", i);
+        log.finalize();
+
+        std::ifstream in(filename);
+        std::string   line;
+        int           lines = 0;
+        while (std::getline(in, line))
+            BOOST_CHECK_EQUAL("I|msg " + std::to_string(lines++), line);
+        BOOST_CHECK_EQUAL(count, lines);
+    }
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_lanes_overflow )
+{
+    const char* filename = "/tmp/logger.lanes.log";
+
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.lanes",              true);
+    pt.put("logger.lane-capacity",      7);
+    pt.put("logger.wait-timeout-ms",    1);
+    pt.put("logger.file.filename",      variant(filename));
+    pt.put("logger.file.append",        false);
+    pt.put("logger.file.no-header",     true);
+
+    logger& log = logger::instance();
+
+    // Hold the logger's thread until the producer fills up its lane
+    std::atomic<bool> go(false);
+    log.set_on_before_run([&]() { while (!go) sched_yield(); });
+
+    auto run = [&](lane_overflow a_policy, int a_count) {
+        if (log.initialized())
+            log.finalize();
+        log.init(pt, nullptr, false);
+
+        auto total = log.dropped();
+        uint64_t dropped = 0;
+        go = false;
+
+        std::thread thr([&]() {
+            log.lane_overflow_policy(a_policy);
+            BOOST_CHECK(a_policy == log.lane_overflow_policy());
+            for (int i=0; i < a_count; i++)
+                LOG_INFO("Msg %d", i);
+            dropped = log.lane_dropped();
+        });
+        // With the OVERWRITE policy the producer waits for the logger to
+        // evict the oldest message when the lane is full
+        if (a_policy == lane_overflow::OVERWRITE)
+            usleep(100000);
+        go = true;
+        thr.join();
+
+        log.finalize();
+
+        BOOST_CHECK_EQUAL(dropped, log.dropped() - total);
+        return std::make_pair(path::read_file(filename), dropped);
+    };
+
+    // The lane holds 7 messages, and the last 3 are discarded
+    auto s = run(lane_overflow::DROP, 10);
+    BOOST_CHECK_EQUAL("I|Msg 0\nI|Msg 1\nI|Msg 2\nI|Msg 3\nI|Msg 4\nI|Msg 5\nI|Msg 6\n", s.first);
+    BOOST_CHECK_EQUAL(3u, s.second);
+
+    // The oldest messages are discarded to make room for the new ones
+    s = run(lane_overflow::OVERWRITE, 10);
+    BOOST_CHECK(s.first.find("I|Msg 0\n") == std::string::npos);
+    BOOST_CHECK(s.first.find("I|Msg 9\n") != std::string::npos);
+
+    // A message with deferred formatting dropped by a full lane is counted
+    // once, and is not formatted again in the caller's context
+    pt.put("logger.deferred-format", true);
+    s = run(lane_overflow::DROP, 8);
+    BOOST_CHECK_EQUAL("I|Msg 0\nI|Msg 1\nI|Msg 2\nI|Msg 3\nI|Msg 4\nI|Msg 5\nI|Msg 6\n", s.first);
+    BOOST_CHECK_EQUAL(1u, s.second);
+
+    log.set_on_before_run(nullptr);
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_lanes_perf )
+{
+    const char* filename   = "/tmp/logger.lanes.log";
+    const int   iterations = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 100000;
+    const int   threads    = getenv("THREADS")    ? atoi(getenv("THREADS"))    : 4;
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("time-usec"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.lane-capacity",         64*1024);
+    pt.put("logger.lane-overflow",         variant("block"));
+    pt.put("logger.wait-timeout-ms",       1);
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    auto run = [&](bool a_lanes) {
+        pt.put("logger.lanes", a_lanes);
+        if (log.initialized())
+            log.finalize();
+        log.init(pt, nullptr, false);
+
+        std::atomic<long> total_ns(0);
+        std::vector<std::thread> thr;
+        for (int t=0; t < threads; t++)
+            thr.emplace_back([&]() {
+                struct timespec ts, te;
+                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+                for (int i=0; i < iterations; i++)
+                    LOG_INFO("Order #%d", i);
+                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &te);
+                total_ns += (te.tv_sec - ts.tv_sec) * 1000000000l
+                          + (te.tv_nsec - ts.tv_nsec);
+            });
+        for (auto& t : thr)
+            t.join();
+
+        log.finalize();
+
+        BOOST_TEST_MESSAGE("  " << (a_lanes ? "per-thread lanes" : "shared queue    ")
+                         << ": " << threads << " threads x " << iterations << " msgs, "
+                         << (double(total_ns) / (threads * iterations)) << " ns/msg");
+    };
+
+    run(false);
+    run(true);
+
+    ::unlink(filename);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_file_batch_perf )
+{
+    const char* filename   = "/tmp/logger.batch.log";
+    const int   iterations = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 100000;
+
+    variant_tree pt;
+    pt.put("logger.timestamp",             variant("none"));
+    pt.put("logger.show-location",         false);
+    pt.put("logger.silent-finish",         true);
+    pt.put("logger.file.filename",         variant(filename));
+    pt.put("logger.file.append",           false);
+    pt.put("logger.file.no-header",        true);
+
+    logger& log = logger::instance();
+
+    auto run = [&](int a_batch_size, bool a_sync, int a_count) {
+        pt.put("logger.file.batch-size", a_batch_size);
+        pt.put("logger.file.sync",       a_sync);
+        if (log.initialized())
+            log.finalize();
+
+        // Hold the logger's thread until all messages are enqueued, so that
+        // the whole backlog is drained in one batch, and measure the time
+        // it takes to write it
+        std::atomic<bool> go(false);
+        log.set_on_before_run([&]() { while (!go) sched_yield(); });
+        log.init(pt, nullptr, false);
+
+        for (int i=0; i < a_count; i++)
+            LOG_INFO("Order #%d: %s %s %d @ %.4f", i, "BUY", "ESZ6", 10, 2042.25);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        go = true;
+        log.finalize();
+        auto sec = std::chrono::duration<double>
+                   (std::chrono::high_resolution_clock::now() - start).count();
+        log.set_on_before_run(nullptr);
+
+        BOOST_TEST_MESSAGE("  batch-size=" << std::setw(6) << std::left << a_batch_size
+                         << " sync=" << (a_sync ? "true " : "false") << ": "
+                         << std::fixed << std::setprecision(0)
+                         << (a_count / sec) << " msgs/s");
+        return path::read_file(filename);
+    };
+
+    auto exp = run(0,       false, iterations);
+    auto res = run(64*1024, false, iterations);
+    BOOST_CHECK_EQUAL(exp, res);
+    res      = run(64*1024, true,  iterations);
+    BOOST_CHECK_EQUAL(exp, res);
+
+    // Without batching every message is synced, so keep this run short
+    int n    = std::min(iterations, 1000);
+    exp      = run(0,       false, n);
+    res      = run(0,       true,  n);
+    BOOST_CHECK_EQUAL(exp, res);
+
+    ::unlink(filename);
+}
+
+namespace {
+    /// Back-end failing to write a batch of messages once
+    struct failing_impl : public logger_impl {
+        std::string        m_name;
+        std::atomic<bool>  m_failed;
+
+        failing_impl(const char* a_name) : m_name(a_name), m_failed(false) {}
+
+        static logger_impl* create(const char* a_name) { return new failing_impl(a_name); }
+
+        const std::string& name() const override { return m_name; }
+        bool init(const variant_tree&)  override { return true;   }
+        std::ostream& dump(std::ostream& out, const std::string&) const override {
+            return out;
+        }
+        void end_batch() override {
+            if (!m_failed.exchange(true))
+                UTXX_THROW_IO_ERROR(ENOSPC, "Error writing batch");
+        }
+    };
+
+    logger_impl_mgr::impl_callback_t s_failing_impl_factory = &failing_impl::create;
+    logger_impl_mgr::registrar       s_failing_impl_reg("test-failing", s_failing_impl_factory);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_end_batch_error )
+{
+    variant_tree pt;
+    pt.put("logger.silent-finish",       true);
+    pt.put("logger.test-failing.enable", true);
+
+    logger& log = logger::instance();
+    if (log.initialized())
+        log.finalize();
+
+    std::atomic<int> errors(0);
+    std::string      reason;
+    std::function<void (const char*)> on_error = [&](const char* a_reason) {
+        reason = a_reason;
+        ++errors;
+    };
+    log.set_error_handler(on_error);
+    log.init(pt, nullptr, false);
+
+    LOG_INFO("Message");
+    log.finalize();
+
+    BOOST_CHECK_EQUAL(1, errors);
+    BOOST_CHECK(reason.find("Error writing batch") != std::string::npos);
+
+    std::function<void (const char*)> none;
+    log.set_error_handler(none);
+}
+
+BOOST_AUTO_TEST_CASE( test_logger_mmap )
+{
+    variant_tree pt;
+    pt.put("logger.timestamp",          variant("none"));
+    pt.put("logger.show-location",      false);
+    pt.put("logger.silent-finish",      true);
+    pt.put("logger.wait-timeout-ms",    1);
+    pt.put("logger.mmap.filename",      variant("/tmp/logger.mmap.log"));
+    pt.put("logger.mmap.append",        false);
+    pt.put("logger.mmap.segment-size",  4096);
+
+    using impl = logger_impl_mmap;
+    auto hsz   = sizeof(impl::header);
+
+    logger& log = logger::instance();
+    if (log.initialized())
+        log.finalize();
+    log.init(pt, nullptr, false);
+
+    // 6000 bytes of messages rotate to the second segment
+    std::string exp;
+    char buf[32];
+    for (int i=0; i < 400; i++) {
+        LOG_INFO("Message #%03d", i);
+        sprintf(buf, "I|Message #%03d\n", i);
+        exp += buf;
+    }
+    log.finalize();
+
+    auto s1 = impl::read_segment("/tmp/logger.mmap_1.log");
+    auto s2 = impl::read_segment("/tmp/logger.mmap_2.log");
+    BOOST_CHECK_EQUAL(4096 - hsz - (4096 - hsz) % 15, s1.size());
+    BOOST_CHECK_EQUAL(exp, s1 + s2);
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_3.log"));
+
+    // Unused space of a segment is released when it's closed
+    BOOST_CHECK_EQUAL(long(hsz + s2.size()), path::file_size("/tmp/logger.mmap_2.log"));
+
+    // Messages written by a process that crashes are not lost
+    pid_t pid = fork();
+    if (pid == 0) {
+        pt.put("logger.mmap.append", true);
+        log.init(pt, nullptr, false);
+        LOG_INFO("Before crash");
+        usleep(100000);
+        kill(getpid(), SIGKILL);
+    }
+    BOOST_REQUIRE(pid > 0);
+    int status;
+    BOOST_REQUIRE_EQUAL(pid, waitpid(pid, &status, 0));
+    BOOST_CHECK(WIFSIGNALED(status));
+
+    s2 = impl::read_segment("/tmp/logger.mmap_2.log");
+    BOOST_CHECK_EQUAL(exp + "I|Before crash\n", s1 + s2);
+    BOOST_CHECK_EQUAL(4096, path::file_size("/tmp/logger.mmap_2.log"));
+
+    // Only the last two segments are kept, so after a restart the existing
+    // segments don't start at 1
+    pt.put("logger.mmap.append",   false);
+    pt.put("logger.mmap.segments", 2);
+    log.init(pt, nullptr, false);
+    for (int i=0; i < 814; i++)
+        LOG_INFO("Message #%03d", i);
+    log.finalize();
+
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_1.log"));
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_2.log"));
+    BOOST_CHECK( path::file_exists("/tmp/logger.mmap_3.log"));
+    BOOST_CHECK( path::file_exists("/tmp/logger.mmap_4.log"));
+    auto s3 = impl::read_segment("/tmp/logger.mmap_3.log");
+    auto s4 = impl::read_segment("/tmp/logger.mmap_4.log");
+
+    // Appending continues the most recent segment, and rotation neither
+    // overwrites existing segments nor leaves more than two of them
+    pt.put("logger.mmap.append", true);
+    log.init(pt, nullptr, false);
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_1.log"));
+    for (int i=0; i < 300; i++)
+        LOG_INFO("Message #%03d", i);
+    log.finalize();
+
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_1.log"));
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_3.log"));
+    auto s4a = impl::read_segment("/tmp/logger.mmap_4.log");
+    auto s5  = impl::read_segment("/tmp/logger.mmap_5.log");
+    BOOST_CHECK_EQUAL(s4, s4a.substr(0, s4.size()));
+    BOOST_CHECK_EQUAL(300u*15, s4a.size() - s4.size() + s5.size());
+    BOOST_CHECK_EQUAL(4096 - hsz - (4096 - hsz) % 15, s3.size());
+
+    // Without appending all existing segments are removed
+    pt.put("logger.mmap.append", false);
+    log.init(pt, nullptr, false);
+    LOG_INFO("New");
+    log.finalize();
+
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_4.log"));
+    BOOST_CHECK(!path::file_exists("/tmp/logger.mmap_5.log"));
+    BOOST_CHECK_EQUAL("I|New\n", impl::read_segment("/tmp/logger.mmap_1.log"));
+
+    ::unlink("/tmp/logger.mmap_1.log");
+}
 #endif
 
 #ifdef UTXX_STANDALONE
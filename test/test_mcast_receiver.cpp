@@ -0,0 +1,205 @@
+//----------------------------------------------------------------------------
+/// \file  test_mcast_receiver.cpp
+//----------------------------------------------------------------------------
+/// \brief Test cases for classes in the mcast_receiver.hpp
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+
+#include <boost/test/unit_test.hpp>
+#include <utxx/io/mcast_receiver.hpp>
+#include <arpa/inet.h>
+#include <thread>
+#include <vector>
+
+using namespace utxx;
+using namespace utxx::io;
+
+namespace {
+    struct channel : public mcast_channel {
+        int id;
+        explicit channel(int a_id) : id(a_id) {}
+    };
+
+    // Packets carry the sequence number as plain text
+    struct text_decoder {
+        template <class Channel>
+        long seqno(const Channel&, const char* a_buf, size_t, bool& a_reset) const {
+            a_reset = *a_buf == 'R';
+            return atol(a_reset ? a_buf+1 : a_buf);
+        }
+    };
+
+    struct gap {
+        int  id;
+        long first;
+        long last;
+    };
+}
+
+BOOST_AUTO_TEST_CASE( test_mcast_receiver_seqno )
+{
+    mcast_receiver<text_decoder, channel> rcv;
+    channel c1(1), c2(2);
+
+    auto a1 = inet_addr("239.1.1.1"), a2 = inet_addr("239.1.1.2");
+    rcv.add(a1, 5000, c1);
+    rcv.add(a2, 5000, c2);
+
+    BOOST_CHECK(&c1 == rcv.find(a1, 5000));
+    BOOST_CHECK(&c2 == rcv.find(a2, 5000));
+    BOOST_CHECK(!rcv.find(a1, 5001));
+    BOOST_CHECK_EQUAL(2u, rcv.channels().size());
+
+    std::vector<gap> gaps;
+    rcv.on_gap([&](channel& c, long a_first, long a_last) {
+        gaps.push_back(gap{c.id, a_first, a_last});
+    });
+
+    auto process = [&](channel& c, const char* s) {
+        return rcv.process(c, s, strlen(s), 1000);
+    };
+
+    BOOST_CHECK(seqno_status::OK           == process(c1, "1"));
+    BOOST_CHECK(seqno_status::OK           == process(c1, "2"));
+    BOOST_CHECK(seqno_status::GAP          == process(c1, "5"));
+    // Sequence is tracked separately by each channel
+    BOOST_CHECK(seqno_status::OK           == process(c2, "100"));
+    BOOST_CHECK(seqno_status::OUT_OF_ORDER == process(c1, "4"));
+    BOOST_CHECK(seqno_status::NONE         == process(c2, "x"));
+    BOOST_CHECK(seqno_status::OK           == process(c2, "101"));
+    BOOST_CHECK(seqno_status::GAP          == process(c2, "110"));
+    // Sequence reset doesn't count as a gap
+    BOOST_CHECK(seqno_status::OK           == process(c2, "R1000"));
+    BOOST_CHECK(seqno_status::OK           == process(c2, "1001"));
+
+    BOOST_REQUIRE_EQUAL(2u, gaps.size());
+    BOOST_CHECK_EQUAL(1,   gaps[0].id);
+    BOOST_CHECK_EQUAL(3,   gaps[0].first);
+    BOOST_CHECK_EQUAL(4,   gaps[0].last);
+    BOOST_CHECK_EQUAL(2,   gaps[1].id);
+    BOOST_CHECK_EQUAL(102, gaps[1].first);
+    BOOST_CHECK_EQUAL(109, gaps[1].last);
+
+    auto s1 = c1.snapshot();
+    BOOST_CHECK_EQUAL(4u,   s1.packets);
+    BOOST_CHECK_EQUAL(4u,   s1.bytes);
+    BOOST_CHECK_EQUAL(1u,   s1.gaps);
+    BOOST_CHECK_EQUAL(2u,   s1.lost);
+    BOOST_CHECK_EQUAL(1u,   s1.out_of_order);
+    BOOST_CHECK_EQUAL(4,    s1.last_seqno);
+    BOOST_CHECK_EQUAL(1000, s1.last_gap_time);
+    BOOST_CHECK_EQUAL(1000, s1.last_ooo_time);
+
+    auto s2 = c2.snapshot();
+    BOOST_CHECK_EQUAL(6u,   s2.packets);
+    BOOST_CHECK_EQUAL(1u,   s2.gaps);
+    BOOST_CHECK_EQUAL(8u,   s2.lost);
+    BOOST_CHECK_EQUAL(0u,   s2.out_of_order);
+    BOOST_CHECK_EQUAL(1001, s2.last_seqno);
+
+    auto t = rcv.totals();
+    BOOST_CHECK_EQUAL(10u,  t.packets);
+    BOOST_CHECK_EQUAL(2u,   t.gaps);
+    BOOST_CHECK_EQUAL(10u,  t.lost);
+}
+
+BOOST_AUTO_TEST_CASE( test_mcast_receiver_decoders )
+{
+    // FORTS FAST packets with sequence numbers 1827032..1827035
+    const uint8_t b0[] =
+        {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xd8,0x23,0x63,0x2d,0x12,0x54,0x66,0x6d,0xf4,0x87,0x98
+        ,0xb1,0x30,0x2d,0x44,0xc7,0x22,0xec,0x0f,0x0a,0xc8,0x95,0x82,0x80,0xff,0x00,0x62};
+    const uint8_t b1[] =
+        {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xd9,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0x82,0x81,0xd8
+        ,0x81,0xb1,0x33,0x3f,0x48,0xc7,0x22,0xec,0x1c,0x21,0xc5,0x95,0x82,0x80,0x81,0x00
+        ,0x4c,0x9b,0x8b,0x80,0x00,0x52,0x11,0x55,0xfd,0x80,0x80,0x80,0x80,0x80};
+    const uint8_t b2[] =
+        {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xda,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0x90,0x85,0xd8
+        ,0x82,0xb1,0x33,0x3f,0x48,0xc7,0x22,0xec,0x1c,0x21,0xc6,0x95,0x82,0x80,0x81,0x00};
+    const uint8_t b3[] =
+        {0xc0,0xf8,0xe0,0xca,0x6f,0x41,0xdb,0x23,0x63,0x2d,0x12,0x54,0x66,0x6e,0xd9,0x82,0xd8
+        ,0x82,0xb0,0x30,0x2d,0x3c,0xc7,0x22,0xec,0x1e,0x6b,0xf2,0x95,0x83,0x80,0x82,0x00};
+
+    struct { const uint8_t* buf; size_t size; } bufs[] =
+        {{b0, sizeof(b0)}, {b1, sizeof(b1)}, {b2, sizeof(b2)}, {b3, sizeof(b3)}};
+
+    mcast_channel       ch;
+    forts_seqno_decoder forts;
+    for (int i=0; i < 4; ++i) {
+        bool reset = false;
+        BOOST_CHECK_EQUAL(1827032+i,
+            forts.seqno(ch, (const char*)bufs[i].buf, bufs[i].size, reset));
+        BOOST_CHECK(!reset);
+    }
+
+    // Truncated packet
+    bool reset = false;
+    BOOST_CHECK_EQUAL(0, forts.seqno(ch, (const char*)b0, 6, reset));
+
+    const char micex[] = {0x78, 0x56, 0x34, 0x12, 0x00};
+    BOOST_CHECK_EQUAL(0x12345678, micex_seqno_decoder().seqno(ch, micex, 5, reset));
+    BOOST_CHECK_EQUAL(0,          micex_seqno_decoder().seqno(ch, micex, 3, reset));
+    BOOST_CHECK_EQUAL(0,          no_seqno_decoder()   .seqno(ch, micex, 5, reset));
+}
+
+BOOST_AUTO_TEST_CASE( test_mcast_receiver_snapshot )
+{
+    mcast_receiver<text_decoder> rcv;
+    mcast_channel ch;
+    rcv.add(inet_addr("239.1.1.1"), 5000, ch);
+
+    const long N = 200000;
+    std::atomic<bool> done(false);
+
+    // Every other packet is lost, so a consistent snapshot always has
+    // lost == packets-1 and last_seqno == 2*packets-1
+    std::thread thr([&]() {
+        char buf[32];
+        for (long i=1; i <= N; ++i) {
+            int n = sprintf(buf, "%ld", 2*i-1);
+            rcv.process(ch, buf, n, i);
+        }
+        done = true;
+    });
+
+    long checks = 0;
+    while (!done || !checks) {
+        auto s = ch.snapshot();
+        if (!s.packets)
+            continue;
+        BOOST_REQUIRE_EQUAL(s.packets-1,       s.lost);
+        BOOST_REQUIRE_EQUAL(s.packets-1,       s.gaps);
+        BOOST_REQUIRE_EQUAL(2*s.packets-1,     (uint64_t)s.last_seqno);
+        BOOST_REQUIRE_EQUAL((long)s.packets,   s.last_data_time);
+        ++checks;
+    }
+
+    thr.join();
+    BOOST_CHECK_EQUAL(uint64_t(N), ch.packets());
+    BOOST_TEST_MESSAGE("Consistent snapshots taken: " << checks);
+}
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <boost/test/unit_test.hpp>
 #include <utxx/pcap.hpp>
+#include <utxx/pcap_mmap.hpp>
 #include <utxx/verbosity.hpp>
 #include <utxx/path.hpp>
 #include <utxx/string.hpp>
@@ -288,3 +289,238 @@ BOOST_AUTO_TEST_CASE( test_pcap_writer )
 
     path::file_unlink(file);
 }
+
+BOOST_AUTO_TEST_CASE( test_pcap_mmap )
+{
+    string file = path::temp_path("test-file-mmap.pcap");
+    string idx  = file + ".idx";
+
+    path::file_unlink(file);
+    path::file_unlink(idx);
+
+    // Little-endian capture with ethernet frames
+    {
+        auto f = fopen(file.c_str(), "wb");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(1u, fwrite(s_buffer, sizeof(s_buffer), 1, f));
+        fclose(f);
+
+        pcap      reader;
+        pcap_mmap mf(file);
+
+        BOOST_CHECK(!mf.big_endian());
+        BOOST_CHECK(mf.link_type() == pcap::link_type::ethernet);
+
+        const char* p = reinterpret_cast<const char*>(s_buffer);
+        reader.read_file_header(p, sizeof(s_buffer));
+
+        size_t n = 0;
+        for (auto& pkt : mf) {
+            BOOST_REQUIRE_EQUAL(p - (const char*)s_buffer, (long)pkt.offset());
+            int  frame_sz, sz;
+            pcap::proto proto;
+            std::tie(frame_sz, sz, proto) = reader.read_packet_hdr_and_frame(p, 65536);
+            BOOST_REQUIRE(pkt.udp());
+            BOOST_CHECK(proto == pkt.protocol());
+            BOOST_CHECK(reader.packet_ts() == pkt.ts());
+            BOOST_CHECK_EQUAL(reader.packet().incl_len, pkt.size());
+            BOOST_CHECK_EQUAL(frame_sz, int(sizeof(pcap::packet_header) + pkt.payload_offset()));
+            BOOST_CHECK_EQUAL(reader.uframe().dst(), pkt.udp()->dst());
+            BOOST_CHECK(pkt.match_dst_ip(reader.uframe().ip.daddr, reader.uframe().udp.dest));
+            BOOST_CHECK(!pkt.match_dst_ip(inet_addr("1.2.3.4")));
+            p += sz;
+            ++n;
+        }
+        BOOST_CHECK_EQUAL(p - (const char*)s_buffer, (long)sizeof(s_buffer));
+        BOOST_CHECK_EQUAL(n, mf.count());
+        BOOST_CHECK(n > 1);
+    }
+
+    path::file_unlink(file);
+
+    // Big-endian capture written by utxx::pcap
+    static const int  s_count = 1000;
+    const time_val    s_start = time_val::universal_time(2015,1,2,3,4,5);
+    {
+        pcap writer;
+        BOOST_REQUIRE_EQUAL(0, writer.open_write(file, false, pcap::link_type::ethernet));
+        for (int i=0; i < s_count; ++i) {
+            char buf[64];
+            int  len = sprintf(buf, "packet %d", i);
+            auto res = writer.write_packet(true, s_start.add_msec(10*i),
+                            i % 2 ? pcap::proto::tcp : pcap::proto::udp,
+                            inet_addr("127.1.1.1"), htons(2000),
+                            inet_addr("239.1.1.1"), htons(3000 + i % 2), buf, len);
+            BOOST_REQUIRE(res > 0);
+        }
+        writer.close();
+    }
+
+    {
+        pcap_mmap mf(file);
+
+        BOOST_CHECK(mf.big_endian());
+        BOOST_CHECK(!mf.has_index());
+        BOOST_CHECK(!mf.load_index());
+        BOOST_CHECK_EQUAL(s_count, (int)mf.count());
+
+        // Seek without the index
+        auto it = mf.seek(size_t(500));
+        BOOST_REQUIRE(it != mf.end());
+        BOOST_CHECK_EQUAL(500u, it.number());
+        BOOST_CHECK_EQUAL("packet 500", string(it->payload(), it->payload_size()));
+
+        mf.index();
+        BOOST_REQUIRE(mf.has_index());
+        BOOST_CHECK(path::file_exists(idx));
+        BOOST_CHECK_EQUAL(s_count, (int)mf.count());
+
+        int i = 0;
+        for (auto& pkt : mf) {
+            char buf[64];
+            int  len = sprintf(buf, "packet %d", i);
+            BOOST_REQUIRE_EQUAL(mf.index_data()[i].offset, pkt.offset());
+            BOOST_REQUIRE(pkt.ts() == s_start.add_msec(10*i));
+            BOOST_REQUIRE_EQUAL(string(buf, len), string(pkt.payload(), pkt.payload_size()));
+            BOOST_REQUIRE(i % 2 ? pkt.tcp() != nullptr : pkt.udp() != nullptr);
+            BOOST_REQUIRE(pkt.match_dst_ip(inet_addr("239.0.0.0"), htons(3000 + i % 2)));
+            BOOST_REQUIRE(!pkt.match_dst_ip(inet_addr("239.0.0.0"), htons(3002)));
+            ++i;
+        }
+        BOOST_CHECK_EQUAL(s_count, i);
+
+        it = mf.seek(size_t(777));
+        BOOST_CHECK_EQUAL(777u, it.number());
+        BOOST_CHECK_EQUAL("packet 777", string(it->payload(), it->payload_size()));
+        ++it;
+        BOOST_CHECK_EQUAL(778u, it.number());
+        BOOST_CHECK_EQUAL("packet 778", string(it->payload(), it->payload_size()));
+        BOOST_CHECK(mf.seek(size_t(s_count)) == mf.end());
+
+        it = mf.seek(s_start.add_msec(5005));
+        BOOST_CHECK_EQUAL(501u, it.number());
+        BOOST_CHECK(it->ts() == s_start.add_msec(5010));
+        BOOST_CHECK(mf.seek(s_start).number() == 0);
+        BOOST_CHECK(mf.seek(s_start.add_sec(100)) == mf.end());
+
+        it = mf.at(it->offset(), 501);
+        BOOST_CHECK_EQUAL("packet 501", string(it->payload(), it->payload_size()));
+    }
+
+    // The saved index is reused
+    {
+        pcap_mmap mf(file);
+        BOOST_REQUIRE(mf.load_index());
+        BOOST_CHECK_EQUAL(s_count, (int)mf.count());
+        BOOST_CHECK_EQUAL(999u, mf.seek(s_start.add_msec(9990)).number());
+    }
+
+    // A stale index is rebuilt
+    {
+        pcap writer;
+        BOOST_REQUIRE(writer.open(file.c_str(), "ab") > 0);
+        writer.init_file_header(pcap::link_type::ethernet);
+        writer.write_packet(true, s_start.add_sec(10), pcap::proto::udp,
+            inet_addr("127.1.1.1"), htons(2000),
+            inet_addr("239.1.1.1"), htons(3000), "last", 4);
+        writer.close();
+
+        pcap_mmap mf(file);
+        BOOST_CHECK(!mf.load_index());
+        mf.index();
+        BOOST_CHECK_EQUAL(s_count+1, (int)mf.count());
+        BOOST_CHECK_EQUAL("last", string(mf.seek(size_t(s_count))->payload(), 4));
+    }
+
+    path::file_unlink(file);
+    path::file_unlink(idx);
+}
+
+BOOST_AUTO_TEST_CASE( test_pcap_mmap_sync )
+{
+    string file = path::temp_path("test-file-sync.pcap");
+    string idx  = file + ".idx";
+
+    path::file_unlink(file);
+    path::file_unlink(idx);
+
+    static const int  s_count = 20;
+    const time_val    s_start = time_val::universal_time(2015,1,2,3,4,5);
+    {
+        pcap writer;
+        BOOST_REQUIRE_EQUAL(0, writer.open_write(file, false, pcap::link_type::ethernet));
+        char buf[64];
+        memset(buf, 'x', sizeof(buf));
+        for (int i=0; i < s_count; ++i)
+            BOOST_REQUIRE(writer.write_packet(true, s_start.add_msec(10*i), pcap::proto::udp,
+                            inet_addr("127.1.1.1"), htons(2000),
+                            inet_addr("239.1.1.1"), htons(3000 + i % 2), buf, sizeof(buf)) > 0);
+        writer.close();
+    }
+
+    // Put a fake packet header in the payload of packet #10, whose record
+    // ends exactly where packet #11 starts
+    uint64_t fake, next;
+    {
+        pcap_mmap mf(file);
+        auto it  = mf.seek(size_t(10));
+        auto hdr = it->header();
+        fake     = it->payload() - mf.begin_ptr();
+        next     = it->next_offset();
+        hdr.incl_len = hdr.orig_len = uint32_t(next - fake - sizeof(hdr));
+        if (mf.big_endian()) {
+            hdr.ts_sec   = htonl(hdr.ts_sec);
+            hdr.ts_usec  = htonl(hdr.ts_usec);
+            hdr.incl_len = htonl(hdr.incl_len);
+            hdr.orig_len = htonl(hdr.orig_len);
+        }
+        auto f = fopen(file.c_str(), "r+b");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(0, fseek(f, fake, SEEK_SET));
+        BOOST_REQUIRE_EQUAL(1u, fwrite(&hdr, sizeof(hdr), 1, f));
+        fclose(f);
+    }
+
+    {
+        pcap_mmap mf(file);
+        BOOST_CHECK_EQUAL(s_count, (int)mf.count());
+
+        // Sequential reading isn't affected by the payload
+        int i = 0;
+        for (auto& pkt : mf) {
+            BOOST_CHECK(pkt.udp());
+            ++i;
+        }
+        BOOST_CHECK_EQUAL(s_count, i);
+
+        // Without the index the heuristic takes the fake header for a real one
+        BOOST_CHECK_EQUAL(fake, mf.sync(fake)->offset());
+        BOOST_CHECK_EQUAL(mf.seek(size_t(5))->offset(),
+                          mf.sync(mf.seek(size_t(4))->offset() + 1)->offset());
+
+        // With the index packet boundaries are exact
+        mf.index();
+        BOOST_REQUIRE(mf.has_index());
+        BOOST_CHECK_EQUAL(next,   mf.sync(fake)->offset());
+        BOOST_CHECK_EQUAL(11u,    mf.sync(fake).number());
+        BOOST_CHECK(mf.sync(mf.size()) == mf.end());
+        BOOST_CHECK_EQUAL(0u,     mf.sync(0).number());
+
+        // Destination filter
+        auto  it  = mf.seek(size_t(3));
+        auto& pkt = *it;
+        BOOST_CHECK( pkt.match_dst_ip(inet_addr("239.1.1.1")));
+        BOOST_CHECK( pkt.match_dst_ip(inet_addr("239.1.1.1"), htons(3001)));
+        BOOST_CHECK( pkt.match_dst_ip(inet_addr("239.0.1.0"), htons(3001)));
+        BOOST_CHECK( pkt.match_dst_ip(0, 0));
+        BOOST_CHECK(!pkt.match_dst_ip(inet_addr("239.1.1.1"), htons(3000)));
+        BOOST_CHECK(!pkt.match_dst_ip(inet_addr("239.2.0.0")));
+    }
+
+    BOOST_CHECK( pcap::match_dst(inet_addr("10.1.2.3"), htons(80), inet_addr("10.0.0.3")));
+    BOOST_CHECK(!pcap::match_dst(inet_addr("10.1.2.3"), htons(80), inet_addr("10.0.0.4")));
+    BOOST_CHECK(!pcap::match_dst(inet_addr("10.1.2.3"), htons(80), 0, htons(81)));
+
+    path::file_unlink(file);
+    path::file_unlink(idx);
+}
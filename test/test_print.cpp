@@ -241,3 +241,125 @@ BOOST_AUTO_TEST_CASE( test_print_perf )
 
 }
 
+
+BOOST_AUTO_TEST_CASE( test_print_format )
+{
+    std::string str("xxx");
+    int         n = 123;
+
+    BOOST_CHECK_EQUAL("abc",              print(UTXX_FMT("abc")));
+    BOOST_CHECK_EQUAL("1 2.5 true c abc", print(UTXX_FMT("{} {} {} {} {}", 1, 2.5, true, 'c', "abc")));
+    BOOST_CHECK_EQUAL("x=123 xxx",        print(UTXX_FMT("x={} {}", n, str)));
+    BOOST_CHECK_EQUAL("{123}",            print(UTXX_FMT("{{{}}}", n)));
+    BOOST_CHECK_EQUAL("}{",               print(UTXX_FMT("}}{{")));
+    BOOST_CHECK_EQUAL("[-5|18446744073709551615]",
+                      print(UTXX_FMT("[{}|{}]", -5L, uint64_t(-1))));
+
+    // Width, alignment and fill
+    BOOST_CHECK_EQUAL("[    123]", print(UTXX_FMT("[{:7}]",   n)));
+    BOOST_CHECK_EQUAL("[123    ]", print(UTXX_FMT("[{:<7}]",  n)));
+    BOOST_CHECK_EQUAL("[123____]", print(UTXX_FMT("[{:_<7}]", n)));
+    BOOST_CHECK_EQUAL("[0000123]", print(UTXX_FMT("[{:07d}]", n)));
+    BOOST_CHECK_EQUAL("[    -12]", print(UTXX_FMT("[{:7}]",   int8_t(-12))));
+    BOOST_CHECK_EQUAL("[   4000]", print(UTXX_FMT("[{:7}]",   uint64_t(4000))));
+    BOOST_CHECK_EQUAL("[xxx    ]", print(UTXX_FMT("[{:7}]",   str)));
+    BOOST_CHECK_EQUAL("[    abc]", print(UTXX_FMT("[{:>7s}]", "abc")));
+    BOOST_CHECK_EQUAL("[a  ]",     print(UTXX_FMT("[{:3}]",   'a')));
+    BOOST_CHECK_EQUAL("[true ]",   print(UTXX_FMT("[{:5}]",   true)));
+
+    // Width is the minimum: longer values are written in full
+    BOOST_CHECK_EQUAL("[123456]",  print(UTXX_FMT("[{:>3}]",  123456)));
+    BOOST_CHECK_EQUAL("[-12345]",  print(UTXX_FMT("[{:4}]",   short(-12345))));
+    BOOST_CHECK_EQUAL("[18446744073709551615]",
+                      print(UTXX_FMT("[{:3d}]", uint64_t(-1))));
+    BOOST_CHECK_EQUAL("[abcdef]",  print(UTXX_FMT("[{:<3}]",  "abcdef")));
+    BOOST_CHECK_EQUAL("[1234567.25]", print(UTXX_FMT("[{:6}]", 1234567.25)));
+    BOOST_CHECK_EQUAL("[12345.68]",   print(UTXX_FMT("[{:>4.2f}]", 12345.678)));
+
+    // Zero padding goes after the sign, other fill chars before it
+    BOOST_CHECK_EQUAL("[-0042]",   print(UTXX_FMT("[{:05}]",  -42)));
+    BOOST_CHECK_EQUAL("[00042]",   print(UTXX_FMT("[{:05}]",  42)));
+    BOOST_CHECK_EQUAL("[-42]",     print(UTXX_FMT("[{:02}]",  -42)));
+    BOOST_CHECK_EQUAL("[__-42]",   print(UTXX_FMT("[{:_>5}]", -42)));
+    BOOST_CHECK_EQUAL("[-0001.50]", print(UTXX_FMT("[{:08.2f}]", -1.5)));
+    BOOST_CHECK_EQUAL("[-1.5   ]", print(UTXX_FMT("[{:<7}]",  -1.5)));
+
+    // Floating point
+    BOOST_CHECK_EQUAL("2.12",      print(UTXX_FMT("{:.2f}",   2.123)));
+    BOOST_CHECK_EQUAL("2.123000",  print(UTXX_FMT("{:f}",     2.123)));
+    BOOST_CHECK_EQUAL("3.000",     print(UTXX_FMT("{:.3}",    3)));
+    BOOST_CHECK_EQUAL("   2.12",   print(UTXX_FMT("{:7.2f}",  2.123)));
+    BOOST_CHECK_EQUAL("2.12   ",   print(UTXX_FMT("{:<7.2f}", 2.123)));
+    BOOST_CHECK_EQUAL("0002.12",   print(UTXX_FMT("{:07.2f}", 2.123)));
+    BOOST_CHECK_EQUAL("    2.5",   print(UTXX_FMT("{:7}",     2.5)));
+
+    // Timestamps
+    time_val tv(time_val::universal_time(2014, 7, 10, 11, 12, 13, 123456));
+    BOOST_CHECK_EQUAL("20140710-11:12:13.123456", print(UTXX_FMT("{:date-time-usec}", tv)));
+    BOOST_CHECK_EQUAL("20140710-11:12:13.123",    print(UTXX_FMT("{:date-time-msec}", tv)));
+    BOOST_CHECK_EQUAL("20140710",                 print(UTXX_FMT("{:date}",           tv)));
+    BOOST_CHECK_EQUAL("<11:12:13.123456>",        print(UTXX_FMT("<{:time-usec}>",    tv)));
+
+    // Mixed with other arguments, and used by to_string() and buffered_print
+    BOOST_CHECK_EQUAL("a=1 b=2.50|xxx",
+                      utxx::to_string("a=", 1, UTXX_FMT(" b={:.2f}|", 2.5), str));
+    buffered_print b;
+    b.print(UTXX_FMT("{:>4}|", std::string("ab")));
+    b << UTXX_FMT("{}", 10);
+    BOOST_CHECK_EQUAL("  ab|10", b.to_string());
+
+    // Output longer than the buffer's capacity
+    std::string s(1000, 'a');
+    BOOST_CHECK_EQUAL(s + s + "|1", print(UTXX_FMT("{}{}|{}", s, s, 1)));
+
+    // Format string validation at compile time
+    static_assert(detail::fmt_count("a{}b{:>8}c{:.3f}{{}}") == 3, "");
+    static_assert(detail::fmt_count("{")       < 0, "");
+    static_assert(detail::fmt_count("}")       < 0, "");
+    static_assert(detail::fmt_count("{1}")     < 0, "");
+    static_assert(detail::fmt_count("{:.f}")   < 0, "");
+    static_assert(detail::fmt_count("{:<}")    < 0, "");
+    static_assert(detail::fmt_count("{:8x}")   < 0, "");
+    static_assert(detail::fmt_count("{:time}") == 1, "");
+}
+
+BOOST_AUTO_TEST_CASE( test_print_format_perf )
+{
+    static const int ITERATIONS = getenv("ITERATIONS")
+                                ? atoi(getenv("ITERATIONS")) : 1000000;
+    const char* sym = "IBM";
+    double elapsed1, elapsed2, elapsed3;
+    {
+        detail::basic_buffered_print<> b;
+        timer tm;
+        for (int i=0; i < ITERATIONS; i++) {
+            b.printf("%s px=%.2f qty=%6d id=%d", sym, 123.45 + i % 10, i % 1000, i);
+            b.reset();
+        }
+        elapsed1 = tm.elapsed();
+    }
+    {
+        detail::basic_buffered_print<> b;
+        timer tm;
+        for (int i=0; i < ITERATIONS; i++) {
+            b.print(UTXX_FMT("{} px={:.2f} qty={:6} id={}", sym, 123.45 + i % 10, i % 1000, i));
+            b.reset();
+        }
+        elapsed2 = tm.elapsed();
+    }
+    {
+        detail::basic_buffered_print<> b;
+        timer tm;
+        for (int i=0; i < ITERATIONS; i++) {
+            b.print(sym, " px=", fixed(123.45 + i % 10, 2), " qty=",
+                    width<6, RIGHT, int>(i % 1000), " id=", i);
+            b.reset();
+        }
+        elapsed3 = tm.elapsed();
+    }
+
+    BOOST_TEST_MESSAGE(" buffered_print::printf speed: " << fixed(double(ITERATIONS)/elapsed1, 10, 0) << " calls/s");
+    BOOST_TEST_MESSAGE(" UTXX_FMT               speed: " << fixed(double(ITERATIONS)/elapsed2, 10, 0) << " calls/s");
+    BOOST_TEST_MESSAGE(" buffered_print::print  speed: " << fixed(double(ITERATIONS)/elapsed3, 10, 0) << " calls/s");
+    BOOST_TEST_MESSAGE("      printf / UTXX_FMT: " << fixed(elapsed1/elapsed2, 6, 4) << " times");
+}
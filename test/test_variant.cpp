@@ -42,6 +42,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/foreach.hpp>
+#include <cmath>
 #include <iostream>
 
 using namespace utxx;
@@ -206,6 +207,18 @@ BOOST_AUTO_TEST_CASE( test_variant )
         BOOST_CHECK_EQUAL("456.789000", v.to<std::string>());
     }
 
+    {
+        auto v = variant(variant::TYPE_DOUBLE, "1.0000000000000002");
+        BOOST_CHECK_EQUAL(variant::TYPE_DOUBLE, v.type());
+        BOOST_CHECK_EQUAL(1.0000000000000002, v.to_double());
+        BOOST_CHECK_THROW(variant(variant::TYPE_DOUBLE, "1.5x"), boost::bad_lexical_cast);
+        BOOST_CHECK_EQUAL(-2.5e-10, variant(" -2.5e-10 ").to<double>());
+        BOOST_CHECK_EQUAL(0.0,      variant("abc").to<double>());
+        BOOST_CHECK(std::isinf(variant("inf").to<double>()));
+        BOOST_CHECK(std::isinf(variant(" -Infinity").to<double>()));
+        BOOST_CHECK(std::isnan(variant("nan").to<double>()));
+    }
+
     {
         auto v = variant("1234");
         BOOST_CHECK_EQUAL(true,   v.to<bool>());
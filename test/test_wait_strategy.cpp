@@ -0,0 +1,171 @@
+//----------------------------------------------------------------------------
+/// \file   test_wait_strategy.cpp
+/// \author Serge Aleynikov
+//----------------------------------------------------------------------------
+/// \brief Test cases for the wait strategy policy.
+//----------------------------------------------------------------------------
+// Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-18
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+This file is part of the utxx open-source project.
+
+Copyright (C) 2026 Serge Aleynikov <saleyn@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***** END LICENSE BLOCK *****
+*/
+#include <boost/test/unit_test.hpp>
+#include <utxx/wait_strategy.hpp>
+#include <utxx/container/concurrent_fifo.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace utxx;
+
+namespace {
+    std::vector<wait_strategy> all_strategies() {
+        return {wait_strategy::busy_spin(),
+                wait_strategy::spin_yield(10),
+                wait_strategy(),
+                wait_strategy::spin_futex(10, 10),
+                wait_strategy::backoff(500)};
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_wait_strategy_parse )
+{
+    for (auto t : {wait_strategy_type::BUSY_SPIN, wait_strategy_type::YIELD,
+                   wait_strategy_type::FUTEX,     wait_strategy_type::BACKOFF}) {
+        wait_strategy_type res;
+        BOOST_REQUIRE(parse_wait_strategy(to_string(t), res));
+        BOOST_CHECK(t == res);
+    }
+    wait_strategy_type res;
+    BOOST_CHECK(!parse_wait_strategy("sleep", res));
+}
+
+BOOST_AUTO_TEST_CASE( test_wait_strategy_timeout )
+{
+    futex       ev(0);
+    futex_event fev;
+    timespec    ts{0, 20000000};
+
+    for (auto& w : all_strategies()) {
+        auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK(!w.wait([]() { return false; }, ev, &ts));
+        BOOST_CHECK(!w.wait([]() { return false; }, fev, &ts));
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        BOOST_CHECK_MESSAGE(elapsed >= std::chrono::milliseconds(40),
+                            to_string(w.type()));
+
+        // A ready condition returns without waiting
+        BOOST_CHECK(w.wait([]() { return true; }, ev));
+    }
+}
+
+namespace {
+    // Ping-pong a counter between two threads, each waiting for its turn
+    template <class Event>
+    double ping_pong(const wait_strategy& a_wait, int a_count)
+    {
+        std::atomic<int> turn(0);
+        Event            ev[2];
+        auto notify = [](Event& e) { e.notify(); };
+
+        std::thread other([&]() {
+            for (int i = 1; i < 2*a_count; i += 2) {
+                a_wait.wait([&]() { return turn.load() == i; }, ev[1]);
+                turn.store(i+1);
+                notify(ev[0]);
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 2*a_count; i += 2) {
+            turn.store(i+1);
+            notify(ev[1]);
+            a_wait.wait([&]() { return turn.load() == i+2; }, ev[0]);
+        }
+        std::chrono::duration<double> sec = std::chrono::steady_clock::now() - start;
+        other.join();
+        BOOST_CHECK_EQUAL(2*a_count, turn.load());
+        return sec.count() / a_count * 1e6;
+    }
+
+    struct futex_signal : futex {
+        futex_signal() : futex(0) {}
+        void notify() { signal(); }
+    };
+}
+
+BOOST_AUTO_TEST_CASE( test_wait_strategy_wakeup )
+{
+    const int N = getenv("ITERATIONS") ? atoi(getenv("ITERATIONS")) : 2000;
+
+    // On a single CPU a thread burning its time slice in a busy spin only
+    // lets the other thread run on preemption, so limit the round trips
+    int  ncpus = std::thread::hardware_concurrency();
+
+    for (auto& w : all_strategies()) {
+        int n = (ncpus > 1 || w.type() != wait_strategy_type::BUSY_SPIN) ? N : 10;
+        double us1 = ping_pong<futex_signal>(w, n);
+        double us2 = ping_pong<futex_event>(w, n);
+        BOOST_TEST_MESSAGE("Wait strategy " << to_string(w.type())
+                           << " (spin=" << w.spin_us() << "us, yield="
+                           << w.yield_us() << "us): round trip "
+                           << us1 << "us (futex), " << us2 << "us (futex_event)");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_wait_strategy_fifo )
+{
+    typedef container::blocking_bound_fifo<long, 64> fifo;
+
+    for (auto& w : all_strategies()) {
+        fifo q(w);
+        BOOST_CHECK(q.wait_policy().type() == w.type());
+
+        const long N = 20000;
+        std::thread producer([&]() {
+            for (long i = 0; i < N; ++i)
+                while (q.enqueue(i) != 0);
+        });
+
+        long v, errors = 0;
+        timespec ts{5, 0};
+        for (long i = 0; i < N; ++i)
+            if (q.dequeue(v, &ts) != 0 || v != i)
+                ++errors;
+        producer.join();
+        BOOST_CHECK_EQUAL(0, errors);
+
+        // Timed out dequeue from an empty fifo
+        ts = timespec{0, 10000000};
+        BOOST_CHECK_EQUAL(-1, q.dequeue(v, &ts));
+
+        // Terminated fifo releases a blocked consumer
+        std::thread consumer([&]() { long x; errors = q.dequeue(x); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        q.terminate();
+        consumer.join();
+        BOOST_CHECK_EQUAL(-1, errors);
+    }
+}